@@ -24,6 +24,7 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 using std::endl;
 
 auto_ptr<Output_format> output_format;
+auto_ptr<Output_format> linked_output_format;	// Set by programs linking DIAMOND, replaces --outfmt
 
 void Output_format::print_title(Text_buffer &buf, const char *id, bool full_titles, bool all_titles, const char *separator)
 {
@@ -65,6 +66,8 @@ void print_hsp(Hsp_data &hsp, sequence query)
 
 Output_format* get_output_format()
 {
+	if (linked_output_format.get())
+		return linked_output_format->clone();
 	const vector<string> &f = config.output_format;
 	if (f.size() == 0) {
 		if (config.daa_file == "" || config.command == Config::view)
@@ -55,6 +55,7 @@ struct Output_format
 };
 
 extern auto_ptr<Output_format> output_format;
+extern auto_ptr<Output_format> linked_output_format;
 
 struct Null_format : public Output_format
 {
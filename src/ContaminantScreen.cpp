@@ -0,0 +1,454 @@
+/*
+ *
+ * Developed by Alexander Hart
+ * Plant Computational Genomics Lab
+ * University of Connecticut
+ *
+ * For information, contact Alexander Hart at:
+ *     entap.dev@gmail.com
+ *
+ * Copyright 2017-2019, Alexander Hart, Dr. Jill Wegrzyn
+ *
+ * This file is part of EnTAP.
+ *
+ * EnTAP is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * EnTAP is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with EnTAP.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+//*********************** Includes *****************************
+#include <atomic>
+#include <mutex>
+#include "ContaminantScreen.h"
+//**************************************************************
+
+
+/**
+ * ======================================================================
+ * Function ContaminantScreen::ContaminantScreen(std::string &input, EntapDataPtrs &entap_data)
+ *
+ * Description          - Pre-search contamination screen of transcripts
+ *                        against user contaminant reference FASTAs
+ *
+ * Notes                - Constructor
+ *
+ * @param input         - Path to transcriptome that will be searched
+ * @param entap_data    - Entap data pointers
+ *
+ * @return              - None
+ *
+ * =====================================================================
+ */
+ContaminantScreen::ContaminantScreen(std::string &input, EntapDataPtrs &entap_data) {
+    FS_dprint("Spawn Object - ContaminantScreen");
+
+    _pQueryData      = entap_data._pQueryData;
+    _pFileSystem     = entap_data._pFileSystem;
+    _pUserInput      = entap_data._pUserInput;
+    _inpath          = input;
+
+    _outpath         = PATHS(_pFileSystem->get_root_path(), SCREEN_OUT_DIR);
+    _reference_paths = _pUserInput->get_user_input<vect_str_t>(_pUserInput->INPUT_FLAG_CONTAM_SCREEN);
+    _min_fraction    = _pUserInput->get_user_input<fp32>(_pUserInput->INPUT_FLAG_CONTAM_SCREEN_MIN);
+    _skip            = _pUserInput->has_input(_pUserInput->INPUT_FLAG_CONTAM_SCREEN_SKIP);
+    _threads         = _pUserInput->get_supported_threads();
+    _is_nucleotide   = true;
+    _kmer            = NUCL_KMER;
+    _window          = NUCL_WINDOW;
+}
+
+
+/**
+ * ======================================================================
+ * Function bool ContaminantScreen::is_enabled(UserInput *user_input)
+ *
+ * Description          - Whether contaminant references were given
+ *
+ * Notes                - None
+ *
+ * @param user_input    - User input
+ *
+ * @return              - True if --contam-screen was used
+ *
+ * =====================================================================
+ */
+bool ContaminantScreen::is_enabled(UserInput *user_input) {
+    return user_input->has_input(user_input->INPUT_FLAG_CONTAM_SCREEN);
+}
+
+
+/**
+ * ======================================================================
+ * Function std::string ContaminantScreen::execute(std::string input)
+ *
+ * Description          - Indexes reference minimizers, then classifies
+ *                        each kept transcript by the fraction of its
+ *                        minimizers found in the references
+ *                      - Transcripts at or above --contam-screen-min are
+ *                        flagged QUERY_CONTAM_SCREEN, and left out of the
+ *                        FASTA to search with --contam-screen-skip
+ *
+ * Notes                - Nucleotide transcripts are screened with
+ *                        canonical k-mers, protein only input with amino
+ *                        acid k-mers (references must match)
+ *
+ * @param input         - Path to transcriptome that will be searched
+ *
+ * @return              - Path to FASTA to search
+ *
+ * =====================================================================
+ */
+std::string ContaminantScreen::execute(std::string input) {
+    std::vector<QuerySequence*>     queries;
+    vect_str_t                      query_ids;
+    std::vector<ScreenResult>       results;
+    std::vector<std::thread>        threads;
+    std::atomic<uint64>             next_query(0);
+    std::exception_ptr              error;
+    std::mutex                      error_mutex;
+    std::stringstream               out_msg;
+    std::string                     out_msg_str;
+    std::string                     out_hits;
+    std::vector<uint32>                   reference_counts(_reference_paths.size() + 1, 0);  // Last is ambiguous
+    uint64                          count_flagged=0;
+
+    _inpath = input;
+    _skipped.clear();
+    _pFileSystem->create_dir(_outpath);
+    out_hits = PATHS(_outpath, OUT_HITS_FILENAME);
+
+    // Sequences still in the pipeline
+    _is_nucleotide = false;
+    for (auto &pair : *_pQueryData->get_sequences_ptr()) {
+        if (!pair.second->is_kept()) continue;
+        queries.push_back(pair.second);
+        query_ids.push_back(pair.first);
+        if (!pair.second->get_sequence_n().empty()) _is_nucleotide = true;
+    }
+    _kmer   = _is_nucleotide ? NUCL_KMER : PROT_KMER;
+    _window = _is_nucleotide ? NUCL_WINDOW : PROT_WINDOW;
+
+    build_index();
+
+    FS_dprint("Screening " + std::to_string(queries.size()) + " sequences for contaminants...");
+    results.resize(queries.size());
+    for (int i = 0; i < std::max(_threads, 1); i++) {
+        threads.emplace_back([&]() {
+            std::vector<uint64> minimizers;
+            try {
+                for (uint64 q = next_query++; q < queries.size(); q = next_query++) {
+                    results[q] = classify(get_residues(_is_nucleotide ? queries[q]->get_sequence_n() :
+                                                                        queries[q]->get_sequence_p()), minimizers);
+                }
+            } catch (...) {
+                std::lock_guard<std::mutex> lock(error_mutex);
+                error = std::current_exception();
+                next_query = queries.size();
+            }
+        });
+    }
+    for (std::thread &thread : threads) {
+        thread.join();
+    }
+    if (error) std::rethrow_exception(error);
+
+    // Flag and write results
+    _pFileSystem->delete_file(out_hits);
+    std::ofstream hits_file(out_hits, std::ios::out | std::ios::app);
+    hits_file << "Query\tReference\tShared minimizers\tQuery minimizers\tFraction" << std::endl;
+    for (uint64 q = 0; q < queries.size(); q++) {
+        ScreenResult &result = results[q];
+        if (result.minimizers < MIN_MINIMIZERS) continue;
+        if ((fp32) result.shared / result.minimizers < _min_fraction) continue;
+
+        QuerySequence *query = queries[q];
+        query->QUERY_FLAG_SET(QuerySequence::QUERY_CONTAM_SCREEN);
+        count_flagged++;
+        bool is_ambiguous = result.reference == AMBIGUOUS_REFERENCE;
+        reference_counts[is_ambiguous ? _reference_paths.size() : result.reference]++;
+        hits_file << query_ids[q] << '\t'
+                  << (is_ambiguous ? "ambiguous" : _pFileSystem->get_filename(_reference_paths[result.reference], true))
+                  << '\t' << result.shared << '\t' << result.minimizers << '\t'
+                  << float_to_string((fp64) result.shared / result.minimizers) << std::endl;
+        if (_skip) {
+            query->QUERY_FLAG_CLEAR(QuerySequence::QUERY_CONTAM_SCREEN_KEPT);
+            _skipped.insert(query_ids[q]);
+        }
+    }
+    hits_file.close();
+
+    _pFileSystem->format_stat_stream(out_msg, "Contaminant Pre-screen");
+    out_msg <<
+            "Sequences screened: "                         << queries.size() <<
+            "\nSequences flagged as contaminants: "        << count_flagged  <<
+            " (at least " << float_to_string(_min_fraction * 100) << "% of minimizers shared)";
+    for (uint16 i = 0; i < _reference_paths.size(); i++) {
+        out_msg << "\n\t" << _pFileSystem->get_filename(_reference_paths[i], true) << ": " << reference_counts[i];
+    }
+    out_msg << "\n\tMore than one reference: " << reference_counts.back();
+    if (_skip) out_msg << "\nFlagged sequences will not be searched";
+    out_msg << "\nResults written to: " << out_hits;
+    out_msg_str = out_msg.str();
+    _pFileSystem->print_stats(out_msg_str);
+
+    FS_dprint("Success! Contaminant screen complete");
+    return remove_skipped(_inpath);
+}
+
+
+/**
+ * ======================================================================
+ * Function std::string ContaminantScreen::remove_skipped(std::string input)
+ *
+ * Description          - Leaves sequences flagged with --contam-screen-skip
+ *                        out of a FASTA that will be searched
+ *
+ * Notes                - Called by execute(), and for any other FASTA of
+ *                        the same sequences (masked similarity search query)
+ *
+ * @param input         - Path to FASTA
+ *
+ * @return              - Path to FASTA without skipped sequences, input if
+ *                        none were skipped
+ *
+ * =====================================================================
+ */
+std::string ContaminantScreen::remove_skipped(std::string input) {
+    std::string     out_kept;
+    std::string     line;
+    std::string     seq_id;
+    bool            is_skipped=false;
+
+    if (!_skip || _skipped.empty()) return input;
+
+    out_kept = PATHS(_outpath, _pFileSystem->get_filename(input, false) + OUT_KEPT_TAG);
+    std::ifstream in_file(input);
+    _pFileSystem->delete_file(out_kept);
+    std::ofstream kept_file(out_kept, std::ios::out | std::ios::app);
+    while (std::getline(in_file, line)) {
+        if (line.find(FileSystem::FASTA_FLAG) == 0) {
+            _pQueryData->trim_sequence_header(seq_id, line);
+            is_skipped = _skipped.count(seq_id) != 0;
+        }
+        if (!is_skipped) kept_file << line << '\n';
+    }
+    kept_file.close();
+    return out_kept;
+}
+
+
+/**
+ * ======================================================================
+ * Function void ContaminantScreen::build_index()
+ *
+ * Description          - Sketches every reference sequence and stores the
+ *                        minimizers sorted with the reference they came
+ *                        from
+ *
+ * Notes                - Minimizers in more than one reference are kept
+ *                        as AMBIGUOUS_REFERENCE
+ *
+ * @return              - None
+ *
+ * =====================================================================
+ */
+void ContaminantScreen::build_index() {
+    std::vector<std::pair<uint64, uint16>> entries;
+    std::vector<uint64>                    minimizers;
+    std::string                            line;
+    std::string                            sequence;
+
+    if (_reference_paths.size() >= AMBIGUOUS_REFERENCE) {
+        throw ExceptionHandler("Too many contaminant references", ERR_ENTAP_INPUT_PARSE);
+    }
+
+    for (uint16 ref = 0; ref < _reference_paths.size(); ref++) {
+        FS_dprint("Indexing contaminant reference: " + _reference_paths[ref]);
+        std::ifstream in_file(_reference_paths[ref]);
+        if (!in_file.is_open()) {
+            throw ExceptionHandler("Unable to open contaminant reference: " + _reference_paths[ref],
+                                   ERR_ENTAP_INPUT_PARSE);
+        }
+        sequence.clear();
+        while (true) {
+            bool is_eof = !std::getline(in_file, line);
+            if (is_eof || line.find(FileSystem::FASTA_FLAG) == 0) {
+                sketch(sequence, minimizers);
+                for (uint64 minimizer : minimizers) entries.emplace_back(minimizer, ref);
+                sequence.clear();
+                if (is_eof) break;
+            } else {
+                sequence += line;
+            }
+        }
+    }
+
+    std::sort(entries.begin(), entries.end());
+    _index_keys.clear();
+    _index_refs.clear();
+    for (auto &entry : entries) {
+        if (!_index_keys.empty() && _index_keys.back() == entry.first) {
+            if (_index_refs.back() != entry.second) _index_refs.back() = AMBIGUOUS_REFERENCE;
+            continue;
+        }
+        _index_keys.push_back(entry.first);
+        _index_refs.push_back(entry.second);
+    }
+    FS_dprint("Contaminant index built with " + std::to_string(_index_keys.size()) + " minimizers (k=" +
+              std::to_string(_kmer) + ", w=" + std::to_string(_window) + ")");
+}
+
+
+/**
+ * ======================================================================
+ * Function void ContaminantScreen::sketch(const std::string &sequence,
+ *                                         std::vector<uint64> &minimizers)
+ *
+ * Description          - Minimizer sketch, the lowest hashed k-mer of each
+ *                        window of _window consecutive k-mers
+ *
+ * Notes                - Nucleotide k-mers are canonical (strand
+ *                        independent). Ambiguous residues restart the
+ *                        k-mer
+ *
+ * @param sequence      - Residues
+ * @param minimizers    - Set to hashed minimizers, in sequence order
+ *
+ * @return              - None
+ *
+ * =====================================================================
+ */
+void ContaminantScreen::sketch(const std::string &sequence, std::vector<uint64> &minimizers) {
+    static const std::string AMINO_ACIDS = "ACDEFGHIKLMNPQRSTVWY";
+    uint16      bits = _is_nucleotide ? 2 : 5;
+    uint64      mask = (1ULL << (bits * _kmer)) - 1;
+    uint64      forward=0;
+    uint64      reverse=0;
+    uint64      kmers=0;                // Since last ambiguous residue
+    uint64      last_pos=UINT64_MAX;    // Position of last minimizer added
+    uint16      length=0;
+    int         code;
+    std::vector<std::pair<uint64, uint64>> window(_window);    // Hash, position
+
+    minimizers.clear();
+    for (uint64 i = 0; i < sequence.size(); i++) {
+        char c = (char) toupper(sequence[i]);
+        if (_is_nucleotide) {
+            switch (c) {
+                case 'A': code = 0; break;
+                case 'C': code = 1; break;
+                case 'G': code = 2; break;
+                case 'T': case 'U': code = 3; break;
+                default:  code = -1; break;
+            }
+        } else {
+            size_t pos = AMINO_ACIDS.find(c);
+            code = pos == std::string::npos ? -1 : (int) pos;
+        }
+        if (code < 0) {
+            length = 0;
+            kmers  = 0;
+            continue;
+        }
+
+        forward = ((forward << bits) | (uint64) code) & mask;
+        if (_is_nucleotide) reverse = (reverse >> 2) | ((uint64) (3 - code) << (2 * (_kmer - 1)));
+        if (length < _kmer) length++;
+        if (length < _kmer) continue;
+
+        window[kmers % _window] = {hash64(_is_nucleotide ? std::min(forward, reverse) : forward, mask), i};
+        if (++kmers < _window) continue;
+
+        auto minimum = window[0];
+        for (uint16 w = 1; w < _window; w++) {
+            if (window[w].first < minimum.first) minimum = window[w];
+        }
+        if (minimum.second != last_pos) {
+            minimizers.push_back(minimum.first);
+            last_pos = minimum.second;
+        }
+    }
+}
+
+
+/**
+ * ======================================================================
+ * Function ContaminantScreen::ScreenResult ContaminantScreen::classify(
+ *                                      const std::string &sequence,
+ *                                      std::vector<uint64> &minimizers)
+ *
+ * Description          - Counts transcript minimizers found in the
+ *                        reference index and the reference sharing most
+ *
+ * Notes                - Thread safe, index is read only
+ *
+ * @param sequence      - Transcript residues
+ * @param minimizers    - Buffer for sketch
+ *
+ * @return              - Screen result
+ *
+ * =====================================================================
+ */
+ContaminantScreen::ScreenResult ContaminantScreen::classify(const std::string &sequence,
+                                                            std::vector<uint64> &minimizers) {
+    ScreenResult    result;
+    std::vector<uint32>   counts(_reference_paths.size(), 0);
+    uint32          best=0;
+
+    sketch(sequence, minimizers);
+    result.minimizers = (uint32) minimizers.size();
+    for (uint64 minimizer : minimizers) {
+        auto it = std::lower_bound(_index_keys.begin(), _index_keys.end(), minimizer);
+        if (it == _index_keys.end() || *it != minimizer) continue;
+        result.shared++;
+        uint16 ref = _index_refs[it - _index_keys.begin()];
+        if (ref != AMBIGUOUS_REFERENCE) counts[ref]++;
+    }
+    result.reference = AMBIGUOUS_REFERENCE;
+    for (uint16 ref = 0; ref < counts.size(); ref++) {
+        if (counts[ref] > best) {
+            best = counts[ref];
+            result.reference = ref;
+        }
+    }
+    return result;
+}
+
+
+// Residues of a FASTA entry (">header\nSEQ\nSEQ"), without the header and line breaks
+std::string ContaminantScreen::get_residues(const std::string &fasta_entry) {
+    std::string residues;
+    size_t      start = 0;
+
+    if (!fasta_entry.empty() && fasta_entry[0] == FileSystem::FASTA_FLAG) {
+        start = fasta_entry.find('\n');
+        if (start == std::string::npos) return residues;
+    }
+    residues.reserve(fasta_entry.size() - start);
+    for (size_t i = start; i < fasta_entry.size(); i++) {
+        if (!isspace(fasta_entry[i])) residues += fasta_entry[i];
+    }
+    return residues;
+}
+
+
+// Invertible integer hash (within mask) so minimizers are not biased to low k-mers
+uint64 ContaminantScreen::hash64(uint64 key, uint64 mask) {
+    key = (~key + (key << 21)) & mask;
+    key = key ^ key >> 24;
+    key = ((key + (key << 3)) + (key << 8)) & mask;
+    key = key ^ key >> 14;
+    key = ((key + (key << 2)) + (key << 4)) & mask;
+    key = key ^ key >> 28;
+    key = (key + (key << 31)) & mask;
+    return key;
+}
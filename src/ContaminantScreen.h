@@ -0,0 +1,89 @@
+/*
+ *
+ * Developed by Alexander Hart
+ * Plant Computational Genomics Lab
+ * University of Connecticut
+ *
+ * For information, contact Alexander Hart at:
+ *     entap.dev@gmail.com
+ *
+ * Copyright 2017-2019, Alexander Hart, Dr. Jill Wegrzyn
+ *
+ * This file is part of EnTAP.
+ *
+ * EnTAP is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * EnTAP is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with EnTAP.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef ENTAP_CONTAMINANTSCREEN_H
+#define ENTAP_CONTAMINANTSCREEN_H
+
+//*********************** Includes *****************************
+#include <unordered_set>
+#include "QuerySequence.h"
+#include "QueryData.h"
+#include "common.h"
+#include "FileSystem.h"
+//**************************************************************
+
+class ContaminantScreen {
+public:
+    ContaminantScreen(std::string&, EntapDataPtrs&);
+    std::string execute(std::string);
+    std::string remove_skipped(std::string);
+    static bool is_enabled(UserInput*);
+
+private:
+
+    // Screening result for a transcript
+    struct ScreenResult {
+        uint32      minimizers=0;       // Minimizers in transcript
+        uint32      shared=0;           // Minimizers found in any reference
+        uint16      reference=0;        // Reference sharing the most minimizers
+    };
+
+    const std::string SCREEN_OUT_DIR        = "contam_screen/";
+    const std::string OUT_HITS_FILENAME     = "contam_screen_hits.tsv";
+    const std::string OUT_KEPT_TAG          = "_contam_screened.fasta";
+    const uint16      NUCL_KMER             = 21;   // Canonical nucleotide k-mers
+    const uint16      NUCL_WINDOW           = 11;   // k-mers per minimizer window
+    const uint16      PROT_KMER             = 7;    // Amino acid k-mers (5 bits per residue)
+    const uint16      PROT_WINDOW           = 5;
+    const uint32      MIN_MINIMIZERS        = 5;    // Fewer are not classified
+    const uint16      AMBIGUOUS_REFERENCE   = 0xFFFF;  // Minimizer in more than one reference
+
+    std::string       _inpath;
+    std::string       _outpath;
+    vect_str_t        _reference_paths;
+    fp32              _min_fraction;
+    bool              _skip;
+    bool              _is_nucleotide;
+    int               _threads;
+    uint16            _kmer;
+    uint16            _window;
+    std::unordered_set<std::string> _skipped;  // Flagged with --contam-screen-skip
+    std::vector<uint64> _index_keys;   // Sorted reference minimizers
+    std::vector<uint16> _index_refs;   // Reference of each minimizer
+    QueryData        *_pQueryData;
+    FileSystem       *_pFileSystem;
+    UserInput        *_pUserInput;
+
+    void build_index();
+    void sketch(const std::string &sequence, std::vector<uint64> &minimizers);
+    ScreenResult classify(const std::string &sequence, std::vector<uint64> &minimizers);
+    static std::string get_residues(const std::string &fasta_entry);
+    static uint64 hash64(uint64 key, uint64 mask);
+};
+
+
+#endif //ENTAP_CONTAMINANTSCREEN_H
@@ -31,6 +31,10 @@
 #include "database/EggnogDatabase.h"
 #include "TerminalCommands.h"
 #include "FileSystem.h"
+#include "similarity_search/ModDiamond.h"
+#include "similarity_search/SubjectIndex.h"
+#include "database/TaxonFilter.h"
+#include "database/MappedDatabase.h"
 //**************************************************************
 
 namespace entapConfig {
@@ -53,11 +57,18 @@ namespace entapConfig {
     FileSystem               *_pFileSystem;
     UserInput                *_pUserInput;
 
+    const std::string        TAXON_FILTER_TAG      = "_restricted";
+    const std::string        TAXON_FILTER_TAXA_EXT = ".taxa";
+
     //****************** Local Prototype Functions******************
     void init_entap_database();
+    void configure_entap_database(EntapDatabase::DATABASE_TYPE, std::string&, std::stringstream&);
     void init_uniprot(std::vector<std::string>&, std::string);
     void init_ncbi(std::vector<std::string>&, std::string);
     void init_diamond_index(std::string, int);
+    void init_diamond_merged_index(std::string, int, std::stringstream&);
+    void init_subject_index(std::string&, std::string&, std::stringstream&);
+    void init_taxon_filter(int, std::stringstream&);
     void init_eggnog(int);
     void handle_state();
 
@@ -239,6 +250,8 @@ namespace entapConfig {
 
         _pFileSystem->format_stat_stream(log_msg, "DIAMOND Database Configuration");
 
+        init_taxon_filter(threads, log_msg);
+
         for (std::string &fasta_path: _compiled_databases) {
             TerminalData terminalData = TerminalData();
 
@@ -250,6 +263,7 @@ namespace entapConfig {
             if (_pFileSystem->file_exists(indexed_path + ".dmnd")) {
                 FS_dprint("File found at " + indexed_path + ".dmnd, skipping...");
                 log_msg << "DIAMOND database skipped, exists at: " << indexed_path << std::endl;
+                init_subject_index(fasta_path, indexed_path, log_msg);
                 continue;
             }
 
@@ -272,13 +286,254 @@ namespace entapConfig {
             }
             FS_dprint("Database successfully indexed to: " + indexed_path + FileSystem::EXT_DMND);
             log_msg << "DIAMOND database generated to: " << indexed_path << FileSystem::EXT_DMND << std::endl;
+            init_subject_index(fasta_path, indexed_path, log_msg);
         } // END LOOP
 
+        if (_pUserInput->has_input(_pUserInput->INPUT_FLAG_DMND_MERGE)) {
+            init_diamond_merged_index(diamond_exe, threads, log_msg);
+        }
+
         std::string temp = log_msg.str();
         _pFileSystem->print_stats(temp);
     }
 
 
+    /**
+     * ======================================================================
+     * Function init_taxon_filter(int threads, std::stringstream &log_msg)
+     *
+     * Description          - Restricts every user specified FASTA database to
+     *                        subjects within the include taxa and outside the
+     *                        exclude taxa, the filtered databases are indexed
+     *                        with DIAMOND in their place
+     *                      - Taxa used are written beside each filtered
+     *                        database, it is regenerated (along with its
+     *                        DIAMOND database) when they change
+     *
+     * Notes                - Species are resolved through the EnTAP database
+     *
+     * @param threads       - Thread number
+     * @param log_msg       - Configuration log
+     *
+     * @return              - None
+     *
+     * =====================================================================
+     */
+    void init_taxon_filter(int threads, std::stringstream &log_msg) {
+        vect_str_t   include;
+        vect_str_t   exclude;
+        vect_uint16_t database_types;
+        std::string  filtered_path;
+        std::string  taxa_path;
+        std::string  indexed_path;
+        std::string  extension;
+        std::stringstream taxa;
+        std::unique_ptr<TaxonFilter> taxon_filter;
+        TaxonFilter::FilterStats stats;
+
+        include = _pUserInput->get_user_taxa(_pUserInput->INPUT_FLAG_RESTRICT_TAXON);
+        exclude = _pUserInput->get_user_taxa(_pUserInput->INPUT_FLAG_EXCLUDE_TAXON);
+        if (include.empty() && exclude.empty()) return;
+
+        for (std::string &taxon : include) taxa << "include\t" << taxon << '\n';
+        for (std::string &taxon : exclude) taxa << "exclude\t" << taxon << '\n';
+
+        for (std::string &fasta_path : _compiled_databases) {
+            extension = _pFileSystem->get_file_extension(fasta_path, false);
+            if (extension == ".gz" || extension == FileSystem::EXT_DMND) {
+                throw ExceptionHandler("Only uncompressed FASTA databases can be restricted by taxon: " + fasta_path,
+                                       ERR_ENTAP_INIT_INDX_DATABASE);
+            }
+            filtered_path = PATHS(_data_dir, _pFileSystem->get_filename(fasta_path, false) + TAXON_FILTER_TAG +
+                                             FileSystem::EXT_FAA);
+            taxa_path     = filtered_path + TAXON_FILTER_TAXA_EXT;
+            indexed_path  = PATHS(_bin_dir, _pFileSystem->get_filename(filtered_path, false)) + FileSystem::EXT_DMND;
+
+            std::ifstream taxa_file(taxa_path);
+            std::stringstream previous_taxa;
+            previous_taxa << taxa_file.rdbuf();
+            taxa_file.close();
+            if (_pFileSystem->file_exists(filtered_path) && previous_taxa.str() == taxa.str()) {
+                FS_dprint("File found at " + filtered_path + ", skipping...");
+                log_msg << "Taxon restricted database skipped, exists at: " << filtered_path << std::endl;
+                fasta_path = filtered_path;
+                continue;
+            }
+
+            if (!taxon_filter) {
+                // Taxonomy is needed to resolve species
+                database_types = _pUserInput->get_user_input<vect_uint16_t>(_pUserInput->INPUT_FLAG_DATABASE_TYPE);
+                if (!_pEntapDatabase->set_database(static_cast<EntapDatabase::DATABASE_TYPE>(database_types[0]))) {
+                    throw ExceptionHandler("Unable to open EnTAP database to restrict by taxon\n" +
+                                           _pEntapDatabase->print_error_log(), ERR_ENTAP_READ_ENTAP_DATA_GENERIC);
+                }
+                taxon_filter.reset(new TaxonFilter(_pFileSystem, _pEntapDatabase, include, exclude, threads));
+            }
+
+            // Previous DIAMOND database and subject index were built from other taxa
+            _pFileSystem->delete_file(taxa_path);
+            _pFileSystem->delete_file(indexed_path);
+            _pFileSystem->delete_file(indexed_path + SubjectIndex::INDEX_EXT);
+
+            stats = taxon_filter->filter(fasta_path, filtered_path);
+            std::ofstream out_taxa(taxa_path, std::ios::out | std::ios::trunc);
+            out_taxa << taxa.str();
+            out_taxa.close();
+
+            log_msg << "Taxon restricted database generated to: " << filtered_path <<
+                    "\n\tSubjects kept: " << stats.kept << "/" << stats.total <<
+                    "\n\tSubjects outside of taxa: " << stats.excluded <<
+                    "\n\tSubjects without taxonomy: " << stats.no_taxonomy << std::endl;
+            fasta_path = filtered_path;
+        }
+    }
+
+
+    /**
+     * ======================================================================
+     * Function init_subject_index(std::string &fasta_path, std::string &indexed_path,
+     *                             std::stringstream &log_msg)
+     *
+     * Description          - Builds the subject index (species, UniProt accession
+     *                        and informativeness of every subject) beside a
+     *                        DIAMOND database so hits are not parsed from their
+     *                        titles during execution
+     *
+     * Notes                - Only uncompressed FASTA databases can be indexed,
+     *                        others are parsed from titles during execution
+     *                      - Existing index is rebuilt if it cannot be loaded
+     *                        (older format or corrupt)
+     *
+     * @param fasta_path    - Database FASTA
+     * @param indexed_path  - DIAMOND database path (without extension)
+     * @param log_msg       - Configuration log
+     *
+     * @return              - None
+     *
+     * =====================================================================
+     */
+    void init_subject_index(std::string &fasta_path, std::string &indexed_path, std::stringstream &log_msg) {
+        std::string index_path;
+        std::string extension;
+        uint64      subjects;
+
+        index_path = indexed_path + FileSystem::EXT_DMND + SubjectIndex::INDEX_EXT;
+        if (_pFileSystem->file_exists(index_path)) {
+            SubjectIndex existing;
+            if (existing.load(index_path, _pUserInput->get_uninformative_vect(), 0)) {
+                FS_dprint("Subject index found at " + index_path + ", skipping...");
+                return;
+            }
+            FS_dprint("Subject index at " + index_path + " is outdated or corrupt, rebuilding...");
+        }
+        extension = _pFileSystem->get_file_extension(fasta_path, false);
+        if (extension == ".gz" || extension == FileSystem::EXT_DMND || !_pFileSystem->file_exists(fasta_path)) {
+            FS_dprint("Subject index not built, database is not an uncompressed FASTA: " + fasta_path);
+            return;
+        }
+        subjects = SubjectIndex::build(_pFileSystem, fasta_path, index_path, _pUserInput->get_uninformative_vect());
+        log_msg << "Subject index (" << subjects << " subjects) generated to: " << index_path << std::endl;
+    }
+
+
+    /**
+     * ======================================================================
+     * Function init_diamond_merged_index(std::string diamond_exe, int threads,
+     *                                    std::stringstream &log_msg)
+     *
+     * Description          - Indexes every user specified FASTA database into
+     *                        a single DIAMOND database so one search covers
+     *                        all of them
+     *                      - Subject IDs are tagged with the database index,
+     *                        tags are listed in a sidecar file that is used to
+     *                        route hits back to each database during execution
+     *
+     * Notes                - Sidecar is written last, a merged database
+     *                        without it, or whose sidecar lists different
+     *                        databases than configured, is rebuilt
+     *
+     * @param diamond_exe   - Path to DIAMOND exe
+     * @param threads       - Thread number
+     * @param log_msg       - Configuration log
+     *
+     * @return              - None
+     *
+     * =====================================================================
+     */
+    void init_diamond_merged_index(std::string diamond_exe, int threads, std::stringstream &log_msg) {
+        std::string  indexed_path;
+        std::string  manifest_path;
+        std::string  merged_fasta;
+        std::string  line;
+        std::string  tag;
+        std::string  extension;
+        std::stringstream manifest;
+        TerminalData terminalData = TerminalData();
+
+        indexed_path  = PATHS(_bin_dir, ModDiamond::MERGED_DATABASE_NAME);
+        manifest_path = indexed_path + FileSystem::EXT_DMND + ModDiamond::MERGED_MANIFEST_EXT;
+        merged_fasta  = indexed_path + FileSystem::EXT_FAA;
+
+        // Sidecar of the configured databases, compared with the existing one
+        for (uint16 i = 0; i < _compiled_databases.size(); i++) {
+            std::string &fasta_path = _compiled_databases[i];
+            extension = _pFileSystem->get_file_extension(fasta_path, false);
+            if (extension == ".gz" || extension == FileSystem::EXT_DMND) {
+                throw ExceptionHandler("Only uncompressed FASTA databases can be merged: " + fasta_path,
+                                       ERR_ENTAP_INIT_INDX_DATABASE);
+            }
+            manifest << i << '\t' << _pFileSystem->get_filename(fasta_path, false) << '\n';
+        }
+
+        if (_pFileSystem->file_exists(indexed_path + FileSystem::EXT_DMND) && _pFileSystem->file_exists(manifest_path)) {
+            std::ifstream existing_file(manifest_path);
+            std::stringstream existing;
+            existing << existing_file.rdbuf();
+            if (existing.str() == manifest.str()) {
+                FS_dprint("File found at " + indexed_path + FileSystem::EXT_DMND + ", skipping...");
+                log_msg << "Merged DIAMOND database skipped, exists at: " << indexed_path << std::endl;
+                return;
+            }
+            FS_dprint("Merged DIAMOND database was built from different databases, rebuilding...");
+        }
+        _pFileSystem->delete_file(manifest_path);
+        FS_dprint("Merging databases into: " + indexed_path + FileSystem::EXT_DMND);
+
+        // Combine databases, tagging each subject with its database
+        std::ofstream out_fasta(merged_fasta, std::ios::out | std::ios::trunc);
+        for (uint16 i = 0; i < _compiled_databases.size(); i++) {
+            std::string &fasta_path = _compiled_databases[i];
+            tag = ModDiamond::get_merged_tag(i);
+            std::ifstream in_fasta(fasta_path);
+            while (std::getline(in_fasta, line)) {
+                if (!line.empty() && line[0] == FileSystem::FASTA_FLAG) {
+                    out_fasta << FileSystem::FASTA_FLAG << tag << line.substr(1) << '\n';
+                } else {
+                    out_fasta << line << '\n';
+                }
+            }
+        }
+        out_fasta.close();
+
+        terminalData.command       = diamond_exe + " makedb --in " + merged_fasta +
+                                     " -d " + indexed_path + " -p " + std::to_string(threads);
+        terminalData.base_std_path = indexed_path + "_std";
+        terminalData.print_files   = true;
+        if (TC_execute_cmd(terminalData) != 0) {
+            throw ExceptionHandler("Error indexing merged database at: " + merged_fasta + "\nDIAMOND Error: " +
+                                   terminalData.err_stream, ERR_ENTAP_INIT_INDX_DATABASE);
+        }
+        _pFileSystem->delete_file(merged_fasta);
+
+        std::ofstream manifest_file(manifest_path, std::ios::out | std::ios::trunc);
+        manifest_file << manifest.str();
+        manifest_file.close();
+
+        FS_dprint("Database successfully indexed to: " + indexed_path + FileSystem::EXT_DMND);
+        log_msg << "Merged DIAMOND database generated to: " << indexed_path << FileSystem::EXT_DMND << std::endl;
+    }
+
+
     /**
      * ======================================================================
      * Function init_eggnog(std::string eggnog_exe)
@@ -422,6 +677,7 @@ namespace entapConfig {
         if (_pEntapDatabase == nullptr) {
             throw ExceptionHandler("Unable to allocate Entap Database memory", ERR_ENTAP_MEM_ALLOC);
         }
+        _pEntapDatabase->set_threads(_pUserInput->get_supported_threads());
 
         // If user would like to generate databases rather than download them from ftp(default)
         generate_databases = _pUserInput->has_input(_pUserInput->INPUT_FLAG_GENERATE);
@@ -461,6 +717,7 @@ namespace entapConfig {
                 if (_pFileSystem->file_exists(database_outpath)) path = database_outpath;
                 FS_dprint("File already exists at: " + path);
                 log_msg << "Database skipped, already exists at: " << path << std::endl;
+                configure_entap_database(database_type, path, log_msg);
                 continue; // Don't redownload
             }
 
@@ -477,6 +734,7 @@ namespace entapConfig {
             if (database_err == EntapDatabase::ERR_DATA_OK) {
                 FS_dprint("Success! Database written to: " + database_outpath);
                 log_msg << "Database written to: " + database_outpath << std::endl;
+                configure_entap_database(database_type, database_outpath, log_msg);
             } else {
                 // Fatal if any databases fail
                 throw ExceptionHandler(_pEntapDatabase->print_error_log(), ERR_ENTAP_INIT_DATA_GENERIC);
@@ -487,4 +745,38 @@ namespace entapConfig {
         std::string temp = log_msg.str();
         _pFileSystem->print_stats(temp);
     }
+
+
+    /**
+     * ======================================================================
+     * Function void configure_entap_database(EntapDatabase::DATABASE_TYPE type,
+     *                                        std::string &path,
+     *                                        std::stringstream &log_msg)
+     *
+     * Description          - Prepares an EnTAP database for execution (memory
+     *                        mapped copy of the serialized database, legacy
+     *                        SQL database migrated to the current schema)
+     *
+     * Notes                - Not fatal, execution falls back to reading the
+     *                        database as is
+     *
+     * @param type          - Type of database
+     * @param path          - Path to database
+     * @param log_msg       - Configuration log
+     *
+     * @return              - None
+     *
+     * =====================================================================
+     */
+    void configure_entap_database(EntapDatabase::DATABASE_TYPE type, std::string &path, std::stringstream &log_msg) {
+        if (_pEntapDatabase->configure_database(type, path)) {
+            if (type == EntapDatabase::ENTAP_SERIALIZED) {
+                log_msg << "Memory mapped database at: " << path << MappedDatabase::MAPPED_EXT << std::endl;
+            }
+        } else {
+            FS_dprint("WARNING: unable to prepare EnTAP database at: " + path + _pEntapDatabase->print_error_log());
+            log_msg << "WARNING: unable to prepare EnTAP database, it will be read as is during execution" <<
+                    _pEntapDatabase->print_error_log() << std::endl;
+        }
+    }
 }
@@ -39,6 +39,7 @@ namespace entapExecute {
     std::string             _entap_outpath;
     bool                    _blastp;          // false for blastx, true for _blastp
     std::string             _input_path;      // FASTA changes depending on execution
+    std::string             _search_path;     // Similarity search query if different (masked), else empty
     std::string             _input_basename;
     int                     _threads;
     databases_t             _databases;       // NCBI+UNIPROT+Other
@@ -84,6 +85,7 @@ namespace entapExecute {
         std::string                             final_out_dir;
         std::queue<char>                        state_queue;
         bool                                    state_flag;
+        bool                                    shard_only;      // Only a sim search shard was run
         vect_uint16_t                           entap_database_types;
         EntapDatabase::DATABASE_TYPE            entap_database_type;
         EntapDataPtrs                           entap_data_ptrs;
@@ -97,6 +99,7 @@ namespace entapExecute {
 
         executeStates           = INIT;
         state_flag              = false;
+        shard_only              = false;
         _pUserInput             = user_input;
         _pFileSystem            = filesystem;
         entap_data_ptrs         = EntapDataPtrs();
@@ -104,6 +107,7 @@ namespace entapExecute {
         // Pull relevant info input by the user
         _input_path    = _pUserInput->get_user_input<std::string>(_pUserInput->INPUT_FLAG_TRANSCRIPTOME);
         original_input = _input_path;
+        _search_path.clear();
         _blastp        = _pUserInput->has_input(_pUserInput->INPUT_FLAG_RUNPROTEIN);
         ontology_flags = _pUserInput->get_user_input<std::vector<uint16>>(_pUserInput->INPUT_FLAG_ONTOLOGY);
         state_queue    = _pUserInput->get_state_queue();    // Will NOT be empty, default is +
@@ -201,6 +205,25 @@ namespace entapExecute {
                     }
                         break;
                     case COPY_FINAL_TRANSCRIPTOME:
+                        if (SequenceFilter::is_enabled(_pUserInput)) {
+                            // Prefilter between frame selection and similarity search
+                            FS_dprint("STATE - SEQUENCE PREFILTER");
+                            std::unique_ptr<SequenceFilter> sequence_filter(new SequenceFilter(
+                                    _input_path, entap_data_ptrs
+                            ));
+                            _input_path = sequence_filter->execute(_input_path);
+                            _search_path = sequence_filter->get_masked_path();  // Masked FASTA only searched
+                            pQUERY_DATA->set_is_success_prefilter(true);
+                        }
+                        if (ContaminantScreen::is_enabled(_pUserInput)) {
+                            FS_dprint("STATE - CONTAMINANT PRE-SCREEN");
+                            std::unique_ptr<ContaminantScreen> contam_screen(new ContaminantScreen(
+                                    _input_path, entap_data_ptrs
+                            ));
+                            _input_path = contam_screen->execute(_input_path);
+                            if (!_search_path.empty()) _search_path = contam_screen->remove_skipped(_search_path);
+                            pQUERY_DATA->set_is_success_contam_screen(true);
+                        }
                         _input_path = copy_final_transcriptome(_input_path);  // Just copies final transcriptome
                         break;
                     case SIMILARITY_SEARCH: {
@@ -208,11 +231,14 @@ namespace entapExecute {
                         // Spawn sim search object
                         std::unique_ptr<SimilaritySearch> sim_search(new SimilaritySearch(
                                 _databases,
-                                _input_path,
+                                _search_path.empty() ? _input_path : _search_path,
                                 entap_data_ptrs
                         ));
-                        sim_search->execute();
-                        pQUERY_DATA->set_is_success_sim_search(true);
+                        if (sim_search->execute()) {
+                            pQUERY_DATA->set_is_success_sim_search(true);
+                        } else {
+                            shard_only = true;
+                        }
                         break;
                     }
                     case GENE_ONTOLOGY: {
@@ -229,11 +255,16 @@ namespace entapExecute {
                         executeStates = EXIT;
                         break;
                 }
+                if (shard_only) {
+                    // Remaining stages continue once all shards are merged
+                    FS_dprint("Similarity search shard executed, exiting...");
+                    break;
+                }
                 verify_state(state_queue, state_flag);
             }
 
             // *************************** Exit Stuff ********************** //
-            pQUERY_DATA->final_statistics(final_out_dir, ontology_flags);
+            if (!shard_only) pQUERY_DATA->final_statistics(final_out_dir, ontology_flags);
            // _pFileSystem->directory_iterate(FileSystem::FILE_ITER_DELETE_EMPTY, _outpath);   // Delete empty files
             delete pQUERY_DATA;
             delete pGraphingManager;
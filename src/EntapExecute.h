@@ -34,6 +34,8 @@
 #include "QuerySequence.h"
 #include "FrameSelection.h"
 #include "ExpressionAnalysis.h"
+#include "SequenceFilter.h"
+#include "ContaminantScreen.h"
 #include "SimilaritySearch.h"
 #include "FileSystem.h"
 #include "UserInput.h"
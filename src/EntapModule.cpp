@@ -44,6 +44,7 @@ EntapModule::EntapModule(std::string &execution_stage_path, std::string &in_hits
     _blastp          = _pUserInput->has_input(_pUserInput->INPUT_FLAG_RUNPROTEIN);
     _overwrite       = _pUserInput->has_input(_pUserInput->INPUT_FLAG_OVERWRITE);
     _alignment_file_types = _pUserInput->get_user_output_types();   // may be overridden at lower level
+    _output_compression   = _pUserInput->get_output_compression();
 
     _transcript_shortname = _pFileSystem->get_filename(_in_hits, false);
 
@@ -82,4 +83,29 @@ go_format_t EntapModule::EM_parse_go_list(std::string list, EntapDatabase* datab
                                              "(L=" + term_info.level + ")");
     }
     return output;
-}
\ No newline at end of file
+}
+
+/**
+ * ======================================================================
+ * Function void EntapModule::compress_output(std::string &path)
+ *
+ * Description          - Compresses a finished hit file in place when the
+ *                        user selected output compression
+ *
+ * Notes                - Hit files are read with FileSystem::open_input so
+ *                        compressed and uncompressed files are both parsed
+ *                      - Failure leaves the file uncompressed and is only
+ *                        logged
+ *
+ * @param path          - Path to hit file
+ *
+ * @return              - None
+ *
+ * =====================================================================
+ */
+void EntapModule::compress_output(std::string &path) {
+    if (_output_compression == FileSystem::ENT_FILE_UNUSED) return;
+    if (!_pFileSystem->compress_file(path, _output_compression)) {
+        FS_dprint("WARNING: unable to compress " + path + ", leaving it uncompressed\n" + _pFileSystem->get_error());
+    }
+}
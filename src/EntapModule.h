@@ -93,8 +93,10 @@ protected:
     FileSystem         *_pFileSystem;
     EntapDatabase      *_pEntapDatabase;
     std::vector<FileSystem::ENT_FILE_TYPES> _alignment_file_types; // may be overriden by module
+    FileSystem::ENT_FILE_TYPES _output_compression;    // Hit file compression, ENT_FILE_UNUSED if none
 
     go_format_t EM_parse_go_list(std::string list, EntapDatabase* database,char delim);
+    void compress_output(std::string &path);
 };
 
 
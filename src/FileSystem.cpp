@@ -29,6 +29,7 @@
 #include "ExceptionHandler.h"
 #include "EntapGlobals.h"
 #include <sys/stat.h>
+#include <pstream.h>
 #include "config.h"
 #include "TerminalCommands.h"
 
@@ -54,6 +55,11 @@ const std::string FileSystem::EXT_STD  = "_std";
 const std::string FileSystem::EXT_TSV  = ".tsv";
 const std::string FileSystem::EXT_CSV  = ".csv";
 const std::string FileSystem::EXT_LST  = ".lst";
+const std::string FileSystem::EXT_GZ   = ".gz";
+const std::string FileSystem::EXT_ZST  = ".zst";
+
+const std::string FileSystem::COMPRESS_GZIP = "gzip";
+const std::string FileSystem::COMPRESS_ZSTD = "zstd";
 
 const char FileSystem::DELIM_TSV = '\t';
 const char FileSystem::DELIM_CSV = ',';
@@ -101,7 +107,7 @@ void FileSystem::close_file(std::ofstream &ofstream) {
  * Description          - Handles printing to EnTAP debug file
  *                      - Adds bo to each entry
  *
- * Notes                - None
+ * Notes                - Thread safe
  *
  * @param msg           - Message to be sent to debug file
  * @return              - None
@@ -109,6 +115,8 @@ void FileSystem::close_file(std::ofstream &ofstream) {
  * =====================================================================
  */
 void FS_dprint(const std::string &msg) {
+    static std::mutex           debug_mutex;    // Called from worker threads (database generation)
+    std::lock_guard<std::mutex> lock(debug_mutex);
     std::ofstream debug_file(DEBUG_FILE_PATH, std::ios::out | std::ios::app);
 
     debug_file << get_cur_time() << ": " + msg << std::endl;
@@ -299,6 +307,53 @@ bool FileSystem::directory_iterate(ENT_FILE_ITER iter, std::string &path) {
 }
 
 
+/**
+ * ======================================================================
+ * Function vect_str_t FileSystem::list_files(std::string &path)
+ *
+ * Description          - Lists filenames (not full paths) within a directory
+ *
+ * Notes                - Not recursive, directories and hidden files skipped
+ *
+ * @param path          - Path to directory
+ *
+ * @return              - Filenames, empty if directory could not be read
+ * ======================================================================
+ */
+vect_str_t FileSystem::list_files(std::string &path) {
+    vect_str_t files;
+#ifdef USE_BOOST
+    if (!file_exists(path)) return files;
+    try {
+        for (boostFS::directory_iterator it(path), end; it != end; ++it) {
+            if (boostFS::is_directory(it->path())) continue;
+            std::string name = it->path().filename().string();
+            if (name.empty() || name[0] == '.') continue;
+            files.push_back(name);
+        }
+    } catch (...) {
+        files.clear();
+    }
+#else   // POSIX
+    struct dirent *entry;
+    DIR *dp;
+
+    dp = opendir(path.c_str());
+    if (dp == NULL) {
+        FS_dprint("opendir: Path could not be read: " + path);
+        return files;
+    }
+    while ((entry = readdir(dp)) != NULL) {
+        if (entry->d_name[0] == '.') continue;
+        if (entry->d_type == DT_DIR) continue;
+        files.push_back(std::string(entry->d_name));
+    }
+    closedir(dp);
+#endif
+    return files;
+}
+
+
 /**
  * ======================================================================
  * Function bool FS_file_empty(std::string path)
@@ -306,7 +361,8 @@ bool FileSystem::directory_iterate(ENT_FILE_ITER iter, std::string &path) {
  * Description          - Check if a file is empty
  *                      - Checks no line or all empty lines
  *
- * Notes                - None
+ * Notes                - Compressed files are decompressed to check, a file
+ *                        that cannot be read or decompressed is empty
  *
  * @param path          - Path to file
  *
@@ -314,20 +370,25 @@ bool FileSystem::directory_iterate(ENT_FILE_ITER iter, std::string &path) {
  * ======================================================================
  */
 bool FileSystem::file_empty(std::string path) {
-    std::ifstream file(path);
+    bool read_ok;
     bool empty;
+
+    empty = read_empty(path, read_ok);
+    if (!read_ok) FS_dprint("WARNING unable to read file (or decompressor failed): " + path);
+    return empty;
+}
+
+// True if no non-empty line can be read, read_ok false if the file/decompressor failed
+bool FileSystem::read_empty(std::string &path, bool &read_ok) {
+    std::unique_ptr<std::istream> file = open_input(path);
     std::string line;
-    empty = file.peek() == std::ifstream::traits_type::eof();
-    if (!empty) {
-        empty = true;
-        while (getline(file,line)) {
-            if (line.empty()) continue;
-            empty = false;
-            break;
-        }
+
+    read_ok = true;
+    while (getline(*file,line)) {
+        if (!line.empty()) return false;   // Decompressor may be stopped part way, nothing to check
     }
-    file.close();
-    return empty;
+    read_ok = close_input(*file);
+    return true;
 }
 
 
@@ -749,6 +810,11 @@ bool FileSystem::decompress_file(std::string &in_path, std::string &out_dir, ENT
             terminal_cmd =
                 "gunzip -c " + in_path + " > " + out_dir; //outdir will be outpath in this case
             break;
+
+        case ENT_FILE_ZST:
+            terminal_cmd =
+                "zstd -dcq " + shell_quote(in_path) + " > " + shell_quote(out_dir);
+            break;
         default:
             return false;
     }
@@ -765,6 +831,163 @@ bool FileSystem::decompress_file(std::string &in_path, std::string &out_dir, ENT
 #endif
 }
 
+/**
+ * ======================================================================
+ * Function bool FileSystem::compress_file(std::string &path, ENT_FILE_TYPES type)
+ *
+ * Description          - Compresses a file in place with gzip or zstd, the
+ *                        path is unchanged so callers do not need to know
+ *                        whether a file was compressed
+ *
+ * Notes                - Files that are already compressed are left as is
+ *                      - Compressed copy is written beside the file and
+ *                        renamed over it once complete
+ *
+ * @param path          - Path to file
+ * @param type          - ENT_FILE_GZ or ENT_FILE_ZST
+ *
+ * @return              - True if the file is compressed
+ *
+ * =====================================================================
+ */
+bool FileSystem::compress_file(std::string &path, ENT_FILE_TYPES type) {
+    TerminalData terminalData;
+    std::string  temp_path;
+
+    if (!file_exists(path)) return false;
+    if (get_compression(path) != ENT_FILE_UNUSED) return true;
+
+    switch (type) {
+        case ENT_FILE_GZ:
+            temp_path = path + EXT_GZ;
+            terminalData.command = "gzip -c " + shell_quote(path) + " > " + shell_quote(temp_path);
+            break;
+
+        case ENT_FILE_ZST:
+            temp_path = path + EXT_ZST;
+            terminalData.command = "zstd -qc " + shell_quote(path) + " > " + shell_quote(temp_path);
+            break;
+
+        default:
+            return false;
+    }
+    terminalData.print_files   = false;
+    terminalData.base_std_path = "";
+
+    FS_dprint("Compressing file at: " + path);
+    if (TC_execute_cmd(terminalData) != 0) {
+        delete_file(temp_path);
+        set_error("Unable to compress file\n" + terminalData.err_stream);
+        return false;
+    }
+    return rename_file(temp_path, path);
+}
+
+/**
+ * ======================================================================
+ * Function FileSystem::ENT_FILE_TYPES FileSystem::get_compression(const std::string &path)
+ *
+ * Description          - Finds whether a file is gzip or zstd compressed
+ *                        from its leading magic bytes
+ *
+ * Notes                - Extension is not used, compressed outputs keep
+ *                        their original names
+ *
+ * @param path          - Path to file
+ *
+ * @return              - ENT_FILE_GZ, ENT_FILE_ZST or ENT_FILE_UNUSED
+ *
+ * =====================================================================
+ */
+FileSystem::ENT_FILE_TYPES FileSystem::get_compression(const std::string &path) {
+    unsigned char magic[4] = {0};
+    std::ifstream file(path, std::ios::in | std::ios::binary);
+
+    file.read(reinterpret_cast<char*>(magic), sizeof(magic));
+    if (file.gcount() >= 2 && magic[0] == 0x1f && magic[1] == 0x8b) return ENT_FILE_GZ;
+    if (file.gcount() == 4 && magic[0] == 0x28 && magic[1] == 0xb5 && magic[2] == 0x2f && magic[3] == 0xfd) {
+        return ENT_FILE_ZST;
+    }
+    return ENT_FILE_UNUSED;
+}
+
+// Compression selected by name (gzip/zstd), ENT_FILE_UNUSED if unrecognized
+FileSystem::ENT_FILE_TYPES FileSystem::get_compression_type(const std::string &name) {
+    if (name == COMPRESS_GZIP) return ENT_FILE_GZ;
+    if (name == COMPRESS_ZSTD) return ENT_FILE_ZST;
+    return ENT_FILE_UNUSED;
+}
+
+/**
+ * ======================================================================
+ * Function std::unique_ptr<std::istream> FileSystem::open_input(const std::string &path)
+ *
+ * Description          - Opens a file for reading, gzip and zstd files are
+ *                        decompressed as they are read
+ *
+ * Notes                - Compressed files are streamed through the gzip/zstd
+ *                        executables, nothing is written to disk
+ *                      - Decompressors are run directly (no shell), so the
+ *                        path is passed as is
+ *                      - close_input should be used to find out if the
+ *                        decompressor failed part way through
+ *
+ * @param path          - Path to file
+ *
+ * @return              - Stream, failed if the file could not be opened
+ *
+ * =====================================================================
+ */
+std::unique_ptr<std::istream> FileSystem::open_input(const std::string &path) {
+    std::unique_ptr<std::istream> ret;
+
+    switch (get_compression(path)) {
+        case ENT_FILE_GZ:
+            ret.reset(new redi::ipstream(COMPRESS_GZIP, vect_str_t{COMPRESS_GZIP, "-dc", "--", path}));
+            break;
+
+        case ENT_FILE_ZST:
+            ret.reset(new redi::ipstream(COMPRESS_ZSTD, vect_str_t{COMPRESS_ZSTD, "-dcq", "--", path}));
+            break;
+
+        default:
+            ret.reset(new std::ifstream(path, std::ios::in | std::ios::binary));
+            break;
+    }
+    return ret;
+}
+
+// False if the file could not be read or its decompressor exited with an error
+// (including being stopped before its output was read to the end)
+bool FileSystem::close_input(std::istream &file) {
+    redi::ipstream *child = dynamic_cast<redi::ipstream*>(&file);
+    std::ifstream  *plain = dynamic_cast<std::ifstream*>(&file);
+
+    if (child != nullptr) {
+        child->close();
+        return child->rdbuf()->exited() && child->rdbuf()->status() == 0;
+    }
+    if (plain != nullptr) {
+        if (!plain->is_open()) return false;
+        plain->close();
+    }
+    return !file.bad();
+}
+
+// Single quotes a path for a shell command, embedded quotes are escaped
+std::string FileSystem::shell_quote(const std::string &path) {
+    std::string ret = "'";
+
+    for (const char &c : path) {
+        if (c == '\'') {
+            ret += "'\\''";
+        } else {
+            ret += c;
+        }
+    }
+    return ret + "'";
+}
+
 bool FileSystem::rename_file(std::string &in, std::string &out) {
     FS_dprint("Moving/renaming file: " + in );
     if (!file_exists(in)) {
@@ -788,16 +1011,17 @@ bool FileSystem::rename_file(std::string &in, std::string &out) {
 
 uint16 FileSystem::get_file_status(std::string &path) {
     uint16 file_status = 0;
+    bool   read_ok;
 
     if (!file_exists(path)) {
         file_status |= FILE_STATUS_PATH_ERR;
     }
 
-    if (file_empty(path)) {
+    if (read_empty(path, read_ok)) {
         file_status |= FILE_STATUS_EMPTY;
     }
 
-    if (!file_test_open(path)) {
+    if (!read_ok || !file_test_open(path)) {
         file_status |= FILE_STATUS_READ_ERR;
     }
 
@@ -828,13 +1052,17 @@ std::string FileSystem::print_file_status(uint16 status, std::string& path) {
     return err_msg;
 }
 
+// Errors are kept per thread so concurrent callers each get the error of their own call
 void FileSystem::set_error(std::string err_msg) {
 //    FS_dprint(err_msg);
-    _err_msg = err_msg;
+    std::lock_guard<std::mutex> lock(_err_mutex);
+    _err_msgs[std::this_thread::get_id()] = err_msg;
 }
 
 std::string FileSystem::get_error() {
-    return "\n" + _err_msg;
+    std::lock_guard<std::mutex> lock(_err_mutex);
+    auto it = _err_msgs.find(std::this_thread::get_id());
+    return "\n" + (it == _err_msgs.end() ? std::string() : it->second);
 }
 
 bool FileSystem::print_headers(std::ofstream& file_stream, std::vector<ENTAP_HEADERS> &headers, char delim) {
@@ -33,6 +33,9 @@
 #include "common.h"
 #include "TerminalCommands.h"
 #include "EntapGlobals.h"
+#include <memory>
+#include <mutex>
+#include <thread>
 //**************************************************************
 
 
@@ -56,6 +59,7 @@ public:
         ENT_FILE_TAR_GZ,
         ENT_FILE_GZ,
         ENT_FILE_ZIP,
+        ENT_FILE_ZST,
 
         ENT_FILE_MAX
 
@@ -93,6 +97,7 @@ public:
     bool delete_file(std::string);
     bool copy_file(std::string, std::string, bool);
     bool directory_iterate(ENT_FILE_ITER, std::string&);
+    vect_str_t list_files(std::string&);
     bool check_fasta(std::string&);
     bool create_dir(std::string&);
     void delete_dir(std::string&);
@@ -111,6 +116,12 @@ public:
 
     bool download_ftp_file(std::string,std::string&);
     bool decompress_file(std::string &in_path, std::string &out_dir, ENT_FILE_TYPES);
+    bool compress_file(std::string &path, ENT_FILE_TYPES type);
+    static ENT_FILE_TYPES get_compression(const std::string &path);
+    static ENT_FILE_TYPES get_compression_type(const std::string &name);
+    static std::unique_ptr<std::istream> open_input(const std::string &path);
+    static bool close_input(std::istream &file);
+    static std::string shell_quote(const std::string &path);
 
     bool print_headers(std::ofstream &file_stream, std::vector<ENTAP_HEADERS> &headers, char delim);
     bool initialize_file(std::ofstream *file_stream, std::vector<ENTAP_HEADERS> &headers, ENT_FILE_TYPES type);
@@ -130,6 +141,11 @@ public:
     static const std::string EXT_TSV;
     static const std::string EXT_CSV;
     static const std::string EXT_LST;
+    static const std::string EXT_GZ;
+    static const std::string EXT_ZST;
+
+    static const std::string COMPRESS_GZIP;
+    static const std::string COMPRESS_ZSTD;
 
     static const char        DELIM_TSV;
     static const char        DELIM_CSV;
@@ -139,6 +155,7 @@ public:
 private:
     void init_log();
     void set_error(std::string err_msg);
+    bool read_empty(std::string &path, bool &read_ok);
 
     const std::string LOG_FILENAME   = "log_file";
     const std::string LOG_EXTENSION  = ".txt";
@@ -150,7 +167,8 @@ private:
     std::string _root_path;     // Root EnTAP output directory
     std::string _final_outpath; // Path to final files after entap has finished
     std::string _temp_outpath;  // Temp directory for EnTAP usage
-    std::string _err_msg;
+    std::unordered_map<std::thread::id, std::string> _err_msgs;   // Per thread, database sections run concurrently
+    std::mutex  _err_mutex;
 };
 
 
@@ -0,0 +1,174 @@
+/*
+ *
+ * Developed by Alexander Hart
+ * Plant Computational Genomics Lab
+ * University of Connecticut
+ *
+ * For information, contact Alexander Hart at:
+ *     entap.dev@gmail.com
+ *
+ * Copyright 2017-2019, Alexander Hart, Dr. Jill Wegrzyn
+ *
+ * This file is part of EnTAP.
+ *
+ * EnTAP is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * EnTAP is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with EnTAP.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+//*********************** Includes *****************************
+#include "PatternMatcher.h"
+//**************************************************************
+
+const int32  PatternMatcher::NO_MATCH;
+const uint16 PatternMatcher::ALPHABET_SIZE;
+const uint32 PatternMatcher::ROOT_NODE;
+
+PatternMatcher::PatternMatcher() {
+    compile(vect_str_t());
+}
+
+PatternMatcher::PatternMatcher(const vect_str_t &patterns) {
+    compile(patterns);
+}
+
+
+/**
+ * ======================================================================
+ * Function void PatternMatcher::compile(const vect_str_t &patterns)
+ *
+ * Description          - Builds Aho-Corasick automaton from list of patterns
+ *                      - Trie is built from lowercase patterns, then failure
+ *                        links are folded into a full transition table so
+ *                        searching is a single table lookup per character
+ *
+ * Notes                - Empty patterns are ignored
+ *                      - When several patterns match, the one appearing first
+ *                        in the input list is reported (same as searching
+ *                        the list in order)
+ *
+ * @param patterns      - Terms to search for
+ *
+ * @return              - None
+ *
+ * =====================================================================
+ */
+void PatternMatcher::compile(const vect_str_t &patterns) {
+    std::vector<uint32> fail_links;
+    std::queue<uint32>  node_queue;
+    uint32              node;
+    uint32              next;
+    uint8               c;
+
+    _patterns.clear();
+    _transitions.clear();
+    _node_match.clear();
+    add_node();     // Root
+
+    // Build trie, transitions of 0 are "missing" (root can never be a child)
+    for (const std::string &pattern : patterns) {
+        if (pattern.empty()) continue;
+        node = ROOT_NODE;
+        for (const char &ch : pattern) {
+            c = (uint8) ::tolower((uint8)ch);
+            next = _transitions[node * ALPHABET_SIZE + c];
+            if (next == ROOT_NODE) {
+                next = add_node();
+                _transitions[node * ALPHABET_SIZE + c] = next;
+            }
+            node = next;
+        }
+        if (_node_match[node] == NO_MATCH) _node_match[node] = (int32) _patterns.size();
+        _patterns.push_back(pattern);
+        LOWERCASE(_patterns.back());
+    }
+
+    // Breadth first to set failure links and complete the transition table
+    fail_links.assign(_node_match.size(), ROOT_NODE);
+    for (uint16 i = 0; i < ALPHABET_SIZE; i++) {
+        next = _transitions[i];
+        if (next != ROOT_NODE) node_queue.push(next);
+    }
+    while (!node_queue.empty()) {
+        node = node_queue.front();
+        node_queue.pop();
+
+        // Inherit the best match from the longest proper suffix
+        int32 suffix_match = _node_match[fail_links[node]];
+        if (suffix_match != NO_MATCH &&
+            (_node_match[node] == NO_MATCH || suffix_match < _node_match[node])) {
+            _node_match[node] = suffix_match;
+        }
+
+        for (uint16 i = 0; i < ALPHABET_SIZE; i++) {
+            next = _transitions[node * ALPHABET_SIZE + i];
+            if (next != ROOT_NODE) {
+                fail_links[next] = _transitions[fail_links[node] * ALPHABET_SIZE + i];
+                node_queue.push(next);
+            } else {
+                _transitions[node * ALPHABET_SIZE + i] = _transitions[fail_links[node] * ALPHABET_SIZE + i];
+            }
+        }
+    }
+}
+
+
+/**
+ * ======================================================================
+ * Function int32 PatternMatcher::search(const std::string &text) const
+ *
+ * Description          - Scans text once (case-insensitive) for any pattern
+ *
+ * Notes                - None
+ *
+ * @param text          - Text to scan
+ *
+ * @return              - Index of matched pattern (lowest index if several),
+ *                        NO_MATCH otherwise
+ *
+ * =====================================================================
+ */
+int32 PatternMatcher::search(const std::string &text) const {
+    int32  best = NO_MATCH;
+    int32  match;
+    uint32 node = ROOT_NODE;
+
+    if (_patterns.empty()) return NO_MATCH;
+    for (const char &ch : text) {
+        node = _transitions[node * ALPHABET_SIZE + (uint8) ::tolower((uint8)ch)];
+        match = _node_match[node];
+        if (match != NO_MATCH && (best == NO_MATCH || match < best)) {
+            best = match;
+            if (best == 0) break;   // Can't do any better
+        }
+    }
+    return best;
+}
+
+bool PatternMatcher::contains_any(const std::string &text) const {
+    return search(text) != NO_MATCH;
+}
+
+bool PatternMatcher::empty() const {
+    return _patterns.empty();
+}
+
+const std::string &PatternMatcher::get_pattern(int32 index) const {
+    return _patterns.at((uint64) index);
+}
+
+uint32 PatternMatcher::add_node() {
+    _transitions.resize(_transitions.size() + ALPHABET_SIZE, ROOT_NODE);
+    _node_match.push_back(NO_MATCH);
+    return (uint32) _node_match.size() - 1;
+}
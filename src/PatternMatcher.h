@@ -0,0 +1,69 @@
+/*
+ *
+ * Developed by Alexander Hart
+ * Plant Computational Genomics Lab
+ * University of Connecticut
+ *
+ * For information, contact Alexander Hart at:
+ *     entap.dev@gmail.com
+ *
+ * Copyright 2017-2019, Alexander Hart, Dr. Jill Wegrzyn
+ *
+ * This file is part of EnTAP.
+ *
+ * EnTAP is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * EnTAP is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with EnTAP.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef ENTAP_PATTERNMATCHER_H
+#define ENTAP_PATTERNMATCHER_H
+
+//*********************** Includes *****************************
+#include "common.h"
+//**************************************************************
+
+
+/**
+ * Case-insensitive Aho-Corasick automaton used to test a string against a
+ * list of terms (contaminants, uninformative keywords...) in a single pass.
+ * Compile once, then search() any number of times. Searching does not
+ * allocate and does not modify the input text.
+ */
+class PatternMatcher {
+
+public:
+    static const int32 NO_MATCH = -1;
+
+    PatternMatcher();
+    explicit PatternMatcher(const vect_str_t &patterns);
+    ~PatternMatcher() = default;
+
+    void compile(const vect_str_t &patterns);
+    int32 search(const std::string &text) const;
+    bool contains_any(const std::string &text) const;
+    bool empty() const;
+    const std::string &get_pattern(int32 index) const;
+
+private:
+    static const uint16 ALPHABET_SIZE = 256;
+    static const uint32 ROOT_NODE     = 0;
+
+    uint32 add_node();
+
+    std::vector<uint32>  _transitions;      // Full DFA, ALPHABET_SIZE entries per node
+    std::vector<int32>   _node_match;       // Lowest pattern index ending at node (incl. suffixes)
+    vect_str_t           _patterns;         // Patterns as given by user (lowercase)
+};
+
+
+#endif //ENTAP_PATTERNMATCHER_H
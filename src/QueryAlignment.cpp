@@ -90,32 +90,41 @@ void QueryAlignment::get_header_data(ENTAP_HEADERS header, std::string &val, uin
 
 /**
  * ======================================================================
- * Function void QuerySequence::set_tax_score(std::string input_lineage)
+ * Function void SimSearchAlignment::set_tax_score(const tax_ancestors_t &input_lineage)
  *
  * Description          - Sets tax score based on informativeness and
  *                        lineage
+ *                      - Lineage score is the number of ancestors shared
+ *                        with the input species (excluding root)
  *
- * Notes                - None
+ * Notes                - Both lineages end at root, so shared ancestors
+ *                        are a common suffix. Walk is bounded by the
+ *                        shallower lineage.
  *
- * @param lineage       - Lineage input from  user
+ * @param input_lineage - Ancestor IDs of species input from user
  *
  * @return              - None
  *
  * =====================================================================
  */
-void SimSearchAlignment::set_tax_score(std::string &input_lineage) {
-    float tax_score = 0;
-    std::string lineage = this->_sim_search_results.lineage;
-    std::remove_if(lineage.begin(),lineage.end(), ::isspace);
-    std::remove_if(input_lineage.begin(),input_lineage.end(), ::isspace);
-
-    std::string temp;
-    size_t p = 0;std::string del = ";";
-    while ((p = lineage.find(';'))!=std::string::npos) {
-        temp = lineage.substr(0,p);
-        if (input_lineage.find(temp)!=std::string::npos) tax_score++;
-        lineage.erase(0,p+del.length());
+void SimSearchAlignment::set_tax_score(const EntapDatabase::tax_ancestors_t &input_lineage) {
+    fp32   tax_score = 0;
+    uint64 hit_ind;
+    uint64 input_ind;
+    const EntapDatabase::tax_ancestors_t *hit_lineage = this->_sim_search_results.lineage_ids;
+
+    if (hit_lineage != nullptr) {
+        hit_ind   = hit_lineage->size();
+        input_ind = input_lineage.size();
+        while (hit_ind > 0 && input_ind > 0 &&
+               (*hit_lineage)[hit_ind - 1] == input_lineage[input_ind - 1]) {
+            hit_ind--;
+            input_ind--;
+            tax_score++;
+        }
+        if (tax_score > 0) tax_score--;     // Root is shared by everything
     }
+
     if (tax_score == 0) {
         if(this->_sim_search_results.is_informative) tax_score += INFORM_ADD;
     } else {
@@ -125,7 +134,8 @@ void SimSearchAlignment::set_tax_score(std::string &input_lineage) {
 }
 
 
-SimSearchAlignment::SimSearchAlignment(QuerySequence::SimSearchResults d, std::string &lineage, QuerySequence* parent) {
+SimSearchAlignment::SimSearchAlignment(QuerySequence::SimSearchResults d, const EntapDatabase::tax_ancestors_t &lineage,
+                                       QuerySequence* parent) {
     _sim_search_results = d;
     set_tax_score(lineage);
     _parent = parent;
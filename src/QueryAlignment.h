@@ -64,13 +64,13 @@ protected:
 class SimSearchAlignment : public QueryAlignment{
 
 public:
-    SimSearchAlignment(QuerySequence::SimSearchResults, std::string&, QuerySequence*);
+    SimSearchAlignment(QuerySequence::SimSearchResults, const EntapDatabase::tax_ancestors_t&, QuerySequence*);
     ~SimSearchAlignment() override = default;
     QuerySequence::SimSearchResults* get_results();
     bool operator>(const QueryAlignment&) override;
 
 private:
-    void set_tax_score(std::string&);
+    void set_tax_score(const EntapDatabase::tax_ancestors_t&);
 
     QuerySequence::SimSearchResults    _sim_search_results;
 
@@ -250,6 +250,12 @@ void QueryData::final_statistics(std::string &outpath, std::vector<uint16> &onto
     uint32                 count_exp_reject=0;
     uint32                 count_frame_kept=0;
     uint32                 count_frame_rejected=0;
+    uint32                 count_prefilter_kept=0;
+    uint32                 count_prefilter_rejected=0;
+    uint32                 count_low_complexity=0;
+    uint32                 count_screen_contam=0;
+    uint32                 count_screen_skipped=0;
+    uint32                 count_budget_skipped=0;
     uint32                 count_sim_hits=0;
     uint32                 count_sim_no_hits=0;
     uint32                 count_ontology=0;
@@ -299,6 +305,12 @@ void QueryData::final_statistics(std::string &outpath, std::vector<uint16> &onto
 
         is_exp_kept ? count_exp_kept++ : count_exp_reject++;
         is_prot ? count_frame_kept++ : count_frame_rejected++;
+        pair.second->QUERY_FLAG_GET(QuerySequence::QUERY_PREFILTER_KEPT) ?
+            count_prefilter_kept++ : count_prefilter_rejected++;
+        if (pair.second->QUERY_FLAG_GET(QuerySequence::QUERY_LOW_COMPLEXITY)) count_low_complexity++;
+        if (pair.second->QUERY_FLAG_GET(QuerySequence::QUERY_CONTAM_SCREEN)) count_screen_contam++;
+        if (!pair.second->QUERY_FLAG_GET(QuerySequence::QUERY_CONTAM_SCREEN_KEPT)) count_screen_skipped++;
+        if (pair.second->QUERY_FLAG_GET(QuerySequence::QUERY_BUDGET_SKIPPED)) count_budget_skipped++;
         is_hit ? count_sim_hits++ : count_sim_no_hits++;
         is_ontology ? count_ontology++ : count_no_ontology++;
         if (is_one_go) count_one_go++;
@@ -347,11 +359,27 @@ void QueryData::final_statistics(std::string &outpath, std::vector<uint16> &onto
            "\n\tTotal sequences retained: " << count_frame_kept     <<
            "\n\tTotal sequences removed: "  << count_frame_rejected;
     }
+    if (DATA_FLAG_GET(SUCCESS_PREFILTER)) {
+        ss <<
+           "\nSequence Prefilter"                      <<
+           "\n\tTotal sequences retained: "            << count_prefilter_kept     <<
+           "\n\tTotal sequences removed: "             << count_prefilter_rejected <<
+           "\n\tTotal sequences low complexity: "      << count_low_complexity;
+    }
+    if (DATA_FLAG_GET(SUCCESS_CONTAM_SCREEN)) {
+        ss <<
+           "\nContaminant Pre-screen"                  <<
+           "\n\tTotal sequences flagged: "             << count_screen_contam  <<
+           "\n\tTotal sequences not searched: "        << count_screen_skipped;
+    }
     if (DATA_FLAG_GET(SUCCESS_SIM_SEARCH)) {
         ss <<
            "\nSimilarity Search"                               <<
            "\n\tTotal unique sequences with an alignment: "    << count_sim_hits <<
            "\n\tTotal unique sequences without an alignment: " << count_sim_no_hits;
+        if (count_budget_skipped > 0) {
+            ss << "\n\tTotal sequences not searched (time budget): " << count_budget_skipped;
+        }
     }
     if (DATA_FLAG_GET(SUCCESS_ONTOLOGY)) {
         for (uint16 flag : ontology_flags) {
@@ -558,6 +586,14 @@ void QueryData::set_is_success_expression(bool val) {
     DATA_FLAG_CHANGE(SUCCESS_EXPRESSION, val);
 }
 
+void QueryData::set_is_success_prefilter(bool val) {
+    DATA_FLAG_CHANGE(SUCCESS_PREFILTER, val);
+}
+
+void QueryData::set_is_success_contam_screen(bool val) {
+    DATA_FLAG_CHANGE(SUCCESS_CONTAM_SCREEN, val);
+}
+
 void QueryData::set_is_success_sim_search(bool val) {
     DATA_FLAG_CHANGE(SUCCESS_SIM_SEARCH, val);
 }
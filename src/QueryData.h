@@ -48,6 +48,8 @@ public:
         SUCCESS_SIM_SEARCH = (1 << 3),
         IS_PROTEIN         = (1 << 4),
         UNIPROT_MATCH      = (1 << 5),
+        SUCCESS_PREFILTER  = (1 << 6),
+        SUCCESS_CONTAM_SCREEN = (1 << 7),
 
         DATA_FLAGS_MAX     = (1 << 31)
     }DATA_FLAGS;
@@ -75,6 +77,8 @@ public:
     void set_is_protein_data(bool val);
     void set_is_success_frame_selection(bool val);
     void set_is_success_expression(bool val);
+    void set_is_success_prefilter(bool val);
+    void set_is_success_contam_screen(bool val);
     void set_is_success_sim_search(bool val);
     void set_is_success_ontology(bool val);
     void set_is_uniprot(bool val);
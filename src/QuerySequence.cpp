@@ -112,6 +112,8 @@ void QuerySequence::init_sequence() {
     _query_flags = 0;
     QUERY_FLAG_SET(QUERY_FRAME_KEPT);
     QUERY_FLAG_SET(QUERY_EXPRESSION_KEPT);
+    QUERY_FLAG_SET(QUERY_PREFILTER_KEPT);
+    QUERY_FLAG_SET(QUERY_CONTAM_SCREEN_KEPT);
     set_header_data();
 }
 
@@ -224,12 +226,17 @@ void QuerySequence::set_fpkm(float _fpkm) {
     set_header_data();
 }
 
+fp32 QuerySequence::get_fpkm() const {
+    return _fpkm;
+}
+
 bool QuerySequence::isContaminant() {
     return this->QUERY_FLAG_GET(QUERY_CONTAMINANT);
 }
 
 bool QuerySequence::is_kept() {
-    return QUERY_FLAG_GET(QUERY_EXPRESSION_KEPT) && QUERY_FLAG_GET(QUERY_FRAME_KEPT);
+    return QUERY_FLAG_GET(QUERY_EXPRESSION_KEPT) && QUERY_FLAG_GET(QUERY_FRAME_KEPT) &&
+           QUERY_FLAG_GET(QUERY_PREFILTER_KEPT) && QUERY_FLAG_GET(QUERY_CONTAM_SCREEN_KEPT);
 }
 
 bool QuerySequence::QUERY_FLAG_GET(QUERY_FLAGS flag) {
@@ -264,9 +271,10 @@ void QuerySequence::add_alignment(ExecuteStates state, uint16 software, EggnogRe
     _alignment_data->update_best_hit(state, software, database, new EggnogDmndAlignment(results,this));
 }
 
-void QuerySequence::add_alignment(ExecuteStates state, uint16 software, SimSearchResults &results, std::string& database,std::string lineage) {
+void QuerySequence::add_alignment(ExecuteStates state, uint16 software, SimSearchResults &results, std::string& database,
+                                  const EntapDatabase::tax_ancestors_t &input_lineage) {
     QUERY_FLAG_SET(QUERY_BLAST_HIT);
-    QueryAlignment *new_alignment = new SimSearchAlignment(results, lineage, this);
+    QueryAlignment *new_alignment = new SimSearchAlignment(results, input_lineage, this);
     _alignment_data->update_best_hit(state, software, database, new_alignment);
 }
 
@@ -360,6 +368,24 @@ bool QuerySequence::AlignmentData::hit_database(ExecuteStates state, uint16 soft
     }
 }
 
+// Deletes every alignment against a database except the database and overall best hits
+void QuerySequence::AlignmentData::clear_unselected_hits(ExecuteStates state, uint16 software, std::string &database) {
+    align_database_hits_t *database_data = get_database_ptr(state, software, database);
+    if (database_data == nullptr || database_data->size() <= 1) return;
+
+    QueryAlignment *best_overall = get_best_align_ptr(state, software, "");
+    align_database_hits_t kept_hits = {database_data->at(0)};
+
+    for (auto it = database_data->begin() + 1; it != database_data->end(); ++it) {
+        if (*it == best_overall) {
+            kept_hits.push_back(*it);
+        } else {
+            delete *it;
+        }
+    }
+    database_data->swap(kept_hits);
+}
+
 void QuerySequence::update_query_flags(ExecuteStates state, uint16 software) {
     switch (state) {
         case SIMILARITY_SEARCH: {
@@ -417,6 +443,10 @@ QuerySequence::get_database_hits(std::string &database, ExecuteStates state, uin
     return this->_alignment_data->get_database_ptr(state, software, database);
 }
 
+void QuerySequence::clear_unselected_hits(ExecuteStates state, uint16 software, std::string &database) {
+    _alignment_data->clear_unselected_hits(state, software, database);
+}
+
 std::string QuerySequence::format_go_info(std::vector<std::string> &go_list, uint8 lvl) {
     std::stringstream out;
 
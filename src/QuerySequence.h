@@ -59,6 +59,11 @@ public:
         QUERY_FAMILY_ONE_GO     = (1 << 13),
         QUERY_ONT_INTERPRO_GO   = (1 << 14),
         QUERY_ONT_INTERPRO_PATHWAY = (1 << 15),
+        QUERY_PREFILTER_KEPT    = (1 << 16),
+        QUERY_LOW_COMPLEXITY    = (1 << 17),
+        QUERY_CONTAM_SCREEN     = (1 << 18),
+        QUERY_CONTAM_SCREEN_KEPT= (1 << 19),
+        QUERY_BUDGET_SKIPPED    = (1 << 20),
 
         QUERY_MAX               = (1 << 31)
 
@@ -114,6 +119,7 @@ public:
         std::string                       species;
         std::string                       contam_type;
         std::string                       lineage;
+        const EntapDatabase::tax_ancestors_t *lineage_ids = nullptr;  // Owned by EntapDatabase
         std::string                       yes_no_contam; // just for convenience
         std::string                       yes_no_inform;
         fp32                              tax_score;     // taxonomic score, may be based on parent
@@ -144,6 +150,7 @@ public:
         void set_best_alignment(ExecuteStates state, uint16 software, QueryAlignment *);
         void update_best_hit(ExecuteStates state, uint16 software, std::string &database, QueryAlignment* new_alignment);
         bool hit_database(ExecuteStates state, uint16 software, std::string &database);
+        void clear_unselected_hits(ExecuteStates state, uint16 software, std::string &database);
         align_database_hits_t* get_database_ptr(ExecuteStates, uint16, std::string&);
         QueryAlignment* get_best_align_ptr(ExecuteStates, uint16 software, std::string database);
         ALIGNMENT_DATA_T* get_software_ptr(ExecuteStates state, uint16 software);
@@ -166,6 +173,7 @@ public:
     void set_sequence_n(const std::string &_sequence_n);
     const std::string &get_sequence() const;
     void set_fpkm(float _fpkm);
+    fp32 get_fpkm() const;
     bool is_kept();
     bool QUERY_FLAG_GET(QUERY_FLAGS flag);
     void QUERY_FLAG_SET(QUERY_FLAGS flag);
@@ -177,9 +185,11 @@ public:
 #endif
     // Alignemnt accession routines
     void add_alignment(ExecuteStates state, uint16 software, EggnogResults &results, std::string& database);
-    void add_alignment(ExecuteStates state, uint16 software, SimSearchResults &results, std::string& database,std::string lineage);
+    void add_alignment(ExecuteStates state, uint16 software, SimSearchResults &results, std::string& database,
+                       const EntapDatabase::tax_ancestors_t &input_lineage);
     void add_alignment(ExecuteStates state, uint16 software, InterProResults &results, std::string& database);
     QuerySequence::align_database_hits_t* get_database_hits(std::string& database,ExecuteStates state, uint16 software);
+    void clear_unselected_hits(ExecuteStates state, uint16 software, std::string &database);
 
     std::string format_go_info(std::vector<std::string> &go_list, uint8 lvl);
 
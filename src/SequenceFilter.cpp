@@ -0,0 +1,467 @@
+/*
+ *
+ * Developed by Alexander Hart
+ * Plant Computational Genomics Lab
+ * University of Connecticut
+ *
+ * For information, contact Alexander Hart at:
+ *     entap.dev@gmail.com
+ *
+ * Copyright 2017-2019, Alexander Hart, Dr. Jill Wegrzyn
+ *
+ * This file is part of EnTAP.
+ *
+ * EnTAP is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * EnTAP is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with EnTAP.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+//*********************** Includes *****************************
+#include "SequenceFilter.h"
+//**************************************************************
+
+
+/**
+ * ======================================================================
+ * Function SequenceFilter::SequenceFilter(std::string &input, EntapDataPtrs &entap_data)
+ *
+ * Description          - Length and low complexity prefilter run before
+ *                        similarity searching
+ *
+ * Notes                - Constructor
+ *
+ * @param input         - Path to transcriptome (frame selected/filtered)
+ * @param entap_data    - Entap data pointers
+ *
+ * @return              - None
+ *
+ * =====================================================================
+ */
+SequenceFilter::SequenceFilter(std::string &input, EntapDataPtrs &entap_data) {
+    FS_dprint("Spawn Object - SequenceFilter");
+
+    _pQueryData  = entap_data._pQueryData;
+    _pFileSystem = entap_data._pFileSystem;
+    _pUserInput  = entap_data._pUserInput;
+    _inpath      = input;
+
+    _outpath     = PATHS(_pFileSystem->get_root_path(), PREFILTER_OUT_DIR);
+    _min_length  = (uint32) std::max(0, _pUserInput->get_user_input<int>(_pUserInput->INPUT_FLAG_MIN_LENGTH));
+    _mask        = _pUserInput->has_input(_pUserInput->INPUT_FLAG_MASK_LOW_COMPLEXITY);
+    _is_protein  = _pQueryData->is_protein_data();
+}
+
+
+/**
+ * ======================================================================
+ * Function bool SequenceFilter::is_enabled(UserInput *user_input)
+ *
+ * Description          - Whether the user requested the prefilter
+ *
+ * Notes                - None
+ *
+ * @param user_input    - User input
+ *
+ * @return              - True if --min-length or --mask-low-complexity
+ *
+ * =====================================================================
+ */
+bool SequenceFilter::is_enabled(UserInput *user_input) {
+    return user_input->has_input(user_input->INPUT_FLAG_MIN_LENGTH) ||
+           user_input->has_input(user_input->INPUT_FLAG_MASK_LOW_COMPLEXITY);
+}
+
+
+/**
+ * ======================================================================
+ * Function std::string SequenceFilter::execute(std::string input)
+ *
+ * Description          - Removes sequences shorter than --min-length
+ *                      - Masks low complexity regions with DUST
+ *                        (nucleotide) or SEG (protein), sequences that are
+ *                        entirely masked are removed and flagged
+ *                      - Masked sequences are written to a separate FASTA
+ *                        used only as the similarity search query, the
+ *                        returned FASTA and sequences in memory are unmasked
+ *
+ * Notes                - Entry
+ *
+ * @param input         - Path to transcriptome (frame selected/filtered)
+ *
+ * @return              - Path to length filtered (unmasked) FASTA
+ *
+ * =====================================================================
+ */
+std::string SequenceFilter::execute(std::string input) {
+    std::stringstream   out_msg;
+    std::string         out_msg_str;
+    std::string         out_kept;
+    std::string         out_masked;
+    std::string         out_removed;
+    std::string         line;
+    std::string         seq_id;
+    std::string         sequence;
+    std::string         basename;
+    uint64              count_total=0;
+    uint64              count_kept=0;
+    uint64              count_short=0;
+    uint64              count_masked=0;
+    uint64              total_residues=0;
+    uint64              masked_residues=0;
+
+    _inpath = input;
+    _pFileSystem->create_dir(_outpath);
+    basename    = _pFileSystem->get_filename(_inpath, false);
+    out_kept    = PATHS(_outpath, basename + OUT_KEPT_TAG);
+    out_masked  = PATHS(_outpath, basename + OUT_MASKED_TAG);
+    out_removed = PATHS(_outpath, basename + OUT_REMOVED_TAG);
+    _pFileSystem->delete_file(out_kept);
+    _pFileSystem->delete_file(out_masked);
+    _pFileSystem->delete_file(out_removed);
+    _masked_path.clear();
+
+    FS_dprint("Prefiltering sequences from: " + _inpath + "\nMinimum length: " + std::to_string(_min_length) +
+              (_mask ? (_is_protein ? "\nMasking with SEG" : "\nMasking with DUST") : ""));
+
+    std::ifstream in_file(_inpath);
+    std::ofstream kept_file(out_kept, std::ios::out | std::ios::app);
+    std::ofstream masked_file;
+    std::ofstream removed_file(out_removed, std::ios::out | std::ios::app);
+
+    if (!in_file.is_open()) {
+        throw ExceptionHandler("Unable to open transcriptome for prefiltering: " + _inpath, ERR_ENTAP_INPUT_PARSE);
+    }
+    if (_mask) masked_file.open(out_masked, std::ios::out | std::ios::app);
+
+    while (true) {
+        bool is_eof = !std::getline(in_file, line);
+        if (!line.empty() && line.back() == '\r') line.pop_back();
+        if (is_eof || line.find(FileSystem::FASTA_FLAG) == 0) {
+            if (!seq_id.empty()) {
+                count_total++;
+                total_residues += sequence.size();
+                if (filter_sequence(seq_id, sequence, kept_file, masked_file, removed_file,
+                                    count_short, count_masked, masked_residues)) {
+                    count_kept++;
+                }
+            }
+            if (is_eof) break;
+            _pQueryData->trim_sequence_header(seq_id, line);
+            sequence.clear();
+        } else {
+            sequence += line;
+        }
+    }
+    kept_file.close();
+    if (_mask) masked_file.close();
+    removed_file.close();
+
+    if (count_kept == 0) {
+        throw ExceptionHandler("All sequences were removed by the prefilter, check --" +
+                               _pUserInput->INPUT_FLAG_MIN_LENGTH, ERR_ENTAP_INPUT_PARSE);
+    }
+
+    _pFileSystem->format_stat_stream(out_msg, "Sequence Prefilter");
+    out_msg <<
+            "Total sequences kept: "                       << count_kept    <<
+            "\nTotal sequences removed (shorter than "     << _min_length   << "): " << count_short;
+    if (_mask) {
+        out_msg <<
+            "\nTotal sequences removed (entirely low complexity, " << (_is_protein ? "SEG" : "DUST") << "): " <<
+            count_masked <<
+            "\nMasked residues in kept sequences: "        << masked_residues << " (" <<
+            float_to_string(total_residues ? (fp64) masked_residues / total_residues * 100 : 0) << "% of all residues)";
+    }
+    out_msg <<
+            "\nKept sequences written to: "               << out_kept;
+    if (_mask) {
+        out_msg <<
+            "\nKept sequences (masked for similarity search) written to: " << out_masked;
+        _masked_path = out_masked;
+    }
+    out_msg <<
+            "\nRemoved sequences written to: "             << out_removed;
+    out_msg_str = out_msg.str();
+    _pFileSystem->print_stats(out_msg_str);
+
+    FS_dprint("Success! Prefiltered " + std::to_string(count_total) + " sequences");
+    return out_kept;
+}
+
+
+/**
+ * ======================================================================
+ * Function std::string SequenceFilter::get_masked_path()
+ *
+ * Description          - Masked FASTA written by execute()
+ *
+ * Notes                - None
+ *
+ * @return              - Path to masked FASTA, empty if not masking
+ *
+ * =====================================================================
+ */
+std::string SequenceFilter::get_masked_path() {
+    return _masked_path;
+}
+
+
+/**
+ * ======================================================================
+ * Function bool SequenceFilter::filter_sequence(...)
+ *
+ * Description          - Applies length filter and masking to a sequence,
+ *                        writing it to the kept or removed file
+ *
+ * Notes                - Sequences not in QueryData are filtered without
+ *                        being flagged
+ *
+ * @param seq_id        - Sequence ID
+ * @param sequence      - Residues (unwrapped)
+ * @param kept          - Kept FASTA (unmasked)
+ * @param masked_out    - Kept FASTA (masked), only written when masking
+ * @param removed       - Removed FASTA
+ * @param count_short   - Incremented if too short
+ * @param count_masked  - Incremented if entirely masked
+ * @param masked_residues - Residues masked in kept sequences
+ *
+ * @return              - True if kept
+ *
+ * =====================================================================
+ */
+bool SequenceFilter::filter_sequence(std::string &seq_id, std::string &sequence, std::ofstream &kept,
+                                     std::ofstream &masked_out, std::ofstream &removed, uint64 &count_short, uint64 &count_masked,
+                                     uint64 &masked_residues) {
+    QuerySequence  *query;
+    std::string     masked;
+    uint64          masked_count;
+
+    query = _pQueryData->get_sequence(seq_id);
+
+    if (sequence.size() < _min_length) {
+        count_short++;
+        removed << FileSystem::FASTA_FLAG << seq_id << '\n' << sequence << '\n';
+        if (query != nullptr) query->QUERY_FLAG_CLEAR(QuerySequence::QUERY_PREFILTER_KEPT);
+        return false;
+    }
+    if (!_mask) {
+        kept << FileSystem::FASTA_FLAG << seq_id << '\n' << sequence << '\n';
+        return true;
+    }
+
+    masked_count = _is_protein ? mask_seg(sequence, masked) : mask_dust(sequence, masked);
+    if (masked_count == sequence.size()) {
+        count_masked++;
+        removed << FileSystem::FASTA_FLAG << seq_id << '\n' << sequence << '\n';
+        if (query != nullptr) {
+            query->QUERY_FLAG_CLEAR(QuerySequence::QUERY_PREFILTER_KEPT);
+            query->QUERY_FLAG_SET(QuerySequence::QUERY_LOW_COMPLEXITY);
+        }
+        return false;
+    }
+    masked_residues += masked_count;
+    kept << FileSystem::FASTA_FLAG << seq_id << '\n' << sequence << '\n';
+    masked_out << FileSystem::FASTA_FLAG << seq_id << '\n' << masked << '\n';
+    return true;
+}
+
+
+/**
+ * ======================================================================
+ * Function uint64 SequenceFilter::mask_dust(const std::string &sequence,
+ *                                           std::string &masked)
+ *
+ * Description          - DUST low complexity masking of nucleotides
+ *                      - Bases are masked when both a forward and a
+ *                        reverse pass of dust_pass() mask them, each pass
+ *                        trims the flank it scans into
+ *
+ * Notes                - None
+ *
+ * @param sequence      - Nucleotide sequence
+ * @param masked        - Set to sequence with masked bases as DUST_MASK
+ *
+ * @return              - Number of masked bases
+ *
+ * =====================================================================
+ */
+uint64 SequenceFilter::mask_dust(const std::string &sequence, std::string &masked) {
+    std::vector<bool>   forward_mask;
+    std::vector<bool>   reverse_mask;
+    std::string         reversed(sequence.rbegin(), sequence.rend());
+    uint64              masked_count=0;
+    uint64              length = sequence.size();
+
+    masked = sequence;
+    if (length < DUST_WINDOW) return 0;
+
+    dust_pass(sequence, forward_mask);
+    dust_pass(reversed, reverse_mask);
+    for (uint64 i = 0; i < length; i++) {
+        if (forward_mask[i] && reverse_mask[length - 1 - i]) {
+            masked[i] = DUST_MASK;
+            masked_count++;
+        }
+    }
+    return masked_count;
+}
+
+
+/**
+ * ======================================================================
+ * Function void SequenceFilter::dust_pass(const std::string &sequence,
+ *                                         std::vector<bool> &mask)
+ *
+ * Description          - Slides a DUST_WINDOW window keeping triplet
+ *                        counts, score is sum c(c-1)/2 / (l-1)
+ *                      - Windows scoring above DUST_LEVEL / 10 have their
+ *                        highest scoring suffix masked, so the flank
+ *                        before a repeat is not masked
+ *
+ * Notes                - Counts are updated as the window slides so each
+ *                        base costs O(1), only high scoring windows are
+ *                        rescanned. Triplets with ambiguous bases are not
+ *                        counted
+ *
+ * @param sequence      - Nucleotide sequence, at least DUST_WINDOW long
+ * @param mask          - Set to true for masked bases
+ *
+ * @return              - None
+ *
+ * =====================================================================
+ */
+void SequenceFilter::dust_pass(const std::string &sequence, std::vector<bool> &mask) {
+    uint16      counts[64] = {0};       // Triplet counts in window
+    uint64      pairs=0;                // sum c(c-1)/2
+    uint64      triplets=0;             // Valid triplets in window
+    uint64      mask_end=0;             // First position not yet masked
+    uint64      length = sequence.size();
+    uint64      start;
+    int         code;
+
+    mask.assign(length, false);
+
+    // -1 for ambiguous bases
+    auto base_code = [](char c) -> int {
+        switch (c) {
+            case 'A': case 'a': return 0;
+            case 'C': case 'c': return 1;
+            case 'G': case 'g': return 2;
+            case 'T': case 't': case 'U': case 'u': return 3;
+            default: return -1;
+        }
+    };
+    auto triplet_code = [&](uint64 i) -> int {
+        int a = base_code(sequence[i]);
+        int b = base_code(sequence[i + 1]);
+        int c = base_code(sequence[i + 2]);
+        return (a < 0 || b < 0 || c < 0) ? -1 : (a << 4) | (b << 2) | c;
+    };
+
+    for (uint64 j = 2; j < length; j++) {
+        // Triplet ending at j enters the window
+        code = triplet_code(j - 2);
+        if (code >= 0) {
+            pairs += counts[code]++;
+            triplets++;
+        }
+        // Triplet starting before the window leaves
+        if (j >= DUST_WINDOW) {
+            code = triplet_code(j - DUST_WINDOW);
+            if (code >= 0) {
+                pairs -= --counts[code];
+                triplets--;
+            }
+        }
+        if (j + 1 < DUST_WINDOW || triplets < 2) continue;
+        if ((fp64) pairs * 10 <= DUST_LEVEL * (triplets - 1)) continue;
+
+        // Highest scoring suffix of the window
+        uint16  suffix_counts[64] = {0};
+        uint64  suffix_pairs=0;
+        uint64  suffix_triplets=0;
+        fp64    best_score=0;
+        start = j - 2;
+        for (uint64 k = j - 2; k + DUST_WINDOW > j; k--) {
+            code = triplet_code(k);
+            if (code >= 0) {
+                suffix_pairs += suffix_counts[code]++;
+                suffix_triplets++;
+            }
+            if (suffix_triplets >= 2 && (fp64) suffix_pairs / (suffix_triplets - 1) >= best_score) {
+                best_score = (fp64) suffix_pairs / (suffix_triplets - 1);
+                start = k;
+            }
+            if (k == 0) break;
+        }
+        for (uint64 i = std::max(mask_end, start); i <= j; i++) mask[i] = true;
+        mask_end = j + 1;
+    }
+}
+
+
+/**
+ * ======================================================================
+ * Function uint64 SequenceFilter::mask_seg(const std::string &sequence,
+ *                                          std::string &masked)
+ *
+ * Description          - SEG low complexity masking of proteins
+ *                      - Slides a SEG_WINDOW window keeping residue
+ *                        counts, windows with Shannon entropy below
+ *                        SEG_ENTROPY bits are masked
+ *
+ * Notes                - Trigger window only, SEG's extension and
+ *                        optimization steps are not done
+ *
+ * @param sequence      - Protein sequence
+ * @param masked        - Set to sequence with masked residues as SEG_MASK
+ *
+ * @return              - Number of masked residues
+ *
+ * =====================================================================
+ */
+uint64 SequenceFilter::mask_seg(const std::string &sequence, std::string &masked) {
+    uint16      counts[32] = {0};       // Residue counts in window, by letter
+    fp64        sum_clogc=0;            // sum c*log2(c)
+    uint64      mask_end=0;
+    uint64      masked_count=0;
+    uint64      length = sequence.size();
+    uint64      start;
+    fp64        window_log = std::log2((fp64) SEG_WINDOW);
+    std::vector<fp64> clogc(SEG_WINDOW + 1, 0);
+
+    masked = sequence;
+    if (length < SEG_WINDOW) return 0;
+
+    for (uint16 c = 1; c <= SEG_WINDOW; c++) clogc[c] = c * std::log2((fp64) c);
+
+    for (uint64 j = 0; j < length; j++) {
+        // Outgoing residue removed first so no count exceeds SEG_WINDOW (clogc bounds)
+        if (j >= SEG_WINDOW) {
+            uint16 &out = counts[toupper(sequence[j - SEG_WINDOW]) & 31];
+            sum_clogc += clogc[out - 1] - clogc[out];
+            out--;
+        }
+        uint16 &in = counts[toupper(sequence[j]) & 31];
+        sum_clogc += clogc[in + 1] - clogc[in];
+        in++;
+        if (j + 1 < SEG_WINDOW) continue;
+        // H = log2(L) - sum c*log2(c) / L
+        if (window_log - sum_clogc / SEG_WINDOW < SEG_ENTROPY) {
+            start = std::max(mask_end, j + 1 - SEG_WINDOW);
+            for (uint64 i = start; i <= j; i++) masked[i] = SEG_MASK;
+            masked_count += j + 1 - start;
+            mask_end = j + 1;
+        }
+    }
+    return masked_count;
+}
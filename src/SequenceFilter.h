@@ -0,0 +1,80 @@
+/*
+ *
+ * Developed by Alexander Hart
+ * Plant Computational Genomics Lab
+ * University of Connecticut
+ *
+ * For information, contact Alexander Hart at:
+ *     entap.dev@gmail.com
+ *
+ * Copyright 2017-2019, Alexander Hart, Dr. Jill Wegrzyn
+ *
+ * This file is part of EnTAP.
+ *
+ * EnTAP is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * EnTAP is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with EnTAP.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef ENTAP_SEQUENCEFILTER_H
+#define ENTAP_SEQUENCEFILTER_H
+
+//*********************** Includes *****************************
+#include "QuerySequence.h"
+#include "QueryData.h"
+#include "common.h"
+#include "FileSystem.h"
+//**************************************************************
+
+class SequenceFilter {
+public:
+    SequenceFilter(std::string&, EntapDataPtrs&);
+    std::string execute(std::string);
+    std::string get_masked_path();
+    static bool is_enabled(UserInput*);
+
+private:
+
+    const std::string PREFILTER_OUT_DIR     = "prefilter/";
+    const std::string OUT_KEPT_TAG          = "_prefiltered.fasta";
+    const std::string OUT_MASKED_TAG        = "_prefiltered_masked.fasta";
+    const std::string OUT_REMOVED_TAG       = "_prefilter_removed.fasta";
+
+    // DUST (nucleotide), window score is sum c(c-1)/2 / (l-1) over triplet counts
+    const uint16      DUST_WINDOW           = 64;
+    const fp64        DUST_LEVEL            = 20.0;    // Masked if score * 10 > level (dustmasker default)
+    const char        DUST_MASK             = 'N';
+
+    // SEG (protein), windows below this Shannon entropy (bits) are masked
+    const uint16      SEG_WINDOW            = 12;
+    const fp64        SEG_ENTROPY           = 2.2;
+    const char        SEG_MASK              = 'X';
+
+    std::string       _inpath;
+    std::string       _outpath;
+    std::string       _masked_path;
+    uint32            _min_length;
+    bool              _mask;
+    bool              _is_protein;
+    QueryData        *_pQueryData;
+    FileSystem       *_pFileSystem;
+    UserInput        *_pUserInput;
+
+    uint64 mask_dust(const std::string &sequence, std::string &masked);
+    void dust_pass(const std::string &sequence, std::vector<bool> &mask);
+    uint64 mask_seg(const std::string &sequence, std::string &masked);
+    bool filter_sequence(std::string &seq_id, std::string &sequence, std::ofstream &kept, std::ofstream &masked_out,
+                         std::ofstream &removed, uint64 &count_short, uint64 &count_masked, uint64 &masked_residues);
+};
+
+
+#endif //ENTAP_SEQUENCEFILTER_H
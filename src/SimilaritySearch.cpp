@@ -76,7 +76,22 @@ SimilaritySearch::SimilaritySearch(vect_str_t &database_paths, std::string &inpu
     _software_flag = SIM_DIAMOND;
 }
 
-void SimilaritySearch::execute() {
+/**
+ * ======================================================================
+ * Function bool SimilaritySearch::execute()
+ *
+ * Description          - Verifies, executes (if needed) and parses
+ *                        similarity searching
+ *
+ * Notes                - If the user selected a single query shard, only
+ *                        that shard is searched and nothing is parsed
+ *
+ * @return              - True if results were parsed, false if only a
+ *                        shard was searched
+ *
+ * =====================================================================
+ */
+bool SimilaritySearch::execute() {
     EntapModule::ModVerifyData verifyData;
     std::unique_ptr<AbstractSimilaritySearch> ptr;
 
@@ -86,8 +101,14 @@ void SimilaritySearch::execute() {
         if (!verifyData.files_exist) {
             ptr->execute();
         }
+        if (_pUserInput->has_input(_pUserInput->INPUT_FLAG_SIM_SHARD_IND)) {
+            FS_dprint("Similarity search shard complete, skipping parsing");
+            ptr.reset();
+            return false;
+        }
         ptr->parse();
         ptr.reset();
+        return true;
     } catch (const ExceptionHandler &e) {
         ptr.reset();
         throw e;
@@ -48,7 +48,7 @@ public:
 
     //******************** Public Prototype Functions *********************
     SimilaritySearch(vect_str_t &database_paths, std::string &input, EntapDataPtrs &entapDataPtrs);
-    void execute();
+    bool execute();
 
 
     //*********************************************************************
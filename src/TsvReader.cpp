@@ -0,0 +1,332 @@
+/*
+ *
+ * Developed by Alexander Hart
+ * Plant Computational Genomics Lab
+ * University of Connecticut
+ *
+ * For information, contact Alexander Hart at:
+ *     entap.dev@gmail.com
+ *
+ * Copyright 2017-2019, Alexander Hart, Dr. Jill Wegrzyn
+ *
+ * This file is part of EnTAP.
+ *
+ * EnTAP is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * EnTAP is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with EnTAP.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+//*********************** Includes *****************************
+#include "TsvReader.h"
+#include "FileSystem.h"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+//**************************************************************
+
+const uint64 TsvReader::BUFFER_SIZE;
+const uint16 TsvReader::MAX_FAST_EXP;
+
+TsvReader::TsvReader(const std::string &path, int err_code) {
+    _path        = path;
+    _err_code    = err_code;
+    _begin       = 0;
+    _end         = 0;
+    _line_number = 0;
+    _buffer.resize(BUFFER_SIZE);
+    _file = FileSystem::open_input(path);
+    if (!*_file) {
+        throw ExceptionHandler("Unable to open file: " + path, err_code);
+    }
+}
+
+
+/**
+ * ======================================================================
+ * Function bool TsvReader::next_row()
+ *
+ * Description          - Reads the next non-empty row, splitting it into
+ *                        fields on tabs
+ *                      - Spaces around fields and a trailing carriage
+ *                        return are removed
+ *
+ * Notes                - Tabs and newlines are found in a single pass, if a
+ *                        row runs past the buffered data more is read and
+ *                        the scan continues where it stopped
+ *
+ * @return              - False once the end of the file is reached
+ *
+ * =====================================================================
+ */
+bool TsvReader::next_row() {
+    uint64      scan;           // Relative to start of row
+    uint64      field_start;    // Relative to start of row
+    uint64      consumed;
+    const char *row;
+    const char *delim;
+
+    do {
+        _field_bounds.clear();
+        scan        = 0;
+        field_start = 0;
+        while (true) {
+            row   = _buffer.data() + _begin;
+            delim = find_delim(row + scan, _buffer.data() + _end);
+            scan  = (uint64)(delim - row);
+            if (_begin + scan == _end) {
+                // Row continues past buffered data
+                if (fill_buffer()) continue;
+                if (scan == 0 && _field_bounds.empty()) return false;     // End of file
+                _field_bounds.emplace_back(field_start, scan);        // Last row has no newline
+                consumed = scan;
+                break;
+            }
+            _field_bounds.emplace_back(field_start, scan);
+            if (*delim == '\n') {
+                consumed = scan + 1;
+                break;
+            }
+            field_start = ++scan;
+        }
+        _line_number++;
+
+        // Build views for this row, trimming as CSVReader did
+        row = _buffer.data() + _begin;
+        _fields.clear();
+        for (std::pair<uint64, uint64> &bounds : _field_bounds) {
+            const char *begin = row + bounds.first;
+            const char *end   = row + bounds.second;
+            if (&bounds == &_field_bounds.back() && end > begin && *(end - 1) == '\r') end--;
+            while (begin < end && *begin == ' ') begin++;
+            while (end > begin && *(end - 1) == ' ') end--;
+            _fields.push_back({begin, (uint64)(end - begin)});
+        }
+        _begin += consumed;
+    } while (_fields.size() == 1 && _fields[0].empty());    // Skip blank lines
+
+    return true;
+}
+
+uint16 TsvReader::field_count() const {
+    return (uint16)_fields.size();
+}
+
+const TsvReader::Field &TsvReader::get_field(uint16 col) const {
+    return _fields.at(col);
+}
+
+uint64 TsvReader::get_line_number() const {
+    return _line_number;
+}
+
+/**
+ * ======================================================================
+ * Function bool TsvReader::fill_buffer()
+ *
+ * Description          - Moves the unread data to the start of the buffer
+ *                        and reads more from the file after it
+ *
+ * Notes                - Buffer is doubled when a single row fills it
+ *
+ * @return              - False if nothing more could be read
+ *
+ * =====================================================================
+ */
+bool TsvReader::fill_buffer() {
+    std::streamsize read_len;
+
+    if (!_file) return false;
+
+    if (_begin > 0) {
+        std::memmove(_buffer.data(), _buffer.data() + _begin, _end - _begin);
+        _end  -= _begin;
+        _begin = 0;
+    }
+    if (_end == _buffer.size()) _buffer.resize(_buffer.size() * 2);
+
+    _file->read(_buffer.data() + _end, (std::streamsize)(_buffer.size() - _end));
+    read_len = _file->gcount();
+    if (_file->bad() || (_file->eof() && !FileSystem::close_input(*_file))) {
+        throw ExceptionHandler("Unable to read file: " + _path, _err_code);
+    }
+    if (_file->eof()) _file.reset();
+    _end += (uint64)read_len;
+    return read_len > 0;
+}
+
+/**
+ * ======================================================================
+ * Function const char *TsvReader::find_delim(const char *begin, const char *end)
+ *
+ * Description          - Finds the first tab or newline byte
+ *                      - Compares 32 (AVX2) or 16 (SSE2) bytes at a time,
+ *                        remaining bytes are checked one by one
+ *
+ * Notes                - Instruction set is chosen at compile time
+ *
+ * @param begin         - Start of data
+ * @param end           - End of data
+ *
+ * @return              - Pointer to delimiter, or end if none found
+ *
+ * =====================================================================
+ */
+const char *TsvReader::find_delim(const char *begin, const char *end) {
+#if defined(__AVX2__)
+    const __m256i tab32 = _mm256_set1_epi8('\t');
+    const __m256i nl32  = _mm256_set1_epi8('\n');
+    while (end - begin >= 32) {
+        __m256i chunk = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(begin));
+        uint32 mask = (uint32)_mm256_movemask_epi8(
+                _mm256_or_si256(_mm256_cmpeq_epi8(chunk, tab32), _mm256_cmpeq_epi8(chunk, nl32)));
+        if (mask != 0) return begin + __builtin_ctz(mask);
+        begin += 32;
+    }
+#endif
+#if defined(__SSE2__)
+    const __m128i tab16 = _mm_set1_epi8('\t');
+    const __m128i nl16  = _mm_set1_epi8('\n');
+    while (end - begin >= 16) {
+        __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(begin));
+        uint32 mask = (uint32)_mm_movemask_epi8(
+                _mm_or_si128(_mm_cmpeq_epi8(chunk, tab16), _mm_cmpeq_epi8(chunk, nl16)));
+        if (mask != 0) return begin + __builtin_ctz(mask);
+        begin += 16;
+    }
+#endif
+    for (; begin < end; begin++) {
+        if (*begin == '\t' || *begin == '\n') return begin;
+    }
+    return end;
+}
+
+/**
+ * ======================================================================
+ * Function bool TsvReader::parse_fp64(const char *begin, const char *end,
+ *                                     fp64 &val)
+ *
+ * Description          - Converts decimal/scientific text to a double
+ *                      - Values with at most 15 significant digits and a
+ *                        small exponent are computed directly, which is
+ *                        exact as both parts are representable
+ *
+ * Notes                - Anything else (large exponents such as e-values,
+ *                        inf, nan...) falls back to strtod
+ *
+ * @param begin         - Start of text
+ * @param end           - End of text
+ * @param val           - Parsed value
+ *
+ * @return              - False if text is not a number
+ *
+ * =====================================================================
+ */
+bool TsvReader::parse_fp64(const char *begin, const char *end, fp64 &val) {
+    static const fp64 POW_10[] = {1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+                                  1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+    const char *pos = begin;
+    bool        negative = false;
+    bool        exp_negative = false;
+    uint64      mantissa = 0;
+    uint16      digits = 0;
+    int32       exponent = 0;
+    int32       exp_val = 0;
+
+    if (pos == end) return false;
+    if (*pos == '-' || *pos == '+') negative = *pos++ == '-';
+
+    const char *digits_start = pos;
+    for (; pos < end && *pos >= '0' && *pos <= '9'; pos++) {
+        if (mantissa != 0 || *pos != '0') digits++;
+        mantissa = mantissa * 10 + (uint64)(*pos - '0');
+        if (digits > 15) break;
+    }
+    if (pos < end && *pos == '.') {
+        for (pos++; pos < end && *pos >= '0' && *pos <= '9'; pos++) {
+            if (mantissa != 0 || *pos != '0') digits++;
+            mantissa = mantissa * 10 + (uint64)(*pos - '0');
+            exponent--;
+            if (digits > 15) break;
+        }
+    }
+    if (pos == digits_start || (pos == digits_start + 1 && *digits_start == '.')) digits = 16; // Not a plain number
+    if (digits <= 15 && pos < end && (*pos == 'e' || *pos == 'E')) {
+        pos++;
+        if (pos < end && (*pos == '-' || *pos == '+')) exp_negative = *pos++ == '-';
+        if (pos == end) digits = 16;
+        for (; pos < end && *pos >= '0' && *pos <= '9' && exp_val < 10000; pos++) {
+            exp_val = exp_val * 10 + (*pos - '0');
+        }
+        exponent += exp_negative ? -exp_val : exp_val;
+    }
+
+    if (digits <= 15 && pos == end && exponent >= -MAX_FAST_EXP && exponent <= MAX_FAST_EXP) {
+        val = (fp64) mantissa;
+        val = exponent < 0 ? val / POW_10[-exponent] : val * POW_10[exponent];
+        if (negative) val = -val;
+        return true;
+    }
+
+    // Slow path, needs a terminated copy
+    std::string text(begin, end);
+    char *parse_end = nullptr;
+    val = std::strtod(text.c_str(), &parse_end);
+    return !text.empty() && parse_end == text.c_str() + text.size();
+}
+
+bool TsvReader::parse_uint64(const char *begin, const char *end, uint64 &val) {
+    if (begin == end || end - begin > 19) return false;     // Longer may overflow
+    val = 0;
+    for (; begin < end; begin++) {
+        if (*begin < '0' || *begin > '9') return false;
+        val = val * 10 + (uint64)(*begin - '0');
+    }
+    return true;
+}
+
+void TsvReader::get(uint16 col, Field &val) {
+    val = _fields[col];
+}
+
+void TsvReader::get(uint16 col, std::string &val) {
+    val.assign(_fields[col].data, _fields[col].size);
+}
+
+void TsvReader::get(uint16 col, fp64 &val) {
+    if (!parse_fp64(_fields[col].data, _fields[col].data + _fields[col].size, val)) throw_invalid(col);
+}
+
+void TsvReader::get(uint16 col, fp32 &val) {
+    fp64 temp;
+    get(col, temp);
+    val = (fp32) temp;
+}
+
+void TsvReader::get(uint16 col, uint64 &val) {
+    if (!parse_uint64(_fields[col].data, _fields[col].data + _fields[col].size, val)) throw_invalid(col);
+}
+
+void TsvReader::get(uint16 col, uint32 &val) {
+    uint64 temp;
+    get(col, temp);
+    if (temp > std::numeric_limits<uint32>::max()) throw_invalid(col);
+    val = (uint32) temp;
+}
+
+void TsvReader::throw_invalid(uint16 col) {
+    throw ExceptionHandler("Invalid number '" + _fields[col].str() + "' in column " + std::to_string(col + 1) +
+                           " at line " + std::to_string(_line_number) + " of " + _path, _err_code);
+}
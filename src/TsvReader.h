@@ -0,0 +1,121 @@
+/*
+ *
+ * Developed by Alexander Hart
+ * Plant Computational Genomics Lab
+ * University of Connecticut
+ *
+ * For information, contact Alexander Hart at:
+ *     entap.dev@gmail.com
+ *
+ * Copyright 2017-2019, Alexander Hart, Dr. Jill Wegrzyn
+ *
+ * This file is part of EnTAP.
+ *
+ * EnTAP is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * EnTAP is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with EnTAP.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef ENTAP_TSVREADER_H
+#define ENTAP_TSVREADER_H
+
+//*********************** Includes *****************************
+#include "common.h"
+#include "EntapGlobals.h"
+#include "ExceptionHandler.h"
+#include <memory>
+//**************************************************************
+
+
+/**
+ * Buffered reader for tab separated files (DIAMOND, RSEM, InterProScan and
+ * EggNOG outputs). Tab and newline bytes are located with SSE2/AVX2 when
+ * available and fields are returned as views into the read buffer, so
+ * nothing is copied unless the caller asks for a std::string. Numeric
+ * fields are converted directly from the buffer.
+ *
+ * gzip and zstd compressed files are decompressed as they are read.
+ *
+ * read_row(a, b, c...) behaves as io::CSVReader::read_row with spaces
+ * trimmed and an error thrown unless the row has exactly that many columns.
+ * Views are only valid until the next row is read.
+ */
+class TsvReader {
+
+public:
+    struct Field {
+        const char *data;
+        uint64      size;
+
+        bool empty() const {return size == 0;}
+        std::string str() const {return std::string(data, size);}
+    };
+
+    TsvReader(const std::string &path, int err_code);
+    ~TsvReader() = default;
+
+    bool next_row();
+    bool next_line() {return next_row();}
+    uint16 field_count() const;
+    const Field &get_field(uint16 col) const;
+    uint64 get_line_number() const;
+
+    template<class... T>
+    bool read_row(T&... cols) {
+        if (!next_row()) return false;
+        if (_fields.size() != sizeof...(cols)) {
+            throw ExceptionHandler("Expected " + std::to_string(sizeof...(cols)) + " columns but found " +
+                                   std::to_string(_fields.size()) + " at line " + std::to_string(_line_number) +
+                                   " of " + _path, _err_code);
+        }
+        assign_fields(0, cols...);
+        return true;
+    }
+
+    static bool parse_fp64(const char *begin, const char *end, fp64 &val);
+    static bool parse_uint64(const char *begin, const char *end, uint64 &val);
+    static const char *find_delim(const char *begin, const char *end);
+
+private:
+    static const uint64 BUFFER_SIZE = 1 << 20;     // Initial read buffer, grows for longer lines
+    static const uint16 MAX_FAST_EXP = 22;          // Powers of 10 exactly representable as fp64
+
+    bool fill_buffer();
+    void get(uint16 col, Field &val);
+    void get(uint16 col, std::string &val);
+    void get(uint16 col, fp64 &val);
+    void get(uint16 col, fp32 &val);
+    void get(uint16 col, uint64 &val);
+    void get(uint16 col, uint32 &val);
+    void throw_invalid(uint16 col);
+
+    void assign_fields(uint16) {}
+
+    template<class T, class... Rest>
+    void assign_fields(uint16 col, T &val, Rest&... rest) {
+        get(col, val);
+        assign_fields(col + 1, rest...);
+    }
+
+    std::unique_ptr<std::istream> _file;      // Decompressed as read for gzip/zstd files
+    std::string         _path;
+    int                 _err_code;
+    std::vector<char>   _buffer;
+    uint64              _begin;         // First unread byte in _buffer
+    uint64              _end;           // End of data read into _buffer
+    uint64              _line_number;
+    std::vector<std::pair<uint64, uint64>> _field_bounds;   // Relative to start of current row
+    std::vector<Field>  _fields;
+};
+
+
+#endif //ENTAP_TSVREADER_H
@@ -39,6 +39,7 @@
 #include "ontology/ModEggnogDMND.h"
 #include "config.h"
 #include "similarity_search/ModDiamond.h"
+#include "similarity_search/SmithWaterman.h"
 
 //**************************************************************
 
@@ -185,6 +186,65 @@
                             "    2. CSV Format\n"                                       \
                             "    3. FASTA Amino Acid (default)\n"                       \
                             "    4. FASTA Nucleotide (default)"
+#define DESC_SIM_SHARDS     "Split the transcriptome into this many length-balanced "   \
+                            "shards for similarity searching. Each shard is searched "  \
+                            "separately and can be re-run on its own if it fails.\n"    \
+                            "Default: 1 (no sharding)"
+#define DESC_SIM_SHARD_IND  "Only run similarity searching for this shard (0 to "       \
+                            "sim-shards - 1) then exit. Use this to spread shards across"\
+                            " separate EnTAP jobs/nodes with the same out-dir. Run EnTAP"\
+                            " again without this flag to merge shards and continue."
+#define DESC_SIM_CACHE      "Path to a directory used to cache similarity search hits " \
+                            "between runs. Sequences already searched against the same "\
+                            "database with the same parameters will not be searched again."
+#define DESC_SIM_SENSITIVITY "DIAMOND sensitivity modes to run, separated by commas "   \
+                            "(fast, sensitive, more-sensitive). Each mode after the "   \
+                            "first only searches sequences that did not get a hit in "  \
+                            "the modes before it, for example: fast,more-sensitive\n"   \
+                            "Default: more-sensitive"
+#define DESC_SIM_DB_CASCADE "Search databases in the order they are given, only sending"\
+                            " sequences without an informative, non-contaminant hit on "\
+                            "to the next database."
+#define DESC_DMND_MERGE     "Configuration only. Also index every database given with "  \
+                            "-d into a single DIAMOND database (entap_merged.dmnd). "   \
+                            "Searching it runs one DIAMOND search for all of them while"\
+                            " results are still reported for each database."
+#define DESC_SIM_SW_MAX     "Allow FASTA databases with up to this many sequences to be "\
+                            "given with -d during Execution. These are searched with "  \
+                            "EnTAP's built-in Smith-Waterman aligner instead of DIAMOND"\
+                            ", skipping database configuration."
+#define DESC_MIN_LENGTH     "Remove sequences shorter than this (residues of the "      \
+                            "sequences being searched, amino acids after frame "        \
+                            "selection) before similarity searching"
+#define DESC_MASK_LOW_COMPLEXITY "Mask low complexity regions before similarity "       \
+                            "searching (DUST for nucleotides, SEG for proteins). "      \
+                            "Entirely masked sequences are removed."
+#define DESC_CONTAM_SCREEN  "Contaminant reference FASTA(s) to screen transcripts "     \
+                            "against before similarity searching, using shared k-mer "  \
+                            "minimizers. Can be flagged multiple times."
+#define DESC_CONTAM_SCREEN_MIN "Fraction of a transcript's minimizers that must be "    \
+                            "found in the contaminant references to flag it.\n"         \
+                            "Default: 0.5"
+#define DESC_CONTAM_SCREEN_SKIP "Do not search transcripts flagged by the contaminant " \
+                            "pre-screen"
+#define DESC_RESTRICT_TAXON "Configuration only. Restrict databases given with -d to "    \
+                            "subjects within this taxon before indexing them with "     \
+                            "DIAMOND. Can be flagged multiple times."
+#define DESC_EXCLUDE_TAXON  "Configuration only. Remove subjects within this taxon "    \
+                            "from databases given with -d before indexing them with "   \
+                            "DIAMOND. Can be flagged multiple times."
+#define DESC_COMPRESS_OUTPUTS "Compress DIAMOND, EggNOG and InterProScan hit files "      \
+                            "(gzip or zstd). Compressed files keep their names and "    \
+                            "are read back transparently, including by later runs."
+#define DESC_TIME_BUDGET    "Wall-clock time (minutes) for similarity searching. "      \
+                            "Sequences are searched in batches by expression (FPKM), "  \
+                            "or length without expression analysis, and no batch is "   \
+                            "started that would exceed the budget. Unsearched sequences"\
+                            " are recorded and searched by a later run."
+#define DESC_SIM_MEMORY     "Memory (GB) a DIAMOND search may use. DIAMOND block size " \
+                            "and index chunks are chosen to fit this and the database " \
+                            "size.\nDefault: 85% of available memory (cgroup limits "   \
+                            "included)"
 //**************************************************************
 // Externs
 std::string RSEM_EXE_DIR;
@@ -270,6 +330,29 @@ void UserInput::parse_arguments_boost(int argc, const char** argv) {
                 (INPUT_FLAG_OUTPUT_FORMAT.c_str(),
                  boostPO::value<std::vector<uint16>>()->multitoken()
                         ->default_value(std::vector<uint16>{FileSystem::ENT_FILE_DELIM_TSV, FileSystem::ENT_FILE_FASTA_FAA, FileSystem::ENT_FILE_FASTA_FNN},""),DESC_OUTPUT_FORMAT)
+                (INPUT_FLAG_SIM_SHARDS.c_str(),
+                 boostPO::value<int>()->default_value(DEFAULT_SIM_SHARDS), DESC_SIM_SHARDS)
+                (INPUT_FLAG_SIM_SHARD_IND.c_str(), boostPO::value<int>(), DESC_SIM_SHARD_IND)
+                (INPUT_FLAG_SIM_CACHE.c_str(), boostPO::value<std::string>(), DESC_SIM_CACHE)
+                (INPUT_FLAG_SIM_SENSITIVITY.c_str(),
+                 boostPO::value<std::string>()->default_value(DEFAULT_SIM_SENSITIVITY), DESC_SIM_SENSITIVITY)
+                (INPUT_FLAG_SIM_DB_CASCADE.c_str(), DESC_SIM_DB_CASCADE)
+                (INPUT_FLAG_DMND_MERGE.c_str(), DESC_DMND_MERGE)
+                (INPUT_FLAG_SIM_SW_MAX.c_str(), boostPO::value<int>(), DESC_SIM_SW_MAX)
+                (INPUT_FLAG_SIM_MEMORY.c_str(), boostPO::value<fp32>(), DESC_SIM_MEMORY)
+                (INPUT_FLAG_MIN_LENGTH.c_str(), boostPO::value<int>(), DESC_MIN_LENGTH)
+                (INPUT_FLAG_MASK_LOW_COMPLEXITY.c_str(), DESC_MASK_LOW_COMPLEXITY)
+                (INPUT_FLAG_CONTAM_SCREEN.c_str(),
+                 boostPO::value<std::vector<std::string>>()->multitoken(), DESC_CONTAM_SCREEN)
+                (INPUT_FLAG_CONTAM_SCREEN_MIN.c_str(),
+                 boostPO::value<fp32>()->default_value(DEFAULT_CONTAM_SCREEN_MIN), DESC_CONTAM_SCREEN_MIN)
+                (INPUT_FLAG_CONTAM_SCREEN_SKIP.c_str(), DESC_CONTAM_SCREEN_SKIP)
+                (INPUT_FLAG_TIME_BUDGET.c_str(), boostPO::value<fp32>(), DESC_TIME_BUDGET)
+                (INPUT_FLAG_RESTRICT_TAXON.c_str(),
+                 boostPO::value<std::vector<std::string>>()->multitoken(), DESC_RESTRICT_TAXON)
+                (INPUT_FLAG_EXCLUDE_TAXON.c_str(),
+                 boostPO::value<std::vector<std::string>>()->multitoken(), DESC_EXCLUDE_TAXON)
+                (INPUT_FLAG_COMPRESS_OUTPUTS.c_str(), boostPO::value<std::string>(), DESC_COMPRESS_OUTPUTS)
                 (INPUT_FLAG_OVERWRITE.c_str(), DESC_OVERWRITE);
         boostPO::variables_map vm;
         try {
@@ -341,6 +424,23 @@ void UserInput::parse_arguments_boost(int argc, const char** argv) {
         TCLAP::ValueArg<std::string> argSpecies("", INPUT_FLAG_SPECIES, DESC_TAXON, false, "", "string", cmd);
         TCLAP::ValueArg<std::string> argState("", INPUT_FLAG_STATE, DESC_STATE, false, DEFAULT_STATE, "string", cmd);
         TCLAP::ValueArg<std::string> argTranscript("i", INPUT_FLAG_TRANSCRIPTOME, DESC_INPUT_TRAN, false, "", "string", cmd);
+        TCLAP::ValueArg<int> argSimShards("", INPUT_FLAG_SIM_SHARDS, DESC_SIM_SHARDS, false, DEFAULT_SIM_SHARDS, "integer", cmd);
+        TCLAP::ValueArg<int> argSimShardInd("", INPUT_FLAG_SIM_SHARD_IND, DESC_SIM_SHARD_IND, false, 0, "integer", cmd);
+        TCLAP::ValueArg<std::string> argSimCache("", INPUT_FLAG_SIM_CACHE, DESC_SIM_CACHE, false, "", "string", cmd);
+        TCLAP::SwitchArg argDmndMerge("", INPUT_FLAG_DMND_MERGE, DESC_DMND_MERGE, cmd, false);
+        TCLAP::ValueArg<int> argSimSwMax("", INPUT_FLAG_SIM_SW_MAX, DESC_SIM_SW_MAX, false, 0, "integer", cmd);
+        TCLAP::ValueArg<fp32> argSimMemory("", INPUT_FLAG_SIM_MEMORY, DESC_SIM_MEMORY, false, 0, "decimal", cmd);
+        TCLAP::ValueArg<int> argMinLength("", INPUT_FLAG_MIN_LENGTH, DESC_MIN_LENGTH, false, 0, "integer", cmd);
+        TCLAP::SwitchArg argMaskLowComplexity("", INPUT_FLAG_MASK_LOW_COMPLEXITY, DESC_MASK_LOW_COMPLEXITY, cmd, false);
+        TCLAP::MultiArg<std::string> argContamScreen("", INPUT_FLAG_CONTAM_SCREEN, DESC_CONTAM_SCREEN, false, "string list", cmd);
+        TCLAP::ValueArg<fp32> argContamScreenMin("", INPUT_FLAG_CONTAM_SCREEN_MIN, DESC_CONTAM_SCREEN_MIN, false, DEFAULT_CONTAM_SCREEN_MIN, "decimal", cmd);
+        TCLAP::SwitchArg argContamScreenSkip("", INPUT_FLAG_CONTAM_SCREEN_SKIP, DESC_CONTAM_SCREEN_SKIP, cmd, false);
+        TCLAP::ValueArg<fp32> argTimeBudget("", INPUT_FLAG_TIME_BUDGET, DESC_TIME_BUDGET, false, 0, "decimal", cmd);
+        TCLAP::MultiArg<std::string> argRestrictTaxon("", INPUT_FLAG_RESTRICT_TAXON, DESC_RESTRICT_TAXON, false, "string list", cmd);
+        TCLAP::MultiArg<std::string> argExcludeTaxon("", INPUT_FLAG_EXCLUDE_TAXON, DESC_EXCLUDE_TAXON, false, "string list", cmd);
+        TCLAP::ValueArg<std::string> argCompressOutputs("", INPUT_FLAG_COMPRESS_OUTPUTS, DESC_COMPRESS_OUTPUTS, false, "", "string", cmd);
+        TCLAP::SwitchArg argSimDbCascade("", INPUT_FLAG_SIM_DB_CASCADE, DESC_SIM_DB_CASCADE, cmd, false);
+        TCLAP::ValueArg<std::string> argSimSensitivity("", INPUT_FLAG_SIM_SENSITIVITY, DESC_SIM_SENSITIVITY, false, DEFAULT_SIM_SENSITIVITY, "string list", cmd);
 
         // Multi Args
         TCLAP::MultiArg<std::string> argInterpro("", INPUT_FLAG_INTERPRO, DESC_INTER_DATA, false, "string list",cmd);
@@ -387,6 +487,23 @@ void UserInput::parse_arguments_boost(int argc, const char** argv) {
         if (argSpecies.isSet()) _user_inputs.emplace(INPUT_FLAG_SPECIES, argSpecies.getValue());
         _user_inputs.emplace(INPUT_FLAG_STATE, argState.getValue());
         if (argTranscript.isSet())_user_inputs.emplace(INPUT_FLAG_TRANSCRIPTOME, argTranscript.getValue());
+        _user_inputs.emplace(INPUT_FLAG_SIM_SHARDS, argSimShards.getValue());
+        if (argSimShardInd.isSet()) _user_inputs.emplace(INPUT_FLAG_SIM_SHARD_IND, argSimShardInd.getValue());
+        if (argSimCache.isSet()) _user_inputs.emplace(INPUT_FLAG_SIM_CACHE, argSimCache.getValue());
+        _user_inputs.emplace(INPUT_FLAG_SIM_SENSITIVITY, argSimSensitivity.getValue());
+        if (argSimDbCascade.isSet()) _user_inputs.emplace(INPUT_FLAG_SIM_DB_CASCADE, true);
+        if (argDmndMerge.isSet()) _user_inputs.emplace(INPUT_FLAG_DMND_MERGE, true);
+        if (argSimSwMax.isSet()) _user_inputs.emplace(INPUT_FLAG_SIM_SW_MAX, argSimSwMax.getValue());
+        if (argSimMemory.isSet()) _user_inputs.emplace(INPUT_FLAG_SIM_MEMORY, argSimMemory.getValue());
+        if (argMinLength.isSet()) _user_inputs.emplace(INPUT_FLAG_MIN_LENGTH, argMinLength.getValue());
+        if (argMaskLowComplexity.isSet()) _user_inputs.emplace(INPUT_FLAG_MASK_LOW_COMPLEXITY, true);
+        if (argContamScreen.isSet()) _user_inputs.emplace(INPUT_FLAG_CONTAM_SCREEN, argContamScreen.getValue());
+        _user_inputs.emplace(INPUT_FLAG_CONTAM_SCREEN_MIN, argContamScreenMin.getValue());
+        if (argContamScreenSkip.isSet()) _user_inputs.emplace(INPUT_FLAG_CONTAM_SCREEN_SKIP, true);
+        if (argTimeBudget.isSet()) _user_inputs.emplace(INPUT_FLAG_TIME_BUDGET, argTimeBudget.getValue());
+        if (argRestrictTaxon.isSet()) _user_inputs.emplace(INPUT_FLAG_RESTRICT_TAXON, argRestrictTaxon.getValue());
+        if (argExcludeTaxon.isSet()) _user_inputs.emplace(INPUT_FLAG_EXCLUDE_TAXON, argExcludeTaxon.getValue());
+        if (argCompressOutputs.isSet()) _user_inputs.emplace(INPUT_FLAG_COMPRESS_OUTPUTS, argCompressOutputs.getValue());
 
         // Add MultiArgs (defaults) Couldnt find a way to do defaults in constructor??!
         if (argInterpro.isSet()) {
@@ -495,6 +612,10 @@ bool UserInput::verify_user_input() {
         throw(ExceptionHandler("Cannot specify both config and run flags",
                                ERR_ENTAP_INPUT_PARSE));
     }
+    if (!is_config && (has_input(INPUT_FLAG_RESTRICT_TAXON) || has_input(INPUT_FLAG_EXCLUDE_TAXON))) {
+        throw ExceptionHandler(INPUT_FLAG_RESTRICT_TAXON + " and " + INPUT_FLAG_EXCLUDE_TAXON +
+                               " can only be used during configuration", ERR_ENTAP_INPUT_PARSE);
+    }
     print_user_input();
 
     // If user wants to skip this check, EXIT
@@ -539,6 +660,11 @@ bool UserInput::verify_user_input() {
                                                pEntapDatabase->get_current_version_str() + "\nYou need: " +
                                                pEntapDatabase->get_required_version_str(), ERR_ENTAP_READ_ENTAP_DATA_GENERIC);
             }
+            if (pEntapDatabase->is_sql_legacy()) {
+                std::cout << "WARNING: EnTAP SQL database is version " + pEntapDatabase->get_current_version_str() +
+                             " and will be read without the new indexes (slower). Run EnTAP with --config to migrate it to version " +
+                             pEntapDatabase->get_required_version_str() << std::endl;
+            }
 
             FS_dprint("Success!");
 
@@ -613,6 +739,84 @@ bool UserInput::verify_user_input() {
                 }
             }
 
+            // Verify similarity search sharding
+            if (has_input(INPUT_FLAG_SIM_SHARDS)) {
+                int shards = get_user_input<int>(INPUT_FLAG_SIM_SHARDS);
+                if (shards < 1) {
+                    throw ExceptionHandler("Similarity search shards must be at least 1", ERR_ENTAP_INPUT_PARSE);
+                }
+                if (shards > 1 && has_input(INPUT_FLAG_SIM_DB_CASCADE)) {
+                    throw ExceptionHandler("Similarity search shards cannot be used with " + INPUT_FLAG_SIM_DB_CASCADE,
+                                           ERR_ENTAP_INPUT_PARSE);
+                }
+                if (has_input(INPUT_FLAG_SIM_SHARD_IND)) {
+                    int shard_ind = get_user_input<int>(INPUT_FLAG_SIM_SHARD_IND);
+                    if (shard_ind < 0 || shard_ind >= shards) {
+                        throw ExceptionHandler("Similarity search shard index must be between 0 and " +
+                                               std::to_string(shards - 1), ERR_ENTAP_INPUT_PARSE);
+                    }
+                }
+            }
+
+            // Verify prefilter
+            if (has_input(INPUT_FLAG_MIN_LENGTH)) {
+                if (get_user_input<int>(INPUT_FLAG_MIN_LENGTH) < 0) {
+                    throw ExceptionHandler("Minimum sequence length cannot be negative", ERR_ENTAP_INPUT_PARSE);
+                }
+            }
+
+            // Verify contaminant pre-screen
+            if (has_input(INPUT_FLAG_CONTAM_SCREEN)) {
+                for (std::string &path : get_user_input<vect_str_t>(INPUT_FLAG_CONTAM_SCREEN)) {
+                    if (!_pFileSystem->file_exists(path)) {
+                        throw ExceptionHandler("Contaminant reference not found at: " + path, ERR_ENTAP_INPUT_PARSE);
+                    }
+                }
+                fp32 screen_min = get_user_input<fp32>(INPUT_FLAG_CONTAM_SCREEN_MIN);
+                if (screen_min <= 0 || screen_min > 1) {
+                    throw ExceptionHandler("Contaminant pre-screen fraction must be greater than 0 and at most 1",
+                                           ERR_ENTAP_INPUT_PARSE);
+                }
+            } else if (has_input(INPUT_FLAG_CONTAM_SCREEN_SKIP)) {
+                throw ExceptionHandler(INPUT_FLAG_CONTAM_SCREEN_SKIP + " requires " + INPUT_FLAG_CONTAM_SCREEN,
+                                       ERR_ENTAP_INPUT_PARSE);
+            }
+
+            // Verify time budget, batches are searched as shards
+            if (has_input(INPUT_FLAG_TIME_BUDGET)) {
+                if (get_user_input<fp32>(INPUT_FLAG_TIME_BUDGET) <= 0) {
+                    throw ExceptionHandler("Time budget must be greater than 0 minutes", ERR_ENTAP_INPUT_PARSE);
+                }
+                if (get_user_input<int>(INPUT_FLAG_SIM_SHARDS) > 1 || has_input(INPUT_FLAG_SIM_SHARD_IND) ||
+                    has_input(INPUT_FLAG_SIM_DB_CASCADE)) {
+                    throw ExceptionHandler(INPUT_FLAG_TIME_BUDGET + " cannot be used with " + INPUT_FLAG_SIM_SHARDS +
+                                           ", " + INPUT_FLAG_SIM_SHARD_IND + " or " + INPUT_FLAG_SIM_DB_CASCADE,
+                                           ERR_ENTAP_INPUT_PARSE);
+                }
+            }
+
+            // Verify hit file compression
+            if (has_input(INPUT_FLAG_COMPRESS_OUTPUTS) && get_output_compression() == FileSystem::ENT_FILE_UNUSED) {
+                throw ExceptionHandler("Output compression must be " + FileSystem::COMPRESS_GZIP + " or " +
+                                       FileSystem::COMPRESS_ZSTD, ERR_ENTAP_INPUT_PARSE);
+            }
+
+            // Verify DIAMOND memory budget
+            if (has_input(INPUT_FLAG_SIM_MEMORY)) {
+                if (get_user_input<fp32>(INPUT_FLAG_SIM_MEMORY) <= 0) {
+                    throw ExceptionHandler("Similarity search memory must be greater than 0 GB", ERR_ENTAP_INPUT_PARSE);
+                }
+            }
+
+            // Verify DIAMOND sensitivity cascade
+            if (has_input(INPUT_FLAG_SIM_SENSITIVITY)) {
+                std::string sensitivity = get_user_input<std::string>(INPUT_FLAG_SIM_SENSITIVITY);
+                if (!ModDiamond::is_valid_sensitivity(_pFileSystem->list_to_vect(',', sensitivity))) {
+                    throw ExceptionHandler("Invalid similarity search sensitivity: " + sensitivity,
+                                           ERR_ENTAP_INPUT_PARSE);
+                }
+            }
+
             // Verify Ontology Flags
             is_interpro = false;
             if (has_input(INPUT_FLAG_ONTOLOGY)) {
@@ -690,6 +894,14 @@ bool UserInput::verify_user_input() {
 void UserInput::verify_databases(bool isrun) {
 
     databases_t     other_data;
+    int             sw_max=0;
+
+    if (has_input(INPUT_FLAG_SIM_SW_MAX)) {
+        sw_max = get_user_input<int>(INPUT_FLAG_SIM_SW_MAX);
+        if (sw_max < 1) {
+            throw ExceptionHandler("Smith-Waterman database size must be at least 1 sequence", ERR_ENTAP_INPUT_PARSE);
+        }
+    }
 
     if (has_input(INPUT_FLAG_DATABASE)) {
         other_data = get_user_input<databases_t>(INPUT_FLAG_DATABASE);
@@ -715,9 +927,11 @@ void UserInput::verify_databases(bool isrun) {
                 throw ExceptionHandler("Cannot input DIAMOND (.dmnd) database when configuring!", ERR_ENTAP_INPUT_PARSE);
             }
         } else {
-            // No, are we executing main pipeline?
-            if (isrun) {
-                throw ExceptionHandler("Must input DIAMOND (.dmnd) database when executing!", ERR_ENTAP_INPUT_PARSE);
+            // No, are we executing main pipeline? Small FASTA databases can be aligned without DIAMOND
+            if (isrun && (sw_max == 0 || (uint64) sw_max < SmithWaterman::count_sequences(path))) {
+                throw ExceptionHandler("Must input DIAMOND (.dmnd) database when executing! FASTA databases are only "
+                                       "allowed up to the size set by " + INPUT_FLAG_SIM_SW_MAX + ": " + path,
+                                       ERR_ENTAP_INPUT_PARSE);
             }
         }
 
@@ -1147,12 +1361,14 @@ void UserInput::verify_state(std::string &state, bool runP, std::vector<uint16>
 std::pair<bool,std::string> UserInput::verify_software(uint8 &states,std::vector<uint16> &ontology) {
     FS_dprint("Verifying software...");
 
+#ifndef DIAMOND_LINKED  // Searches ran in-process
     if (states & SIMILARITY_SEARCH) {
         if (!ModDiamond::is_executable(DIAMOND_EXE)) {
             return std::make_pair(false, "Could not execute a test run of DIAMOND, be sure"
                     " it's properly installed and the path is correct");
         }
     }
+#endif
     if (states & GENE_ONTOLOGY) {
         for (uint16 flag : ontology) {
             switch (flag) {
@@ -1284,6 +1500,19 @@ vect_str_t UserInput::get_contaminants() {
     return output_contams;
 }
 
+vect_str_t UserInput::get_user_taxa(const std::string &flag) {
+    vect_str_t output_taxa;
+
+    if (has_input(flag)) {
+        output_taxa = get_user_input<vect_str_t>(flag);
+        for (std::string &taxon : output_taxa) {
+            if (taxon.empty()) continue;
+            process_user_species(taxon);
+        }
+    }
+    return output_taxa;
+}
+
 vect_str_t UserInput::get_uninformative_vect() {
     vect_str_t output_uninform;
     std::string uninform_path;
@@ -1340,6 +1569,12 @@ std::string UserInput::get_executable_dir() {
     return "";
 }
 
+// Compression for hit files, ENT_FILE_UNUSED if they are left uncompressed
+FileSystem::ENT_FILE_TYPES UserInput::get_output_compression() {
+    if (!has_input(INPUT_FLAG_COMPRESS_OUTPUTS)) return FileSystem::ENT_FILE_UNUSED;
+    return FileSystem::get_compression_type(get_user_input<std::string>(INPUT_FLAG_COMPRESS_OUTPUTS));
+}
+
 std::vector<FileSystem::ENT_FILE_TYPES> UserInput::get_user_output_types() {
     std::vector<FileSystem::ENT_FILE_TYPES> ret;
 
@@ -82,9 +82,11 @@ public:
     std::queue<char> get_state_queue();
     std::string get_target_species_str();
     vect_str_t get_contaminants();
+    vect_str_t get_user_taxa(const std::string &flag);
     vect_str_t get_uninformative_vect();
     std::string get_user_transc_basename();
     std::vector<FileSystem::ENT_FILE_TYPES> get_user_output_types();
+    FileSystem::ENT_FILE_TYPES get_output_compression();
 
     template<class T>
     T get_user_input(const std::string &key) {
@@ -137,6 +139,23 @@ public:
     const std::string INPUT_FLAG_GENERATE      = "data-generate";
     const std::string INPUT_FLAG_DATABASE_TYPE = "data-type";
     const std::string INPUT_FLAG_OUTPUT_FORMAT = "output-format";
+    const std::string INPUT_FLAG_SIM_SHARDS    = "sim-shards";
+    const std::string INPUT_FLAG_SIM_SHARD_IND = "sim-shard-index";
+    const std::string INPUT_FLAG_SIM_CACHE     = "sim-cache";
+    const std::string INPUT_FLAG_SIM_SENSITIVITY = "sim-sensitivity";
+    const std::string INPUT_FLAG_SIM_DB_CASCADE  = "sim-db-cascade";
+    const std::string INPUT_FLAG_DMND_MERGE    = "dmnd-merge";
+    const std::string INPUT_FLAG_SIM_SW_MAX    = "sim-sw-max";
+    const std::string INPUT_FLAG_SIM_MEMORY    = "sim-memory";
+    const std::string INPUT_FLAG_MIN_LENGTH    = "min-length";
+    const std::string INPUT_FLAG_MASK_LOW_COMPLEXITY = "mask-low-complexity";
+    const std::string INPUT_FLAG_CONTAM_SCREEN = "contam-screen";
+    const std::string INPUT_FLAG_CONTAM_SCREEN_MIN  = "contam-screen-min";
+    const std::string INPUT_FLAG_CONTAM_SCREEN_SKIP = "contam-screen-skip";
+    const std::string INPUT_FLAG_TIME_BUDGET   = "time-budget";
+    const std::string INPUT_FLAG_RESTRICT_TAXON = "restrict-taxon";
+    const std::string INPUT_FLAG_EXCLUDE_TAXON = "exclude-taxon";
+    const std::string INPUT_FLAG_COMPRESS_OUTPUTS = "compress-outputs";
 
 private:
     enum SPECIES_FLAGS {
@@ -177,7 +196,10 @@ private:
     const fp32 FPKM_MIN                        = 0.0;
     const fp32 FPKM_MAX                        = 100.0;
     const uint8 MAX_DATABASE_SIZE              = 5;
+    const int   DEFAULT_SIM_SHARDS             = 1;
     const std::string DEFAULT_STATE            = "+";
+    const std::string DEFAULT_SIM_SENSITIVITY  = "more-sensitive";
+    const fp32 DEFAULT_CONTAM_SCREEN_MIN       = 0.5;
     const std::string OUTFILE_DEFAULT          = PATHS(FileSystem::get_cur_dir(),"entap_outfiles");
 
     // Enter as lowercase
@@ -0,0 +1,140 @@
+/*
+ *
+ * Developed by Alexander Hart
+ * Plant Computational Genomics Lab
+ * University of Connecticut
+ *
+ * For information, contact Alexander Hart at:
+ *     entap.dev@gmail.com
+ *
+ * Copyright 2017-2019, Alexander Hart, Dr. Jill Wegrzyn
+ *
+ * This file is part of EnTAP.
+ *
+ * EnTAP is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * EnTAP is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with EnTAP.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+/**
+ * Standalone benchmark comparing TsvReader against io::CSVReader on a
+ * DIAMOND output file (EnTAP's tabular format, 14 columns). Both readers
+ * parse every row into the same types used by ModDiamond and the row
+ * count and e-value sum are compared so differing results are reported.
+ *
+ * Usage: tsv_reader_benchmark <diamond_output.tsv> [repeats]
+ *
+ * Built only with -DBUILD_BENCHMARKS=ON
+ */
+
+//*********************** Includes *****************************
+#include <chrono>
+#include <iostream>
+#include <csv.h>
+#include "../TsvReader.h"
+//**************************************************************
+
+struct BenchResult {
+    uint64 rows;
+    fp64   evalue_sum;
+    fp64   seconds;
+};
+
+typedef std::chrono::steady_clock bench_clock_t;
+
+// Defined in main.cpp for EnTAP, debug/log output is not written here
+std::string DEBUG_FILE_PATH;
+std::string LOG_FILE_PATH;
+
+static const uint16 DMND_COL_NUMBER = 14;
+
+static BenchResult bench_csv_reader(const std::string &path) {
+    BenchResult result = {};
+    std::string qseqid, sseqid, stitle, pident, bitscore,
+            length, mismatch, gapopen, qstart, qend, sstart, send;
+    fp64        evalue, coverage;
+
+    bench_clock_t::time_point start = bench_clock_t::now();
+    io::CSVReader<DMND_COL_NUMBER, io::trim_chars<' '>, io::no_quote_escape<'\t'>> in(path);
+    while (in.read_row(qseqid, sseqid, pident, length, mismatch, gapopen,
+                       qstart, qend, sstart, send, evalue, bitscore, coverage, stitle)) {
+        result.rows++;
+        result.evalue_sum += evalue;
+    }
+    result.seconds = std::chrono::duration<fp64>(bench_clock_t::now() - start).count();
+    return result;
+}
+
+static BenchResult bench_tsv_reader(const std::string &path) {
+    BenchResult result = {};
+    std::string qseqid, sseqid, stitle, pident, bitscore,
+            length, mismatch, gapopen, qstart, qend, sstart, send;
+    fp64        evalue, coverage;
+
+    bench_clock_t::time_point start = bench_clock_t::now();
+    TsvReader in(path, ERR_ENTAP_RUN_SIM_SEARCH_FILTER);
+    while (in.read_row(qseqid, sseqid, pident, length, mismatch, gapopen,
+                       qstart, qend, sstart, send, evalue, bitscore, coverage, stitle)) {
+        result.rows++;
+        result.evalue_sum += evalue;
+    }
+    result.seconds = std::chrono::duration<fp64>(bench_clock_t::now() - start).count();
+    return result;
+}
+
+static void print_result(const std::string &name, const BenchResult &result) {
+    std::cout << name << ": " << result.rows << " rows in " << result.seconds << "s ("
+              << (result.seconds > 0 ? result.rows / result.seconds : 0) << " rows/s)" << std::endl;
+}
+
+int main(int argc, const char **argv) {
+    std::string path;
+    int         repeats = 5;
+    BenchResult csv_best = {};
+    BenchResult tsv_best = {};
+    BenchResult result;
+
+    if (argc < 2) {
+        std::cerr << "Usage: " << argv[0] << " <diamond_output.tsv> [repeats]" << std::endl;
+        return 1;
+    }
+    path = argv[1];
+    if (argc > 2) repeats = std::max(std::atoi(argv[2]), 1);
+
+    try {
+        // Alternate readers so both see the same page cache state, keep fastest run
+        for (int i = 0; i < repeats; i++) {
+            result = bench_csv_reader(path);
+            if (i == 0 || result.seconds < csv_best.seconds) csv_best = result;
+            result = bench_tsv_reader(path);
+            if (i == 0 || result.seconds < tsv_best.seconds) tsv_best = result;
+        }
+    } catch (ExceptionHandler &e) {
+        std::cerr << "TsvReader error: " << e.what() << std::endl;
+        return 1;
+    } catch (const std::exception &e) {
+        std::cerr << "CSVReader error: " << e.what() << std::endl;
+        return 1;
+    }
+
+    print_result("io::CSVReader", csv_best);
+    print_result("TsvReader    ", tsv_best);
+    if (tsv_best.seconds > 0) {
+        std::cout << "Speedup: " << csv_best.seconds / tsv_best.seconds << "x" << std::endl;
+    }
+    if (csv_best.rows != tsv_best.rows || csv_best.evalue_sum != tsv_best.evalue_sum) {
+        std::cerr << "ERROR: readers returned different results" << std::endl;
+        return 1;
+    }
+    return 0;
+}
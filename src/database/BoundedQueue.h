@@ -0,0 +1,94 @@
+/*
+ *
+ * Developed by Alexander Hart
+ * Plant Computational Genomics Lab
+ * University of Connecticut
+ *
+ * For information, contact Alexander Hart at:
+ *     entap.dev@gmail.com
+ *
+ * Copyright 2017-2019, Alexander Hart, Dr. Jill Wegrzyn
+ *
+ * This file is part of EnTAP.
+ *
+ * EnTAP is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * EnTAP is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with EnTAP.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef ENTAP_BOUNDEDQUEUE_H
+#define ENTAP_BOUNDEDQUEUE_H
+
+//*********************** Includes *****************************
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+//**************************************************************
+
+
+/**
+ * Fixed capacity queue handing work from producer threads to consumer
+ * threads
+ *
+ * push() blocks while the queue is full so a fast producer (parser) cannot
+ * run ahead of a slow consumer (writer) and buffer a whole file in memory.
+ * pop() blocks while the queue is empty and returns false once the queue
+ * has been closed and drained. Closing also releases blocked producers,
+ * whose items are then dropped.
+ */
+template<class T>
+class BoundedQueue {
+
+public:
+    explicit BoundedQueue(size_t capacity) : _capacity(capacity > 0 ? capacity : 1), _closed(false) {}
+    BoundedQueue(const BoundedQueue&) = delete;
+    BoundedQueue &operator=(const BoundedQueue&) = delete;
+
+    // Returns false if queue was closed and item was not queued
+    bool push(T &&item) {
+        std::unique_lock<std::mutex> lock(_mutex);
+        _not_full.wait(lock, [this]() {return _closed || _items.size() < _capacity;});
+        if (_closed) return false;
+        _items.push_back(std::move(item));
+        _not_empty.notify_one();
+        return true;
+    }
+
+    // Returns false once queue is closed and empty
+    bool pop(T &item) {
+        std::unique_lock<std::mutex> lock(_mutex);
+        _not_empty.wait(lock, [this]() {return _closed || !_items.empty();});
+        if (_items.empty()) return false;
+        item = std::move(_items.front());
+        _items.pop_front();
+        _not_full.notify_one();
+        return true;
+    }
+
+    void close() {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _closed = true;
+        _not_empty.notify_all();
+        _not_full.notify_all();
+    }
+
+private:
+    size_t                  _capacity;
+    bool                    _closed;
+    std::deque<T>           _items;
+    std::mutex              _mutex;
+    std::condition_variable _not_empty;
+    std::condition_variable _not_full;
+};
+
+
+#endif //ENTAP_BOUNDEDQUEUE_H
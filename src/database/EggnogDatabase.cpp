@@ -338,7 +338,7 @@ EggnogDatabase::ERR_EGGNOG_DB EggnogDatabase::open_sql(std::string& sql_path) {
     }
 
     _pSQLDatabase = new SQLDatabaseHelper();
-    if (!_pSQLDatabase->open(sql_path)) {
+    if (!_pSQLDatabase->open(sql_path, true)) {
         FS_dprint("Unable to open SQL database");
         return ERR_EGG_SQL_OPEN;
     }
@@ -452,19 +452,17 @@ void EggnogDatabase::get_tax_scope(QuerySequence::EggnogResults *eggnogResults)
 void EggnogDatabase::get_sql_data(QuerySequence::EggnogResults *eggnogResults) {
     // Lookup description, KEGG, protein domain from SQL database
     if (!eggnogResults->og_key.empty()) {
-        std::vector<std::vector<std::string>>results;
         std::string sql_kegg;
         std::string sql_desc;
         std::string sql_protein;
 
-        char *query = sqlite3_mprintf(
-                "SELECT description, KEGG_freq, SMART_freq FROM og WHERE og=%Q",
-                eggnogResults->og_key.c_str());
         try {
-            results = _pSQLDatabase->query(query);
-            sql_desc = results[0][0];
-            sql_kegg = results[0][1];
-            sql_protein = results[0][2];
+            SQLDatabaseHelper::Statement statement = _pSQLDatabase->prepare(SQL_SELECT_OG);
+            statement.bind(1, eggnogResults->og_key);
+            if (!statement.step()) return;
+            sql_desc = statement.get_string(0);
+            sql_kegg = statement.get_string(1);
+            sql_protein = statement.get_string(2);
             if (!sql_desc.empty() && sql_desc.find("[]") != 0) eggnogResults->description = sql_desc;
             if (!sql_kegg.empty() && sql_kegg.find("[]") != 0) {
                 eggnogResults->kegg = format_sql_data(sql_kegg);
@@ -571,33 +569,23 @@ std::string EggnogDatabase::format_sql_data(std::string &input) {
 }
 
 void EggnogDatabase::get_member_ogs(QuerySequence::EggnogResults *eggnog_results) {
-    std::vector<std::vector<std::string>>results;
-    char *query;
+    std::string member_table;
 
     if (eggnog_results->seed_ortholog.empty()) return;
 
     if (_sql_version == EGGNOG_VERSION_4_5_1) {
         // emapper.db-4.5.1
-        query = sqlite3_mprintf(
-                "SELECT %q FROM %q WHERE %q=%Q",
-                SQL_MEMBER_GROUP.c_str(),
-                SQL_EGGNOG_TABLE.c_str(),
-                SQL_MEMBER_NAME.c_str(),
-                eggnog_results->seed_ortholog.c_str()
-        );
+        member_table = SQL_EGGNOG_TABLE;
     } else {
         // Older versions
-        query = sqlite3_mprintf(
-                "SELECT %q FROM %q WHERE %q=%Q",
-                SQL_MEMBER_GROUP.c_str(),
-                _SQL_MEMBER_TABLE.c_str(),
-                SQL_MEMBER_NAME.c_str(),
-                eggnog_results->seed_ortholog.c_str());
+        member_table = _SQL_MEMBER_TABLE;
     }
 
-    results = _pSQLDatabase->query(query);
-    if (!results.empty()) {
-        eggnog_results->member_ogs = results[0][0];
+    SQLDatabaseHelper::Statement statement = _pSQLDatabase->prepare(
+            "SELECT " + SQL_MEMBER_GROUP + " FROM " + member_table + " WHERE " + SQL_MEMBER_NAME + "=?");
+    statement.bind(1, eggnog_results->seed_ortholog);
+    if (statement.step()) {
+        eggnog_results->member_ogs = statement.get_string(0);
     }
 }
 
@@ -613,16 +601,13 @@ EggnogDatabase::member_orthologs_t EggnogDatabase::get_member_orthologs(EggnogDa
     query_taxon = best_hit.substr(0, best_hit.find_first_of('.'));    // "34740"
     target_members.insert(best_hit);                                  // 34740.HMEL017225-PA
 
-    sql_query = sqlite3_mprintf(
-            "SELECT %q FROM %q WHERE %q=%Q",
-            SQL_MEMBER_ORTHOINDEX.c_str(),
-            _SQL_MEMBER_TABLE.c_str(),
-            SQL_MEMBER_NAME.c_str(),
-            best_hit.c_str());
-    sql_results = _pSQLDatabase->query(sql_query);
-    if (!sql_results.empty()) {
-        event_indexes = sql_results[0][0];
-    } else return member_orthologs_t();
+    {
+        SQLDatabaseHelper::Statement statement = _pSQLDatabase->prepare(
+                "SELECT " + SQL_MEMBER_ORTHOINDEX + " FROM " + _SQL_MEMBER_TABLE + " WHERE " + SQL_MEMBER_NAME + "=?");
+        statement.bind(1, best_hit);
+        if (!statement.step()) return member_orthologs_t();
+        event_indexes = statement.get_string(0);
+    }
 
     if (event_indexes.empty()) return member_orthologs_t();
     // Can specify levels as well here
@@ -161,6 +161,7 @@ private:
     const std::string SQL_MEMBER_GROUP      = "groups";
     const std::string SQL_MEMBER_NAME       = "name";
     const std::string SQL_MEMBER_ORTHOINDEX = "orthoindex";
+    const std::string SQL_SELECT_OG         = "SELECT description, KEGG_freq, SMART_freq FROM og WHERE og=?";
     const std::string SQL_MEMBER_PNAME      = "pname";
     const std::string SQL_MEMBER_GO         = "go";
     const std::string SQL_MEMBER_KEGG       = "kegg";
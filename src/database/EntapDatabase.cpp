@@ -26,6 +26,8 @@
 
 #include <csv.h>
 #include "EntapDatabase.h"
+#include "MappedDatabase.h"
+#include "UniprotDatParser.h"
 
 /**
  * ======================================================================
@@ -49,10 +51,34 @@ EntapDatabase::EntapDatabase(FileSystem* filesystem) {
     _pFilesystem     = filesystem;
     _temp_directory  = filesystem->get_temp_outdir();    // created previously
     _pSerializedDatabase = nullptr;
+    _pMappedDatabase     = nullptr;
     _pDatabaseHelper     = nullptr;
     _use_serial          = true;                         // default
+    _sql_go_complete     = false;
+    _sql_legacy          = false;
+    _threads             = 1;
     _err_msg             = "";
     _err_code            = ERR_DATA_OK;
+
+    // SQL lookups
+    _sql_select_tax     = "SELECT " + SQL_COL_NCBI_TAX_TAXID + ", " + SQL_COL_NCBI_TAX_LINEAGE +
+                          " FROM " + SQL_TABLE_NCBI_TAX_TITLE + " WHERE " + SQL_COL_NCBI_TAX_NAME + "=?";
+    _sql_select_go      = "SELECT " + SQL_TABLE_GO_COL_DESC + ", " + SQL_TABLE_GO_COL_CATEGORY + ", " +
+                          SQL_TABLE_GO_COL_LEVEL + " FROM " + SQL_TABLE_GO_TITLE +
+                          " WHERE " + SQL_TABLE_GO_COL_ID + "=?";
+    _sql_select_uniprot = "SELECT " + SQL_TABLE_UNIPROT_COL_ID + ", " + SQL_TABLE_UNIPROT_COL_XREF + ", " +
+                          SQL_TABLE_UNIPROT_COL_COMM + " FROM " + SQL_TABLE_UNIPROT_TITLE +
+                          " WHERE " + SQL_TABLE_UNIPROT_COL_ID + "=?";
+
+    // SQL generation, later duplicates replace earlier ones as in the serialized maps
+    _sql_insert_tax     = "INSERT OR REPLACE INTO " + SQL_TABLE_NCBI_TAX_TITLE + " (" + SQL_COL_NCBI_TAX_NAME +
+                          ", " + SQL_COL_NCBI_TAX_TAXID + ", " + SQL_COL_NCBI_TAX_LINEAGE + ") VALUES (?,?,?)";
+    _sql_insert_go      = "INSERT OR REPLACE INTO " + SQL_TABLE_GO_TITLE + " (" + SQL_TABLE_GO_COL_ID + ", " +
+                          SQL_TABLE_GO_COL_DESC + ", " + SQL_TABLE_GO_COL_CATEGORY + ", " +
+                          SQL_TABLE_GO_COL_LEVEL + ") VALUES (?,?,?,?)";
+    _sql_insert_uniprot = "INSERT OR REPLACE INTO " + SQL_TABLE_UNIPROT_TITLE + " (" + SQL_TABLE_UNIPROT_COL_ID +
+                          ", " + SQL_TABLE_UNIPROT_COL_XREF + ", " + SQL_TABLE_UNIPROT_COL_COMM +
+                          ") VALUES (?,?,?)";
 }
 
 
@@ -75,7 +101,7 @@ bool EntapDatabase::set_database(DATABASE_TYPE type) {
         case ENTAP_SERIALIZED:
             // Filepath checked in routine
             _use_serial = true;
-            return serialize_database_read(SERIALIZE_DEFAULT, ENTAP_DATABASE_BIN_PATH) == ERR_DATA_OK;
+            return mapped_database_read(ENTAP_DATABASE_BIN_PATH) == ERR_DATA_OK;
         case ENTAP_SQL:
             _use_serial = false;
             if (!_pFilesystem->file_exists(ENTAP_DATABASE_SQL_PATH)) {
@@ -84,13 +110,77 @@ bool EntapDatabase::set_database(DATABASE_TYPE type) {
             }
             if (_pDatabaseHelper != nullptr) return true;   // already generated
             _pDatabaseHelper = new SQLDatabaseHelper();
-            return _pDatabaseHelper->open(ENTAP_DATABASE_SQL_PATH);
+            if (!_pDatabaseHelper->open(ENTAP_DATABASE_SQL_PATH, true)) {
+                set_err_msg("Unable to open SQL database at: " + ENTAP_DATABASE_SQL_PATH, ERR_DATA_SQL_OPEN);
+                return false;
+            }
+            return sql_check_schema(ENTAP_DATABASE_SQL_PATH, false) == ERR_DATA_OK;
         default:
             return false;
     }
 }
 
 
+/**
+ * ======================================================================
+ * Function bool EntapDatabase::configure_database(DATABASE_TYPE type, std::string &path)
+ *
+ * Description          - Prepares a downloaded/generated database for
+ *                        execution, run during configuration only
+ *                      - Serialized database: builds the memory mapped
+ *                        copy beside it if it is missing or out of date
+ *                      - SQL database: migrates a legacy (1.0) schema to
+ *                        the current indexed layout
+ *
+ * Notes                - Not fatal, execution reads the serialized database
+ *                        if there is no usable mapped copy and a legacy
+ *                        SQL database as is
+ *
+ * @param type          - Type of database
+ * @param path          - Path to database
+ *
+ * @return              - False if the database could not be prepared
+ *                        (print_error_log)
+ *
+ * =====================================================================
+ */
+bool EntapDatabase::configure_database(DATABASE_TYPE type, std::string &path) {
+    std::string mapped_path;
+
+    switch (type) {
+        case ENTAP_SERIALIZED:
+            _use_serial = true;
+            if (_pMappedDatabase != nullptr) return true;   // Already mapped
+            mapped_path = path + MappedDatabase::MAPPED_EXT;
+            _pMappedDatabase = new MappedDatabase();
+            if (_pMappedDatabase->open(mapped_path, path) && is_valid_version()) {
+                FS_dprint("Mapped EnTAP database up to date: " + mapped_path);
+                return true;
+            }
+            delete _pMappedDatabase;
+            _pMappedDatabase = nullptr;
+
+            if (_pSerializedDatabase == nullptr &&
+                serialize_database_read(SERIALIZE_DEFAULT, path) != ERR_DATA_OK) return false;
+            return mapped_database_save(path);
+        case ENTAP_SQL:
+            _use_serial = false;
+            if (_pDatabaseHelper == nullptr) {
+                _pDatabaseHelper = new SQLDatabaseHelper();
+                if (!_pDatabaseHelper->open(path, true)) {
+                    set_err_msg("Unable to open SQL database at: " + path, ERR_DATA_SQL_OPEN);
+                    delete _pDatabaseHelper;
+                    _pDatabaseHelper = nullptr;
+                    return false;
+                }
+            }
+            return sql_check_schema(path, true) == ERR_DATA_OK;
+        default:
+            return true;
+    }
+}
+
+
 /**
  * ======================================================================
  * Function EntapDatabase::DATABASE_ERR EntapDatabase::download_database(
@@ -156,10 +246,45 @@ EntapDatabase::DATABASE_ERR EntapDatabase::generate_database(
     return err;
 }
 
+/**
+ * ======================================================================
+ * Function EntapDatabase::DATABASE_ERR EntapDatabase::generate_entap_database(
+ *                                          DATABASE_TYPE type, std::string &outpath)
+ *
+ * Description          - Builds taxonomy, GO and UniProt sections of the
+ *                        database concurrently, then combines them
+ *                      - UniProt is downloaded alongside the others, its
+ *                        parsing waits for GO as entries reference GO terms
+ *                      - SQL sections are written to their own staging
+ *                        databases and copied into a staging copy of the
+ *                        final database, which is renamed to the output
+ *                        path once complete
+ *
+ * Notes                - Serialized sections fill separate maps of the
+ *                        database so they do not need combining
+ *
+ * @param type          - Type of database to generate
+ * @param outpath       - Path to output database
+ *
+ * @return              - DATABASE_ERR type
+ *
+ * =====================================================================
+ */
 EntapDatabase::DATABASE_ERR EntapDatabase::generate_entap_database(DATABASE_TYPE type, std::string &outpath) {
     DATABASE_ERR err_code;
+    DATABASE_ERR tax_err;
+    DATABASE_ERR go_err;
+    DATABASE_ERR uniprot_err;
+    std::string  staging_path;
+    std::string  uniprot_flat;
+    std::unique_ptr<SQLDatabaseHelper> tax_database;
+    std::unique_ptr<SQLDatabaseHelper> go_database;
+    std::unique_ptr<SQLDatabaseHelper> uniprot_database;
+    std::thread::id tax_thread_id;
+    std::thread::id go_thread_id;
 
     FS_dprint("Database type: " + ENTAP_DATABASE_TYPES_STR[type] + ", Outpath: " + outpath);
+    staging_path = outpath + SQL_STAGING_EXT;
     switch (type) {
 
         case ENTAP_SQL:
@@ -174,11 +299,15 @@ EntapDatabase::DATABASE_ERR EntapDatabase::generate_entap_database(DATABASE_TYPE
                 return ERR_DATA_OK;
             }
 
-            // Create sql database (will create if doesn't exist)
-            _pDatabaseHelper = new SQLDatabaseHelper();
-            if (!_pDatabaseHelper->create(outpath)) {
+            // Create sql database and a staging database for each section
+            _pDatabaseHelper = sql_create_staging(staging_path);
+            tax_database.reset(sql_create_staging(sql_section_path(outpath, ENTAP_TAXONOMY)));
+            go_database.reset(sql_create_staging(sql_section_path(outpath, ENTAP_GENE_ONTOLOGY)));
+            uniprot_database.reset(sql_create_staging(sql_section_path(outpath, ENTAP_UNIPROT)));
+            if (!_pDatabaseHelper || !tax_database || !go_database || !uniprot_database) {
                 // Return error if can't create
                 set_err_msg("Unable to create the EnTAP SQL database", ERR_DATA_SQL_CREATE_DATABASE);
+                sql_remove_staging(outpath);
                 return ERR_DATA_SQL_CREATE_DATABASE;
             }
             FS_dprint("Success!");
@@ -209,21 +338,59 @@ EntapDatabase::DATABASE_ERR EntapDatabase::generate_entap_database(DATABASE_TYPE
 
     // ---------------------- Add Database Entries ---------------------- //
     FS_dprint("Adding entries to database...");
-    // Generate tax entries, don't need a path - using SQL member
-    err_code = generate_entap_tax(type);
-    if (err_code != ERR_DATA_OK) {
-        return err_code;
-    }
+    // Exceptions are caught in each thread, reported with the section's error after join
+    std::thread tax_thread([&]() {
+        try {
+            tax_err = generate_entap_tax(type, tax_database.get());
+        } catch (ExceptionHandler &e) {
+            set_err_msg("Unable to generate taxonomy entries: " + std::string(e.what()), ERR_DATA_TAXONOMY_PARSE);
+            tax_err = ERR_DATA_TAXONOMY_PARSE;
+        } catch (const std::exception &e) {
+            set_err_msg("Unable to generate taxonomy entries: " + std::string(e.what()), ERR_DATA_TAXONOMY_PARSE);
+            tax_err = ERR_DATA_TAXONOMY_PARSE;
+        } catch (...) {
+            set_err_msg("Unable to generate taxonomy entries: unknown error", ERR_DATA_TAXONOMY_PARSE);
+            tax_err = ERR_DATA_TAXONOMY_PARSE;
+        }
+    });
+    std::thread go_thread([&]() {
+        try {
+            go_err = generate_entap_go(type, go_database.get());
+        } catch (ExceptionHandler &e) {
+            set_err_msg("Unable to generate Gene Ontology entries: " + std::string(e.what()), ERR_DATA_GO_PARSE);
+            go_err = ERR_DATA_GO_PARSE;
+        } catch (const std::exception &e) {
+            set_err_msg("Unable to generate Gene Ontology entries: " + std::string(e.what()), ERR_DATA_GO_PARSE);
+            go_err = ERR_DATA_GO_PARSE;
+        } catch (...) {
+            set_err_msg("Unable to generate Gene Ontology entries: unknown error", ERR_DATA_GO_PARSE);
+            go_err = ERR_DATA_GO_PARSE;
+        }
+    });
+    tax_thread_id = tax_thread.get_id();
+    go_thread_id  = go_thread.get_id();
+    uniprot_err = download_entap_uniprot(uniprot_flat);
 
-    // Generate go entries
-    err_code = generate_entap_go(type);
-    if (err_code != ERR_DATA_OK) {
-        return err_code;
+    // Generate UniProt entries (this references GO database, must be done after)
+    go_thread.join();
+    if (uniprot_err == ERR_DATA_OK && go_err == ERR_DATA_OK) {
+        uniprot_err = generate_entap_uniprot(type, uniprot_database.get(), uniprot_flat);
     }
+    tax_thread.join();
 
-    // Generate UniProt entries (this references GO database, must be done after)
-    err_code = generate_entap_uniprot(type);
+    err_code = tax_err != ERR_DATA_OK ? tax_err : (go_err != ERR_DATA_OK ? go_err : uniprot_err);
     if (err_code != ERR_DATA_OK) {
+        // Report each failed section with its own message, not whichever failed last
+        std::string err_msg;
+        if (tax_err != ERR_DATA_OK) err_msg += get_thread_err_msg(tax_thread_id) + "\n";
+        if (go_err != ERR_DATA_OK) err_msg += get_thread_err_msg(go_thread_id) + "\n";
+        if (uniprot_err != ERR_DATA_OK) err_msg += get_thread_err_msg(std::this_thread::get_id()) + "\n";
+        {
+            std::lock_guard<std::mutex> lock(_err_mutex);
+            _err_msg  = err_msg;
+            _err_code = err_code;
+        }
+        if (type == ENTAP_SQL) sql_remove_staging(outpath);
         return err_code;
     }
     // ------------------------------------------------------------------ //
@@ -231,12 +398,24 @@ EntapDatabase::DATABASE_ERR EntapDatabase::generate_entap_database(DATABASE_TYPE
     // Write database to file if necessary and set version number
     FS_dprint("All entries have been added, finalizing...");
 
-    set_database_versions(type);
     switch (type) {
         case ENTAP_SQL:
+            // Sections are complete, release them so they can be attached
+            tax_database.reset();
+            go_database.reset();
+            uniprot_database.reset();
+            err_code = sql_combine_sections(outpath);
+            sql_remove_staging(outpath);
+            if (err_code != ERR_DATA_OK) return err_code;
+            _pDatabaseHelper = new SQLDatabaseHelper();
+            if (!_pDatabaseHelper->open(outpath, true)) {
+                set_err_msg("Unable to open SQL database at: " + outpath, ERR_DATA_SQL_OPEN);
+                return ERR_DATA_SQL_OPEN;
+            }
             break;
 
         case ENTAP_SERIALIZED:
+            set_database_versions(type);
             FS_dprint("All entries added to database, serializing...");
             err_code = serialize_database_save(SERIALIZE_DEFAULT, outpath);
             if (err_code != ERR_DATA_OK) {
@@ -252,6 +431,107 @@ EntapDatabase::DATABASE_ERR EntapDatabase::generate_entap_database(DATABASE_TYPE
     return ERR_DATA_OK;
 }
 
+
+/**
+ * ======================================================================
+ * Function EntapDatabase::DATABASE_ERR EntapDatabase::sql_combine_sections(std::string &outpath)
+ *
+ * Description          - Copies each SQL section staging database into the
+ *                        staging copy of the final database in a single
+ *                        transaction, sets its version and renames it to
+ *                        the output path
+ *                      - Tables are created with the same schema as the
+ *                        sections so SQLite copies their pages directly
+ *
+ * Notes                - Connection to the staging copy is closed
+ *
+ * @param outpath       - Path to output database
+ *
+ * @return              - DATABASE_ERR type
+ *
+ * =====================================================================
+ */
+EntapDatabase::DATABASE_ERR EntapDatabase::sql_combine_sections(std::string &outpath) {
+    std::string staging_path;
+    std::string section_path;
+    std::string title;
+    bool        success;
+
+    const DATABASE_TYPE sections[] = {ENTAP_TAXONOMY, ENTAP_GENE_ONTOLOGY, ENTAP_UNIPROT};
+
+    FS_dprint("Combining SQL database sections...");
+    staging_path = outpath + SQL_STAGING_EXT;
+    success = true;
+    try {
+        // Attached outside of the transaction, close() detaches them
+        for (DATABASE_TYPE section : sections) {
+            section_path = sql_section_path(outpath, section);
+            _pDatabaseHelper->prepare("ATTACH DATABASE ? AS " + SQL_SECTION_ALIAS + std::to_string(section))
+                    .bind(1, section_path).step();
+        }
+    } catch (const std::exception &e) {
+        FS_dprint("Unable to attach SQL database section: " + std::string(e.what()));
+        success = false;
+    }
+
+    success = success && _pDatabaseHelper->execute_cmd("BEGIN TRANSACTION;");
+    for (DATABASE_TYPE section : sections) {
+        if (!success) break;
+        title = section == ENTAP_TAXONOMY      ? SQL_TABLE_NCBI_TAX_TITLE :
+                section == ENTAP_GENE_ONTOLOGY ? SQL_TABLE_GO_TITLE       : SQL_TABLE_UNIPROT_TITLE;
+        success = create_sql_table(_pDatabaseHelper, section) &&
+                  _pDatabaseHelper->execute_cmd("INSERT INTO " + title + " SELECT * FROM " +
+                                                SQL_SECTION_ALIAS + std::to_string(section) + "." + title + ";");
+    }
+    success = _pDatabaseHelper->execute_cmd("COMMIT;") && success;
+    success = success && set_database_versions(ENTAP_SQL);
+
+    // Publish database, readers never see a partially combined one
+    _pDatabaseHelper->close();
+    if (!success || !_pFilesystem->rename_file(staging_path, outpath)) {
+        set_err_msg("Unable to combine EnTAP SQL database sections", ERR_DATA_SQL_CREATE_DATABASE);
+        return ERR_DATA_SQL_CREATE_DATABASE;
+    }
+    return ERR_DATA_OK;
+}
+
+
+// Path of staging database a SQL section is generated into
+std::string EntapDatabase::sql_section_path(std::string &outpath, DATABASE_TYPE section) {
+    return outpath + "." + std::to_string(section) + SQL_STAGING_EXT;
+}
+
+
+// Creates empty staging database (replacing leftovers of an interrupted run), nullptr on failure
+SQLDatabaseHelper *EntapDatabase::sql_create_staging(const std::string &path) {
+    SQLDatabaseHelper *database;
+
+    if (_pFilesystem->file_exists(path)) _pFilesystem->delete_file(path);
+    database = new SQLDatabaseHelper();
+    if (!database->create(path)) {
+        delete database;
+        return nullptr;
+    }
+    return database;
+}
+
+
+// Closes the SQL connection (still on the staging copy) and removes every staging database of an output path
+void EntapDatabase::sql_remove_staging(std::string &outpath) {
+    std::string staging_path = outpath + SQL_STAGING_EXT;
+
+    if (_pDatabaseHelper != nullptr) {
+        _pDatabaseHelper->close();
+        delete _pDatabaseHelper;
+        _pDatabaseHelper = nullptr;
+    }
+    if (_pFilesystem->file_exists(staging_path)) _pFilesystem->delete_file(staging_path);
+    for (DATABASE_TYPE section : {ENTAP_TAXONOMY, ENTAP_GENE_ONTOLOGY, ENTAP_UNIPROT}) {
+        staging_path = sql_section_path(outpath, section);
+        if (_pFilesystem->file_exists(staging_path)) _pFilesystem->delete_file(staging_path);
+    }
+}
+
 EntapDatabase::~EntapDatabase() {
     FS_dprint("Killing Object - EntapDatabase");
     if (_pDatabaseHelper != nullptr) {
@@ -259,9 +539,11 @@ EntapDatabase::~EntapDatabase() {
         delete(_pDatabaseHelper);
     }
     delete _pSerializedDatabase;
+    delete _pMappedDatabase;
 }
 
-EntapDatabase::DATABASE_ERR EntapDatabase::generate_entap_tax(EntapDatabase::DATABASE_TYPE type) {
+EntapDatabase::DATABASE_ERR EntapDatabase::generate_entap_tax(EntapDatabase::DATABASE_TYPE type,
+                                                              SQLDatabaseHelper *sql_database) {
     std::string temp_outpath;   // Path to unzipped files
     std::string sql_cmd;
     std::stringstream ss_temp;  // just for now
@@ -288,7 +570,7 @@ EntapDatabase::DATABASE_ERR EntapDatabase::generate_entap_tax(EntapDatabase::DAT
 
     if (type == ENTAP_SQL) {
         // If SQL, we want to create taxonomy table in database
-        if (!create_sql_table(ENTAP_TAXONOMY)) {
+        if (!create_sql_table(sql_database, ENTAP_TAXONOMY)) {
             set_err_msg("Error generating SQL Taxonomy table", ERR_DATA_SQL_TAX_CREATE_TABLE);
             return ERR_DATA_SQL_TAX_CREATE_TABLE;
         }
@@ -368,6 +650,8 @@ EntapDatabase::DATABASE_ERR EntapDatabase::generate_entap_tax(EntapDatabase::DAT
 
         // parse through entire map and generate NCBI taxonomy entries
         TaxEntry taxEntry;
+        std::unique_ptr<SqlLoader> loader;
+        if (type == ENTAP_SQL) loader.reset(new SqlLoader(this, sql_database));
         for (auto &pair : taxonomy_nodes) {
             // want a separate entry for each name (doing this for now, may change)
             for (std::string name : pair.second.names) {
@@ -381,7 +665,7 @@ EntapDatabase::DATABASE_ERR EntapDatabase::generate_entap_tax(EntapDatabase::DAT
 
                 // Add to SQL database or other...
                 if (type == ENTAP_SQL) {
-                    if (!sql_add_tax_entry(taxEntry)) {
+                    if (!loader->add(taxEntry)) {
                         // unable to add entry
                         set_err_msg("Unable to add Taxonomy entry " + name, ERR_DATA_SQL_CREATE_ENTRY);
                         return ERR_DATA_SQL_CREATE_ENTRY;
@@ -399,6 +683,10 @@ EntapDatabase::DATABASE_ERR EntapDatabase::generate_entap_tax(EntapDatabase::DAT
             }
             // ********************************************************** //
         }
+        if (loader && !loader->finish()) {
+            set_err_msg("Unable to add Taxonomy entries to SQL database", ERR_DATA_SQL_CREATE_ENTRY);
+            return ERR_DATA_SQL_CREATE_ENTRY;
+        }
     } catch (const std::exception &e) {
         set_err_msg("Unable to parse taxonomy data: " + std::string(e.what()), ERR_DATA_TAXONOMY_PARSE);
         return ERR_DATA_TAXONOMY_PARSE;
@@ -408,7 +696,8 @@ EntapDatabase::DATABASE_ERR EntapDatabase::generate_entap_tax(EntapDatabase::DAT
     return ERR_DATA_OK;
 }
 
-EntapDatabase::DATABASE_ERR EntapDatabase::generate_entap_go(EntapDatabase::DATABASE_TYPE type) {
+EntapDatabase::DATABASE_ERR EntapDatabase::generate_entap_go(EntapDatabase::DATABASE_TYPE type,
+                                                             SQLDatabaseHelper *sql_database) {
     FS_dprint("Generating EnTAP Gene Ontology entries...");
 
     std::string go_db_path;
@@ -448,7 +737,7 @@ EntapDatabase::DATABASE_ERR EntapDatabase::generate_entap_go(EntapDatabase::DATA
 
     // If we are creating SQL database, add GO table
     if (type == ENTAP_SQL) {
-        if (!create_sql_table(ENTAP_GENE_ONTOLOGY)) {
+        if (!create_sql_table(sql_database, ENTAP_GENE_ONTOLOGY)) {
             // error creating table
             return ERR_DATA_SQL_GO_CREATE_TABLE;
         }
@@ -475,6 +764,8 @@ EntapDatabase::DATABASE_ERR EntapDatabase::generate_entap_go(EntapDatabase::DATA
         }
         GoEntry goEntry;
         std::string num,term,cat,go,ex,ex1,ex2;
+        std::unique_ptr<SqlLoader> loader;
+        if (type == ENTAP_SQL) loader.reset(new SqlLoader(this, sql_database));
         io::CSVReader<7, io::trim_chars<' '>, io::no_quote_escape<'\t'>> in2(go_term_path);
         while (in2.read_row(num,term,cat,go,ex,ex1,ex2)) {
             goEntry = {};
@@ -485,7 +776,9 @@ EntapDatabase::DATABASE_ERR EntapDatabase::generate_entap_go(EntapDatabase::DATA
 
             // Add to SQL database OR to overall map
             if (type == ENTAP_SQL) {
-                if (!sql_add_go_entry(goEntry)) {
+                // UniProt generation resolves GO terms from memory while the writer owns the connection
+                _sql_go_helper[go] = goEntry;
+                if (!loader->add(goEntry)) {
                     set_err_msg("Unable to add GO entry: " + goEntry.go_id, ERR_DATA_GO_ENTRY);
                     return ERR_DATA_GO_ENTRY;
                 }
@@ -493,6 +786,13 @@ EntapDatabase::DATABASE_ERR EntapDatabase::generate_entap_go(EntapDatabase::DATA
                 _pSerializedDatabase->gene_ontology_data[go] = goEntry;
             }
         }
+        if (loader) {
+            if (!loader->finish()) {
+                set_err_msg("Unable to add GO entries to SQL database", ERR_DATA_GO_ENTRY);
+                return ERR_DATA_GO_ENTRY;
+            }
+            _sql_go_complete = true;
+        }
     } catch (const std::exception &e) {
         set_err_msg("Unable to parse Gene Ontology data: " + std::string(e.what()), ERR_DATA_GO_PARSE);
         return ERR_DATA_GO_PARSE;
@@ -505,60 +805,37 @@ EntapDatabase::DATABASE_ERR EntapDatabase::generate_entap_go(EntapDatabase::DATA
 }
 
 
-EntapDatabase::DATABASE_ERR EntapDatabase::generate_entap_uniprot(EntapDatabase::DATABASE_TYPE type) {
-
-    std::string uniprot_flat_gz;
-    std::string uniprot_flat;       // Decompressed path (this is parsed)
-    std::string line;
-    std::string dat_tag;
-    std::string database;
-    std::string go_list;            // Will be turned into go_format when indexed (comma delim)
-    std::string kegg_list;
+/**
+ * ======================================================================
+ * Function EntapDatabase::DATABASE_ERR EntapDatabase::download_entap_uniprot(std::string &uniprot_flat)
+ *
+ * Description          - Downloads UniProt flat file
+ *
+ * Notes                - Independent of other sections, runs while they
+ *                        are generated
+ *                      - File is left compressed, it is decompressed
+ *                        while being parsed
+ *
+ * @param uniprot_flat  - Set to path of compressed flat file
+ *
+ * @return              - DATABASE_ERR type
+ *
+ * =====================================================================
+ */
+EntapDatabase::DATABASE_ERR EntapDatabase::download_entap_uniprot(std::string &uniprot_flat) {
     uint16      file_status;
-    uint16      index_go;
-    uint16      index_term;
-    std::string data;
-    bool        same_entry = false;
-
-    const uint8       UNIPROT_DAT_TAG_LEN            = 2;   // Length of tags
-    const uint8       UNIPROT_DAT_TAG_DATA_POS       = 5;   // Position data starts
-    // ID   001R_FRG3G              Reviewed;         256 AA.
-    const std::string UNIPROT_DAT_TAG_ID             = "ID";
-    // DR   SwissPalm; Q6GZX4; -.
-    const std::string UNIPROT_DAT_TAG_DATABASE_X_REF = "DR";
-    // Tag used to separate database names
-    const char UNIPROT_DAT_TAG_DATABASE_DELIM    = ';';
-    // Tag used for the Gene Ontology database
-    const std::string UNIPROT_DAT_TAG_DATABASE_GO = "GO";
-    // Tag used for the KEGG database
-    const std::string UNIPROT_DAT_TAG_DATABASE_KEGG = "KEGG";
-
-    // CC   -!- FUNCTION: Transcription activation. {ECO:0000305}.
-    const std::string UNIPROT_DAT_TAG_COMMENT        = "CC";
-    // Entries are split by this (this is on the last line of file)
-    const std::string UNIPROT_DAT_TAG_NEXT_ENTRY     = "//";
 
     // Set output path for FTP file
-    uniprot_flat_gz = PATHS(_temp_directory, UNIPROT_DAT_FILE_GZ);
-    uniprot_flat    = PATHS(_temp_directory, UNIPROT_DAT_FILE);
-
+    uniprot_flat = PATHS(_temp_directory, UNIPROT_DAT_FILE_GZ);
 
     // download UniProt flat file
-    if (!_pFilesystem->download_ftp_file(FTP_UNIPROT_FLAT_FILE, uniprot_flat_gz)) {
+    if (!_pFilesystem->download_ftp_file(FTP_UNIPROT_FLAT_FILE, uniprot_flat)) {
         // failed to download from ftp
         set_err_msg("Unable to download UniProt data from " + FTP_UNIPROT_FLAT_FILE + _pFilesystem->get_error(), ERR_DATA_UNIPROT_DOWNLOAD);
         return ERR_DATA_UNIPROT_DOWNLOAD;
     }
 
-    // decompress database file
-    if (!_pFilesystem->decompress_file(uniprot_flat_gz, uniprot_flat, FileSystem::ENT_FILE_GZ)) {
-        // failed to decompress
-        set_err_msg("Unable to decompress UniProt data" + _pFilesystem->get_error(), ERR_DATA_UNIPROT_DECOMPRESS);
-        return ERR_DATA_UNIPROT_DECOMPRESS;
-    }
-    _pFilesystem->delete_file(uniprot_flat_gz); // Ensure gz file is deleted
-
-    FS_dprint("UniProt file downloaded/decompressed, verifying...");
+    FS_dprint("UniProt file downloaded, verifying...");
     // Ensure file is valid (should be)
     file_status = _pFilesystem->get_file_status(uniprot_flat);
     if (file_status != 0) {
@@ -566,82 +843,69 @@ EntapDatabase::DATABASE_ERR EntapDatabase::generate_entap_uniprot(EntapDatabase:
         set_err_msg(_pFilesystem->print_file_status(file_status, uniprot_flat), ERR_DATA_UNIPROT_FILE);
         return ERR_DATA_UNIPROT_FILE;
     }
+    return ERR_DATA_OK;
+}
+
+
+/**
+ * ======================================================================
+ * Function EntapDatabase::DATABASE_ERR EntapDatabase::generate_entap_uniprot(DATABASE_TYPE type,
+ *                                                      SQLDatabaseHelper *sql_database,
+ *                                                      std::string &uniprot_flat)
+ *
+ * Description          - Parses UniProt flat file and adds each entry to
+ *                        the database
+ *
+ * Notes                - Entries reference GO data, must be run after GO
+ *                        section is complete
+ *                      - Parsed with _threads threads
+ *
+ * @param type          - Database type being generated
+ * @param sql_database  - UniProt section (SQL only)
+ * @param uniprot_flat  - Path to UniProt flat file (plain or gzip)
+ *
+ * @return              - DATABASE_ERR type
+ *
+ * =====================================================================
+ */
+EntapDatabase::DATABASE_ERR EntapDatabase::generate_entap_uniprot(EntapDatabase::DATABASE_TYPE type,
+                                                                  SQLDatabaseHelper *sql_database,
+                                                                  std::string &uniprot_flat) {
 
     // If we are creating SQL database, add UniProt table
     if (type == ENTAP_SQL) {
-        if (!create_sql_table(ENTAP_UNIPROT)) {
+        if (!create_sql_table(sql_database, ENTAP_UNIPROT)) {
             // error creating table
             set_err_msg("Unable to create UniProt SQL Table", ERR_DATA_SQL_UNIPROT_CREATE_TABLE);
             return ERR_DATA_SQL_UNIPROT_CREATE_TABLE;
         }
     }
-    FS_dprint("UniProt file successfully downloaded/decompressed. Parsing...");
+    FS_dprint("UniProt file successfully downloaded. Parsing...");
     // File valid, continue to parse
     try {
-        UniprotEntry uniprotEntry;
-        std::ifstream infile(uniprot_flat);
-        while (std::getline(infile, line)) {
-            if (line.empty() || line.length() < UNIPROT_DAT_TAG_LEN) continue;
-            STR_ERASE(line, '\n');
-            dat_tag = line.substr(0, UNIPROT_DAT_TAG_LEN);
-            if (line.length() > UNIPROT_DAT_TAG_DATA_POS) {
-                data = line.substr(UNIPROT_DAT_TAG_DATA_POS); // All data from the line
-            }
-
-            // Check if this is sequence ID
-            if (dat_tag == UNIPROT_DAT_TAG_ID) {
-                if (same_entry) {
-                    FS_dprint("ERROR: Same entry is true");
-                    return ERR_DATA_UNIPROT_PARSE;
-                }
-                same_entry = true;
-                uniprotEntry.uniprot_id = line.substr(UNIPROT_DAT_TAG_DATA_POS,
-                                                      line.find_first_of(' ',UNIPROT_DAT_TAG_DATA_POS)-UNIPROT_DAT_TAG_DATA_POS);
-            } else if (dat_tag == UNIPROT_DAT_TAG_DATABASE_X_REF) {
-                // ID matches the database cross reference ID
-
-                // Check which database we have
-                database = data.substr(0, data.find(UNIPROT_DAT_TAG_DATABASE_DELIM));
-                if (database == UNIPROT_DAT_TAG_DATABASE_GO) {
-                    index_go = (uint16) data.find("GO:");
-                    index_term = (uint16) data.find(';', index_go);
-                    go_list += data.substr(index_go, index_term - index_go) + ',';
-
-                } else if (database == UNIPROT_DAT_TAG_DATABASE_KEGG) {
-                    index_go = (uint16) (data.find(':') + 1);
-                    index_term = (uint16) data.find(';', index_go);
-                    kegg_list += data.substr(index_go, index_term - index_go) + ',';
-                } else {
-                    // Neither GO nor KEGG, add to x refs
-                    uniprotEntry.database_x_refs += "|" + data;
-                }
+        UniprotDatParser parser(this, _threads);
+        std::unique_ptr<SqlLoader> loader;
+        if (type == ENTAP_SQL) loader.reset(new SqlLoader(this, sql_database));
 
-            } else if (dat_tag == UNIPROT_DAT_TAG_COMMENT) {
-                // ID matches the comments (sometimes useful info? maybe)
-                uniprotEntry.comments += "|" + data;
-            } else if (dat_tag == UNIPROT_DAT_TAG_NEXT_ENTRY){
-                // We've hit the next entry, add previous to the database
-                if (go_list.length() > 0) go_list.pop_back();   // remove trailing ','
-                uniprotEntry.go_terms = format_go_delim(go_list, ',');
-                uniprotEntry.kegg_terms = kegg_list;
-
-                if (!add_uniprot_entry(type, uniprotEntry)) {
-                    // Unable to add entry
-                    set_err_msg("ERROR: Unable to add entry:\n" + uniprotEntry.print(), ERR_DATA_UNIPROT_ENTRY);
-                    return ERR_DATA_UNIPROT_ENTRY;
+        if (!parser.parse(uniprot_flat, [&](UniprotEntry &uniprotEntry) {
+                if (type == ENTAP_SQL ? loader->add(uniprotEntry) : add_uniprot_entry(type, uniprotEntry)) {
+                    return true;
                 }
-                uniprotEntry = {};
-                same_entry = false;
-                go_list = "";
-                kegg_list = "";
-
-            } else {
-                // Unhandled information from UniProt mapping, discard
-            }
+                // Unable to add entry
+                set_err_msg("ERROR: Unable to add entry:\n" + uniprotEntry.print(), ERR_DATA_UNIPROT_ENTRY);
+                return false;
+            })) {
+            return ERR_DATA_UNIPROT_ENTRY;
+        }
+        if (loader && !loader->finish()) {
+            set_err_msg("Unable to add UniProt entries to SQL database", ERR_DATA_UNIPROT_ENTRY);
+            return ERR_DATA_UNIPROT_ENTRY;
         }
+    } catch (ExceptionHandler &e) {
+        set_err_msg("Unable to parse UniProt data: " + std::string(e.what()), ERR_DATA_UNIPROT_PARSE);
+        return ERR_DATA_UNIPROT_PARSE;
     } catch (const std::exception &e) {
-        set_err_msg("Unable to parse UniProt data: " + std::string(e.what()) + "\nLine: " + line,
-                    ERR_DATA_UNIPROT_PARSE);
+        set_err_msg("Unable to parse UniProt data: " + std::string(e.what()), ERR_DATA_UNIPROT_PARSE);
         return ERR_DATA_UNIPROT_PARSE;
     }
 
@@ -661,51 +925,184 @@ std::string EntapDatabase::entap_tax_get_lineage(EntapDatabase::TaxonomyNode &no
     }
 }
 
-bool EntapDatabase::sql_add_tax_entry(TaxEntry &taxEntry) {
-    char *sql_cmd;
+bool EntapDatabase::sql_add_tax_entry(SQLDatabaseHelper *sql_database, TaxEntry &taxEntry) {
+
+    if (sql_database == nullptr) return false;
+
+    try {
+        SQLDatabaseHelper::Statement statement = sql_database->prepare(_sql_insert_tax);
+        statement.bind(1, taxEntry.tax_name)
+                 .bind(2, (int64) std::stoll(taxEntry.tax_id))
+                 .bind(3, taxEntry.lineage);
+        statement.step();
+        return true;
+    } catch (const std::exception &e) {
+        FS_dprint("Unable to add taxonomy entry: " + std::string(e.what()));
+        return false;
+    }
+}
+
+bool EntapDatabase::sql_add_go_entry(SQLDatabaseHelper *sql_database, GoEntry &goEntry) {
+    int64 go_id;
+
+    if (sql_database == nullptr) return false;
+    if (!sql_go_id(goEntry.go_id, go_id)) return false;
+
+    try {
+        SQLDatabaseHelper::Statement statement = sql_database->prepare(_sql_insert_go);
+        statement.bind(1, go_id)
+                 .bind(2, goEntry.term)
+                 .bind(3, goEntry.category)
+                 .bind(4, goEntry.level);
+        statement.step();
+        return true;
+    } catch (const std::exception &e) {
+        FS_dprint("Unable to add GO entry: " + std::string(e.what()));
+        return false;
+    }
+}
+
+/**
+ * ======================================================================
+ * Function bool EntapDatabase::sql_write_batch(SQLDatabaseHelper *sql_database, SqlBatch &batch)
+ *
+ * Description          - Inserts a batch of generated rows in a single
+ *                        transaction
+ *                      - Rows are sorted by key first so each transaction
+ *                        walks the (clustered) primary key b-trees in order
+ *                      - Sort is stable so duplicate keys are inserted in
+ *                        source order, last occurrence replaces the others
+ *
+ * Notes                - Called from SqlLoader writer thread
+ *
+ * @param sql_database  - Database rows are inserted into
+ * @param batch         - Rows to insert
+ *
+ * @return              - False if any row could not be inserted
+ *
+ * =====================================================================
+ */
+bool EntapDatabase::sql_write_batch(SQLDatabaseHelper *sql_database, SqlBatch &batch) {
+    bool success = true;
+
+    std::stable_sort(batch.tax.begin(), batch.tax.end(), [](const TaxEntry &a, const TaxEntry &b) {
+        return a.tax_name < b.tax_name;});
+    std::stable_sort(batch.go.begin(), batch.go.end(), [](const GoEntry &a, const GoEntry &b) {
+        return a.go_id < b.go_id;});     // Fixed width accessions, same order as integer IDs
+    std::stable_sort(batch.uniprot.begin(), batch.uniprot.end(), [](const UniprotEntry &a, const UniprotEntry &b) {
+        return a.uniprot_id < b.uniprot_id;});
+
+    if (!sql_database->execute_cmd("BEGIN TRANSACTION;")) return false;
+    for (TaxEntry &entry : batch.tax) {
+        if (!(success = sql_add_tax_entry(sql_database, entry))) break;
+    }
+    for (uint64 i = 0; success && i < batch.go.size(); i++) {
+        success = sql_add_go_entry(sql_database, batch.go[i]);
+    }
+    for (uint64 i = 0; success && i < batch.uniprot.size(); i++) {
+        success = sql_add_uniprot_entry(sql_database, batch.uniprot[i]);
+    }
+    // Journal is off during generation, commit what was written either way
+    return sql_database->execute_cmd("COMMIT;") && success;
+}
+
+
+EntapDatabase::SqlLoader::SqlLoader(EntapDatabase *database, SQLDatabaseHelper *sql_database) :
+        _pDatabase(database), _pSqlDatabase(sql_database), _queue(SQL_LOAD_QUEUE), _batch_rows(0), _failed(false) {
+    _writer = std::thread(&SqlLoader::write, this);
+}
+
+EntapDatabase::SqlLoader::~SqlLoader() {
+    // Generation aborted before finish(), stop writer
+    _queue.close();
+    if (_writer.joinable()) _writer.join();
+}
 
-    if (_pDatabaseHelper == nullptr) return false;
+bool EntapDatabase::SqlLoader::add(TaxEntry &entry) {
+    _batch.tax.push_back(entry);
+    return ++_batch_rows < SQL_LOAD_BATCH_ROWS || queue_batch();
+}
 
-    sql_cmd = sqlite3_mprintf(
-            "INSERT INTO %Q (%Q,%Q,%Q) "\
-            "VALUES (%Q, %Q, %Q);",
+bool EntapDatabase::SqlLoader::add(GoEntry &entry) {
+    _batch.go.push_back(entry);
+    return ++_batch_rows < SQL_LOAD_BATCH_ROWS || queue_batch();
+}
 
-            SQL_TABLE_NCBI_TAX_TITLE.c_str(),
-            SQL_COL_NCBI_TAX_TAXID.c_str(),
-            SQL_COL_NCBI_TAX_LINEAGE.c_str(),
-            SQL_COL_NCBI_TAX_NAME.c_str(),
-            taxEntry.tax_id.c_str(),
-            taxEntry.lineage.c_str(),
-            taxEntry.tax_name.c_str()
-    );
-    return _pDatabaseHelper->execute_cmd(sql_cmd);
+bool EntapDatabase::SqlLoader::add(UniprotEntry &entry) {
+    _batch.uniprot.push_back(entry);
+    return ++_batch_rows < SQL_LOAD_BATCH_ROWS || queue_batch();
 }
 
-bool EntapDatabase::sql_add_go_entry(GoEntry &goEntry) {
-    char *sql_cmd;
-
-    if (_pDatabaseHelper == nullptr) return false;
-
-    sql_cmd = sqlite3_mprintf(
-            "INSERT INTO %Q (%Q,%Q,%Q,%Q) "\
-            "VALUES (%Q, %Q, %Q, %Q);",
-
-            SQL_TABLE_GO_TITLE.c_str(),
-            SQL_TABLE_GO_COL_ID.c_str(),
-            SQL_TABLE_GO_COL_DESC.c_str(),
-            SQL_TABLE_GO_COL_CATEGORY.c_str(),
-            SQL_TABLE_GO_COL_LEVEL.c_str(),
-            goEntry.go_id.c_str(),
-            goEntry.term.c_str(),
-            goEntry.category.c_str(),
-            goEntry.level.c_str()
-    );
-    return _pDatabaseHelper->execute_cmd(sql_cmd);
+
+/**
+ * ======================================================================
+ * Function bool EntapDatabase::SqlLoader::finish()
+ *
+ * Description          - Queues remaining rows and waits for the writer to
+ *                        insert everything
+ *
+ * Notes                - Loader cannot be used after this
+ *
+ * @return              - False if any batch failed to insert
+ *
+ * =====================================================================
+ */
+bool EntapDatabase::SqlLoader::finish() {
+    if (_batch_rows > 0) queue_batch();
+    _queue.close();
+    if (_writer.joinable()) _writer.join();
+    return !_failed;
+}
+
+bool EntapDatabase::SqlLoader::queue_batch() {
+    SqlBatch batch;
+
+    std::swap(batch, _batch);
+    _batch_rows = 0;
+    // Queue is only closed early by a failed writer
+    return _queue.push(std::move(batch)) && !_failed;
+}
+
+void EntapDatabase::SqlLoader::write() {
+    SqlBatch batch;
+
+    try {
+        while (_queue.pop(batch)) {
+            if (!_pDatabase->sql_write_batch(_pSqlDatabase, batch)) {
+                _failed = true;
+                break;
+            }
+        }
+    } catch (const std::exception &e) {
+        FS_dprint("ERROR: SQL generation writer: " + std::string(e.what()));
+        _failed = true;
+    }
+    // Release parser if it is waiting on a full queue
+    if (_failed) _queue.close();
+}
+
+bool EntapDatabase::sql_add_uniprot_entry(SQLDatabaseHelper *sql_database, UniprotEntry &entry) {
+
+    if (sql_database == nullptr) {
+        FS_dprint("ERROR: SQL database NULL");
+        return false;
+    }
+
+    try {
+        SQLDatabaseHelper::Statement statement = sql_database->prepare(_sql_insert_uniprot);
+        statement.bind(1, entry.uniprot_id)
+                 .bind(2, entry.database_x_refs)
+                 .bind(3, entry.comments);
+        statement.step();
+        return true;
+    } catch (const std::exception &e) {
+        FS_dprint("Unable to add UniProt entry: " + std::string(e.what()));
+        return false;
+    }
 }
 
 bool EntapDatabase::add_uniprot_entry(EntapDatabase::DATABASE_TYPE type, UniprotEntry &entry) {
     bool ret = true;
-    char *sql_cmd;
 
     switch (type) {
         case ENTAP_SERIALIZED:
@@ -718,25 +1115,7 @@ bool EntapDatabase::add_uniprot_entry(EntapDatabase::DATABASE_TYPE type, Uniprot
             break;
 
         case ENTAP_SQL:
-            if (_pDatabaseHelper == nullptr) {
-                FS_dprint("ERROR: SQL database NULL");
-                ret = false;
-                break;
-            }
-
-            sql_cmd = sqlite3_mprintf(
-                    "INSERT INTO %Q (%Q,%Q,%Q) " \
-                    "VALUES (%Q,%Q,%Q);",
-
-                    SQL_TABLE_UNIPROT_TITLE.c_str(),
-                    SQL_TABLE_UNIPROT_COL_ID.c_str(),
-                    SQL_TABLE_UNIPROT_COL_XREF.c_str(),
-                    SQL_TABLE_UNIPROT_COL_COMM.c_str(),
-                    entry.uniprot_id.c_str(),
-                    entry.database_x_refs.c_str(),
-                    entry.comments.c_str()
-            );
-            ret = _pDatabaseHelper->execute_cmd(sql_cmd);
+            ret = sql_add_uniprot_entry(_pDatabaseHelper, entry);
             break;
 
         default:
@@ -745,87 +1124,246 @@ bool EntapDatabase::add_uniprot_entry(EntapDatabase::DATABASE_TYPE type, Uniprot
     return ret;
 }
 
-bool EntapDatabase::create_sql_table(DATABASE_TYPE type) {
-    char *sql_cmd;
+bool EntapDatabase::create_sql_table(SQLDatabaseHelper *sql_database, DATABASE_TYPE type) {
+    std::string sql_cmd;
     bool success;
 
-    if (_pDatabaseHelper == nullptr) return false;
+    if (sql_database == nullptr) return false;
+
+    sql_cmd = sql_table_cmd(type);
+    if (sql_cmd.empty()) {
+        FS_dprint("ERROR: Unhandled SQL table creation");
+        return false;
+    }
+    FS_dprint("Creating SQL table:\n" + sql_cmd);
+
+    success = sql_database->execute_cmd(sql_cmd);
+    if (success) {
+        FS_dprint("Success!");
+    } else {
+        FS_dprint("ERROR: Unable to create SQL table");
+    }
+    return success;
+}
+
 
+/**
+ * ======================================================================
+ * Function std::string EntapDatabase::sql_table_cmd(DATABASE_TYPE type)
+ *
+ * Description          - Returns CREATE TABLE statement of the current SQL
+ *                        schema for a table
+ *                      - Lookup tables are WITHOUT ROWID and keyed on the
+ *                        column searched at run time, so each lookup is a
+ *                        single b-tree search and the key is a covering
+ *                        index (rows are stored in the key's b-tree)
+ *                      - GO terms and taxa use integer IDs ("GO:0008150"
+ *                        is stored as 8150)
+ *
+ * Notes                - Used for generation and legacy migration
+ *
+ * @param type          - Table to create
+ *
+ * @return              - SQL statement, empty if unhandled type
+ *
+ * =====================================================================
+ */
+std::string EntapDatabase::sql_table_cmd(DATABASE_TYPE type) {
     switch (type) {
         case ENTAP_TAXONOMY:
-            FS_dprint("Creating SQL Taxonomy table...");
-            sql_cmd = sqlite3_mprintf(
-                    "CREATE TABLE %Q ("                 \
-                    "ID      INTEGER PRIMARY KEY     NOT NULL," \
-                    "%Q      TEXT                NOT NULL," \
-                    "%Q      TEXT                NOT NULL," \
-                    "%Q      TEXT                NOT NULL);",
-
-                    SQL_TABLE_NCBI_TAX_TITLE.c_str(),
-                    SQL_COL_NCBI_TAX_TAXID.c_str(),
-                    SQL_COL_NCBI_TAX_LINEAGE.c_str(),
-                    SQL_COL_NCBI_TAX_NAME.c_str()
-            );
-            break;
+            return "CREATE TABLE " + SQL_TABLE_NCBI_TAX_TITLE + " (" +
+                   SQL_COL_NCBI_TAX_NAME    + " TEXT    PRIMARY KEY NOT NULL, " +
+                   SQL_COL_NCBI_TAX_TAXID   + " INTEGER NOT NULL, " +
+                   SQL_COL_NCBI_TAX_LINEAGE + " TEXT    NOT NULL) WITHOUT ROWID;";
 
         case ENTAP_GENE_ONTOLOGY:
-            FS_dprint("Creating SQL Gene Ontology table...");
-            sql_cmd = sqlite3_mprintf(
-                    "CREATE TABLE %Q ("                     \
-                    "ID        INTEGER PRIMARY KEY       NOT NULL," \
-                    "%Q        TEXT                      NOT NULL," \
-                    "%Q        TEXT                      NOT NULL," \
-                    "%Q        TEXT                      NOT NULL," \
-                    "%Q        TEXT                      NOT NULL);",
-
-                    SQL_TABLE_GO_TITLE.c_str(),
-                    SQL_TABLE_GO_COL_ID.c_str(),
-                    SQL_TABLE_GO_COL_DESC.c_str(),
-                    SQL_TABLE_GO_COL_CATEGORY.c_str(),
-                    SQL_TABLE_GO_COL_LEVEL.c_str()
-            );
-            break;
+            return "CREATE TABLE " + SQL_TABLE_GO_TITLE + " (" +
+                   SQL_TABLE_GO_COL_ID       + " INTEGER PRIMARY KEY NOT NULL, " +
+                   SQL_TABLE_GO_COL_DESC     + " TEXT    NOT NULL, " +
+                   SQL_TABLE_GO_COL_CATEGORY + " TEXT    NOT NULL, " +
+                   SQL_TABLE_GO_COL_LEVEL    + " TEXT    NOT NULL) WITHOUT ROWID;";
 
         case ENTAP_UNIPROT:
-            FS_dprint("Creating SQL UniProt table...");
-            sql_cmd = sqlite3_mprintf(
-                    "CREATE TABLE %Q ("                 \
-                    "ID    INTEGER PRIMARY KEY     NOT NULL," \
-                    "%Q    TEXT                    NOT NULL," \
-                    "%Q    TEXT                    NOT NULL," \
-                    "%Q    TEXT                    NOT NULL);",
-
-                    SQL_TABLE_UNIPROT_TITLE.c_str(),
-                    SQL_TABLE_UNIPROT_COL_ID.c_str(),
-                    SQL_TABLE_UNIPROT_COL_XREF.c_str(),
-                    SQL_TABLE_UNIPROT_COL_COMM.c_str()
-            );
-            break;
+            return "CREATE TABLE " + SQL_TABLE_UNIPROT_TITLE + " (" +
+                   SQL_TABLE_UNIPROT_COL_ID   + " TEXT    PRIMARY KEY NOT NULL, " +
+                   SQL_TABLE_UNIPROT_COL_XREF + " TEXT    NOT NULL, " +
+                   SQL_TABLE_UNIPROT_COL_COMM + " TEXT    NOT NULL) WITHOUT ROWID;";
 
         case ENTAP_VERSION:
-            FS_dprint("Creating version table...");
-            sql_cmd = sqlite3_mprintf(
-                    "CREATE TABLE %Q ("                     \
-                    "ID   INTEGER PRIMARY KEY    NOT NULL," \
-                    "%Q   TEXT                   NOT NULL);",
-                    SQL_TABLE_VERSION_TITLE.c_str(),
-                    SQL_TABLE_VERSION_COL_VER.c_str()
-                    );
-            break;
+            return "CREATE TABLE " + SQL_TABLE_VERSION_TITLE + " (" +
+                   "ID INTEGER PRIMARY KEY NOT NULL, " +
+                   SQL_TABLE_VERSION_COL_VER + " TEXT NOT NULL);";
 
         default:
-            FS_dprint("ERROR: Unhandled SQL table creation");
-            return false;
+            return "";
     }
+}
 
-    success = _pDatabaseHelper->execute_cmd(sql_cmd);
-    if (success) {
-        FS_dprint("Success!");
-    } else {
-        std::string temp = sql_cmd;
-        FS_dprint("ERROR: Unable to create table with command: \n" + temp);
+
+/**
+ * ======================================================================
+ * Function EntapDatabase::DATABASE_ERR EntapDatabase::sql_check_schema(std::string &path,
+ *                                                                      bool migrate)
+ *
+ * Description          - Checks schema version of the opened SQL database
+ *                      - Legacy (1.0) databases are migrated to the
+ *                        current schema and reopened when migrate is set
+ *                        (configuration), otherwise they are read as is
+ *                        without the new indexes
+ *                      - Any other version is rejected
+ *
+ * Notes                - Called after SQL database has been opened
+ *
+ * @param path          - Path to SQL database
+ * @param migrate       - True to rewrite a legacy database (configuration)
+ *
+ * @return              - DATABASE_ERR type
+ *
+ * =====================================================================
+ */
+EntapDatabase::DATABASE_ERR EntapDatabase::sql_check_schema(std::string &path, bool migrate) {
+    DATABASE_ERR err;
+    std::string  version;
+
+    _sql_legacy = false;
+    version = get_current_version_str();
+    if (version == get_required_version_str()) return ERR_DATA_OK;
+
+    if (version != SQL_LEGACY_VERSION) {
+        set_err_msg("EnTAP SQL database version is not compatible with this version of EnTAP.\n" \
+                    "Current Version: " + version + "\nRequired version: " + get_required_version_str(),
+                    ERR_DATA_INCOMPATIBLE_VER);
+        return ERR_DATA_INCOMPATIBLE_VER;
     }
-    return success;
+
+    if (!migrate) {
+        // Read only during execution, leave migration to the configuration stage
+        _sql_legacy = true;
+        FS_dprint("EnTAP SQL database version " + version + " found, reading without migration");
+        return ERR_DATA_OK;
+    }
+
+    FS_dprint("EnTAP SQL database version " + version + " found, migrating to " +
+              get_required_version_str() + "...");
+    _pDatabaseHelper->close();
+    err = sql_migrate_legacy(path);
+    if (!_pDatabaseHelper->open(path, true)) {
+        set_err_msg("Unable to open SQL database at: " + path, ERR_DATA_SQL_OPEN);
+        return ERR_DATA_SQL_OPEN;
+    }
+    if (err == ERR_DATA_OK) FS_dprint("Success! SQL database migrated");
+    return err;
+}
+
+
+/**
+ * ======================================================================
+ * Function EntapDatabase::DATABASE_ERR EntapDatabase::sql_migrate_legacy(std::string &path)
+ *
+ * Description          - Rewrites a legacy (1.0) SQL database into the
+ *                        current schema
+ *                      - New database is built beside the old one with the
+ *                        old one attached, then renamed over it so an
+ *                        interrupted migration leaves the original intact
+ *
+ * Notes                - Legacy database is left untouched on failure
+ *
+ * @param path          - Path to legacy SQL database
+ *
+ * @return              - DATABASE_ERR type
+ *
+ * =====================================================================
+ */
+EntapDatabase::DATABASE_ERR EntapDatabase::sql_migrate_legacy(std::string &path) {
+    SQLDatabaseHelper migrated;
+    std::string       migrate_path;
+    std::string       version;
+    std::string       sql_cmd;
+    bool              success;
+
+    migrate_path = path + SQL_MIGRATE_EXT;
+    if (_pFilesystem->file_exists(migrate_path)) _pFilesystem->delete_file(migrate_path);
+    if (!migrated.create(migrate_path)) {
+        set_err_msg("Unable to create migrated SQL database at: " + migrate_path, ERR_DATA_SQL_CREATE_DATABASE);
+        return ERR_DATA_SQL_CREATE_DATABASE;
+    }
+
+    try {
+        migrated.prepare("ATTACH DATABASE ? AS " + SQL_LEGACY_ALIAS).bind(1, path).step();
+
+        // Taxa were stored once per row with text IDs, later duplicate names win as in generation
+        sql_cmd = "BEGIN;" +
+            sql_table_cmd(ENTAP_TAXONOMY) +
+            sql_table_cmd(ENTAP_GENE_ONTOLOGY) +
+            sql_table_cmd(ENTAP_UNIPROT) +
+            sql_table_cmd(ENTAP_VERSION) +
+            "INSERT OR REPLACE INTO " + SQL_TABLE_NCBI_TAX_TITLE + " (" + SQL_COL_NCBI_TAX_NAME + ", " +
+                SQL_COL_NCBI_TAX_TAXID + ", " + SQL_COL_NCBI_TAX_LINEAGE + ") SELECT " +
+                SQL_COL_NCBI_TAX_NAME + ", CAST(" + SQL_COL_NCBI_TAX_TAXID + " AS INTEGER), " +
+                SQL_COL_NCBI_TAX_LINEAGE + " FROM " + SQL_LEGACY_ALIAS + "." + SQL_TABLE_NCBI_TAX_TITLE +
+                " ORDER BY ID;" +
+            "INSERT OR REPLACE INTO " + SQL_TABLE_GO_TITLE + " (" + SQL_TABLE_GO_COL_ID + ", " +
+                SQL_TABLE_GO_COL_DESC + ", " + SQL_TABLE_GO_COL_CATEGORY + ", " + SQL_TABLE_GO_COL_LEVEL +
+                ") SELECT CAST(SUBSTR(" + SQL_TABLE_GO_COL_ID + ", " + std::to_string(GO_ID_PREFIX.length() + 1) +
+                ") AS INTEGER), " + SQL_TABLE_GO_COL_DESC + ", " + SQL_TABLE_GO_COL_CATEGORY + ", " +
+                SQL_TABLE_GO_COL_LEVEL + " FROM " + SQL_LEGACY_ALIAS + "." + SQL_TABLE_GO_TITLE +
+                " WHERE " + SQL_TABLE_GO_COL_ID + " LIKE '" + GO_ID_PREFIX + "%' ORDER BY ID;" +
+            "INSERT OR REPLACE INTO " + SQL_TABLE_UNIPROT_TITLE + " (" + SQL_TABLE_UNIPROT_COL_ID + ", " +
+                SQL_TABLE_UNIPROT_COL_XREF + ", " + SQL_TABLE_UNIPROT_COL_COMM + ") SELECT " +
+                SQL_TABLE_UNIPROT_COL_ID + ", " + SQL_TABLE_UNIPROT_COL_XREF + ", " +
+                SQL_TABLE_UNIPROT_COL_COMM + " FROM " + SQL_LEGACY_ALIAS + "." + SQL_TABLE_UNIPROT_TITLE +
+                " ORDER BY ID;" +
+            "COMMIT;";
+        success = migrated.execute_cmd(sql_cmd);
+        if (success) {
+            version = get_required_version_str();
+            migrated.prepare("INSERT INTO " + SQL_TABLE_VERSION_TITLE + " (" + SQL_TABLE_VERSION_COL_VER +
+                             ") VALUES (?)").bind(1, version).step();
+        }
+    } catch (const std::exception &e) {
+        FS_dprint(e.what());
+        success = false;
+    }
+    migrated.close();
+
+    if (!success || !_pFilesystem->rename_file(migrate_path, path)) {
+        _pFilesystem->delete_file(migrate_path);
+        set_err_msg("Unable to migrate EnTAP SQL database at: " + path +
+                    "\nRegenerate it with the configuration stage", ERR_DATA_INCOMPATIBLE_VER);
+        return ERR_DATA_INCOMPATIBLE_VER;
+    }
+    return ERR_DATA_OK;
+}
+
+
+/**
+ * ======================================================================
+ * Function bool EntapDatabase::sql_go_id(const std::string &go_id, int64 &id)
+ *
+ * Description          - Converts GO accession to the integer ID used as
+ *                        the SQL key ("GO:0008150" -> 8150)
+ *
+ * Notes                - None
+ *
+ * @param go_id         - GO accession
+ * @param id            - Integer ID (set on success)
+ *
+ * @return              - False if accession is not a GO ID
+ *
+ * =====================================================================
+ */
+bool EntapDatabase::sql_go_id(const std::string &go_id, int64 &id) {
+    uint64 pos;
+
+    if (go_id.length() <= GO_ID_PREFIX.length() || go_id.compare(0, GO_ID_PREFIX.length(), GO_ID_PREFIX) != 0) {
+        return false;
+    }
+    id = 0;
+    for (pos = GO_ID_PREFIX.length(); pos < go_id.length(); pos++) {
+        if (!::isdigit((uint8)go_id[pos])) return false;
+        id = id * 10 + (go_id[pos] - '0');
+    }
+    return true;
 }
 
 EntapDatabase::DATABASE_ERR EntapDatabase::download_entap_serial(std::string &out_path) {
@@ -893,7 +1431,14 @@ GoEntry EntapDatabase::get_go_entry(std::string &go_id) {
 
     if (go_id.empty()) return GoEntry();
 
-    if (_use_serial) {
+    if (_use_serial && _pMappedDatabase != nullptr) {
+        // Using memory mapped database, read through cache
+        go_serial_map_t::iterator it = _mapped_go_cache.find(go_id);
+        if (it != _mapped_go_cache.end()) return it->second;
+        if (!_pMappedDatabase->find_go_entry(go_id, goEntry)) goEntry = GoEntry();
+        return _mapped_go_cache.emplace(go_id, goEntry).first->second;
+
+    } else if (_use_serial) {
         // Using serialized database
         go_serial_map_t::iterator it = _pSerializedDatabase->gene_ontology_data.find(go_id);
         if (it == _pSerializedDatabase->gene_ontology_data.end()) {
@@ -903,28 +1448,24 @@ GoEntry EntapDatabase::get_go_entry(std::string &go_id) {
 
     } else {
         // Using SQL database
-        std::vector<std::vector<std::string>> results;
         // Check temp if previously found (increase speeds)
+        int64 sql_id;
         go_serial_map_t::iterator it = _sql_go_helper.find(go_id);
         if (it != _sql_go_helper.end()) return it->second;
-        // Generate SQL query
-        char *query = sqlite3_mprintf(
-                "SELECT %q, %q, %q, %q FROM %q WHERE %q=%Q",
-                SQL_TABLE_GO_COL_ID.c_str(),
-                SQL_TABLE_GO_COL_DESC.c_str(),
-                SQL_TABLE_GO_COL_CATEGORY.c_str(),
-                SQL_TABLE_GO_COL_LEVEL.c_str(),
-                SQL_TABLE_GO_TITLE.c_str(),
-                SQL_TABLE_GO_COL_ID.c_str(),
-                go_id.c_str()
-        );
+        if (_sql_go_complete || (!_sql_legacy && !sql_go_id(go_id, sql_id))) return GoEntry();
         try {
-            if (results.empty()) return GoEntry();
-            results = _pDatabaseHelper->query(query);
-            goEntry.go_id    = results[0][0];
-            goEntry.term     = results[0][1];
-            goEntry.category = results[0][2];
-            goEntry.level    = results[0][3];
+            SQLDatabaseHelper::Statement statement = _pDatabaseHelper->prepare(_sql_select_go);
+            // Legacy schema keys GO terms by the full accession
+            if (_sql_legacy) {
+                statement.bind(1, go_id);
+            } else {
+                statement.bind(1, sql_id);
+            }
+            if (!statement.step()) return GoEntry();
+            goEntry.go_id    = go_id;
+            goEntry.term     = statement.get_string(0);
+            goEntry.category = statement.get_string(1);
+            goEntry.level    = statement.get_string(2);
             _sql_go_helper[go_id] = goEntry;
             return goEntry;
         } catch (std::exception &e) {
@@ -944,7 +1485,23 @@ TaxEntry EntapDatabase::get_tax_entry(std::string &species) {
 
     LOWERCASE(species); // ensure lowercase (database is based on this for direct matching)
 
-    if (_use_serial) {
+    if (_use_serial && _pMappedDatabase != nullptr) {
+        // Using memory mapped database, read through cache
+        tax_serial_map_t::iterator it = _mapped_tax_cache.find(species);
+        if (it != _mapped_tax_cache.end()) return it->second;
+        // Broaden species until found
+        temp_species = species;
+        while (!_pMappedDatabase->find_tax_entry(temp_species, taxEntry)) {
+            index = temp_species.find_last_of(' ');
+            if (index == std::string::npos) {
+                taxEntry = TaxEntry();
+                break;
+            }
+            temp_species = temp_species.substr(0, index);
+        }
+        return _mapped_tax_cache.emplace(species, taxEntry).first->second;
+
+    } else if (_use_serial) {
         // Using serialized database
         tax_serial_map_t::iterator it = _pSerializedDatabase->taxonomic_data.find(species);
         if (it == _pSerializedDatabase->taxonomic_data.end()) {
@@ -964,33 +1521,24 @@ TaxEntry EntapDatabase::get_tax_entry(std::string &species) {
 
     } else {
         // Using SQL database
-        std::vector<std::vector<std::string>> results;
         temp_species = species;
         try {
             // If we can't find species, keep trying by making it more broad
             while (true) {
-                // Generate SQL query
-                char *query = sqlite3_mprintf(
-                        "SELECT %q, %q FROM %q WHERE %q=%Q",
-                        SQL_COL_NCBI_TAX_TAXID.c_str(),
-                        SQL_COL_NCBI_TAX_LINEAGE.c_str(),
-                        SQL_TABLE_NCBI_TAX_TITLE.c_str(),
-                        SQL_COL_NCBI_TAX_NAME.c_str(),
-                        temp_species.c_str()
-                );
-                results = _pDatabaseHelper->query(query);
-                if (results.empty()) {
-                    index = temp_species.find_last_of(' ');
-                    if (index == std::string::npos) return TaxEntry(); // couldn't find
-                    temp_species = temp_species.substr(0, index);
-                } else break; // Found species
+                SQLDatabaseHelper::Statement statement = _pDatabaseHelper->prepare(_sql_select_tax);
+                statement.bind(1, temp_species);
+                if (statement.step()) {
+                    // Found species
+                    taxEntry.tax_id  = std::to_string(statement.get_int(0));
+                    taxEntry.lineage = statement.get_string(1);
+                    taxEntry.tax_name= temp_species;
+                    return taxEntry;
+                }
+                index = temp_species.find_last_of(' ');
+                if (index == std::string::npos) return TaxEntry(); // couldn't find
+                temp_species = temp_species.substr(0, index);
             }
 
-            taxEntry.tax_id  = results[0][0];
-            taxEntry.lineage = results[0][1];
-            taxEntry.tax_name= temp_species;
-            return taxEntry;
-
         } catch (std::exception &e) {
             // Do not fatal error
             FS_dprint(e.what());
@@ -999,13 +1547,86 @@ TaxEntry EntapDatabase::get_tax_entry(std::string &species) {
     }
 }
 
+
+/**
+ * ======================================================================
+ * Function const tax_ancestors_t &EntapDatabase::get_tax_ancestors(const std::string &lineage)
+ *
+ * Description          - Resolves a lineage string (as stored in TaxEntry)
+ *                        to an array of taxon IDs, node first, root last
+ *                      - Each distinct lineage is only split once, later
+ *                        calls return the cached array
+ *
+ * Notes                - Returned reference stays valid for the life of
+ *                        the database object
+ *
+ * @param lineage       - Lineage string ("homo sapiens;homo;...;root")
+ *
+ * @return              - Ancestor taxon IDs (empty if lineage is empty)
+ *
+ * =====================================================================
+ */
+const EntapDatabase::tax_ancestors_t &EntapDatabase::get_tax_ancestors(const std::string &lineage) {
+    uint64 start;
+    uint64 end;
+    uint64 level_start;
+    uint64 level_end;
+
+    std::unordered_map<std::string, tax_ancestors_t>::iterator it = _tax_ancestors.find(lineage);
+    if (it != _tax_ancestors.end()) return it->second;
+
+    tax_ancestors_t &ancestors = _tax_ancestors[lineage];
+    start = 0;
+    while (start < lineage.size()) {
+        end = lineage.find(TAX_LINEAGE_DELIM, start);
+        if (end == std::string::npos) end = lineage.size();
+
+        // Trim surrounding whitespace from level
+        level_start = start;
+        level_end   = end;
+        while (level_start < level_end && ::isspace((uint8)lineage[level_start])) level_start++;
+        while (level_end > level_start && ::isspace((uint8)lineage[level_end - 1])) level_end--;
+        if (level_end > level_start) {
+            ancestors.push_back(get_taxon_id(lineage.substr(level_start, level_end - level_start)));
+        }
+        start = end + 1;
+    }
+    return ancestors;
+}
+
+
+/**
+ * ======================================================================
+ * Function uint32 EntapDatabase::get_taxon_id(const std::string &sci_name)
+ *
+ * Description          - Returns integer ID of a lineage level name
+ *
+ * Notes                - Lineages are stored by scientific name, so IDs are
+ *                        assigned the first time a name is seen in this run
+ *                        and are only comparable within the run
+ *
+ * @param sci_name      - Lowercase scientific name of taxon
+ *
+ * @return              - Taxon ID
+ *
+ * =====================================================================
+ */
+uint32 EntapDatabase::get_taxon_id(const std::string &sci_name) {
+    return _taxon_ids.emplace(sci_name, (uint32) _taxon_ids.size()).first->second;
+}
+
+
 UniprotEntry EntapDatabase::get_uniprot_entry(std::string& accession) {
     UniprotEntry uniprotEntry;
 
     if (accession.empty()) return UniprotEntry();
 
     try {
-        if (_use_serial) {
+        if (_use_serial && _pMappedDatabase != nullptr) {
+            // Using memory mapped database
+            if (!_pMappedDatabase->find_uniprot_entry(accession, uniprotEntry)) return UniprotEntry();
+            return uniprotEntry;
+        } else if (_use_serial) {
             // Using serialized database
             uniprot_serial_map_t::iterator it =
                     _pSerializedDatabase->uniprot_data.find(accession);
@@ -1015,21 +1636,12 @@ UniprotEntry EntapDatabase::get_uniprot_entry(std::string& accession) {
             } else return it->second;
         } else {
             // Using SQL database
-            std::vector<std::vector<std::string>> results;
-            char *query = sqlite3_mprintf(
-                    "SELECT %q, %q, %q FROM %q WHERE %q=%Q",
-                    SQL_TABLE_UNIPROT_COL_ID.c_str(),
-                    SQL_TABLE_UNIPROT_COL_XREF.c_str(),
-                    SQL_TABLE_UNIPROT_COL_COMM.c_str(),
-                    SQL_TABLE_UNIPROT_TITLE.c_str(),
-                    SQL_TABLE_UNIPROT_COL_ID.c_str(),
-                    accession.c_str()
-            );
-            if (results.empty()) return UniprotEntry();
-            results = _pDatabaseHelper->query(query);
-            uniprotEntry.uniprot_id      = results[0][0];
-            uniprotEntry.database_x_refs = results[0][1];
-            uniprotEntry.comments        = results[0][2];
+            SQLDatabaseHelper::Statement statement = _pDatabaseHelper->prepare(_sql_select_uniprot);
+            statement.bind(1, accession);
+            if (!statement.step()) return UniprotEntry();
+            uniprotEntry.uniprot_id      = statement.get_string(0);
+            uniprotEntry.database_x_refs = statement.get_string(1);
+            uniprotEntry.comments        = statement.get_string(2);
             return uniprotEntry;
         }
     } catch (const std::exception &e) {
@@ -1152,14 +1764,113 @@ EntapDatabase::DATABASE_ERR EntapDatabase::serialize_database_read(SERIALIZATION
     return ERR_DATA_OK;
 }
 
+/**
+ * ======================================================================
+ * Function EntapDatabase::DATABASE_ERR EntapDatabase::mapped_database_read(std::string &in_path)
+ *
+ * Description          - Opens the memory mapped copy of the serialized
+ *                        database, nothing is deserialized
+ *                      - If there is no usable mapped copy, the serialized
+ *                        database is read instead
+ *
+ * Notes                - Mapped copy is only built during configuration
+ *                        (configure_database), it is unusable once the
+ *                        serialized database is replaced or its version
+ *                        changes
+ *
+ * @param in_path       - Path to serialized database
+ *
+ * @return              - DATABASE_ERR type
+ *
+ * =====================================================================
+ */
+EntapDatabase::DATABASE_ERR EntapDatabase::mapped_database_read(std::string &in_path) {
+    std::string  mapped_path;
+
+    // Already read
+    if (_pMappedDatabase != nullptr || _pSerializedDatabase != nullptr) return ERR_DATA_OK;
+
+    mapped_path = in_path + MappedDatabase::MAPPED_EXT;
+    _pMappedDatabase = new MappedDatabase();
+    if (_pMappedDatabase->open(mapped_path, in_path) && is_valid_version()) return ERR_DATA_OK;
+    delete _pMappedDatabase;
+    _pMappedDatabase = nullptr;
+
+    FS_dprint("No usable mapped EnTAP database at " + mapped_path + " (built with --config), "
+              "reading serialized database");
+    return serialize_database_read(SERIALIZE_DEFAULT, in_path);
+}
+
+
+/**
+ * ======================================================================
+ * Function bool EntapDatabase::mapped_database_save(std::string &in_path)
+ *
+ * Description          - Builds the memory mapped copy of the serialized
+ *                        database beside it and switches lookups to it,
+ *                        freeing the deserialized maps
+ *
+ * Notes                - Lookups stay on the serialized maps if the copy
+ *                        cannot be written
+ *
+ * @param in_path       - Path to serialized database
+ *
+ * @return              - True if the mapped copy was written
+ *
+ * =====================================================================
+ */
+bool EntapDatabase::mapped_database_save(std::string &in_path) {
+    std::string mapped_path;
+
+    if (_pSerializedDatabase == nullptr) return false;
+
+    mapped_path = in_path + MappedDatabase::MAPPED_EXT;
+    if (!mapped_database_build(in_path, mapped_path)) {
+        set_err_msg("Unable to write mapped EnTAP database to: " + mapped_path, ERR_DATA_SERIALIZE_SAVE);
+        return false;
+    }
+    delete _pSerializedDatabase;
+    _pSerializedDatabase = nullptr;
+    return true;
+}
+
+
+// Builds mapped copy from the serialized maps at mapped_path and opens it
+bool EntapDatabase::mapped_database_build(std::string &in_path, std::string &mapped_path) {
+    _pMappedDatabase = new MappedDatabase();
+    if (MappedDatabase::build(*_pSerializedDatabase, in_path, mapped_path, _pFilesystem) &&
+        _pMappedDatabase->open(mapped_path, in_path)) {
+        FS_dprint("Using mapped EnTAP database: " + mapped_path);
+        return true;
+    }
+    FS_dprint("WARNING: unable to write mapped EnTAP database to: " + mapped_path);
+    delete _pMappedDatabase;
+    _pMappedDatabase = nullptr;
+    return false;
+}
+
 std::string EntapDatabase::print_error_log() {
+    std::lock_guard<std::mutex> lock(_err_mutex);
     return "\nEnTAP Database Error: " + _err_msg;
 }
 
+void EntapDatabase::set_threads(int threads) {
+    _threads = std::max(threads, 1);
+}
+
 void EntapDatabase::set_err_msg(std::string msg, DATABASE_ERR code) {
+    std::lock_guard<std::mutex> lock(_err_mutex);
     FS_dprint(msg);
     _err_msg = msg;
     _err_code = code;
+    _thread_err_msgs[std::this_thread::get_id()] = msg;
+}
+
+// Last error set from a thread, so concurrently generated sections keep their own messages
+std::string EntapDatabase::get_thread_err_msg(std::thread::id thread_id) {
+    std::lock_guard<std::mutex> lock(_err_mutex);
+    auto it = _thread_err_msgs.find(thread_id);
+    return it == _thread_err_msgs.end() ? std::string() : it->second;
 }
 
 
@@ -1188,15 +1899,24 @@ go_format_t EntapDatabase::format_go_delim(std::string terms, char delim) {
 }
 
 bool EntapDatabase::is_valid_version() {
+    // Legacy SQL schema is still readable until migrated during configuration
+    if (!_use_serial && _sql_legacy) return true;
     return (get_current_version_str() == get_required_version_str());
 }
 
+bool EntapDatabase::is_sql_legacy() {
+    return _sql_legacy;
+}
+
 std::string EntapDatabase::get_current_version_str() {
     std::string version_str;
 
     if (_use_serial) {
         // Using serialized database
-        if (_pSerializedDatabase != nullptr) {
+        if (_pMappedDatabase != nullptr) {
+            version_str = std::to_string(_pMappedDatabase->get_major_version()) + "." +
+                          std::to_string(_pMappedDatabase->get_minor_version());
+        } else if (_pSerializedDatabase != nullptr) {
             version_str = std::to_string(_pSerializedDatabase->MAJOR_VERSION) + "." +
                           std::to_string(_pSerializedDatabase->MINOR_VERSION);
         } else {
@@ -1205,19 +1925,12 @@ std::string EntapDatabase::get_current_version_str() {
 
     } else {
         // Using SQL database
-        char* query;
-
         if (_pDatabaseHelper != nullptr) {
-            query = sqlite3_mprintf(
-                    "SELECT %Q FROM %Q",
-                    SQL_TABLE_VERSION_TITLE.c_str(),
-                    SQL_TABLE_VERSION_COL_VER.c_str()
-            );
-
             try {
-                FS_dprint("Executing sql cmd: " + std::string(query));
-                version_str = _pDatabaseHelper->query(query)[0][0];
-                FS_dprint("Success! Returned version: " + version_str);
+                SQLDatabaseHelper::Statement statement = _pDatabaseHelper->prepare(
+                        "SELECT " + SQL_TABLE_VERSION_COL_VER + " FROM " + SQL_TABLE_VERSION_TITLE);
+                version_str = statement.step() ? statement.get_string(0) : "";
+                FS_dprint("Returned SQL database version: " + version_str);
 
             } catch (...) {
                 set_err_msg("ERROR: couldn't get SQL version of EnTAP Database", ERR_DATA_GET_VERSION);
@@ -1256,23 +1969,21 @@ bool EntapDatabase::set_database_versions(EntapDatabase::DATABASE_TYPE type) {
 
         case ENTAP_SQL:
             if (_pDatabaseHelper != nullptr) {
-                char *query;
                 std::string version_str;
 
                 // Can we create the table to store the versioning data
-                if (create_sql_table(ENTAP_VERSION)) {
+                if (create_sql_table(_pDatabaseHelper, ENTAP_VERSION)) {
                     // YES, create entry into table
-
                     version_str = get_required_version_str();
-                    query = sqlite3_mprintf(
-                            "INSERT INTO %Q (%Q) VALUES (%Q);",
-                            SQL_TABLE_VERSION_TITLE.c_str(),
-                            SQL_TABLE_VERSION_COL_VER.c_str(),
-                            version_str.c_str()
-                    );
-
-                    FS_dprint("Executing SQL cmd: " + std::string(query));
-                    ret = _pDatabaseHelper->execute_cmd(query);
+                    try {
+                        _pDatabaseHelper->prepare("INSERT INTO " + SQL_TABLE_VERSION_TITLE + " (" +
+                                                  SQL_TABLE_VERSION_COL_VER + ") VALUES (?)")
+                                .bind(1, version_str).step();
+                        ret = true;
+                    } catch (const std::exception &e) {
+                        FS_dprint("Unable to set SQL database version: " + std::string(e.what()));
+                        ret = false;
+                    }
 
                 } else {
                     // NO, return
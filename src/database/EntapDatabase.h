@@ -30,7 +30,11 @@
 
 #include "../EntapGlobals.h"
 #include "../EntapConfig.h"
+#include <atomic>
+#include <mutex>
+#include <thread>
 #include "SQLDatabaseHelper.h"
+#include "BoundedQueue.h"
 
 #ifdef USE_BOOST    // Include boost serialization headers
 #include <boost/serialization/serialization.hpp>
@@ -54,6 +58,7 @@
 
 #include "../FileSystem.h"
 
+class MappedDatabase;
 
 struct  GoEntry {
     std::string go_id;
@@ -182,6 +187,7 @@ public:
     typedef std::unordered_map<std::string, TaxEntry> tax_serial_map_t;
     typedef std::unordered_map<std::string, GoEntry> go_serial_map_t;
     typedef std::unordered_map<std::string, UniprotEntry> uniprot_serial_map_t;
+    typedef std::vector<uint32> tax_ancestors_t;    // Taxon ID of each lineage level, node first, root last
 
     typedef enum {
 
@@ -298,40 +304,95 @@ public:
     bool set_database(DATABASE_TYPE type);
     DATABASE_ERR download_database(DATABASE_TYPE, std::string&);
     DATABASE_ERR generate_database(DATABASE_TYPE, std::string&);
+    bool configure_database(DATABASE_TYPE, std::string&);
     std::string print_error_log();
+    void set_threads(int threads);
     go_format_t format_go_delim(std::string terms, char delim);
 
     // Database accession routines
     TaxEntry get_tax_entry(std::string& species);
     GoEntry get_go_entry(std::string& go_id);
     UniprotEntry get_uniprot_entry(std::string& accession);
+    const tax_ancestors_t &get_tax_ancestors(const std::string &lineage);
+    uint32 get_taxon_id(const std::string &sci_name);
 
     // Database versioning
     bool is_valid_version();
+    bool is_sql_legacy();
     std::string get_current_version_str();
     std::string get_required_version_str();
 
 
 private:
 
+    // Rows parsed during SQL generation, inserted by the writer in one transaction
+    struct SqlBatch {
+        std::vector<TaxEntry>     tax;
+        std::vector<GoEntry>      go;
+        std::vector<UniprotEntry> uniprot;
+    };
+
+    /**
+     * Pipelines SQL generation. The generating (parser) thread adds rows,
+     * which are grouped into batches and handed through a bounded queue to
+     * a writer thread that owns the SQL connection until finish().
+     */
+    class SqlLoader {
+
+    public:
+        SqlLoader(EntapDatabase *database, SQLDatabaseHelper *sql_database);
+        ~SqlLoader();
+        bool add(TaxEntry &entry);
+        bool add(GoEntry &entry);
+        bool add(UniprotEntry &entry);
+        bool finish();
+
+    private:
+        bool queue_batch();
+        void write();
+
+        EntapDatabase          *_pDatabase;
+        SQLDatabaseHelper      *_pSqlDatabase;      // Section being generated
+        BoundedQueue<SqlBatch>  _queue;
+        SqlBatch                _batch;
+        uint64                  _batch_rows;
+        std::atomic<bool>       _failed;
+        std::thread             _writer;
+    };
+
     // Generation/download database routines
     DATABASE_ERR download_entap_sql(std::string&);
     DATABASE_ERR download_entap_serial(std::string&);
     DATABASE_ERR generate_entap_database(DATABASE_TYPE type, std::string& path);
-    DATABASE_ERR generate_entap_tax(DATABASE_TYPE);
-    DATABASE_ERR generate_entap_go(DATABASE_TYPE);
-    DATABASE_ERR generate_entap_uniprot(DATABASE_TYPE);
+    DATABASE_ERR generate_entap_tax(DATABASE_TYPE, SQLDatabaseHelper *sql_database);
+    DATABASE_ERR generate_entap_go(DATABASE_TYPE, SQLDatabaseHelper *sql_database);
+    DATABASE_ERR download_entap_uniprot(std::string &uniprot_flat);
+    DATABASE_ERR generate_entap_uniprot(DATABASE_TYPE, SQLDatabaseHelper *sql_database, std::string &uniprot_flat);
     std::string  entap_tax_get_lineage(TaxonomyNode &,
                                        std::unordered_map<std::string, TaxonomyNode>&);
-    bool sql_add_tax_entry(TaxEntry&);
-    bool sql_add_go_entry(GoEntry&);
-    bool create_sql_table(DATABASE_TYPE);
+    bool sql_add_tax_entry(SQLDatabaseHelper *sql_database, TaxEntry&);
+    bool sql_add_go_entry(SQLDatabaseHelper *sql_database, GoEntry&);
+    bool sql_add_uniprot_entry(SQLDatabaseHelper *sql_database, UniprotEntry&);
+    bool sql_write_batch(SQLDatabaseHelper *sql_database, SqlBatch &batch);
+    bool create_sql_table(SQLDatabaseHelper *sql_database, DATABASE_TYPE);
+    DATABASE_ERR sql_combine_sections(std::string &outpath);
+    std::string sql_section_path(std::string &outpath, DATABASE_TYPE section);
+    SQLDatabaseHelper *sql_create_staging(const std::string &path);
+    void sql_remove_staging(std::string &outpath);
+    std::string sql_table_cmd(DATABASE_TYPE);
+    DATABASE_ERR sql_check_schema(std::string &path, bool migrate);
+    DATABASE_ERR sql_migrate_legacy(std::string &path);
+    bool sql_go_id(const std::string &go_id, int64 &id);
     bool add_uniprot_entry(DATABASE_TYPE type, UniprotEntry &entry);
     void set_err_msg(std::string msg, DATABASE_ERR code);
+    std::string get_thread_err_msg(std::thread::id thread_id);
     bool set_database_versions(DATABASE_TYPE type);
 
     DATABASE_ERR serialize_database_save(SERIALIZATION_TYPE, std::string&);
     DATABASE_ERR serialize_database_read(SERIALIZATION_TYPE, std::string&);
+    DATABASE_ERR mapped_database_read(std::string&);
+    bool mapped_database_save(std::string&);
+    bool mapped_database_build(std::string&, std::string&);
 
     // FTP Paths
     const std::string FTP_GO_DATABASE =
@@ -352,6 +413,7 @@ private:
     const std::string NCBI_TAX_DUMP_FTP_NAMES= "names.dmp";
     const std::string NCBI_TAX_DUMP_FTP_NODES= "nodes.dmp";
     const char        NCBI_TAX_DUMP_DELIM    = '\t';
+    const char        TAX_LINEAGE_DELIM      = ';';
 
     // NCBI Taxonomy dump columns
     const uint8 NCBI_TAX_DUMP_COL_NAME_CLASS   = 6; // Name type (scientific, authority...)
@@ -376,6 +438,12 @@ private:
     const std::string SQL_TABLE_UNIPROT_COL_ID   = "UNIPROTID";
     const std::string SQL_TABLE_VERSION_TITLE    = "VERSION";
     const std::string SQL_TABLE_VERSION_COL_VER  = "VERSION";
+    const std::string SQL_LEGACY_ALIAS           = "LEGACY";    // Attached 1.0 database during migration
+    const std::string SQL_LEGACY_VERSION         = "1.0";       // Text keyed schema, migrated during configuration
+    const std::string SQL_MIGRATE_EXT            = ".migrate";
+    const std::string SQL_SECTION_ALIAS          = "SECTION";   // Attached section while combining
+    const std::string SQL_STAGING_EXT            = ".staging";
+    const std::string GO_ID_PREFIX               = "GO:";
 
     // Gene Ontology constants
     const std::string GO_BIOLOGICAL_LVL = "6679";
@@ -394,19 +462,37 @@ private:
     const SERIALIZATION_TYPE SERIALIZE_DEFAULT    = CEREAL_BIN_ARCHIVE;
     const uint8              SERIALIZE_MAJOR      = 1;
     const uint8              SERIALIZE_MINOR      = 0;
-    const uint8              SQL_MAJOR            = 1;
+    const uint8              SQL_MAJOR            = 2;
     const uint8              SQL_MINOR            = 0;
 
     const uint8 STATUS_UPDATES = 5;     // Percentage of updates when downloading/configuring
+    static const uint64 SQL_LOAD_BATCH_ROWS = 20000;  // Rows inserted per transaction during generation
+    static const uint64 SQL_LOAD_QUEUE      = 4;      // Batches parsed ahead of the writer
 
     EntapDatabaseStruct *_pSerializedDatabase;
+    MappedDatabase      *_pMappedDatabase;      // Used instead of _pSerializedDatabase when set
+    go_serial_map_t      _mapped_go_cache;      // Mapped entries decoded on first lookup (including misses)
+    tax_serial_map_t     _mapped_tax_cache;     // Keyed by requested species, before broadening
     FileSystem          *_pFilesystem;
     SQLDatabaseHelper   *_pDatabaseHelper;
+    std::string          _sql_select_tax;       // Prepared once per connection, bound per lookup
+    std::string          _sql_select_go;
+    std::string          _sql_select_uniprot;
+    std::string          _sql_insert_tax;
+    std::string          _sql_insert_go;
+    std::string          _sql_insert_uniprot;
     std::string          _temp_directory;
+    int                  _threads;          // Used to parse UniProt data during generation
     go_serial_map_t      _sql_go_helper;    // Using to increase speeds for now, change later
+    bool                 _sql_go_complete;  // _sql_go_helper holds every GO term (generation)
+    bool                 _sql_legacy;       // Legacy (1.0) SQL schema read as is (not migrated)
+    std::unordered_map<std::string, uint32>          _taxon_ids;        // Lineage level name to taxon ID
+    std::unordered_map<std::string, tax_ancestors_t> _tax_ancestors;    // Resolved lineages
     bool                 _use_serial;
     std::string          _err_msg;
     DATABASE_ERR         _err_code;
+    std::mutex           _err_mutex;        // Sections are generated concurrently
+    std::unordered_map<std::thread::id, std::string> _thread_err_msgs;  // Last error set by each thread
 
     const std::string ENTAP_DATABASE_TYPES_STR[ENTAP_MAX_TYPES-1] {
             "EnTAP Serialized Database",
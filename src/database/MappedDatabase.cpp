@@ -0,0 +1,453 @@
+/*
+ *
+ * Developed by Alexander Hart
+ * Plant Computational Genomics Lab
+ * University of Connecticut
+ *
+ * For information, contact Alexander Hart at:
+ *     entap.dev@gmail.com
+ *
+ * Copyright 2017-2019, Alexander Hart, Dr. Jill Wegrzyn
+ *
+ * This file is part of EnTAP.
+ *
+ * EnTAP is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * EnTAP is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with EnTAP.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+//*********************** Includes *****************************
+#include "MappedDatabase.h"
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+//**************************************************************
+
+const std::string MappedDatabase::MAPPED_EXT = ".map";
+const uint64 MappedDatabase::MAPPED_MAGIC;
+const uint32 MappedDatabase::MAPPED_VERSION;
+const uint16 MappedDatabase::LOAD_FACTOR;
+
+MappedDatabase::MappedDatabase() {
+    _data   = nullptr;
+    _size   = 0;
+    _header = nullptr;
+}
+
+MappedDatabase::~MappedDatabase() {
+    unmap();
+}
+
+
+/**
+ * ======================================================================
+ * Function bool MappedDatabase::build(EntapDatabase::EntapDatabaseStruct &database,
+ *                                     std::string &source_path, std::string &out_path,
+ *                                     FileSystem *filesystem)
+ *
+ * Description          - Writes the memory mapped format of a serialized
+ *                        EnTAP database
+ *                      - Records are streamed to the file as they are
+ *                        added to the hash tables, tables are written after
+ *                        the records and the header last
+ *
+ * Notes                - Written to a temporary file and renamed, so a
+ *                        partial file is never opened, the temporary file
+ *                        is removed on any failure
+ *                      - Size and modification time of source_path are
+ *                        recorded so a replaced database is rebuilt
+ *
+ * @param database      - Serialized database, already read
+ * @param source_path   - Path of serialized database file
+ * @param out_path      - Path to write mapped database to
+ * @param filesystem    - Used to rename finished file
+ *
+ * @return              - True if written
+ *
+ * =====================================================================
+ */
+bool MappedDatabase::build(EntapDatabase::EntapDatabaseStruct &database, std::string &source_path,
+                           std::string &out_path, FileSystem *filesystem) {
+    FileHeader          header;
+    std::string         temp_path;
+    bool                success;
+
+    FS_dprint("Building memory mapped EnTAP database: " + out_path);
+
+    std::memset(&header, 0, sizeof(header));
+    header.magic          = MAPPED_MAGIC;
+    header.format_version = MAPPED_VERSION;
+    header.major_version  = database.MAJOR_VERSION;
+    header.minor_version  = database.MINOR_VERSION;
+    if (!get_source_stat(source_path, header.source_size, header.source_mtime)) return false;
+
+    temp_path = out_path + ".tmp";
+    std::ofstream file(temp_path, std::ios::out | std::ios::binary | std::ios::trunc);
+    if (!file.is_open()) return false;
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+    try {
+        success = write_records(database, file, header);
+    } catch (...) {
+        file.close();
+        filesystem->delete_file(temp_path);
+        throw;
+    }
+    if (success) {
+        file.seekp(0);
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    }
+    file.close();
+    if (!success || !file || !filesystem->rename_file(temp_path, out_path)) {
+        filesystem->delete_file(temp_path);
+        return false;
+    }
+    FS_dprint("Success! Mapped database written (" + std::to_string(header.file_size) + " bytes)");
+    return true;
+}
+
+
+/**
+ * ======================================================================
+ * Function bool MappedDatabase::write_records(EntapDatabase::EntapDatabaseStruct &database,
+ *                                             std::ofstream &file, FileHeader &header)
+ *
+ * Description          - Writes records and hash tables of each table
+ *                        after the (placeholder) header
+ *
+ * Notes                - Table headers and file size are set in header,
+ *                        caller writes it once everything succeeded
+ *
+ * @param database      - Serialized database, already read
+ * @param file          - Mapped database being written
+ * @param header        - File header to fill in
+ *
+ * @return              - True if written
+ *
+ * =====================================================================
+ */
+bool MappedDatabase::write_records(EntapDatabase::EntapDatabaseStruct &database, std::ofstream &file,
+                                   FileHeader &header) {
+    std::vector<Slot>   slots;
+    uint64              offset = sizeof(header);
+
+    // Taxonomy, keyed by lowercase species name
+    slots.resize(get_slot_count(database.taxonomic_data.size()));
+    for (auto &pair : database.taxonomic_data) {
+        add_slot(slots, hash_key(pair.first.data(), pair.first.size()), offset);
+        offset += write_string(file, pair.first);
+        offset += write_string(file, pair.second.tax_id);
+        offset += write_string(file, pair.second.lineage);
+        offset += write_string(file, pair.second.tax_name);
+    }
+    header.tables[TABLE_TAXONOMY].entry_count = database.taxonomic_data.size();
+    if (!write_table(file, slots, offset, header.tables[TABLE_TAXONOMY])) return false;
+
+    // Gene Ontology, keyed by GO ID
+    slots.clear();
+    slots.resize(get_slot_count(database.gene_ontology_data.size()));
+    for (auto &pair : database.gene_ontology_data) {
+        add_slot(slots, hash_key(pair.first.data(), pair.first.size()), offset);
+        offset += write_string(file, pair.first);
+        offset += write_string(file, pair.second.go_id);
+        offset += write_string(file, pair.second.level);
+        offset += write_string(file, pair.second.category);
+        offset += write_string(file, pair.second.term);
+    }
+    header.tables[TABLE_GENE_ONTOLOGY].entry_count = database.gene_ontology_data.size();
+    if (!write_table(file, slots, offset, header.tables[TABLE_GENE_ONTOLOGY])) return false;
+
+    // UniProt, keyed by accession, GO terms follow as category -> terms
+    slots.clear();
+    slots.resize(get_slot_count(database.uniprot_data.size()));
+    for (auto &pair : database.uniprot_data) {
+        add_slot(slots, hash_key(pair.first.data(), pair.first.size()), offset);
+        offset += write_string(file, pair.first);
+        offset += write_string(file, pair.second.database_x_refs);
+        offset += write_string(file, pair.second.comments);
+        offset += write_string(file, pair.second.uniprot_id);
+        offset += write_string(file, pair.second.kegg_terms);
+        offset += write_uint32(file, (uint32) pair.second.go_terms.size());
+        for (auto &category : pair.second.go_terms) {
+            offset += write_string(file, category.first);
+            offset += write_uint32(file, (uint32) category.second.size());
+            for (const std::string &term : category.second) offset += write_string(file, term);
+        }
+    }
+    header.tables[TABLE_UNIPROT].entry_count = database.uniprot_data.size();
+    if (!write_table(file, slots, offset, header.tables[TABLE_UNIPROT])) return false;
+
+    header.file_size = offset;
+    return (bool) file;
+}
+
+
+/**
+ * ======================================================================
+ * Function bool MappedDatabase::open(std::string &path, std::string &source_path)
+ *
+ * Description          - Maps a database built with build() read-only and
+ *                        checks its header and table bounds
+ *
+ * Notes                - Fails if the serialized database at source_path
+ *                        has changed since the file was built, a missing
+ *                        source is allowed
+ *                      - Lookups are random, so read ahead is disabled
+ *
+ * @param path          - Path to mapped database
+ * @param source_path   - Path of serialized database it was built from
+ *
+ * @return              - True if mapped and valid
+ *
+ * =====================================================================
+ */
+bool MappedDatabase::open(std::string &path, std::string &source_path) {
+    struct stat file_stat;
+    uint64      source_size;
+    int64       source_mtime;
+    int         fd;
+    void       *data;
+
+    unmap();
+    fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+    if (fstat(fd, &file_stat) != 0 || (uint64) file_stat.st_size < sizeof(FileHeader)) {
+        ::close(fd);
+        return false;
+    }
+    data = mmap(nullptr, (size_t) file_stat.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);    // Mapping stays valid
+    if (data == MAP_FAILED) {
+        FS_dprint("Unable to map EnTAP database: " + path);
+        return false;
+    }
+#ifdef MADV_RANDOM
+    madvise(data, (size_t) file_stat.st_size, MADV_RANDOM);
+#endif
+    _data   = static_cast<const char*>(data);
+    _size   = (uint64) file_stat.st_size;
+    _header = reinterpret_cast<const FileHeader*>(_data);
+
+    if (_header->magic != MAPPED_MAGIC || _header->format_version != MAPPED_VERSION || _header->file_size != _size) {
+        FS_dprint("Mapped EnTAP database is not valid: " + path);
+        unmap();
+        return false;
+    }
+    if (get_source_stat(source_path, source_size, source_mtime) &&
+        (source_size != _header->source_size || source_mtime != _header->source_mtime)) {
+        FS_dprint("Mapped EnTAP database is out of date: " + path);
+        unmap();
+        return false;
+    }
+    for (const TableHeader &table : _header->tables) {
+        if ((table.slot_count & (table.slot_count - 1)) != 0 || table.slots_offset % sizeof(uint64) != 0 ||
+            table.slots_offset > _size || table.slot_count > (_size - table.slots_offset) / sizeof(Slot)) {
+            FS_dprint("Mapped EnTAP database table out of bounds: " + path);
+            unmap();
+            return false;
+        }
+    }
+    FS_dprint("Mapped EnTAP database: " + path + " (" + std::to_string(_size) + " bytes)");
+    return true;
+}
+
+bool MappedDatabase::find_tax_entry(const std::string &species, TaxEntry &entry) const {
+    const char *pos = find_record(TABLE_TAXONOMY, species);
+
+    if (pos == nullptr) return false;
+    entry = TaxEntry();
+    pos = read_string(pos, entry.tax_id);
+    pos = read_string(pos, entry.lineage);
+    pos = read_string(pos, entry.tax_name);
+    return pos != nullptr;
+}
+
+bool MappedDatabase::find_go_entry(const std::string &go_id, GoEntry &entry) const {
+    const char *pos = find_record(TABLE_GENE_ONTOLOGY, go_id);
+
+    if (pos == nullptr) return false;
+    entry = GoEntry();
+    pos = read_string(pos, entry.go_id);
+    pos = read_string(pos, entry.level);
+    pos = read_string(pos, entry.category);
+    pos = read_string(pos, entry.term);
+    return pos != nullptr;
+}
+
+bool MappedDatabase::find_uniprot_entry(const std::string &accession, UniprotEntry &entry) const {
+    const char *pos = find_record(TABLE_UNIPROT, accession);
+    std::string category;
+    uint32      category_count=0;
+    uint32      term_count=0;
+
+    if (pos == nullptr) return false;
+    entry = UniprotEntry();
+    pos = read_string(pos, entry.database_x_refs);
+    pos = read_string(pos, entry.comments);
+    pos = read_string(pos, entry.uniprot_id);
+    pos = read_string(pos, entry.kegg_terms);
+    pos = read_uint32(pos, category_count);
+    for (uint32 i = 0; pos != nullptr && i < category_count; i++) {
+        pos = read_string(pos, category);
+        pos = read_uint32(pos, term_count);
+        vect_str_t &terms = entry.go_terms[category];
+        for (uint32 j = 0; pos != nullptr && j < term_count; j++) {
+            terms.emplace_back();
+            pos = read_string(pos, terms.back());
+        }
+    }
+    return pos != nullptr;
+}
+
+uint8 MappedDatabase::get_major_version() const {
+    return _header == nullptr ? (uint8) 0 : _header->major_version;
+}
+
+uint8 MappedDatabase::get_minor_version() const {
+    return _header == nullptr ? (uint8) 0 : _header->minor_version;
+}
+
+
+/**
+ * ======================================================================
+ * Function const char *MappedDatabase::find_record(MAPPED_TABLE table,
+ *                                                  const std::string &key)
+ *
+ * Description          - Probes a table from the slot of the key hash
+ *                        until the key or an empty slot is found
+ *
+ * Notes                - Stored key is compared in place, nothing is
+ *                        copied for misses
+ *
+ * @param table         - Table to search
+ * @param key           - Key to find
+ *
+ * @return              - Position of first field after the key, nullptr if
+ *                        not found
+ *
+ * =====================================================================
+ */
+const char *MappedDatabase::find_record(MAPPED_TABLE table, const std::string &key) const {
+    const Slot  *slots;
+    const char  *pos;
+    uint64       hash;
+    uint64       mask;
+    uint64       index;
+    uint32       key_size;
+
+    if (_header == nullptr) return nullptr;
+    const TableHeader &table_header = _header->tables[table];
+    if (table_header.slot_count == 0) return nullptr;
+
+    slots = reinterpret_cast<const Slot*>(_data + table_header.slots_offset);
+    hash  = hash_key(key.data(), key.size());
+    mask  = table_header.slot_count - 1;
+    index = hash & mask;
+    for (uint64 probe = 0; probe < table_header.slot_count; probe++, index = (index + 1) & mask) {
+        const Slot &slot = slots[index];
+        if (slot.record_offset == 0) return nullptr;
+        if (slot.hash != hash || slot.record_offset >= _size) continue;
+        pos = read_uint32(_data + slot.record_offset, key_size);
+        if (pos == nullptr || key_size != key.size() || (uint64)(_data + _size - pos) < key_size) continue;
+        if (std::memcmp(pos, key.data(), key_size) == 0) return pos + key_size;
+    }
+    return nullptr;
+}
+
+// Reads a length prefixed string, nullptr if pos is nullptr or it runs past the file
+const char *MappedDatabase::read_string(const char *pos, std::string &str) const {
+    uint32 size=0;
+
+    pos = read_uint32(pos, size);
+    if (pos == nullptr || (uint64)(_data + _size - pos) < size) return nullptr;
+    str.assign(pos, size);
+    return pos + size;
+}
+
+const char *MappedDatabase::read_uint32(const char *pos, uint32 &val) const {
+    if (pos == nullptr || (uint64)(_data + _size - pos) < sizeof(uint32)) return nullptr;
+    std::memcpy(&val, pos, sizeof(uint32));     // Records are not aligned
+    return pos + sizeof(uint32);
+}
+
+void MappedDatabase::unmap() {
+    if (_data != nullptr) munmap(const_cast<char*>(_data), (size_t) _size);
+    _data   = nullptr;
+    _size   = 0;
+    _header = nullptr;
+}
+
+// FNV-1a
+uint64 MappedDatabase::hash_key(const char *key, uint64 size) {
+    uint64 hash = 14695981039346656037ULL;
+    for (uint64 i = 0; i < size; i++) {
+        hash ^= (uint8) key[i];
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+// Smallest power of 2 giving at least LOAD_FACTOR slots per entry
+uint64 MappedDatabase::get_slot_count(uint64 entries) {
+    uint64 count = 1;
+
+    if (entries == 0) return 0;
+    while (count < entries * LOAD_FACTOR) count <<= 1;
+    return count;
+}
+
+bool MappedDatabase::get_source_stat(std::string &source_path, uint64 &size, int64 &mtime) {
+    struct stat file_stat;
+
+    if (stat(source_path.c_str(), &file_stat) != 0) return false;
+    size  = (uint64) file_stat.st_size;
+    mtime = (int64) file_stat.st_mtime;
+    return true;
+}
+
+void MappedDatabase::add_slot(std::vector<Slot> &slots, uint64 hash, uint64 record_offset) {
+    uint64 mask;
+    uint64 index;
+
+    if (slots.empty()) return;
+    mask  = slots.size() - 1;
+    index = hash & mask;
+    while (slots[index].record_offset != 0) index = (index + 1) & mask;
+    slots[index] = {hash, record_offset};
+}
+
+uint64 MappedDatabase::write_string(std::ofstream &file, const std::string &str) {
+    uint64 size = write_uint32(file, (uint32) str.size());
+    file.write(str.data(), (std::streamsize) str.size());
+    return size + str.size();
+}
+
+uint64 MappedDatabase::write_uint32(std::ofstream &file, uint32 val) {
+    file.write(reinterpret_cast<const char*>(&val), sizeof(uint32));
+    return sizeof(uint32);
+}
+
+// Pads to 8 bytes then writes the slots of a table after the records
+bool MappedDatabase::write_table(std::ofstream &file, std::vector<Slot> &slots, uint64 &offset, TableHeader &header) {
+    static const char padding[sizeof(uint64)] = {0};
+    uint64 pad = (sizeof(uint64) - offset % sizeof(uint64)) % sizeof(uint64);
+
+    file.write(padding, (std::streamsize) pad);
+    offset += pad;
+    header.slots_offset = offset;
+    header.slot_count   = slots.size();
+    file.write(reinterpret_cast<const char*>(slots.data()), (std::streamsize)(slots.size() * sizeof(Slot)));
+    offset += slots.size() * sizeof(Slot);
+    return (bool) file;
+}
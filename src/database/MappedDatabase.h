@@ -0,0 +1,123 @@
+/*
+ *
+ * Developed by Alexander Hart
+ * Plant Computational Genomics Lab
+ * University of Connecticut
+ *
+ * For information, contact Alexander Hart at:
+ *     entap.dev@gmail.com
+ *
+ * Copyright 2017-2019, Alexander Hart, Dr. Jill Wegrzyn
+ *
+ * This file is part of EnTAP.
+ *
+ * EnTAP is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * EnTAP is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with EnTAP.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef ENTAP_MAPPEDDATABASE_H
+#define ENTAP_MAPPEDDATABASE_H
+
+//*********************** Includes *****************************
+#include "../common.h"
+#include "EntapDatabase.h"
+//**************************************************************
+
+
+/**
+ * Read-only EnTAP database that is memory mapped and queried in place
+ *
+ * Built once from the serialized database. Taxonomy, Gene Ontology and
+ * UniProt entries are each stored as an open addressing hash table
+ * (linear probing) of fixed size slots pointing into a heap of length
+ * prefixed strings, all at offsets recorded in the file header. Opening
+ * only maps the file, nothing is deserialized, and concurrent runs share
+ * the same pages through the page cache.
+ *
+ * Entries are only copied out to TaxEntry/GoEntry/UniprotEntry when they
+ * are looked up. Files are native byte order.
+ */
+class MappedDatabase {
+
+public:
+    typedef enum {
+        TABLE_TAXONOMY=0,
+        TABLE_GENE_ONTOLOGY,
+        TABLE_UNIPROT,
+
+        TABLE_MAX
+    } MAPPED_TABLE;
+
+    static const std::string MAPPED_EXT;
+
+    MappedDatabase();
+    ~MappedDatabase();
+
+    static bool build(EntapDatabase::EntapDatabaseStruct &database, std::string &source_path,
+                      std::string &out_path, FileSystem *filesystem);
+    bool open(std::string &path, std::string &source_path);
+    bool find_tax_entry(const std::string &species, TaxEntry &entry) const;
+    bool find_go_entry(const std::string &go_id, GoEntry &entry) const;
+    bool find_uniprot_entry(const std::string &accession, UniprotEntry &entry) const;
+    uint8 get_major_version() const;
+    uint8 get_minor_version() const;
+
+private:
+    struct TableHeader {
+        uint64 slots_offset;            // From start of file, 8 byte aligned
+        uint64 slot_count;              // Power of 2, 0 if table is empty
+        uint64 entry_count;
+    };
+
+    struct FileHeader {
+        uint64      magic;
+        uint32      format_version;
+        uint8       major_version;      // EnTAP database version this was built from
+        uint8       minor_version;
+        uint16      reserved;
+        uint64      source_size;        // Serialized database this was built from
+        int64       source_mtime;
+        uint64      file_size;
+        TableHeader tables[TABLE_MAX];
+    };
+
+    struct Slot {
+        uint64 hash;
+        uint64 record_offset;           // From start of file, 0 if slot is empty
+    };
+
+    static const uint64 MAPPED_MAGIC   = 0x70614d5041746e45ULL;    // "EntAPMap"
+    static const uint32 MAPPED_VERSION = 1;
+    static const uint16 LOAD_FACTOR    = 2;                         // Slots per entry (at least)
+
+    static uint64 hash_key(const char *key, uint64 size);
+    static uint64 get_slot_count(uint64 entries);
+    static bool get_source_stat(std::string &source_path, uint64 &size, int64 &mtime);
+    static void add_slot(std::vector<Slot> &slots, uint64 hash, uint64 record_offset);
+    static uint64 write_string(std::ofstream &file, const std::string &str);
+    static uint64 write_uint32(std::ofstream &file, uint32 val);
+    static bool write_table(std::ofstream &file, std::vector<Slot> &slots, uint64 &offset, TableHeader &header);
+    static bool write_records(EntapDatabase::EntapDatabaseStruct &database, std::ofstream &file, FileHeader &header);
+
+    const char *find_record(MAPPED_TABLE table, const std::string &key) const;
+    const char *read_string(const char *pos, std::string &str) const;
+    const char *read_uint32(const char *pos, uint32 &val) const;
+    void unmap();
+
+    const char       *_data;
+    uint64            _size;
+    const FileHeader *_header;
+};
+
+
+#endif //ENTAP_MAPPEDDATABASE_H
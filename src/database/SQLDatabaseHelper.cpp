@@ -32,30 +32,53 @@
 #include "../EntapGlobals.h"
 //**************************************************************
 
+const int64 SQLDatabaseHelper::QUERY_MMAP_SIZE;
+const int32 SQLDatabaseHelper::QUERY_CACHE_KB;
+
 
 /**
  * ======================================================================
- * Function bool DatabaseHelper::open(std::string file)
+ * Function bool DatabaseHelper::open(std::string file, bool read_only)
  *
  * Description          - Opens sql database through sqlite3
+ *                      - Read-only databases are tuned for lookups, pages
+ *                        are memory mapped, the page cache is enlarged and
+ *                        temporary tables are kept in memory
  *
  * Notes                - This is used as a creation routine as well
  *
  * @param file          - Path to database
+ * @param read_only     - Open without write access (database must exist)
  *
  * @return              - True/false if successful
  *
  * =====================================================================
  */
-bool SQLDatabaseHelper::open(std::string file) {
+bool SQLDatabaseHelper::open(std::string file, bool read_only) {
     FS_dprint("Opening SQL database at: " + file);
     int err_code;
-    err_code = sqlite3_open(file.c_str(),&_database);
+    int flags;
+    std::string pragma;
+
+    flags = read_only ? SQLITE_OPEN_READONLY : (SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE);
+    err_code = sqlite3_open_v2(file.c_str(), &_database, flags, NULL);
     if (err_code == SQLITE_OK) {
-        sqlite3_exec(_database,"PRAGMA synchronous = OFF", NULL, NULL, NULL);
-        sqlite3_exec(_database,"PRAGMA count_changes = false", NULL, NULL, NULL);
-        sqlite3_exec(_database,"PRAGMA journal_mode = OFF", NULL, NULL, NULL);
+        if (read_only) {
+            pragma = "PRAGMA mmap_size = " + std::to_string(QUERY_MMAP_SIZE);
+            sqlite3_exec(_database, pragma.c_str(), NULL, NULL, NULL);
+            pragma = "PRAGMA cache_size = -" + std::to_string(QUERY_CACHE_KB);
+            sqlite3_exec(_database, pragma.c_str(), NULL, NULL, NULL);
+            sqlite3_exec(_database,"PRAGMA temp_store = MEMORY", NULL, NULL, NULL);
+        } else {
+            sqlite3_exec(_database,"PRAGMA synchronous = OFF", NULL, NULL, NULL);
+            sqlite3_exec(_database,"PRAGMA count_changes = false", NULL, NULL, NULL);
+            sqlite3_exec(_database,"PRAGMA journal_mode = OFF", NULL, NULL, NULL);
+        }
         FS_dprint("Success!");
+    } else {
+        FS_dprint("SQL Error: " + std::string(sqlite3_errstr(err_code)));
+        sqlite3_close(_database);
+        _database = NULL;
     }
     return err_code == SQLITE_OK;
 }
@@ -75,7 +98,10 @@ bool SQLDatabaseHelper::open(std::string file) {
  * =====================================================================
  */
 void SQLDatabaseHelper::close() {
+    for (auto &pair : _statements) sqlite3_finalize(pair.second.stmt);
+    _statements.clear();
     sqlite3_close(_database);
+    _database = NULL;
 }
 
 
@@ -151,6 +177,116 @@ std::vector<std::vector<std::string>> SQLDatabaseHelper::query(char *query) {
 }
 
 
+/**
+ * ======================================================================
+ * Function SQLDatabaseHelper::Statement SQLDatabaseHelper::prepare(const std::string &sql)
+ *
+ * Description          - Returns a prepared statement for sql, parsing it
+ *                        only the first time it is seen on this connection
+ *
+ * Notes                - If the cached statement is still in use (nested
+ *                        lookup) a separate one is prepared and finalized
+ *                        when it goes out of scope
+ *                      - Not thread safe, as the connection is shared
+ *
+ * @param sql           - SQL with ? parameters
+ *
+ * @return              - Statement, ready for binding
+ *
+ * =====================================================================
+ */
+SQLDatabaseHelper::Statement SQLDatabaseHelper::prepare(const std::string &sql) {
+    sqlite3_stmt *stmt;
+
+    std::unordered_map<std::string, CachedStatement>::iterator it = _statements.find(sql);
+    if (it != _statements.end() && !it->second.in_use) {
+        it->second.in_use = true;
+        return Statement(it->second.stmt, &it->second.in_use);
+    }
+
+    if (sqlite3_prepare_v2(_database, sql.c_str(), -1, &stmt, 0) != SQLITE_OK) {
+        throw ExceptionHandler("Error preparing database query: " + std::string(sqlite3_errmsg(_database)) +
+                               "\n" + sql, ERR_ENTAP_DATABASE_QUERY);
+    }
+    if (it != _statements.end()) return Statement(stmt, nullptr);
+
+    CachedStatement &cached = _statements[sql];
+    cached.stmt   = stmt;
+    cached.in_use = true;
+    return Statement(stmt, &cached.in_use);
+}
+
+
+SQLDatabaseHelper::Statement::Statement(sqlite3_stmt *stmt, bool *in_use) {
+    _stmt   = stmt;
+    _in_use = in_use;
+}
+
+SQLDatabaseHelper::Statement::Statement(Statement &&other) {
+    _stmt   = other._stmt;
+    _in_use = other._in_use;
+    other._stmt   = nullptr;
+    other._in_use = nullptr;
+}
+
+SQLDatabaseHelper::Statement::~Statement() {
+    if (_stmt == nullptr) return;
+    if (_in_use == nullptr) {
+        sqlite3_finalize(_stmt);
+    } else {
+        sqlite3_reset(_stmt);
+        sqlite3_clear_bindings(_stmt);
+        *_in_use = false;
+    }
+}
+
+SQLDatabaseHelper::Statement &SQLDatabaseHelper::Statement::bind(int index, const std::string &val) {
+    if (sqlite3_bind_text(_stmt, index, val.data(), (int) val.size(), SQLITE_TRANSIENT) != SQLITE_OK) {
+        throw ExceptionHandler("Error binding database query parameter " + std::to_string(index),
+                               ERR_ENTAP_DATABASE_QUERY);
+    }
+    return *this;
+}
+
+SQLDatabaseHelper::Statement &SQLDatabaseHelper::Statement::bind(int index, int64 val) {
+    if (sqlite3_bind_int64(_stmt, index, (sqlite3_int64) val) != SQLITE_OK) {
+        throw ExceptionHandler("Error binding database query parameter " + std::to_string(index),
+                               ERR_ENTAP_DATABASE_QUERY);
+    }
+    return *this;
+}
+
+// Moves to the next row, false once there are no more
+bool SQLDatabaseHelper::Statement::step() {
+    int stat = sqlite3_step(_stmt);
+
+    if (stat == SQLITE_ROW) return true;
+    if (stat == SQLITE_DONE) return false;
+    throw ExceptionHandler("Error querying database: " + std::string(sqlite3_errmsg(sqlite3_db_handle(_stmt))),
+                           ERR_ENTAP_DATABASE_QUERY);
+}
+
+// NULL columns are returned as empty strings
+std::string SQLDatabaseHelper::Statement::get_string(int col) const {
+    const char *txt = reinterpret_cast<const char*>(sqlite3_column_text(_stmt, col));
+
+    if (txt == nullptr) return "";
+    return std::string(txt, (uint64) sqlite3_column_bytes(_stmt, col));
+}
+
+int64 SQLDatabaseHelper::Statement::get_int(int col) const {
+    return (int64) sqlite3_column_int64(_stmt, col);
+}
+
+fp64 SQLDatabaseHelper::Statement::get_double(int col) const {
+    return sqlite3_column_double(_stmt, col);
+}
+
+bool SQLDatabaseHelper::Statement::is_null(int col) const {
+    return sqlite3_column_type(_stmt, col) == SQLITE_NULL;
+}
+
+
 SQLDatabaseHelper::SQLDatabaseHelper() {
     _database = NULL;
 }
@@ -160,13 +296,13 @@ SQLDatabaseHelper::~SQLDatabaseHelper() {
     close();
 }
 
-bool SQLDatabaseHelper::execute_cmd(char* cmd) {
+bool SQLDatabaseHelper::execute_cmd(const std::string &cmd) {
     int err;
     char* err_msg = 0;
 
 //    FS_dprint("Executing SQL cmd:\n" + cmd);
 
-    err = sqlite3_exec(_database, cmd, NULL, 0, &err_msg);
+    err = sqlite3_exec(_database, cmd.c_str(), NULL, 0, &err_msg);
 
     if( err != SQLITE_OK ){
         std::string err_str = err_msg;
@@ -39,20 +39,59 @@ class SQLDatabaseHelper {
 public:
     typedef std::vector<std::vector<std::string>> query_struct;
 
+    /**
+     * Prepared statement from the helper's cache. Parameters are bound
+     * (1-based as in sqlite3_bind) and rows are read with typed accessors
+     * (0-based columns) straight from SQLite. Statement is reset and its
+     * bindings cleared when this goes out of scope so the next lookup
+     * reuses it without parsing the SQL again.
+     */
+    class Statement {
+
+    public:
+        Statement(sqlite3_stmt *stmt, bool *in_use);
+        Statement(Statement &&other);
+        ~Statement();
+        Statement(const Statement&) = delete;
+        Statement &operator=(const Statement&) = delete;
+
+        Statement &bind(int index, const std::string &val);
+        Statement &bind(int index, int64 val);
+        bool step();
+        std::string get_string(int col) const;
+        int64 get_int(int col) const;
+        fp64 get_double(int col) const;
+        bool is_null(int col) const;
+
+    private:
+        sqlite3_stmt *_stmt;
+        bool         *_in_use;        // Cache flag, nullptr if statement is not cached
+    };
+
     SQLDatabaseHelper();
     ~SQLDatabaseHelper();
-    bool open(std::string file);
+    bool open(std::string file, bool read_only=false);
     bool create(std::string file);
-    bool execute_cmd(char*);
+    bool execute_cmd(const std::string &cmd);
     void close();
     query_struct query(char* query);
+    Statement prepare(const std::string &sql);
 
     // change to template
     std::string format_container(std::set<std::string> &in_cont);
     std::string format_string(std::string& str, char delim);
 
 private:
+    struct CachedStatement {
+        sqlite3_stmt *stmt;
+        bool          in_use;
+    };
+
+    static const int64 QUERY_MMAP_SIZE = 1LL << 30;    // Bytes of database file mapped for reads
+    static const int32 QUERY_CACHE_KB  = 65536;        // Page cache per connection (KiB)
+
     sqlite3 *_database;
+    std::unordered_map<std::string, CachedStatement> _statements;   // SQL text -> prepared statement
 };
 
 
@@ -0,0 +1,260 @@
+/*
+ *
+ * Developed by Alexander Hart
+ * Plant Computational Genomics Lab
+ * University of Connecticut
+ *
+ * For information, contact Alexander Hart at:
+ *     entap.dev@gmail.com
+ *
+ * Copyright 2017-2019, Alexander Hart, Dr. Jill Wegrzyn
+ *
+ * This file is part of EnTAP.
+ *
+ * EnTAP is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * EnTAP is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with EnTAP.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+//*********************** Includes *****************************
+#include <thread>
+#include "TaxonFilter.h"
+#include "../ExceptionHandler.h"
+#include "../similarity_search/AbstractSimilaritySearch.h"
+//**************************************************************
+
+TaxonFilter::TaxonFilter(FileSystem *filesystem, EntapDatabase *database, vect_str_t &include,
+                         vect_str_t &exclude, int threads) {
+    FS_dprint("Spawn Object - TaxonFilter");
+    _pFileSystem    = filesystem;
+    _pEntapDatabase = database;
+    _threads        = std::max(threads, 1);
+    resolve_taxa(include, _include_ids);
+    resolve_taxa(exclude, _exclude_ids);
+}
+
+
+/**
+ * ======================================================================
+ * Function TaxonFilter::FilterStats TaxonFilter::filter(std::string &in_fasta,
+ *                                                       std::string &out_fasta)
+ *
+ * Description          - Writes every record of a FASTA whose species is
+ *                        within the include taxa (if any) and not within
+ *                        the exclude taxa
+ *                      - A batch of chunks (one per thread) is read, each
+ *                        filtered by its own thread, then written in order
+ *
+ * Notes                - Subjects without a species in the taxonomy are
+ *                        removed when include taxa are given, kept
+ *                        otherwise
+ *                      - Written to a temporary file and renamed, so an
+ *                        interrupted filter is never indexed, the
+ *                        temporary file is removed on any error
+ *
+ * @param in_fasta      - Reference FASTA (uncompressed)
+ * @param out_fasta     - Filtered FASTA
+ *
+ * @return              - Subject counts
+ *
+ * =====================================================================
+ */
+TaxonFilter::FilterStats TaxonFilter::filter(std::string &in_fasta, std::string &out_fasta) {
+    std::string                 line;
+    std::string                 temp_path;
+    std::vector<FastaChunk>     chunks((uint64) _threads);
+    std::vector<decision_map_t> local_decisions((uint64) _threads);
+    std::vector<std::thread>    threads;
+    std::exception_ptr          error;
+    std::mutex                  error_mutex;
+    FilterStats                 stats;
+    uint64                      chunk_count;
+    bool                        has_line;
+
+    FS_dprint("Filtering reference by taxon: " + in_fasta);
+
+    std::ifstream in_file(in_fasta);
+    if (!in_file.is_open()) {
+        throw ExceptionHandler("Unable to read reference database: " + in_fasta, ERR_ENTAP_INIT_INDX_DATABASE);
+    }
+    temp_path = out_fasta + ".tmp";
+    std::ofstream out_file(temp_path, std::ios::out | std::ios::trunc);
+
+    try {
+        has_line = (bool) std::getline(in_file, line);
+        while (has_line) {
+            // Read a chunk for each thread, chunks always end before a header
+            for (chunk_count = 0; chunk_count < chunks.size() && has_line; chunk_count++) {
+                FastaChunk &chunk = chunks[chunk_count];
+                chunk.data.clear();
+                do {
+                    chunk.data.append(line).push_back('\n');
+                    has_line = (bool) std::getline(in_file, line);
+                } while (has_line && (chunk.data.size() < CHUNK_BYTES || line.empty() ||
+                                      line[0] != FileSystem::FASTA_FLAG));
+            }
+
+            threads.clear();
+            for (uint64 i = 0; i < chunk_count; i++) {
+                threads.emplace_back([&, i]() {
+                    try {
+                        filter_chunk(chunks[i], local_decisions[i]);
+                    } catch (...) {
+                        std::lock_guard<std::mutex> lock(error_mutex);
+                        error = std::current_exception();
+                    }
+                });
+            }
+            for (std::thread &thread : threads) {
+                thread.join();
+            }
+            if (error) std::rethrow_exception(error);
+
+            for (uint64 i = 0; i < chunk_count; i++) {
+                out_file << chunks[i].output;
+                stats.total       += chunks[i].stats.total;
+                stats.kept        += chunks[i].stats.kept;
+                stats.excluded    += chunks[i].stats.excluded;
+                stats.no_taxonomy += chunks[i].stats.no_taxonomy;
+            }
+        }
+    } catch (...) {
+        out_file.close();
+        _pFileSystem->delete_file(temp_path);
+        throw;
+    }
+    in_file.close();
+    out_file.close();
+    if (!out_file || !_pFileSystem->rename_file(temp_path, out_fasta)) {
+        _pFileSystem->delete_file(temp_path);
+        throw ExceptionHandler("Unable to write filtered reference database: " + out_fasta,
+                               ERR_ENTAP_INIT_INDX_DATABASE);
+    }
+
+    FS_dprint("Success! Kept " + std::to_string(stats.kept) + "/" + std::to_string(stats.total) +
+              " subjects, written to: " + out_fasta);
+    return stats;
+}
+
+void TaxonFilter::filter_chunk(FastaChunk &chunk, decision_map_t &local_decisions) {
+    uint64              pos=0;
+    uint64              end;
+    bool                keep=true;
+    SUBJECT_DECISION    decision;
+
+    chunk.output.clear();
+    chunk.stats = FilterStats();
+    while (pos < chunk.data.size()) {
+        end = chunk.data.find('\n', pos);
+        if (end == std::string::npos) end = chunk.data.size();
+        if (end > pos && chunk.data[pos] == FileSystem::FASTA_FLAG) {
+            decision = get_decision(AbstractSimilaritySearch::get_species(chunk.data.substr(pos + 1, end - pos - 1)),
+                                    local_decisions);
+            keep = decision == SUBJECT_KEEP;
+            chunk.stats.total++;
+            switch (decision) {
+                case SUBJECT_KEEP:
+                    chunk.stats.kept++;
+                    break;
+                case SUBJECT_EXCLUDED:
+                    chunk.stats.excluded++;
+                    break;
+                case SUBJECT_NO_TAXONOMY:
+                    chunk.stats.no_taxonomy++;
+                    break;
+            }
+        }
+        if (keep) chunk.output.append(chunk.data, pos, end + 1 - pos);
+        pos = end + 1;
+    }
+}
+
+TaxonFilter::SUBJECT_DECISION TaxonFilter::get_decision(const std::string &species, decision_map_t &local_decisions) {
+    std::string         lookup;
+    TaxEntry            taxEntry;
+    SUBJECT_DECISION    decision;
+    bool                included;
+    bool                excluded=false;
+
+    auto local = local_decisions.find(species);
+    if (local != local_decisions.end()) return local->second;
+
+    {
+        // Database and its lineage cache are not thread safe
+        std::lock_guard<std::mutex> lock(_decision_mutex);
+        auto shared = _decisions.find(species);
+        if (shared != _decisions.end()) {
+            decision = shared->second;
+        } else {
+            lookup   = species;
+            taxEntry = _pEntapDatabase->get_tax_entry(lookup);
+            if (taxEntry.is_empty()) {
+                decision = _include_ids.empty() ? SUBJECT_KEEP : SUBJECT_NO_TAXONOMY;
+            } else {
+                const EntapDatabase::tax_ancestors_t &ancestors = _pEntapDatabase->get_tax_ancestors(taxEntry.lineage);
+                included = _include_ids.empty();
+                for (uint32 taxon : ancestors) {
+                    if (std::find(_include_ids.begin(), _include_ids.end(), taxon) != _include_ids.end()) {
+                        included = true;
+                    }
+                    if (std::find(_exclude_ids.begin(), _exclude_ids.end(), taxon) != _exclude_ids.end()) {
+                        excluded = true;
+                    }
+                }
+                decision = included && !excluded ? SUBJECT_KEEP : SUBJECT_EXCLUDED;
+            }
+            _decisions.emplace(species, decision);
+        }
+    }
+    local_decisions.emplace(species, decision);
+    return decision;
+}
+
+/**
+ * ======================================================================
+ * Function void TaxonFilter::resolve_taxa(vect_str_t &names,
+ *                                         std::vector<uint32> &taxon_ids)
+ *
+ * Description          - Resolves taxon names to taxon IDs so subjects can
+ *                        be checked by ancestor membership
+ *
+ * Notes                - Names must exactly match a taxon in the taxonomy
+ *
+ * @param names         - Taxon names (lowercase)
+ * @param taxon_ids     - Resolved IDs
+ *
+ * @return              - None
+ *
+ * =====================================================================
+ */
+void TaxonFilter::resolve_taxa(vect_str_t &names, std::vector<uint32> &taxon_ids) {
+    std::string taxon_name;
+    TaxEntry    taxEntry;
+
+    for (const std::string &name : names) {
+        if (name.empty()) continue;
+        taxon_name = name;
+        taxEntry   = _pEntapDatabase->get_tax_entry(taxon_name);
+        // get_tax_entry broadens the name if not found, only accept exact matches
+        if (taxEntry.is_empty() || taxEntry.tax_name != taxon_name) {
+            throw ExceptionHandler("Taxon not found in EnTAP taxonomy: " + name, ERR_ENTAP_INIT_INDX_DATABASE);
+        }
+        // First lineage level is the scientific name of the taxon itself
+        const EntapDatabase::tax_ancestors_t &ancestors = _pEntapDatabase->get_tax_ancestors(taxEntry.lineage);
+        if (ancestors.empty()) {
+            throw ExceptionHandler("Taxon has no lineage in EnTAP taxonomy: " + name, ERR_ENTAP_INIT_INDX_DATABASE);
+        }
+        FS_dprint("Taxon " + name + " resolved in taxonomy");
+        taxon_ids.push_back(ancestors.front());
+    }
+}
@@ -0,0 +1,96 @@
+/*
+ *
+ * Developed by Alexander Hart
+ * Plant Computational Genomics Lab
+ * University of Connecticut
+ *
+ * For information, contact Alexander Hart at:
+ *     entap.dev@gmail.com
+ *
+ * Copyright 2017-2019, Alexander Hart, Dr. Jill Wegrzyn
+ *
+ * This file is part of EnTAP.
+ *
+ * EnTAP is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * EnTAP is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with EnTAP.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef ENTAP_TAXONFILTER_H
+#define ENTAP_TAXONFILTER_H
+
+//*********************** Includes *****************************
+#include <mutex>
+#include "../common.h"
+#include "../FileSystem.h"
+#include "EntapDatabase.h"
+//**************************************************************
+
+
+/**
+ * Restricts a reference protein FASTA to subjects within (or outside of)
+ * a set of taxa so smaller databases can be searched
+ *
+ * The FASTA is streamed in chunks of whole records. Chunks are filtered in
+ * parallel and written back in input order. Species are resolved through
+ * the EnTAP taxonomy once each: threads keep their own decisions and only
+ * lock to look up species they have not seen.
+ */
+class TaxonFilter {
+
+public:
+    struct FilterStats {
+        uint64  total=0;
+        uint64  kept=0;
+        uint64  excluded=0;         // Outside include taxa or within exclude taxa
+        uint64  no_taxonomy=0;      // Species not found in taxonomy
+    };
+
+    TaxonFilter(FileSystem *filesystem, EntapDatabase *database, vect_str_t &include, vect_str_t &exclude,
+                int threads);
+    ~TaxonFilter() = default;
+
+    FilterStats filter(std::string &in_fasta, std::string &out_fasta);
+
+private:
+    typedef enum {
+        SUBJECT_KEEP,
+        SUBJECT_EXCLUDED,
+        SUBJECT_NO_TAXONOMY
+    } SUBJECT_DECISION;
+
+    typedef std::unordered_map<std::string, SUBJECT_DECISION> decision_map_t;
+
+    // Whole FASTA records filtered by one thread
+    struct FastaChunk {
+        std::string data;
+        std::string output;
+        FilterStats stats;
+    };
+
+    const uint64 CHUNK_BYTES = 1 << 22;    // Records are read in chunks of at least this
+
+    void resolve_taxa(vect_str_t &names, std::vector<uint32> &taxon_ids);
+    void filter_chunk(FastaChunk &chunk, decision_map_t &local_decisions);
+    SUBJECT_DECISION get_decision(const std::string &species, decision_map_t &local_decisions);
+
+    FileSystem          *_pFileSystem;
+    EntapDatabase       *_pEntapDatabase;
+    std::vector<uint32>  _include_ids;
+    std::vector<uint32>  _exclude_ids;
+    int                  _threads;
+    decision_map_t       _decisions;            // Shared by every thread, guarded by _decision_mutex
+    std::mutex           _decision_mutex;
+};
+
+
+#endif //ENTAP_TAXONFILTER_H
@@ -0,0 +1,291 @@
+/*
+ *
+ * Developed by Alexander Hart
+ * Plant Computational Genomics Lab
+ * University of Connecticut
+ *
+ * For information, contact Alexander Hart at:
+ *     entap.dev@gmail.com
+ *
+ * Copyright 2017-2019, Alexander Hart, Dr. Jill Wegrzyn
+ *
+ * This file is part of EnTAP.
+ *
+ * EnTAP is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * EnTAP is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with EnTAP.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+//*********************** Includes *****************************
+#include <algorithm>
+#include <cstring>
+#include <thread>
+#include "UniprotDatParser.h"
+#include "../ExceptionHandler.h"
+//**************************************************************
+
+// ID   001R_FRG3G              Reviewed;         256 AA.
+static const char *DAT_TAG_ID          = "ID";
+// DR   GO; GO:0046782; P:regulation of viral transcription; IEA:InterPro.
+static const char *DAT_TAG_X_REF       = "DR";
+// CC   -!- FUNCTION: Transcription activation. {ECO:0000305}.
+static const char *DAT_TAG_COMMENT     = "CC";
+// Entries are split by this (this is on the last line of file)
+static const char *DAT_TAG_NEXT_ENTRY  = "//";
+static const char *DAT_RECORD_END      = "\n//\n";
+static const char *DAT_DATABASE_GO     = "GO";
+static const char *DAT_DATABASE_KEGG   = "KEGG";
+static const char *DAT_GO_PREFIX       = "GO:";
+static const char  DAT_DATABASE_DELIM  = ';';
+static const char  DAT_KEGG_DELIM      = ':';
+static const char  DAT_LIST_DELIM      = ',';
+static const char  DAT_FIELD_DELIM     = '|';
+
+// Position of c within [start, len) of a line, len if not found
+static uint64 find_char(const char *line, uint64 len, char c, uint64 start) {
+    const void *found;
+
+    if (start >= len) return len;
+    found = memchr(line + start, c, len - start);
+    return found == nullptr ? len : (uint64) ((const char*) found - line);
+}
+
+static bool has_tag(const char *line, const char *tag) {
+    return line[0] == tag[0] && line[1] == tag[1];
+}
+
+
+UniprotDatParser::UniprotDatParser(EntapDatabase *database, int threads) {
+    FS_dprint("Spawn Object - UniprotDatParser");
+    _pEntapDatabase = database;
+    _threads        = std::max(threads, 1);
+}
+
+
+/**
+ * ======================================================================
+ * Function bool UniprotDatParser::parse(const std::string &dat_path,
+ *                                       const add_entry_t &add_entry)
+ *
+ * Description          - Parses every record of a UniProt flat file
+ *                      - A batch of blocks (one per thread) is read, each
+ *                        parsed by its own thread, then entries are passed
+ *                        to add_entry in file order on the calling thread
+ *                      - GO terms are resolved on the calling thread, just
+ *                        before each entry is passed
+ *
+ * Notes                - gzip/zstd compressed files are decompressed while
+ *                        being read
+ *                      - Throws ExceptionHandler if the file cannot be read
+ *                        or a record is malformed
+ *
+ * @param dat_path      - UniProt flat file
+ * @param add_entry     - Called with each entry, parsing stops if it
+ *                        returns false
+ *
+ * @return              - False if add_entry failed
+ *
+ * =====================================================================
+ */
+bool UniprotDatParser::parse(const std::string &dat_path, const add_entry_t &add_entry) {
+    std::vector<DatChunk>       chunks((uint64) _threads);
+    std::vector<std::thread>    threads;
+    std::exception_ptr          error;
+    std::mutex                  error_mutex;
+    std::string                 carry;          // Partial record following last block
+    uint64                      chunk_count;
+    uint64                      total=0;
+
+    FS_dprint("Parsing UniProt flat file with " + std::to_string(_threads) + " threads: " + dat_path);
+
+    std::unique_ptr<std::istream> in_file = FileSystem::open_input(dat_path);
+    if (!*in_file) {
+        throw ExceptionHandler("Unable to read UniProt data: " + dat_path, ERR_ENTAP_INIT_DATA_GENERIC);
+    }
+
+    while (true) {
+        // Read a block for each thread, blocks always end after a record
+        chunk_count = 0;
+        while (chunk_count < chunks.size() && read_chunk(*in_file, chunks[chunk_count], carry)) {
+            chunk_count++;
+        }
+        if (chunk_count == 0) break;
+
+        threads.clear();
+        for (uint64 i = 0; i < chunk_count; i++) {
+            threads.emplace_back([&, i]() {
+                try {
+                    parse_chunk(chunks[i]);
+                } catch (...) {
+                    std::lock_guard<std::mutex> lock(error_mutex);
+                    error = std::current_exception();
+                }
+            });
+        }
+        for (std::thread &thread : threads) {
+            thread.join();
+        }
+        if (error) std::rethrow_exception(error);
+
+        for (uint64 i = 0; i < chunk_count; i++) {
+            for (uint64 j = 0; j < chunks[i].entries.size(); j++) {
+                UniprotEntry &entry = chunks[i].entries[j];
+                entry.go_terms = _pEntapDatabase->format_go_delim(chunks[i].go_lists[j], DAT_LIST_DELIM);
+                if (!add_entry(entry)) return false;
+            }
+            total += chunks[i].entries.size();
+        }
+    }
+
+    if (!FileSystem::close_input(*in_file)) {
+        throw ExceptionHandler("UniProt data is truncated or corrupt: " + dat_path, ERR_ENTAP_INIT_DATA_GENERIC);
+    }
+    FS_dprint("Success! Parsed " + std::to_string(total) + " UniProt entries");
+    return true;
+}
+
+
+/**
+ * ======================================================================
+ * Function bool UniprotDatParser::read_chunk(std::istream &in_file, DatChunk &chunk,
+ *                                            std::string &carry)
+ *
+ * Description          - Reads the next block of whole records
+ *                      - Data after the last complete record is carried
+ *                        over to the next block
+ *
+ * Notes                - Records larger than a block extend it
+ *
+ * @param in_file       - UniProt flat file
+ * @param chunk         - Block to fill
+ * @param carry         - Partial record from previous block, replaced
+ *
+ * @return              - False if there is nothing left to read
+ *
+ * =====================================================================
+ */
+bool UniprotDatParser::read_chunk(std::istream &in_file, DatChunk &chunk, std::string &carry) {
+    uint64 size;
+    uint64 end;
+
+    chunk.data.swap(carry);
+    carry.clear();
+    while (true) {
+        if (chunk.data.size() >= CHUNK_BYTES) {
+            end = chunk.data.rfind(DAT_RECORD_END);
+            if (end != std::string::npos) {
+                end += strlen(DAT_RECORD_END);
+                carry.assign(chunk.data, end, std::string::npos);
+                chunk.data.resize(end);
+                return true;
+            }
+        }
+        if (!in_file) return !chunk.data.empty();   // Remaining records
+
+        size = chunk.data.size();
+        chunk.data.resize(size + CHUNK_BYTES);
+        in_file.read(&chunk.data[size], CHUNK_BYTES);
+        chunk.data.resize(size + (uint64) in_file.gcount());
+    }
+}
+
+
+/**
+ * ======================================================================
+ * Function void UniprotDatParser::parse_chunk(DatChunk &chunk)
+ *
+ * Description          - Parses every record within a block
+ *                      - Lines are tokenized in place, only the ID, GO and
+ *                        KEGG cross references, other cross references and
+ *                        comments are copied into the entry
+ *
+ * Notes                - Runs on a worker thread, must not use the EnTAP
+ *                        database (GO terms are only collected)
+ *
+ * @param chunk         - Block of whole records, entries are set
+ *
+ * @return              - None
+ *
+ * =====================================================================
+ */
+void UniprotDatParser::parse_chunk(DatChunk &chunk) {
+    const char  *line;
+    const char  *field;
+    const char  *go_start;
+    uint64       pos=0;
+    uint64       len;
+    uint64       field_len;
+    uint64       start;
+    uint64       end;
+    bool         same_entry=false;
+    std::string  go_list;               // Comma delim, turned into go_format by parse()
+    std::string  kegg_list;
+    UniprotEntry entry;
+
+    chunk.entries.clear();
+    chunk.go_lists.clear();
+    while (pos < chunk.data.size()) {
+        end = chunk.data.find('\n', pos);
+        if (end == std::string::npos) end = chunk.data.size();
+        line = chunk.data.data() + pos;
+        len  = end - pos;
+        pos  = end + 1;
+        if (len < TAG_LEN) continue;
+        field     = line + DATA_POS;
+        field_len = len > DATA_POS ? len - DATA_POS : 0;
+
+        if (has_tag(line, DAT_TAG_ID)) {
+            if (same_entry) {
+                throw ExceptionHandler("UniProt record missing terminator before: " +
+                                       std::string(line, len), ERR_ENTAP_INIT_DATA_GENERIC);
+            }
+            same_entry = true;
+            entry.uniprot_id.assign(field, find_char(field, field_len, ' ', 0));
+
+        } else if (has_tag(line, DAT_TAG_X_REF)) {
+            // Check which database we have
+            end = find_char(field, field_len, DAT_DATABASE_DELIM, 0);
+            if (end == strlen(DAT_DATABASE_GO) && strncmp(field, DAT_DATABASE_GO, end) == 0) {
+                go_start = std::search(field, field + field_len, DAT_GO_PREFIX, DAT_GO_PREFIX + strlen(DAT_GO_PREFIX));
+                if (go_start == field + field_len) continue;
+                start = (uint64) (go_start - field);
+                end   = find_char(field, field_len, DAT_DATABASE_DELIM, start);
+                go_list.append(field + start, end - start).push_back(DAT_LIST_DELIM);
+
+            } else if (end == strlen(DAT_DATABASE_KEGG) && strncmp(field, DAT_DATABASE_KEGG, end) == 0) {
+                start = find_char(field, field_len, DAT_KEGG_DELIM, 0);
+                start = start == field_len ? 0 : start + 1;
+                end   = find_char(field, field_len, DAT_DATABASE_DELIM, start);
+                kegg_list.append(field + start, end - start).push_back(DAT_LIST_DELIM);
+
+            } else {
+                // Neither GO nor KEGG, add to x refs
+                entry.database_x_refs.append(1, DAT_FIELD_DELIM).append(field, field_len);
+            }
+
+        } else if (has_tag(line, DAT_TAG_COMMENT)) {
+            entry.comments.append(1, DAT_FIELD_DELIM).append(field, field_len);
+
+        } else if (has_tag(line, DAT_TAG_NEXT_ENTRY)) {
+            // End of record
+            if (!go_list.empty()) go_list.pop_back();   // remove trailing ','
+            entry.kegg_terms = kegg_list;
+            chunk.entries.push_back(std::move(entry));
+            chunk.go_lists.push_back(go_list);
+            entry      = UniprotEntry();
+            same_entry = false;
+            go_list.clear();
+            kegg_list.clear();
+        }
+        // Other lines are not kept
+    }
+}
@@ -0,0 +1,79 @@
+/*
+ *
+ * Developed by Alexander Hart
+ * Plant Computational Genomics Lab
+ * University of Connecticut
+ *
+ * For information, contact Alexander Hart at:
+ *     entap.dev@gmail.com
+ *
+ * Copyright 2017-2019, Alexander Hart, Dr. Jill Wegrzyn
+ *
+ * This file is part of EnTAP.
+ *
+ * EnTAP is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * EnTAP is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with EnTAP.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef ENTAP_UNIPROTDATPARSER_H
+#define ENTAP_UNIPROTDATPARSER_H
+
+//*********************** Includes *****************************
+#include <functional>
+#include "../common.h"
+#include "EntapDatabase.h"
+//**************************************************************
+
+
+/**
+ * Parses UniProt flat files (.dat, plain or gzip compressed) into UniProt
+ * entries
+ *
+ * The file is read in large blocks cut at record ("//") boundaries. A batch
+ * of blocks (one per thread) is parsed in parallel, then entries are handed
+ * to the caller in file order. Lines are tokenized in place within the
+ * block, only the fields kept in an entry are copied out.
+ *
+ * GO terms are resolved through the EnTAP database on the calling thread
+ * as entries are handed over, as GO lookups are not thread safe.
+ */
+class UniprotDatParser {
+
+public:
+    typedef std::function<bool(UniprotEntry&)> add_entry_t;
+
+    UniprotDatParser(EntapDatabase *database, int threads);
+    ~UniprotDatParser() = default;
+    bool parse(const std::string &dat_path, const add_entry_t &add_entry);
+
+private:
+    // Whole records parsed by one thread
+    struct DatChunk {
+        std::string               data;
+        std::vector<UniprotEntry> entries;
+        vect_str_t                go_lists;     // Comma delim GO IDs of each entry, resolved by caller
+    };
+
+    static const uint64 CHUNK_BYTES = 1 << 23;    // Records are read in blocks of at least this
+    static const uint64 TAG_LEN     = 2;          // Length of line tags
+    static const uint64 DATA_POS    = 5;          // Position data starts
+
+    bool read_chunk(std::istream &in_file, DatChunk &chunk, std::string &carry);
+    void parse_chunk(DatChunk &chunk);
+
+    EntapDatabase *_pEntapDatabase;
+    int            _threads;
+};
+
+
+#endif //ENTAP_UNIPROTDATPARSER_H
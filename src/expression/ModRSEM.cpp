@@ -204,8 +204,7 @@ void ModRSEM::parse() {
     std::ofstream removed_file(out_removed, std::ios::out | std::ios::app);
 
     // Begin to iterate through RSEM output file
-    io::CSVReader<RSEM_COL_NUM, io::trim_chars<' '>,
-    io::no_quote_escape<'\t'>> in(_rsem_out);
+    TsvReader in(_rsem_out, ERR_ENTAP_RUN_RSEM_EXPRESSION_PARSE);
     in.next_line();
     while (in.read_row(geneid, transid, in_len, e_leng, e_count, tpm, fpkm_val)) {
         count_total++;
@@ -31,7 +31,7 @@
 
 //*********************** Includes *****************************
 #include "AbstractExpression.h"
-#include <csv.h>
+#include "../TsvReader.h"
 #include "../ExceptionHandler.h"
 #include "../GraphingManager.h"
 #include "../FileSystem.h"
@@ -78,7 +78,6 @@ private:
 
     const unsigned char GRAPH_EXPRESSION_FLAG = 2;
     const unsigned char GRAPH_BOX_FLAG        = 1;
-    static constexpr int RSEM_COL_NUM = 7;
 
     std::string _filename;
     std::string _rsem_out;
@@ -29,7 +29,7 @@
 
 
 #include <boost/archive/binary_iarchive.hpp>
-#include <csv.h>
+#include "../TsvReader.h"
 #include "ModEggnog.h"
 #include "../ExceptionHandler.h"
 #include "../FileSystem.h"
@@ -113,7 +113,7 @@ void ModEggnog::parse() {
 
     ss<<std::fixed<<std::setprecision(2);
 
-    if (!EGGNOG_DATABASE.open(_eggnog_db_path))
+    if (!EGGNOG_DATABASE.open(_eggnog_db_path, true))
         throw ExceptionHandler("Unable to open EggNOG database",ERR_ENTAP_PARSE_EGGNOG);
 
     path = _out_hits;
@@ -130,7 +130,7 @@ void ModEggnog::parse() {
     // Begin to read through TSV file
     std::string qseqid, seed_ortho, seed_e, seed_score, predicted_gene, go_terms, kegg, tax_scope, ogs,
             best_og, cog_cat, eggnog_annot;
-    io::CSVReader<EGGNOG_COL_NUM, io::trim_chars<' '>, io::no_quote_escape<'\t'>> in(path);
+    TsvReader in(path, ERR_ENTAP_PARSE_EGGNOG);
     while (in.read_row(qseqid, seed_ortho, seed_e, seed_score, predicted_gene, go_terms, kegg, tax_scope, ogs,
                        best_og, cog_cat, eggnog_annot)) {
         // Check if the query matches one of our original transcriptome sequences
@@ -493,19 +493,18 @@ void ModEggnog::get_tax_scope(std::string &raw_scope,
 void ModEggnog::get_sql_data(QuerySequence::EggnogResults &eggnogResults, SQLDatabaseHelper &database) {
     // Lookup description, KEGG, protein domain from SQL database
     if (!eggnogResults.og_key.empty()) {
-        std::vector<std::vector<std::string>>results;
         std::string sql_kegg;
         std::string sql_desc;
         std::string sql_protein;
 
-        char *query = sqlite3_mprintf(
-                "SELECT description, KEGG_freq, SMART_freq FROM og WHERE og=%Q",
-                eggnogResults.og_key.c_str());
         try {
-            results = database.query(query);
-            sql_desc = results[0][0];
-            sql_kegg = results[0][1];
-            sql_protein = results[0][2];
+            SQLDatabaseHelper::Statement statement = database.prepare(
+                    "SELECT description, KEGG_freq, SMART_freq FROM og WHERE og=?");
+            statement.bind(1, eggnogResults.og_key);
+            if (!statement.step()) return;
+            sql_desc = statement.get_string(0);
+            sql_kegg = statement.get_string(1);
+            sql_protein = statement.get_string(2);
             if (!sql_desc.empty() && sql_desc.find("[]") != 0) eggnogResults.description = sql_desc;
             if (!sql_kegg.empty() && sql_kegg.find("[]") != 0) {
                 eggnogResults.sql_kegg = format_sql_data(sql_kegg);
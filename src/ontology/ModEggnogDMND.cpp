@@ -29,6 +29,7 @@
 #include "../database/EggnogDatabase.h"
 #include "../TerminalCommands.h"
 #include "../QueryAlignment.h"
+#include "../TsvReader.h"
 
 const std::vector<ENTAP_HEADERS> ModEggnogDMND::DEFAULT_HEADERS = {
     ENTAP_HEADER_ONT_EGG_SEED_ORTHO,
@@ -80,6 +81,7 @@ void ModEggnogDMND::execute() {
     std::string                        std_out;
     std::string                        cmd;
     std::string                        blast;
+    std::string                        compressed_path;
     TerminalData                       terminalData;
 
     FS_dprint("Running EggNOG against Diamond database...");
@@ -109,6 +111,7 @@ void ModEggnogDMND::execute() {
             " -p "                 + std::to_string(_threads) +
             " -f " + "6 qseqid sseqid pident length mismatch gapopen "
                     "qstart qend sstart send evalue bitscore qcovhsp stitle";
+    if (_output_compression == FileSystem::ENT_FILE_GZ) cmd += DMND_COMPRESS_FLAGS;
 
     terminalData.command        = cmd;
     terminalData.print_files    = true;
@@ -121,6 +124,13 @@ void ModEggnogDMND::execute() {
         throw ExceptionHandler("Error in running DIAMOND against EggNOG database at: " +
                                EGG_DMND_PATH + "\nDIAMOND Error:\n" + terminalData.err_stream, ERR_ENTAP_RUN_EGGNOG);
     }
+
+    // DIAMOND appends .gz to compressed outputs, keep the name EnTAP expects
+    compressed_path = _out_hits + FileSystem::EXT_GZ;
+    if (_pFileSystem->file_exists(compressed_path) && !_pFileSystem->rename_file(compressed_path, _out_hits)) {
+        throw ExceptionHandler("Unable to move DIAMOND output to: " + _out_hits, ERR_ENTAP_RUN_EGGNOG);
+    }
+    compress_output(_out_hits);
 }
 
 void ModEggnogDMND::parse() {
@@ -151,9 +161,9 @@ void ModEggnogDMND::parse() {
     QuerySequence::EggnogResults eggnogResults;
     QuerySequence *querySequence;
     // ----------------------------------------------------------------- //
-    // Begin using CSVReader lib to parse data
+    // Begin using TsvReader to parse data
     try {
-        io::CSVReader<DMND_COL_NUMBER, io::trim_chars<' '>, io::no_quote_escape<'\t'>> in(_out_hits);
+        TsvReader in(_out_hits, ERR_ENTAP_PARSE_EGGNOG_DMND);
         while (in.read_row(qseqid, sseqid, pident, length, mismatch, gapopen,
                            qstart, qend, sstart, send, evalue, bitscore, coverage,stitle)) {
             // Currently throwing away most DIAMOND results
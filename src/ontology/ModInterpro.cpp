@@ -27,7 +27,7 @@
 
 
 //*********************** Includes *****************************
-#include <csv.h>
+#include "../TsvReader.h"
 #include <iomanip>
 #include "ModInterpro.h"
 #include "../ExceptionHandler.h"
@@ -144,6 +144,7 @@ void ModInterpro::execute() {
                                ERR_ENTAP_RUN_INTERPRO);
     } else {
         _pFileSystem->delete_dir(temp_dir);
+        compress_output(_final_outpath);
     }
 }
 
@@ -375,7 +376,7 @@ std::map<std::string,ModInterpro::InterProData> ModInterpro::parse_tsv(void) {
 
     temp_file_path = format_interpro();
 
-    io::CSVReader<INTERPRO_COL_NUM, io::trim_chars<' '>, io::no_quote_escape<'\t'>> in(temp_file_path);
+    TsvReader in(temp_file_path, ERR_ENTAP_PARSE_INTERPRO);
     while (in.read_row(query, md5, length, database, database_id, database_desc,
                        start, stop, eval, status, date, interpro_id, interpro_desc,
                        go_terms, pathways)) {
@@ -426,7 +427,7 @@ std::map<std::string,ModInterpro::InterProData> ModInterpro::parse_tsv(void) {
 *                      - This will add in tabs to keep everything consistent
 *
 *
-* Notes                - None
+* Notes                - gzip/zstd compressed output is read transparently
 *
 * @return              - Path of temporary altered file
 *
@@ -440,9 +441,9 @@ std::string ModInterpro::format_interpro(void) {
 
     path_temp = _final_outpath + "_temp";
     _pFileSystem->delete_file(path_temp);
-    std::ifstream file_in(_final_outpath);
+    std::unique_ptr<std::istream> file_in = FileSystem::open_input(_final_outpath);
     std::ofstream file_temp(path_temp, std::ios::out | std::ios::app);
-    while(std::getline(file_in, line)) {
+    while(std::getline(*file_in, line)) {
         if (line.empty()) continue;
         file_temp << line;
         tab_ct = (uint16)std::count(line.begin(), line.end(), '\t');
@@ -452,8 +453,10 @@ std::string ModInterpro::format_interpro(void) {
         }
         file_temp << std::endl;
     }
-    file_in.close();
     file_temp.close();
+    if (!FileSystem::close_input(*file_in)) {
+        throw ExceptionHandler("Unable to read InterProScan file at: " + _final_outpath, ERR_ENTAP_PARSE_INTERPRO);
+    }
     return path_temp;
 }
 
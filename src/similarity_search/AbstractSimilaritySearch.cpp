@@ -26,7 +26,10 @@
 */
 
 #include <regex>
+#include <unistd.h>
 #include "AbstractSimilaritySearch.h"
+#include "../QueryData.h"
+#include "../QuerySequence.h"
 
 AbstractSimilaritySearch::AbstractSimilaritySearch(std::string &execution_stage_path, std::string &in_hits,
                                                    EntapDataPtrs &entap_data, std::string mod_name,
@@ -42,12 +45,40 @@ AbstractSimilaritySearch::AbstractSimilaritySearch(std::string &execution_stage_
     _e_val            = _pUserInput->get_user_input<fp64>(_pUserInput->INPUT_FLAG_E_VAL);
     _contaminants     = _pUserInput->get_contaminants();
     _uninformative_vect= _pUserInput->get_uninformative_vect();
+    _uninformative_matcher.compile(_uninformative_vect);
 
     _database_paths = databases;
 
+    // Query sharding, default will be a single shard (no sharding)
+    _shard_count = (uint16) _pUserInput->get_user_input<int>(_pUserInput->INPUT_FLAG_SIM_SHARDS);
+    if (_shard_count < 1) _shard_count = 1;
+    if (_pUserInput->has_input(_pUserInput->INPUT_FLAG_SIM_SHARD_IND)) {
+        _shard_index = _pUserInput->get_user_input<int>(_pUserInput->INPUT_FLAG_SIM_SHARD_IND);
+    } else {
+        _shard_index = SHARD_ALL;
+    }
+
+    // Time budget, queries are searched as priority ordered batches (shards). Unsearched
+    // sequences from an earlier budgeted run are finished without a limit unless one is given
+    _time_budget       = _pUserInput->get_user_input<fp32>(_pUserInput->INPUT_FLAG_TIME_BUDGET) * 60.0;
+    _shard_by_priority = _time_budget > 0 || _pFileSystem->file_exists(get_budget_unsearched_path());
+    if (_shard_by_priority) {
+        _shard_count = BUDGET_BATCHES;
+        _shard_index = SHARD_ALL;
+    }
+
+    // Hit cache shared between runs
+    if (_pUserInput->has_input(_pUserInput->INPUT_FLAG_SIM_CACHE)) {
+        std::string cache_dir = _pUserInput->get_user_input<std::string>(_pUserInput->INPUT_FLAG_SIM_CACHE);
+        _pSimSearchCache.reset(new SimSearchCache(_pFileSystem, cache_dir));
+    }
+
     // Get input species lineage information
     TaxEntry taxEntry = _pEntapDatabase->get_tax_entry(_input_species);
     _input_lineage    = taxEntry.lineage;
+    _input_ancestors  = _pEntapDatabase->get_tax_ancestors(_input_lineage);
+
+    init_contaminants();
 
     // set blast string to use for file naming
     _blastp ? _blast_type = BLASTP_STR : _blast_type = BLASTX_STR;
@@ -69,27 +100,308 @@ std::string AbstractSimilaritySearch::get_database_output_path(std::string &data
     return PATHS(_mod_out_dir,_blast_type + "_" + _transcript_shortname + "_" + get_database_shortname(database_name) + FileSystem::EXT_OUT);
 }
 
-std::pair<bool,std::string> AbstractSimilaritySearch::is_contaminant(std::string lineage, vect_str_t &contams) {
-    // species and tax database both lowercase
-    if (contams.empty()) return std::pair<bool,std::string>(false,"");
-    LOWERCASE(lineage);
-    for (auto const &contaminant:contams) {
-        if (lineage.find(contaminant) != std::string::npos){
-            return std::pair<bool,std::string>(true,contaminant);
+// Returns shards that should be searched during this invocation
+std::vector<uint16> AbstractSimilaritySearch::get_run_shards() {
+    std::vector<uint16> shards;
+
+    if (_shard_index != SHARD_ALL) {
+        shards.push_back((uint16) _shard_index);
+    } else {
+        for (uint16 i = 0; i < _shard_count; i++) shards.push_back(i);
+    }
+    return shards;
+}
+
+std::string AbstractSimilaritySearch::get_budget_unsearched_path() {
+    return PATHS(_mod_out_dir, BUDGET_UNSEARCHED);
+}
+
+// Shard count and split type are part of the name, so shards from a run with a different
+// split are never reused (ex: _shard2_of8)
+std::string AbstractSimilaritySearch::get_shard_tag(uint16 shard) {
+    return (_shard_by_priority ? BATCH_TAG : SHARD_TAG) + std::to_string(shard) +
+           SHARD_COUNT_TAG + std::to_string(_shard_count);
+}
+
+std::string AbstractSimilaritySearch::get_shard_query_path(uint16 shard) {
+    return PATHS(PATHS(_mod_out_dir, SHARD_DIRECTORY),
+                 _transcript_shortname + get_shard_tag(shard) + SHARD_QUERY_EXT);
+}
+
+std::string AbstractSimilaritySearch::get_shard_output_path(std::string &database_path, uint16 shard) {
+    std::string output_path = get_database_output_path(database_path);
+    return PATHS(PATHS(_mod_out_dir, SHARD_DIRECTORY),
+                 _pFileSystem->get_filename(output_path, false) + get_shard_tag(shard) + FileSystem::EXT_OUT);
+}
+
+// Shard outputs are only written (renamed) once the search has completed, may be empty
+uint16 AbstractSimilaritySearch::get_completed_shards(std::string &database_path) {
+    uint16 completed = 0;
+
+    for (uint16 i = 0; i < _shard_count; i++) {
+        if (_pFileSystem->file_exists(get_shard_output_path(database_path, i))) completed++;
+    }
+    return completed;
+}
+
+
+/**
+ * ======================================================================
+ * Function void AbstractSimilaritySearch::write_query_shards(std::set<uint16> &shards)
+ *
+ * Description          - Splits input transcriptome into _shard_count
+ *                        length-balanced shards and writes the requested ones
+ *                      - With a time budget, shards are instead contiguous
+ *                        batches of equal length in priority order, FPKM
+ *                        when expression analysis was run, otherwise
+ *                        sequence length
+ *                      - Sequences are assigned longest first to the shard
+ *                        with the least total length so far
+ *
+ * Notes                - Assignment only depends on the input, so separate
+ *                        invocations agree on shard contents
+ *                      - Shards that already exist are not rewritten
+ *
+ * @param shards        - Shard indices to write
+ *
+ * @return              - None
+ *
+ * =====================================================================
+ */
+void AbstractSimilaritySearch::write_query_shards(std::set<uint16> &shards) {
+    typedef std::pair<uint64, uint16> shard_load_t;    // Total length, shard index
+
+    std::string                 line;
+    std::string                 shard_dir;
+    std::string                 temp_path;
+    std::string                 final_path;
+    std::vector<uint64>         seq_lengths;
+    std::vector<fp32>           seq_fpkms;
+    uint64                      total_length=0;
+    uint64                      batch_length=0;
+    bool                        use_fpkm;
+    std::vector<uint64>         seq_order;
+    std::vector<uint16>         seq_shard;
+    std::ofstream              *out_file = nullptr;
+    std::map<uint16, std::ofstream*> shard_files;
+    std::priority_queue<shard_load_t, std::vector<shard_load_t>, std::greater<shard_load_t>> shard_loads;
+    int64                       seq_ind;
+
+    // Remove shards that have already been written
+    for (auto it = shards.begin(); it != shards.end();) {
+        if (_pFileSystem->file_exists(get_shard_query_path(*it))) {
+            it = shards.erase(it);
+        } else ++it;
+    }
+    if (shards.empty()) return;
+
+    FS_dprint("Splitting transcriptome into " + std::to_string(_shard_count) + " shards...");
+    shard_dir = PATHS(_mod_out_dir, SHARD_DIRECTORY);
+    _pFileSystem->create_dir(shard_dir);
+
+    // Get length (and expression) of each sequence
+    use_fpkm = _pUserInput->has_input(_pUserInput->INPUT_FLAG_ALIGN);
+    std::ifstream in_file(_in_hits);
+    while (std::getline(in_file, line)) {
+        if (line.empty()) continue;
+        if (line[0] == FileSystem::FASTA_FLAG) {
+            seq_lengths.push_back(0);
+            if (_shard_by_priority && use_fpkm) {
+                std::string query_id;
+                _pQUERY_DATA->trim_sequence_header(query_id, line);
+                QuerySequence *query = _pQUERY_DATA->get_sequence(query_id);
+                seq_fpkms.push_back(query != nullptr ? query->get_fpkm() : 0);
+            }
+        } else if (!seq_lengths.empty()) {
+            if (line.back() == '\r') line.pop_back();
+            seq_lengths.back() += line.size();
+            total_length += line.size();
+        }
+    }
+    in_file.close();
+
+    seq_order.resize(seq_lengths.size());
+    for (uint64 i = 0; i < seq_order.size(); i++) seq_order[i] = i;
+    seq_shard.resize(seq_lengths.size());
+    if (_shard_by_priority) {
+        // Highest priority first, each batch gets an equal share of the total length
+        std::stable_sort(seq_order.begin(), seq_order.end(), [&](uint64 a, uint64 b) {
+            if (use_fpkm && seq_fpkms[a] != seq_fpkms[b]) return seq_fpkms[a] > seq_fpkms[b];
+            return seq_lengths[a] > seq_lengths[b];
+        });
+        for (uint64 ind : seq_order) {
+            seq_shard[ind] = (uint16) std::min<uint64>(_shard_count - 1u,
+                    total_length > 0 ? batch_length * _shard_count / total_length : 0);
+            batch_length += seq_lengths[ind];
+        }
+    } else {
+        // Longest sequences first (stable so ties keep input order)
+        std::stable_sort(seq_order.begin(), seq_order.end(), [&seq_lengths](uint64 a, uint64 b) {
+            return seq_lengths[a] > seq_lengths[b];
+        });
+        for (uint16 i = 0; i < _shard_count; i++) shard_loads.push(shard_load_t(0, i));
+        for (uint64 ind : seq_order) {
+            shard_load_t lightest = shard_loads.top();
+            shard_loads.pop();
+            seq_shard[ind] = lightest.second;
+            lightest.first += seq_lengths[ind];
+            shard_loads.push(lightest);
+        }
+    }
+
+    // Write requested shards
+    for (uint16 shard : shards) {
+        shard_files[shard] = new std::ofstream(get_shard_query_path(shard) + TEMP_EXT, std::ios::out | std::ios::trunc);
+    }
+    seq_ind = -1;
+    in_file.open(_in_hits);
+    while (std::getline(in_file, line)) {
+        if (line.empty()) continue;
+        if (line[0] == FileSystem::FASTA_FLAG) {
+            seq_ind++;
+            auto it = shard_files.find(seq_shard[seq_ind]);
+            out_file = it == shard_files.end() ? nullptr : it->second;
+        }
+        if (out_file != nullptr) *out_file << line << '\n';
+    }
+    in_file.close();
+
+    for (auto &pair : shard_files) {
+        pair.second->close();
+        delete pair.second;
+        temp_path  = get_shard_query_path(pair.first) + TEMP_EXT;
+        final_path = get_shard_query_path(pair.first);
+        if (!_pFileSystem->rename_file(temp_path, final_path)) {
+            throw ExceptionHandler("Unable to write query shard to: " + final_path, ERR_ENTAP_RUN_SIM_SEARCH_RUN);
+        }
+    }
+    FS_dprint("Success! Shards written to: " + shard_dir);
+}
+
+
+/**
+ * ======================================================================
+ * Function void AbstractSimilaritySearch::merge_shard_outputs(std::string &database_path)
+ *
+ * Description          - Concatenates completed shard outputs for a database
+ *                        into the normal database output file so it can
+ *                        be parsed as if unsharded
+ *
+ * Notes                - Every query is within a single shard, so hits for
+ *                        a query stay together
+ *
+ * @param database_path - Path to database searched against
+ * @param allow_missing - Merge only completed shards (time budget reached)
+ *
+ * @return              - None
+ *
+ * =====================================================================
+ */
+void AbstractSimilaritySearch::merge_shard_outputs(std::string &database_path, bool allow_missing) {
+    std::string output_path;
+    std::string temp_path;
+    std::string shard_path;
+
+    output_path = get_database_output_path(database_path);
+    temp_path   = output_path + "." + std::to_string(getpid()) + TEMP_EXT;   // Output dir may be shared
+    FS_dprint("Merging shards to: " + output_path);
+
+    std::ofstream out_file(temp_path, std::ios::out | std::ios::trunc | std::ios::binary);
+    for (uint16 i = 0; i < _shard_count; i++) {
+        shard_path = get_shard_output_path(database_path, i);
+        if (!_pFileSystem->file_exists(shard_path)) {
+            if (allow_missing) continue;
+            out_file.close();
+            _pFileSystem->delete_file(temp_path);
+            throw ExceptionHandler("Similarity search shard " + std::to_string(i) + " has not completed: " + shard_path,
+                                   ERR_ENTAP_RUN_SIM_SEARCH_RUN);
+        }
+        std::unique_ptr<std::istream> in_file = FileSystem::open_input(shard_path);
+        if (in_file->peek() != std::istream::traits_type::eof()) out_file << in_file->rdbuf();
+        if (!FileSystem::close_input(*in_file)) {
+            out_file.close();
+            _pFileSystem->delete_file(temp_path);
+            throw ExceptionHandler("Unable to read similarity search shard: " + shard_path,
+                                   ERR_ENTAP_RUN_SIM_SEARCH_RUN);
+        }
+    }
+    out_file.close();
+    if (!out_file.good()) {
+        // Do not replace output with a partial merge (disk full)
+        _pFileSystem->delete_file(temp_path);
+        throw ExceptionHandler("Unable to write merged similarity search shards to: " + temp_path,
+                               ERR_ENTAP_RUN_SIM_SEARCH_RUN);
+    }
+
+    if (!_pFileSystem->rename_file(temp_path, output_path)) {
+        _pFileSystem->delete_file(temp_path);
+        throw ExceptionHandler("Unable to merge similarity search shards to: " + output_path,
+                               ERR_ENTAP_RUN_SIM_SEARCH_RUN);
+    }
+    compress_output(output_path);
+}
+
+/**
+ * ======================================================================
+ * Function void AbstractSimilaritySearch::init_contaminants()
+ *
+ * Description          - Resolves user contaminants to taxon IDs so hits
+ *                        can be checked by ancestor membership
+ *
+ * Notes                - Contaminants that are not an exact taxonomy name
+ *                        fall back to a (case-insensitive) substring
+ *                        search of the lineage
+ *
+ * @return              - None
+ *
+ * =====================================================================
+ */
+void AbstractSimilaritySearch::init_contaminants() {
+    vect_str_t unresolved;
+    std::string contam_name;
+    TaxEntry taxEntry;
+
+    for (const std::string &contaminant : _contaminants) {
+        if (contaminant.empty()) continue;
+        contam_name = contaminant;
+        taxEntry = _pEntapDatabase->get_tax_entry(contam_name);
+        // get_tax_entry broadens the name if not found, only accept exact matches
+        if (!taxEntry.is_empty() && taxEntry.tax_name == contam_name) {
+            // First lineage level is the scientific name of the taxon itself
+            const EntapDatabase::tax_ancestors_t &ancestors = _pEntapDatabase->get_tax_ancestors(taxEntry.lineage);
+            if (!ancestors.empty()) {
+                FS_dprint("Contaminant " + contaminant + " resolved to taxon in database");
+                _contaminant_ids.emplace_back(ancestors.front(), contaminant);
+                continue;
+            }
         }
+        FS_dprint("Contaminant " + contaminant + " not found in taxonomy, matching lineage text");
+        unresolved.push_back(contaminant);
     }
-    return std::pair<bool,std::string>(false,"");
+    _contaminant_matcher.compile(unresolved);
 }
 
-bool AbstractSimilaritySearch::is_informative(std::string title, vect_str_t &uninformative_vect) {
-    LOWERCASE(title);
-    for (std::string &item : uninformative_vect) { // Already lowercase
-        if (title.find(item) != std::string::npos) return false;
+// Contaminant/uninformative checks are case-insensitive, single pass over the string
+std::pair<bool,std::string> AbstractSimilaritySearch::is_contaminant(const std::string &lineage,
+                                                                     const EntapDatabase::tax_ancestors_t &ancestors) const {
+    int32 match;
+
+    for (const std::pair<uint32, std::string> &contaminant : _contaminant_ids) {
+        for (const uint32 &taxon : ancestors) {
+            if (taxon == contaminant.first) return std::pair<bool,std::string>(true, contaminant.second);
+        }
     }
-    return true;
+
+    match = _contaminant_matcher.search(lineage);
+    if (match == PatternMatcher::NO_MATCH) return std::pair<bool,std::string>(false,"");
+    return std::pair<bool,std::string>(true, _contaminant_matcher.get_pattern(match));
+}
+
+bool AbstractSimilaritySearch::is_informative(const std::string &title) const {
+    return !_uninformative_matcher.contains_any(title);
 }
 
-std::string AbstractSimilaritySearch::get_species(std::string &title) {
+std::string AbstractSimilaritySearch::get_species(const std::string &title) {
     // TODO fix issue
 
     std::string species="";
@@ -146,6 +458,7 @@ std::string AbstractSimilaritySearch::get_species(std::string &title) {
 #endif
 
     // Double bracket fix
+    if (species.empty()) return species;
     if (species[0] == '[') species = species.substr(1);
     if (species[species.length()-1] == ']') species = species.substr(0,species.length()-1);
 
@@ -161,4 +474,67 @@ bool AbstractSimilaritySearch::is_uniprot_entry(std::string &sseqid, UniprotEntr
     accession = sseqid.substr(sseqid.rfind('|',sseqid.length())+1);     // Q9FJZ9
     entry = _pEntapDatabase->get_uniprot_entry(accession);
     return !entry.is_empty();
-}
\ No newline at end of file
+}
+
+
+// Query ID (header up to first whitespace, as reported by search) to sequence hash
+/**
+ * ======================================================================
+ * Function uint64 AbstractSimilaritySearch::write_query_subset(std::string &in_fasta,
+ *                                     std::string &out_fasta,
+ *                                     const std::unordered_set<std::string> &exclude)
+ *
+ * Description          - Copies query sequences to a new FASTA file, leaving
+ *                        out any with an ID in the exclude set
+ *
+ * Notes                - IDs are taken up to the first whitespace as DIAMOND
+ *                        reports them
+ *
+ * @param in_fasta      - Query FASTA file
+ * @param out_fasta     - Output FASTA file (overwritten)
+ * @param exclude       - Query IDs to leave out
+ *
+ * @return              - Number of sequences written
+ *
+ * =====================================================================
+ */
+uint64 AbstractSimilaritySearch::write_query_subset(std::string &in_fasta, std::string &out_fasta,
+                                                   const std::unordered_set<std::string> &exclude) {
+    std::string line;
+    uint64      count=0;
+    bool        write_seq=false;
+
+    std::ifstream in_file(in_fasta);
+    std::ofstream out_file(out_fasta, std::ios::out | std::ios::trunc);
+    while (std::getline(in_file, line)) {
+        if (line.empty()) continue;
+        if (line[0] == FileSystem::FASTA_FLAG) {
+            write_seq = exclude.find(line.substr(1, line.find_first_of(" \t\r", 1) - 1)) == exclude.end();
+            if (write_seq) count++;
+        }
+        if (write_seq) out_file << line << '\n';
+    }
+    out_file.close();
+    if (!out_file) {
+        throw ExceptionHandler("Unable to write query sequences to: " + out_fasta, ERR_ENTAP_RUN_SIM_SEARCH_RUN);
+    }
+    return count;
+}
+
+void AbstractSimilaritySearch::read_query_hashes(std::string &fasta_path,
+                                                 std::unordered_map<std::string, uint64> &query_hashes) {
+    std::string line;
+    uint64     *hash = nullptr;
+
+    std::ifstream in_file(fasta_path);
+    while (std::getline(in_file, line)) {
+        if (line.empty()) continue;
+        if (line[0] == FileSystem::FASTA_FLAG) {
+            std::string query_id = line.substr(1, line.find_first_of(" \t\r", 1) - 1);
+            hash = &query_hashes[query_id];
+            *hash = SimSearchCache::hash_sequence("");
+        } else if (hash != nullptr) {
+            *hash = SimSearchCache::hash_sequence(line, *hash);
+        }
+    }
+}
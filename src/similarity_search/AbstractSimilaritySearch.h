@@ -30,6 +30,8 @@
 
 
 #include "../EntapModule.h"
+#include "../PatternMatcher.h"
+#include "SimSearchCache.h"
 
 class AbstractSimilaritySearch : public EntapModule{
 
@@ -43,13 +45,14 @@ public:
         std::string         std_out_path;
 
         bool                blastp;
-        bool                more_sensitive;
+        std::string         sensitivity;    // DIAMOND mode (fast, sensitive, more-sensitive)
 
         uint16              threads;
         fp64                eval;
         fp32                qcoverage;      // query coverage
         fp32                tcoverage;      // target coverage
         uint16              top_num;        // default = 3
+        uint32              max_target_seqs; // used instead of --top when set (merged databases)
         uint16              output_flags;    // currently unused
     };
 
@@ -65,6 +68,7 @@ public:
     virtual void parse() = 0;
 
     virtual bool run_blast(SimSearchCmd *cmd, bool use_defaults) = 0;
+    static std::string get_species(const std::string &title);
 
 protected:
 
@@ -72,25 +76,55 @@ protected:
     vect_str_t                      _uninformative_vect;
     vect_str_t                      _contaminants;
     vect_str_t                      _output_paths;
+    std::vector<std::pair<uint32, std::string>> _contaminant_ids; // Contaminants found in tax database
+    PatternMatcher                  _contaminant_matcher;   // Contaminants not found in tax database
+    PatternMatcher                  _uninformative_matcher; // Compiled from _uninformative_vect
     std::map<std::string, std::string> _path_to_database;      // mapping of full database file path to shortened name
     std::string                     _input_lineage;
+    EntapDatabase::tax_ancestors_t  _input_ancestors;
     std::string                     _input_species;
     std::string                     _blast_type;            // string to signify blast type
     fp64                            _e_val;
     fp32                            _qcoverage;
     fp32                            _tcoverage;
+    uint16                          _shard_count;           // Number of query shards (1 = no sharding)
+    int32                           _shard_index;           // Shard to run this invocation (SHARD_ALL for every shard)
+    bool                            _shard_by_priority;     // Shards are priority ordered batches (time budget)
+    fp64                            _time_budget;           // Seconds for searching, 0 for no limit
+    std::unique_ptr<SimSearchCache> _pSimSearchCache;       // Cross-run hit cache, nullptr if unused
 
     const std::string BLASTX_STR           = "blastx";
     const std::string BLASTP_STR           = "blastp";
     const uint8       UNIPROT_ATTEMPTS     = 15;   // Number of attempts to see if database is uniprot
     const std::string NCBI_REGEX          = "\\[(.+)\\](?!.+\\[.+\\])";
     const std::string UNIPROT_REGEX       = "OS=(.+?)\\s\\S\\S=";
-
+    static constexpr int32 SHARD_ALL      = -1;
+    const std::string SHARD_DIRECTORY     = "shards";
+    const std::string SHARD_TAG           = "_shard";
+    const std::string BATCH_TAG           = "_batch";   // Shards split in priority order (time budget)
+    const std::string SHARD_COUNT_TAG     = "_of";
+    const std::string SHARD_QUERY_EXT     = ".fasta";
+    const std::string TEMP_EXT            = ".tmp";   // Files are renamed from this once complete
+    const uint16      BUDGET_BATCHES      = 20;       // Priority batches searched under a time budget
+    const std::string BUDGET_UNSEARCHED   = "budget_unsearched.fasta";
+
+    void init_contaminants();
     std::string get_database_shortname(std::string &full_path);
     std::string get_database_output_path(std::string &database_name);
-    std::pair<bool, std::string> is_contaminant(std::string lineage, vect_str_t &contams);
-    bool is_informative(std::string title, vect_str_t &uninformative_vect);
-    std::string get_species(std::string &title);
+    std::vector<uint16> get_run_shards();
+    std::string get_shard_tag(uint16 shard);
+    std::string get_shard_query_path(uint16 shard);
+    std::string get_shard_output_path(std::string &database_path, uint16 shard);
+    uint16 get_completed_shards(std::string &database_path);
+    void write_query_shards(std::set<uint16> &shards);
+    void merge_shard_outputs(std::string &database_path, bool allow_missing=false);
+    std::string get_budget_unsearched_path();
+    void read_query_hashes(std::string &fasta_path, std::unordered_map<std::string, uint64> &query_hashes);
+    uint64 write_query_subset(std::string &in_fasta, std::string &out_fasta,
+                              const std::unordered_set<std::string> &exclude);
+    std::pair<bool, std::string> is_contaminant(const std::string &lineage,
+                                                const EntapDatabase::tax_ancestors_t &ancestors) const;
+    bool is_informative(const std::string &title) const;
     bool is_uniprot_entry(std::string &sseqid, UniprotEntry &entry);
 };
 
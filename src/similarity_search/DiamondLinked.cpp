@@ -0,0 +1,156 @@
+/*
+ *
+ * Developed by Alexander Hart
+ * Plant Computational Genomics Lab
+ * University of Connecticut
+ *
+ * For information, contact Alexander Hart at:
+ *     entap.dev@gmail.com
+ *
+ * Copyright 2017-2019, Alexander Hart, Dr. Jill Wegrzyn
+ *
+ * This file is part of EnTAP.
+ *
+ * EnTAP is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * EnTAP is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with EnTAP.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+//*********************** Includes *****************************
+#include <mutex>
+#include "DiamondLinked.h"
+#include "../../libs/diamond-0.9.9/src/basic/config.h"
+#include "../../libs/diamond-0.9.9/src/output/output_format.h"
+#include "../../libs/diamond-0.9.9/src/util/simd.h"
+//**************************************************************
+
+void master_thread_di();    // DIAMOND blastp/blastx entry (run/double_indexed.cpp)
+
+namespace {
+
+    // Collects the hits of one query and hands them to EnTAP once the query is finished
+    struct EntapHitFormat : public Output_format {
+
+        EntapHitFormat(const dmnd_hit_callback_t *callback, std::mutex *callback_mutex) :
+            Output_format(blast_tab),
+            callback_(callback),
+            callback_mutex_(callback_mutex)
+        {}
+
+        virtual void print_match(const Hsp_context &r, Text_buffer &out) {
+            DiamondHit hit;
+
+            hit.qseqid   = to_string(r.query_name, Const::id_delimiters);
+            hit.sseqid   = to_string(r.subject_name, Const::id_delimiters);
+            hit.stitle   = to_string(r.subject_name, "\1");
+            hit.pident   = to_string((double)r.identities() * 100 / r.length());
+            hit.length   = to_string(r.length());
+            hit.mismatch = to_string(r.mismatches());
+            hit.gapopen  = to_string(r.gap_openings());
+            hit.qstart   = to_string(r.oriented_query_range().begin_ + 1);
+            hit.qend     = to_string(r.oriented_query_range().end_ + 1);
+            hit.sstart   = to_string(r.subject_range().begin_ + 1);
+            hit.send     = to_string(r.subject_range().end_);
+            hit.bitscore = to_string(r.bit_score());
+            hit.evalue   = r.evalue();
+            hit.coverage = (double)r.query_source_range().length() * 100.0 / r.source_query.length();
+            hits_.push_back(std::move(hit));
+        }
+
+        virtual void print_query_epilog(Text_buffer &out, const char *query_title, bool unaligned) const {
+            if (hits_.empty()) return;
+            {
+                std::lock_guard<std::mutex> lock(*callback_mutex_);
+                (*callback_)(hits_);
+            }
+            hits_.clear();
+        }
+
+        virtual Output_format* clone() const {
+            return new EntapHitFormat(callback_, callback_mutex_);
+        }
+
+    private:
+        // Formatted as DIAMOND writes tabular output
+        template<typename T>
+        static std::string to_string(T value) {
+            Text_buffer buf;
+            buf << value;
+            return std::string(buf.get_begin(), buf.size());
+        }
+
+        static std::string to_string(const char *title, const char *delimiters) {
+            Text_buffer buf;
+            buf.write_until(title, delimiters);
+            return std::string(buf.get_begin(), buf.size());
+        }
+
+        const dmnd_hit_callback_t       *callback_;
+        std::mutex                      *callback_mutex_;
+        mutable std::vector<DiamondHit>  hits_;
+    };
+}
+
+/**
+ * ======================================================================
+ * Function int DMND_run_linked(const vect_str_t &args,
+ *                              const dmnd_hit_callback_t &callback,
+ *                              std::string &err_msg)
+ *
+ * Description          - Runs a blastp/blastx search with the DIAMOND
+ *                        sources linked into EnTAP instead of a child
+ *                        process
+ *                      - Hits are handed to callback as they are aligned,
+ *                        nothing is written to the DIAMOND output file
+ *
+ * Notes                - Called with every hit of a query at once, queries
+ *                        arrive in any order. Calls are serialized
+ *                      - DIAMOND keeps its settings globally, so searches
+ *                        cannot run concurrently
+ *
+ * @param args          - DIAMOND command line without the executable
+ *                        (starting with blastp/blastx)
+ * @param callback      - Receives hits for each query
+ * @param err_msg       - DIAMOND error if the search failed
+ *
+ * @return              - 0 on success
+ *
+ * =====================================================================
+ */
+int DMND_run_linked(const vect_str_t &args, const dmnd_hit_callback_t &callback, std::string &err_msg) {
+    static std::mutex            run_mutex;
+    std::mutex                   callback_mutex;
+    std::vector<const char*>     argv;
+
+    std::lock_guard<std::mutex> lock(run_mutex);
+    err_msg.clear();
+
+    argv.push_back("diamond");
+    for (const std::string &arg : args) {
+        argv.push_back(arg.c_str());
+    }
+
+    try {
+        check_simd();
+        config     = Config((int)argv.size(), argv.data());
+        linked_output_format = auto_ptr<Output_format>(new EntapHitFormat(&callback, &callback_mutex));
+        master_thread_di();
+    } catch (const std::bad_alloc &e) {
+        err_msg = "Failed to allocate sufficient memory";
+    } catch (const std::exception &e) {
+        err_msg = e.what();
+    }
+    linked_output_format.reset();
+    output_format.reset();
+    return err_msg.empty() ? 0 : 1;
+}
@@ -0,0 +1,59 @@
+/*
+ *
+ * Developed by Alexander Hart
+ * Plant Computational Genomics Lab
+ * University of Connecticut
+ *
+ * For information, contact Alexander Hart at:
+ *     entap.dev@gmail.com
+ *
+ * Copyright 2017-2019, Alexander Hart, Dr. Jill Wegrzyn
+ *
+ * This file is part of EnTAP.
+ *
+ * EnTAP is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * EnTAP is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with EnTAP.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef ENTAP_DIAMONDLINKED_H
+#define ENTAP_DIAMONDLINKED_H
+
+//*********************** Includes *****************************
+#include "../common.h"
+#include <functional>
+//**************************************************************
+
+// Alignment reported by linked DIAMOND, columns match ModDiamond output format
+struct DiamondHit {
+    std::string qseqid;
+    std::string sseqid;
+    std::string pident;
+    std::string length;
+    std::string mismatch;
+    std::string gapopen;
+    std::string qstart;
+    std::string qend;
+    std::string sstart;
+    std::string send;
+    std::string bitscore;
+    std::string stitle;
+    fp64        evalue;
+    fp64        coverage;
+};
+
+typedef std::function<void(std::vector<DiamondHit>&)> dmnd_hit_callback_t;   // Every hit for a single query
+
+int DMND_run_linked(const vect_str_t &args, const dmnd_hit_callback_t &callback, std::string &err_msg);
+
+
+#endif //ENTAP_DIAMONDLINKED_H
@@ -25,10 +25,11 @@
  * along with EnTAP.  If not, see <http://www.gnu.org/licenses/>.
 */
 
-#include <csv.h>
 #include "ModDiamond.h"
 #include "../QuerySequence.h"
 #include "../QueryAlignment.h"
+#include "SmithWaterman.h"
+#include <chrono>
 
 #ifdef USE_BOOST
 #include <boost/regex.hpp>
@@ -36,6 +37,12 @@
 #include <regex>
 #endif
 
+const vect_str_t ModDiamond::SENSITIVITY_MODES = {"fast", "sensitive", "more-sensitive"};
+const std::string ModDiamond::MERGED_DATABASE_NAME = "entap_merged";
+const std::string ModDiamond::MERGED_MANIFEST_EXT  = ".tags";
+const std::string ModDiamond::MERGED_TAG_PREFIX    = "entapdb";
+const char        ModDiamond::MERGED_TAG_DELIM     = '|';
+
 std::vector<ENTAP_HEADERS> ModDiamond::DEFAULT_HEADERS = {
         ENTAP_HEADER_QUERY,
         ENTAP_HEADER_FRAME,
@@ -71,6 +78,12 @@ ModDiamond::ModDiamond(std::string &execution_stage_path, std::string &in_hits,
     FS_dprint("Spawn Object - ModDiamond");
 
     _software_flag = SIM_DIAMOND;
+
+    std::string sensitivity = _pUserInput->get_user_input<std::string>(_pUserInput->INPUT_FLAG_SIM_SENSITIVITY);
+    _sensitivity_modes = _pFileSystem->list_to_vect(',', sensitivity);
+    if (_sensitivity_modes.empty()) _sensitivity_modes.push_back(SENSITIVITY_MODES.back());
+    _db_cascade = _pUserInput->has_input(_pUserInput->INPUT_FLAG_SIM_DB_CASCADE);
+    _memory_budget = _pUserInput->get_user_input<fp32>(_pUserInput->INPUT_FLAG_SIM_MEMORY);
 }
 
 EntapModule::ModVerifyData ModDiamond::verify_files() {
@@ -94,8 +107,35 @@ EntapModule::ModVerifyData ModDiamond::verify_files() {
 
         // add mapping of output file to shortened database name
         _path_to_database[out_path] = database_name;
+        _subject_databases[out_path] = data_path;
+
+        // Merged database, results are split back to each database it was built from
+        vect_str_t merged_names;
+        std::ifstream manifest(data_path + MERGED_MANIFEST_EXT);
+        for (std::string line; std::getline(manifest, line);) {
+            if (line.empty()) continue;
+            merged_names.push_back(line.substr(line.find('\t') + 1));
+        }
+        if (!merged_names.empty()) {
+            FS_dprint("Database is a merge of " + std::to_string(merged_names.size()) + " databases");
+            vect_str_t &database_outputs = _merged_outputs[out_path];
+            for (std::string &merged_name : merged_names) {
+                database_outputs.push_back(PATHS(_mod_out_dir, _blast_type + "_" + _transcript_shortname + "_" +
+                                                               merged_name + FileSystem::EXT_OUT));
+                _path_to_database[database_outputs.back()] = merged_name;
+                // Each merged database is also indexed on its own beside the merged database
+                _subject_databases[database_outputs.back()] =
+                        PATHS(data_path.substr(0, data_path.find_last_of('/') + 1), merged_name + FileSystem::EXT_DMND);
+            }
+        }
 
         // Check if file exists/can be read/empty
+        // Earlier budgeted run stopped early, its partial output is finished this run
+        if (_shard_by_priority && _pFileSystem->file_exists(get_budget_unsearched_path())) {
+            FS_dprint("Time budget previously reached, resuming search for: " + database_name);
+            _pFileSystem->delete_file(out_path);
+        }
+
         file_status = _pFileSystem->get_file_status(out_path);
         if (file_status != 0) {
             FS_dprint("File for database " + database_name + " does not exist.\n" + out_path);
@@ -103,12 +143,20 @@ EntapModule::ModVerifyData ModDiamond::verify_files() {
             verify_data.files_exist = false;
             // delete file just in case it is corrupt/empty
             _pFileSystem->delete_file(out_path);
+            if (_shard_count > 1) {
+                FS_dprint("Shards completed for database " + database_name + ": " +
+                          std::to_string(get_completed_shards(data_path)) + "/" + std::to_string(_shard_count));
+            }
         } else {
             // File found + is 'legit', can skip execution for it
             FS_dprint("File for database " + database_name + " exists, skipping...\n" + out_path);
         }
         verify_data.output_paths.push_back(out_path);
-        _output_paths.push_back(out_path);
+        if (_merged_outputs.count(out_path)) {
+            _output_paths.insert(_output_paths.end(), _merged_outputs[out_path].begin(), _merged_outputs[out_path].end());
+        } else {
+            _output_paths.push_back(out_path);
+        }
     }
 
     FS_dprint("Success! Verified files for DIAMOND, continuing...");
@@ -128,70 +176,777 @@ bool ModDiamond::is_executable(std::string &exe) {
     return TC_execute_cmd(terminalData) == 0;
 }
 
+bool ModDiamond::is_valid_sensitivity(const vect_str_t &modes) {
+    if (modes.empty()) return false;
+    for (const std::string &mode : modes) {
+        if (std::find(SENSITIVITY_MODES.begin(), SENSITIVITY_MODES.end(), mode) == SENSITIVITY_MODES.end()) {
+            return false;
+        }
+    }
+    return true;
+}
+
 void ModDiamond::execute() {
     std::string output_path;
+    std::string query_path;
     uint16 file_status = 0;
+    uint64 remaining = 1;
     SimSearchCmd simSearchCmd;
+    std::unordered_set<std::string> accepted_queries;
 
     FS_dprint("Executing DIAMOND for necessary files....");
 
-    for (std::string &database_path : _database_paths) {
+    if (_shard_by_priority) {
+        execute_budgeted();
+        return;
+    }
+    if (_shard_count > 1) {
+        execute_shards();
+        return;
+    }
+
+    query_path = _in_hits;
+    for (uint16 i = 0; i < _database_paths.size(); i++) {
+        std::string &database_path = _database_paths[i];
         output_path = get_database_output_path(database_path);
 
         file_status = _pFileSystem->get_file_status(output_path);
-        if (file_status != 0) {
+        if (file_status != 0 && remaining == 0) {
+            // Database cascade, every query already annotated
+            FS_dprint("No queries left to search against: " + database_path);
+            std::ofstream empty_file(output_path, std::ios::out | std::ios::trunc);
+        } else if (file_status != 0) {
             // If file does not exist or cannot be read, execute diamond
             FS_dprint("File not found, executing against database at: " + database_path);
 
-            simSearchCmd = {};
-            simSearchCmd.database_path = database_path;
+            init_search_cmd(simSearchCmd, database_path, output_path);
             simSearchCmd.output_path   = output_path;
             simSearchCmd.std_out_path  = output_path + FileSystem::EXT_STD;
-            simSearchCmd.threads       = (uint16)_threads;
-            simSearchCmd.query_path    = _in_hits;
-            simSearchCmd.eval          = _e_val;
-            simSearchCmd.tcoverage     = _tcoverage;
-            simSearchCmd.qcoverage     = _qcoverage;
-            simSearchCmd.exe_path      = _exe_path;
-            simSearchCmd.blastp        = _blastp;
+            simSearchCmd.query_path    = query_path;
 
             try {
-                run_blast(&simSearchCmd, true);
+                if (_pSimSearchCache) {
+                    execute_cached(simSearchCmd);
+                } else {
+                    run_search(simSearchCmd);
+                }
             } catch (const ExceptionHandler &e ){
                 throw e;
             }
+            compress_output(output_path);
 
             FS_dprint("Success! Results written to: " + output_path);
         }
+
+        // Only queries without an accepted hit go on to the next database
+        if (_db_cascade && i + 1u < _database_paths.size() && remaining > 0) {
+            read_accepted_queries(output_path, accepted_queries);
+            query_path = get_database_output_path(_database_paths[i + 1]) + DB_CASCADE_QUERY_EXT;
+            remaining  = write_query_subset(_in_hits, query_path, accepted_queries);
+            FS_dprint("Queries annotated so far: " + std::to_string(accepted_queries.size()) +
+                      ", remaining for next database: " + std::to_string(remaining));
+        }
+    }
+}
+
+std::string ModDiamond::get_merged_tag(uint16 index) {
+    return MERGED_TAG_PREFIX + std::to_string(index) + MERGED_TAG_DELIM;
+}
+
+// Settings shared by every search against a database, paths are set by the caller
+void ModDiamond::init_search_cmd(SimSearchCmd &cmd, std::string &database_path, std::string &output_path) {
+    cmd = {};
+    cmd.database_path   = database_path;
+    cmd.threads         = (uint16)_threads;
+    cmd.eval            = _e_val;
+    cmd.tcoverage       = _tcoverage;
+    cmd.qcoverage       = _qcoverage;
+    cmd.exe_path        = _exe_path;
+    cmd.blastp          = _blastp;
+    cmd.max_target_seqs = get_max_target_seqs(output_path);
+}
+
+uint32 ModDiamond::get_max_target_seqs(std::string &output_path) {
+    auto it = _merged_outputs.find(output_path);
+    if (it == _merged_outputs.end()) return 0;      // Normal database, use --top
+    return MERGED_TARGETS_PER_DB * (uint32) it->second.size();
+}
+
+/**
+ * ======================================================================
+ * Function void ModDiamond::split_merged_output(std::string &merged_output,
+ *                                               vect_str_t &database_outputs)
+ *
+ * Description          - Routes every hit from a merged database search to
+ *                        the output of the database it came from, using
+ *                        the tag on the subject ID
+ *                      - Tags are removed so outputs match a search against
+ *                        the database on its own
+ *
+ * Notes                - Database outputs are overwritten each time
+ *
+ * @param merged_output - DIAMOND output of the merged database
+ * @param database_outputs - Outputs for each database, indexed by tag
+ *
+ * @return              - None
+ *
+ * =====================================================================
+ */
+void ModDiamond::split_merged_output(std::string &merged_output, vect_str_t &database_outputs) {
+    std::string line;
+    std::string tag;
+    uint64      sseqid_pos;
+    uint64      stitle_pos;
+    uint64      tag_end;
+    uint64      index;
+    std::vector<std::unique_ptr<std::ofstream>> out_files;
+
+    FS_dprint("Splitting merged DIAMOND output: " + merged_output);
+    for (std::string &path : database_outputs) {
+        out_files.emplace_back(new std::ofstream(path, std::ios::out | std::ios::trunc));
+    }
+
+    std::unique_ptr<std::istream> in_file = FileSystem::open_input(merged_output);
+    while (std::getline(*in_file, line)) {
+        if (line.empty()) continue;
+        sseqid_pos = line.find('\t') + 1;
+        tag_end    = line.find(MERGED_TAG_DELIM, sseqid_pos);
+        if (sseqid_pos == 0 || line.compare(sseqid_pos, MERGED_TAG_PREFIX.size(), MERGED_TAG_PREFIX) != 0 ||
+            tag_end == std::string::npos ||
+            !TsvReader::parse_uint64(line.data() + sseqid_pos + MERGED_TAG_PREFIX.size(), line.data() + tag_end, index) ||
+            index >= out_files.size()) {
+            throw ExceptionHandler("Unrecognized subject in merged DIAMOND output: " + merged_output + "\n" + line,
+                                   ERR_ENTAP_RUN_SIM_SEARCH_FILTER);
+        }
+        tag = line.substr(sseqid_pos, tag_end + 1 - sseqid_pos);
+
+        // Title also begins with the tagged subject ID
+        stitle_pos = line.rfind('\t') + 1;
+        if (stitle_pos > sseqid_pos && line.compare(stitle_pos, tag.size(), tag) == 0) {
+            line.erase(stitle_pos, tag.size());
+        }
+        line.erase(sseqid_pos, tag.size());
+        *out_files[index] << line << '\n';
+    }
+
+    if (!FileSystem::close_input(*in_file)) {
+        throw ExceptionHandler("Unable to read merged DIAMOND output: " + merged_output,
+                               ERR_ENTAP_RUN_SIM_SEARCH_FILTER);
+    }
+    for (std::unique_ptr<std::ofstream> &out_file : out_files) {
+        out_file->close();
+        if (!*out_file) {
+            throw ExceptionHandler("Unable to write split DIAMOND output from: " + merged_output,
+                                   ERR_ENTAP_RUN_SIM_SEARCH_FILTER);
+        }
+    }
+    for (std::string &path : database_outputs) compress_output(path);
+}
+
+/**
+ * ======================================================================
+ * Function void ModDiamond::read_accepted_queries(std::string &output_path,
+ *                                  std::unordered_set<std::string> &accepted)
+ *
+ * Description          - Finds queries in a DIAMOND output with at least one
+ *                        informative, non-contaminant hit for the database
+ *                        cascade
+ *
+ * Notes                - Uses the same contaminant and informative checks
+ *                        as parsing
+ *
+ * @param output_path   - DIAMOND output
+ * @param accepted      - Queries with an accepted hit are added here
+ *
+ * @return              - None
+ *
+ * =====================================================================
+ */
+void ModDiamond::read_accepted_queries(std::string &output_path, std::unordered_set<std::string> &accepted) {
+    std::string         qseqid;
+    std::string         stitle;
+    std::string         species;
+    TsvReader::Field    unused;
+    TaxEntry            taxEntry;
+
+    TsvReader in(output_path, ERR_ENTAP_RUN_SIM_SEARCH_RUN);
+    while (in.read_row(qseqid, unused, unused, unused, unused, unused, unused,
+                       unused, unused, unused, unused, unused, unused, stitle)) {
+        if (accepted.find(qseqid) != accepted.end()) continue;
+        if (!is_informative(stitle)) continue;
+        species  = get_species(stitle);
+        taxEntry = _pEntapDatabase->get_tax_entry(species);
+        if (!is_contaminant(taxEntry.lineage, _pEntapDatabase->get_tax_ancestors(taxEntry.lineage)).first) {
+            accepted.insert(qseqid);
+        }
+    }
+}
+
+/**
+ * ======================================================================
+ * Function void ModDiamond::execute_shards()
+ *
+ * Description          - Runs DIAMOND for every query shard (or only the
+ *                        user selected shard) that has not completed
+ *                      - Once all shards for a database are complete they
+ *                        are merged to the normal output path
+ *
+ * Notes                - Shard outputs are written to a temporary file and
+ *                        renamed on success so a failed shard will simply
+ *                        be re-run
+ *
+ * @return              - None
+ *
+ * =====================================================================
+ */
+void ModDiamond::execute_shards() {
+    std::string         output_path;
+    std::string         shard_output;
+    std::string         temp_output;
+    std::string         shard_query;
+    std::vector<uint16> run_shards;
+    std::set<uint16>    query_shards;
+    SimSearchCmd        simSearchCmd;
+
+    run_shards = get_run_shards();
+
+    // Find which query shards are needed
+    for (std::string &database_path : _database_paths) {
+        output_path = get_database_output_path(database_path);
+        if (_pFileSystem->get_file_status(output_path) == 0) continue;
+        for (uint16 shard : run_shards) {
+            if (!_pFileSystem->file_exists(get_shard_output_path(database_path, shard))) {
+                query_shards.insert(shard);
+            }
+        }
+    }
+    write_query_shards(query_shards);
+
+    for (std::string &database_path : _database_paths) {
+        output_path = get_database_output_path(database_path);
+        if (_pFileSystem->get_file_status(output_path) == 0) continue;
+
+        for (uint16 shard : run_shards) {
+            shard_output = get_shard_output_path(database_path, shard);
+            if (_pFileSystem->file_exists(shard_output)) {
+                FS_dprint("Shard " + std::to_string(shard) + " complete, skipping: " + shard_output);
+                continue;
+            }
+            shard_query = get_shard_query_path(shard);
+            temp_output = shard_output + TEMP_EXT;
+
+            if (_pFileSystem->file_empty(shard_query)) {
+                // More shards than sequences, nothing to search
+                std::ofstream empty_file(temp_output, std::ios::out | std::ios::trunc);
+                empty_file.close();
+            } else {
+                FS_dprint("Executing shard " + std::to_string(shard) + " against database at: " + database_path);
+                init_search_cmd(simSearchCmd, database_path, output_path);
+                simSearchCmd.output_path   = temp_output;
+                simSearchCmd.std_out_path  = shard_output + FileSystem::EXT_STD;
+                simSearchCmd.query_path    = shard_query;
+
+                run_search(simSearchCmd);
+            }
+            if (!_pFileSystem->rename_file(temp_output, shard_output)) {
+                throw ExceptionHandler("Unable to finalize DIAMOND shard output: " + shard_output,
+                                       ERR_ENTAP_RUN_SIM_SEARCH_RUN);
+            }
+            FS_dprint("Success! Shard results written to: " + shard_output);
+        }
+
+        // Only merge once every shard has been searched
+        if (get_completed_shards(database_path) == _shard_count) {
+            merge_shard_outputs(database_path);
+            if (_pSimSearchCache) {
+                init_search_cmd(simSearchCmd, database_path, output_path);
+                cache_add_output(simSearchCmd, output_path);
+            }
+        } else {
+            FS_dprint("Not all shards complete for database, will merge later: " + database_path);
+        }
+    }
+}
+
+/**
+ * ======================================================================
+ * Function void ModDiamond::execute_budgeted()
+ *
+ * Description          - Searches queries in priority ordered batches (highest
+ *                        FPKM, or longest without expression analysis, first)
+ *                        until the time budget is nearly used
+ *                      - Time for each batch is estimated from the rate of the
+ *                        batches already searched, a batch is not launched if
+ *                        it would not finish within the budget
+ *                      - Completed batches are merged to the normal output
+ *                        path, sequences in remaining batches are recorded so
+ *                        a later run finishes them
+ *
+ * Notes                - Batches are shards, so completed batches are kept
+ *                        and skipped by the later run
+ *                      - The first batch is always searched
+ *
+ * @return              - None
+ *
+ * =====================================================================
+ */
+void ModDiamond::execute_budgeted() {
+    std::string         output_path;
+    std::string         shard_output;
+    std::string         temp_output;
+    std::string         shard_query;
+    std::set<uint16>    query_shards;
+    std::vector<uint16> unsearched;
+    vect_str_t          batch_databases;    // Databases this batch still needs searching against
+    SimSearchCmd        simSearchCmd;
+    fp64                elapsed;
+    fp64                search_time=0;
+    fp64                searched_size=0;    // Query bytes searched, times databases
+    fp64                batch_size;
+    bool                budget_reached=false;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    if (_time_budget > 0) {
+        FS_dprint("Time budget for similarity searching: " + float_to_string(_time_budget / 60) + " minutes");
+    }
+
+    for (std::string &database_path : _database_paths) {
+        output_path = get_database_output_path(database_path);
+        if (_pFileSystem->get_file_status(output_path) == 0) continue;
+        for (uint16 i = 0; i < _shard_count; i++) query_shards.insert(i);
+    }
+    write_query_shards(query_shards);
+
+    for (uint16 batch = 0; batch < _shard_count; batch++) {
+        batch_databases.clear();
+        for (std::string &database_path : _database_paths) {
+            output_path = get_database_output_path(database_path);
+            if (_pFileSystem->get_file_status(output_path) == 0) continue;
+            if (!_pFileSystem->file_exists(get_shard_output_path(database_path, batch))) {
+                batch_databases.push_back(database_path);
+            }
+        }
+        if (batch_databases.empty()) continue;
+
+        shard_query = get_shard_query_path(batch);
+        std::ifstream query_file(shard_query, std::ios::binary | std::ios::ate);
+        batch_size = query_file ? (fp64) query_file.tellg() * batch_databases.size() : 0;
+        query_file.close();
+
+        // Stop launching batches once the next one is not expected to finish in time
+        if (!budget_reached && _time_budget > 0 && searched_size > 0) {
+            elapsed = std::chrono::duration<fp64>(std::chrono::steady_clock::now() - start).count();
+            if (elapsed >= _time_budget * BUDGET_STOP_FRACTION ||
+                elapsed + search_time / searched_size * batch_size > _time_budget) {
+                FS_dprint("Time budget reached after " + float_to_string(elapsed / 60) +
+                          " minutes, batch " + std::to_string(batch) + " and later will not be searched");
+                budget_reached = true;
+            }
+        }
+        if (budget_reached) {
+            unsearched.push_back(batch);
+            continue;
+        }
+
+        std::chrono::steady_clock::time_point batch_start = std::chrono::steady_clock::now();
+        for (std::string &database_path : batch_databases) {
+            output_path  = get_database_output_path(database_path);
+            shard_output = get_shard_output_path(database_path, batch);
+            temp_output  = shard_output + TEMP_EXT;
+
+            if (_pFileSystem->file_empty(shard_query)) {
+                // More batches than sequences, nothing to search
+                std::ofstream empty_file(temp_output, std::ios::out | std::ios::trunc);
+                empty_file.close();
+            } else {
+                FS_dprint("Executing batch " + std::to_string(batch) + " against database at: " + database_path);
+                init_search_cmd(simSearchCmd, database_path, output_path);
+                simSearchCmd.output_path   = temp_output;
+                simSearchCmd.std_out_path  = shard_output + FileSystem::EXT_STD;
+                simSearchCmd.query_path    = shard_query;
+
+                run_search(simSearchCmd);
+            }
+            if (!_pFileSystem->rename_file(temp_output, shard_output)) {
+                throw ExceptionHandler("Unable to finalize DIAMOND batch output: " + shard_output,
+                                       ERR_ENTAP_RUN_SIM_SEARCH_RUN);
+            }
+        }
+        search_time   += std::chrono::duration<fp64>(std::chrono::steady_clock::now() - batch_start).count();
+        searched_size += batch_size;
+    }
+
+    // Completed batches are merged even if the budget was reached so they can be parsed
+    for (std::string &database_path : _database_paths) {
+        output_path = get_database_output_path(database_path);
+        if (_pFileSystem->get_file_status(output_path) == 0) continue;
+        merge_shard_outputs(database_path, !unsearched.empty());
+        if (_pSimSearchCache && unsearched.empty()) {
+            init_search_cmd(simSearchCmd, database_path, output_path);
+            cache_add_output(simSearchCmd, output_path);
+        }
+    }
+    write_budget_unsearched(unsearched);
+}
+
+/**
+ * ======================================================================
+ * Function void ModDiamond::write_budget_unsearched(std::vector<uint16> &batches)
+ *
+ * Description          - Records the sequences of batches that were not
+ *                        searched within the time budget so the next run
+ *                        finishes them, and flags them so they are not
+ *                        reported as having no hits
+ *                      - Record is removed once every batch is complete
+ *
+ * Notes                - None
+ *
+ * @param batches       - Batches left unsearched
+ *
+ * @return              - None
+ *
+ * =====================================================================
+ */
+void ModDiamond::write_budget_unsearched(std::vector<uint16> &batches) {
+    std::string         record_path;
+    std::string         shard_query;
+    std::string         line;
+    std::string         query_id;
+    std::stringstream   out_msg;
+    std::string         out_msg_str;
+    QuerySequence      *query;
+    uint64              count_unsearched=0;
+
+    record_path = get_budget_unsearched_path();
+    if (batches.empty()) {
+        if (_pFileSystem->file_exists(record_path)) {
+            FS_dprint("Every batch searched, removing: " + record_path);
+            _pFileSystem->delete_file(record_path);
+        }
+        return;
+    }
+
+    std::ofstream record_file(record_path, std::ios::out | std::ios::trunc);
+    for (uint16 batch : batches) {
+        shard_query = get_shard_query_path(batch);
+        std::ifstream in_file(shard_query);
+        while (std::getline(in_file, line)) {
+            if (line.empty()) continue;
+            if (line[0] == FileSystem::FASTA_FLAG) {
+                _pQUERY_DATA->trim_sequence_header(query_id, line);
+                query = _pQUERY_DATA->get_sequence(query_id);
+                if (query != nullptr) query->QUERY_FLAG_SET(QuerySequence::QUERY_BUDGET_SKIPPED);
+                count_unsearched++;
+            }
+            record_file << line << '\n';
+        }
+    }
+    record_file.close();
+    if (!record_file) {
+        throw ExceptionHandler("Unable to write unsearched sequences to: " + record_path,
+                               ERR_ENTAP_RUN_SIM_SEARCH_RUN);
+    }
+
+    _pFileSystem->format_stat_stream(out_msg, "Similarity Search Time Budget");
+    out_msg <<
+            "Time budget reached before every sequence was searched" <<
+            "\nBatches searched: "    << _shard_count - batches.size() << "/" << _shard_count <<
+            "\nSequences not searched: " << count_unsearched <<
+            "\nUnsearched sequences written to: " << record_path <<
+            "\nRun again with the same output directory to search them";
+    out_msg_str = out_msg.str();
+    _pFileSystem->print_stats(out_msg_str);
+}
+
+/**
+ * ======================================================================
+ * Function void ModDiamond::execute_cached(SimSearchCmd &cmd)
+ *
+ * Description          - Runs DIAMOND only for queries that are not in the
+ *                        cross-run hit cache, then writes the cached hits
+ *                        and new hits to the normal output path
+ *                      - Newly searched queries are added to the cache
+ *
+ * Notes                - Queries are matched to the cache by sequence, so
+ *                        renamed sequences will still be found
+ *
+ * @param cmd           - Search command as it would be ran without caching
+ *
+ * @return              - None
+ *
+ * =====================================================================
+ */
+void ModDiamond::execute_cached(SimSearchCmd &cmd) {
+    std::string     params;
+    std::string     line;
+    std::string     final_output;
+    std::string     uncached_query;
+    std::string     search_output;
+    std::string     temp_output;
+    std::set<uint64> searched;
+    std::unordered_map<std::string, uint64> query_hashes;
+    SimSearchCache::hash_queries_t cached_queries;
+    SimSearchCmd    uncached_cmd;
+    uint64          cached_hits;
+    bool            write_seq=false;
+
+    params = get_cache_parameters(cmd);
+    if (!_pSimSearchCache->open(cmd.database_path, params)) {
+        FS_dprint("Unable to open similarity search cache for: " + cmd.database_path + ", searching all queries");
+        run_search(cmd);
+        return;
+    }
+
+    final_output   = cmd.output_path;
+    uncached_query = final_output + CACHE_QUERY_EXT;
+    search_output  = final_output + CACHE_SEARCH_EXT;
+    temp_output    = final_output + TEMP_EXT;
+
+    // Split queries into cached and those that need to be searched
+    read_query_hashes(cmd.query_path, query_hashes);
+    for (auto &pair : query_hashes) {
+        if (_pSimSearchCache->is_cached(pair.second)) {
+            cached_queries[pair.second].push_back(pair.first);
+        } else {
+            searched.insert(pair.second);
+        }
+    }
+    FS_dprint("Queries found in cache: " + std::to_string(query_hashes.size() - searched.size()) + "/" +
+              std::to_string(query_hashes.size()));
+
+    if (!searched.empty()) {
+        std::ifstream in_file(cmd.query_path);
+        std::ofstream out_file(uncached_query, std::ios::out | std::ios::trunc);
+        while (std::getline(in_file, line)) {
+            if (line.empty()) continue;
+            if (line[0] == FileSystem::FASTA_FLAG) {
+                std::string query_id = line.substr(1, line.find_first_of(" \t\r", 1) - 1);
+                write_seq = !_pSimSearchCache->is_cached(query_hashes[query_id]);
+            }
+            if (write_seq) out_file << line << '\n';
+        }
+        in_file.close();
+        out_file.close();
+
+        uncached_cmd = cmd;
+        uncached_cmd.query_path  = uncached_query;
+        uncached_cmd.output_path = search_output;
+        run_search(uncached_cmd);
+    }
+
+    // Combine cached + new hits
+    std::ofstream out_file(temp_output, std::ios::out | std::ios::trunc);
+    cached_hits = _pSimSearchCache->write_cached_hits(out_file, cached_queries);
+    if (!searched.empty()) {
+        std::unique_ptr<std::istream> in_file = FileSystem::open_input(search_output);
+        if (in_file->peek() != std::istream::traits_type::eof()) out_file << in_file->rdbuf();
+        if (!FileSystem::close_input(*in_file)) {
+            throw ExceptionHandler("Unable to read DIAMOND output: " + search_output, ERR_ENTAP_RUN_SIM_SEARCH_RUN);
+        }
+    }
+    out_file.close();
+    FS_dprint("Hits used from cache: " + std::to_string(cached_hits));
+
+    if (!searched.empty()) {
+        _pSimSearchCache->add_results(search_output, query_hashes, searched);
+    }
+    if (!_pFileSystem->rename_file(temp_output, final_output)) {
+        throw ExceptionHandler("Unable to write DIAMOND output to: " + final_output, ERR_ENTAP_RUN_SIM_SEARCH_RUN);
+    }
+    _pFileSystem->delete_file(uncached_query);
+    _pFileSystem->delete_file(search_output);
+}
+
+// Adds every uncached query of an already complete output to the cache, cmd is the search
+// that produced it (cache key)
+void ModDiamond::cache_add_output(SimSearchCmd &cmd, std::string &output_path) {
+    std::string     params;
+    std::set<uint64> searched;
+    std::unordered_map<std::string, uint64> query_hashes;
+
+    params = get_cache_parameters(cmd);
+    if (!_pSimSearchCache->open(cmd.database_path, params)) return;
+
+    read_query_hashes(_in_hits, query_hashes);
+    for (auto &pair : query_hashes) {
+        if (!_pSimSearchCache->is_cached(pair.second)) searched.insert(pair.second);
+    }
+    _pSimSearchCache->add_results(output_path, query_hashes, searched);
+}
+
+// Every parameter that changes DIAMOND results must be part of this
+std::string ModDiamond::get_cache_parameters(SimSearchCmd &cmd) {
+    std::stringstream ss;
+    std::string       sensitivity;
+
+    // Same flags as a single pass, cascades list each mode
+    for (std::string &mode : _sensitivity_modes) {
+        if (!sensitivity.empty()) sensitivity += ",";
+        if (mode != SENSITIVITY_FAST) sensitivity += "--" + mode;
+    }
+
+    ss << (cmd.blastp ? BLASTP_STR : BLASTX_STR) << CACHE_PARAM_DELIM
+       << cmd.eval      << CACHE_PARAM_DELIM
+       << cmd.qcoverage << CACHE_PARAM_DELIM
+       << cmd.tcoverage << CACHE_PARAM_DELIM
+       << sensitivity << " " << (cmd.max_target_seqs > 0 ?
+                "--max-target-seqs " + std::to_string(cmd.max_target_seqs) : DMND_TOP_FLAGS) << CACHE_PARAM_DELIM
+       << DMND_OUTPUT_FORMAT;
+    return ss.str();
+}
+
+/**
+ * ======================================================================
+ * Function void ModDiamond::run_search(SimSearchCmd &cmd)
+ *
+ * Description          - Searches the queries in cmd with the sensitivity
+ *                        mode(s) selected by the user
+ *
+ * Notes                - A single mode is a normal DIAMOND run
+ *
+ * @param cmd           - Search command, sensitivity is set here
+ *
+ * @return              - None
+ *
+ * =====================================================================
+ */
+void ModDiamond::run_search(SimSearchCmd &cmd) {
+    if (_sensitivity_modes.size() > 1) {
+        run_sensitivity_cascade(cmd);
+    } else {
+        cmd.sensitivity = _sensitivity_modes.front();
+        run_blast(&cmd, true);
+    }
+}
+
+/**
+ * ======================================================================
+ * Function void ModDiamond::run_sensitivity_cascade(SimSearchCmd &cmd)
+ *
+ * Description          - Runs DIAMOND once per sensitivity mode, each pass
+ *                        only searching queries that did not hit in any
+ *                        earlier pass
+ *                      - Hits from every pass are combined into the output
+ *                        of cmd before best hit selection
+ *
+ * Notes                - DIAMOND only reports hits passing the e-value and
+ *                        coverage cutoffs, so any hit counts as found
+ *                      - Passes stop early once every query has a hit
+ *
+ * @param cmd           - Search command for all queries
+ *
+ * @return              - None
+ *
+ * =====================================================================
+ */
+void ModDiamond::run_sensitivity_cascade(SimSearchCmd &cmd) {
+    std::string     line;
+    std::string     pass_query;
+    std::string     temp_output;
+    std::unordered_set<std::string> hit_queries;
+    SimSearchCmd    pass_cmd;
+    uint64          remaining;
+
+    temp_output = cmd.output_path + TEMP_EXT;
+    std::ofstream out_file(temp_output, std::ios::out | std::ios::trunc);
+
+    pass_cmd = cmd;
+    for (uint16 pass = 0; pass < _sensitivity_modes.size(); pass++) {
+        pass_cmd.sensitivity  = _sensitivity_modes[pass];
+        pass_cmd.output_path  = cmd.output_path + CASCADE_TAG + std::to_string(pass) + CASCADE_OUTPUT_EXT;
+        pass_cmd.std_out_path = pass_cmd.output_path + FileSystem::EXT_STD;
+        FS_dprint("Running DIAMOND pass " + std::to_string(pass) + " (" + pass_cmd.sensitivity + ") with: " +
+                  pass_cmd.query_path);
+        run_blast(&pass_cmd, true);
+
+        // Keep hits and note which queries no longer need to be searched
+        std::unique_ptr<std::istream> in_file = FileSystem::open_input(pass_cmd.output_path);
+        while (std::getline(*in_file, line)) {
+            if (line.empty()) continue;
+            hit_queries.insert(line.substr(0, line.find('\t')));
+            out_file << line << '\n';
+        }
+        if (!FileSystem::close_input(*in_file)) {
+            throw ExceptionHandler("Unable to read DIAMOND output: " + pass_cmd.output_path,
+                                   ERR_ENTAP_RUN_SIM_SEARCH_RUN);
+        }
+        _pFileSystem->delete_file(pass_cmd.output_path);
+        if (pass > 0) _pFileSystem->delete_file(pass_cmd.query_path);
+
+        if (pass + 1u == _sensitivity_modes.size()) break;
+        pass_query = cmd.output_path + CASCADE_TAG + std::to_string(pass + 1) + CASCADE_QUERY_EXT;
+        remaining  = write_query_subset(pass_cmd.query_path, pass_query, hit_queries);
+        FS_dprint("Queries without a hit after pass " + std::to_string(pass) + ": " + std::to_string(remaining));
+        if (remaining == 0) {
+            _pFileSystem->delete_file(pass_query);
+            break;
+        }
+        pass_cmd.query_path = pass_query;
+    }
+    out_file.close();
+
+    if (!out_file || !_pFileSystem->rename_file(temp_output, cmd.output_path)) {
+        throw ExceptionHandler("Unable to write DIAMOND output to: " + cmd.output_path, ERR_ENTAP_RUN_SIM_SEARCH_RUN);
     }
 }
 
 bool ModDiamond::run_blast(AbstractSimilaritySearch::SimSearchCmd *cmd, bool use_defaults) {
+    std::string     diamond_args;
+    DiamondPlan     plan;
+#ifndef DIAMOND_LINKED
     std::string     diamond_cmd;
+    std::string     compressed_path;
     TerminalData    terminalData;
     int32           err_code;
+#endif
     bool            ret = true;
 
-    diamond_cmd = cmd->exe_path + " ";
+    if (_pFileSystem->get_file_extension(cmd->database_path, false) != FileSystem::EXT_DMND) {
+        // Small FASTA database (sim-sw-max), aligned without DIAMOND
+        run_smith_waterman(cmd);
+        return ret;
+    }
 
     if (cmd->blastp) {
-        diamond_cmd += BLASTP_STR;
+        diamond_args = BLASTP_STR;
     } else {
-        diamond_cmd += BLASTX_STR;
+        diamond_args = BLASTX_STR;
     }
 
-    diamond_cmd += " -d " + cmd->database_path;
-    diamond_cmd += " --query-cover " + std::to_string(cmd->qcoverage);
-    diamond_cmd += " --subject-cover " + std::to_string(cmd->tcoverage);
-    diamond_cmd += " --evalue " + std::to_string(cmd->eval);
+    diamond_args += " -d " + cmd->database_path;
+    diamond_args += " --query-cover " + std::to_string(cmd->qcoverage);
+    diamond_args += " --subject-cover " + std::to_string(cmd->tcoverage);
+    diamond_args += " --evalue " + std::to_string(cmd->eval);
 
-    diamond_cmd += " --more-sensitive --top 3";
+    if (!cmd->sensitivity.empty() && cmd->sensitivity != SENSITIVITY_FAST) {
+        diamond_args += " --" + cmd->sensitivity;
+    }
+    if (cmd->max_target_seqs > 0) {
+        diamond_args += " --max-target-seqs " + std::to_string(cmd->max_target_seqs);
+    } else {
+        diamond_args += " " + DMND_TOP_FLAGS;
+    }
+
+    diamond_args += " -q " + cmd->query_path;
+    diamond_args += " -p " + std::to_string(cmd->threads);
 
-    diamond_cmd += " -q " + cmd->query_path;
+    plan = plan_memory(cmd);
+    if (plan.index_chunks > 0) {
+        diamond_args += " --block-size " + float_to_string(plan.block_size);
+        diamond_args += " --index-chunks " + std::to_string(plan.index_chunks);
+    }
+
+#ifdef DIAMOND_LINKED
+    run_blast_linked(cmd, diamond_args);
+#else
+    diamond_cmd = cmd->exe_path + " " + diamond_args;
     diamond_cmd += " -o " + cmd->output_path;
-    diamond_cmd += " -p " + std::to_string(cmd->threads);
     diamond_cmd += " -f ";
-    diamond_cmd += "6 qseqid sseqid pident length mismatch gapopen qstart qend sstart send evalue bitscore qcovhsp stitle";
+    diamond_cmd += DMND_OUTPUT_FORMAT;
+    if (_output_compression == FileSystem::ENT_FILE_GZ) {
+        // DIAMOND writes gzip itself, saving a separate compression pass
+        diamond_cmd += " " + DMND_COMPRESS_FLAGS;
+    }
 
     terminalData.command        = diamond_cmd;
     terminalData.base_std_path  = cmd->std_out_path;
@@ -206,343 +961,1063 @@ bool ModDiamond::run_blast(AbstractSimilaritySearch::SimSearchCmd *cmd, bool use
         throw ExceptionHandler("Error with database located at: " + cmd->database_path + "\nDIAMOND Error: " +
             terminalData.err_stream, ERR_ENTAP_RUN_SIM_SEARCH_RUN);
     }
+    // DIAMOND appends .gz to compressed outputs, keep the name EnTAP expects
+    compressed_path = cmd->output_path + FileSystem::EXT_GZ;
+    if (_pFileSystem->file_exists(compressed_path) && !_pFileSystem->rename_file(compressed_path, cmd->output_path)) {
+        throw ExceptionHandler("Unable to move DIAMOND output to: " + cmd->output_path, ERR_ENTAP_RUN_SIM_SEARCH_RUN);
+    }
+#endif
 
     return ret;
 }
 
-void ModDiamond::parse() {
-    bool                is_uniprot;
-    uint32              uniprot_attempts=0;
-    uint16              file_status=0;
-    std::string         database_shortname;
-    std::string         species;
-    QuerySequence::SimSearchResults simSearchResults;
-    TaxEntry            taxEntry;
-    std::pair<bool, std::string> contam_info;
+/**
+ * ======================================================================
+ * Function ModDiamond::DiamondPlan ModDiamond::plan_memory(SimSearchCmd *cmd)
+ *
+ * Description          - Picks DIAMOND block size (-b) and index chunks (-c)
+ *                        so a search fits in the memory budget
+ *                      - Budget is --sim-memory or a fraction of available
+ *                        memory (cgroup limits included)
+ *                      - Each chunk count is tried with the largest block
+ *                        that fits, keeping the one needing the fewest
+ *                        query/reference block passes
+ *
+ * Notes                - DIAMOND memory is estimated as
+ *                        b * (PLAN_MEMORY_BASE_GB + PLAN_MEMORY_INDEX_GB / c)
+ *                        which gives DIAMOND's ~6b GB at the default c = 4
+ *
+ * @param cmd           - Search command
+ *
+ * @return              - Plan, index_chunks is 0 to use DIAMOND defaults
+ *
+ * =====================================================================
+ */
+ModDiamond::DiamondPlan ModDiamond::plan_memory(SimSearchCmd *cmd) {
+    DiamondPlan plan {0, 0};
+    fp64        budget;             // GB
+    fp64        usable;             // GB, minus fixed overhead
+    fp64        db_letters;         // Billions of letters
+    fp64        query_letters;      // Billions of letters
+    fp64        max_letters;
+    fp64        block_size;
+    fp64        cost;
+    fp64        best_cost=0;
+    std::ifstream query_file(cmd->query_path, std::ios::binary | std::ios::ate);
+
+    if (_memory_budget > 0) {
+        budget = _memory_budget;
+    } else {
+        budget = get_available_memory() * PLAN_MEMORY_FRACTION / 1e9;
+        if (budget <= 0) {
+            FS_dprint("Unable to detect available memory, using DIAMOND default block size");
+            return plan;
+        }
+    }
+    usable = budget - PLAN_OVERHEAD_GB;
+
+    db_letters    = get_database_letters(cmd->database_path);
+    query_letters = query_file ? (fp64) query_file.tellg() / 1e9 : 0;
+    if (!cmd->blastp) query_letters *= 2;  // Six frames of a third of the length
+    // No gain from blocks larger than either input
+    max_letters   = std::max(PLAN_MIN_BLOCK_SIZE, std::ceil(std::max(db_letters, query_letters) * 10) / 10);
+
+    for (uint16 chunks : PLAN_INDEX_CHUNKS) {
+        block_size = usable / (PLAN_MEMORY_BASE_GB + PLAN_MEMORY_INDEX_GB / chunks);
+        block_size = std::min(std::floor(block_size * 100) / 100, max_letters);
+        if (block_size < PLAN_MIN_BLOCK_SIZE) continue;
+        cost = std::max(1.0, std::ceil(db_letters / block_size)) *
+               std::max(1.0, std::ceil(query_letters / block_size)) *
+               (1 + PLAN_CHUNK_COST * (chunks - 1));
+        if (plan.index_chunks == 0 || cost < best_cost) {
+            plan.block_size   = block_size;
+            plan.index_chunks = chunks;
+            best_cost = cost;
+        }
+    }
+
+    if (plan.index_chunks == 0) {
+        // Nothing fits, smallest footprint DIAMOND can run with
+        plan.block_size   = PLAN_MIN_BLOCK_SIZE;
+        plan.index_chunks = PLAN_INDEX_CHUNKS.back();
+        FS_dprint("WARNING memory budget of " + float_to_string(budget) + "GB is below DIAMOND's minimum estimate");
+    }
+    FS_dprint("DIAMOND memory plan (budget " + float_to_string(budget) + "GB, database " +
+              float_to_string(db_letters) + "G letters, queries " + float_to_string(query_letters) +
+              "G letters): block size " + float_to_string(plan.block_size) +
+              ", index chunks " + std::to_string(plan.index_chunks));
+    return plan;
+}
+
+/**
+ * ======================================================================
+ * Function fp64 ModDiamond::get_database_letters(std::string &database_path)
+ *
+ * Description          - Reads the number of letters (residues) from a
+ *                        DIAMOND database header
+ *
+ * Notes                - Falls back to file size for unknown headers
+ *
+ * @param database_path - Path to DIAMOND database
+ *
+ * @return              - Letters in billions
+ *
+ * =====================================================================
+ */
+fp64 ModDiamond::get_database_letters(std::string &database_path) {
+    uint64        sequences;
+    uint64        letters=0;
+
+    if (!read_database_header(database_path, sequences, letters)) {
+        std::ifstream file(database_path, std::ios::binary | std::ios::ate);
+        letters = file ? (uint64) file.tellg() : 0;
+    }
+    return letters / 1e9;
+}
+
+bool ModDiamond::read_database_header(std::string &database_path, uint64 &sequences, uint64 &letters) {
+    std::ifstream file(database_path, std::ios::binary);
+    uint64        unique_id=0;
+    uint32        build;
+    uint32        db_version;
+
+    file.read((char*)&unique_id, sizeof(unique_id));
+    file.read((char*)&build, sizeof(build));
+    file.read((char*)&db_version, sizeof(db_version));
+    file.read((char*)&sequences, sizeof(sequences));
+    file.read((char*)&letters, sizeof(letters));
+    return file && unique_id == DMND_HEADER_ID;
+}
 
-    // ------------------ Read from DIAMOND output ---------------------- //
-    std::string qseqid, sseqid, stitle, database_name,pident, bitscore,
-            length, mismatch, gapopen, qstart, qend, sstart, send;
-    fp64  evalue, coverage;
+/**
+ * ======================================================================
+ * Function void ModDiamond::load_subject_index(DiamondOutput &output)
+ *
+ * Description          - Loads the subject index built during configuration
+ *                        for the database an output was searched against,
+ *                        so hits are not parsed from their titles
+ *
+ * Notes                - Output is parsed from titles as before if there is
+ *                        no index or it no longer matches the database
+ *
+ * @param output        - DIAMOND output to parse
+ *
+ * @return              - None
+ *
+ * =====================================================================
+ */
+void ModDiamond::load_subject_index(DiamondOutput &output) {
+    std::string index_path;
+    uint64      sequences=0;
+    uint64      letters;
+
+    auto it = _subject_databases.find(output.output_path);
+    if (it == _subject_databases.end()) return;
+    index_path = it->second + SubjectIndex::INDEX_EXT;
+    if (!_pFileSystem->file_exists(index_path)) {
+        FS_dprint("No subject index for " + it->second + ", parsing subject titles");
+        return;
+    }
+    if (!read_database_header(it->second, sequences, letters)) sequences = 0;
+    output.subject_index.reset(new SubjectIndex());
+    if (!output.subject_index->load(index_path, _uninformative_vect, sequences)) {
+        output.subject_index.reset();
+    }
+}
+
+/**
+ * ======================================================================
+ * Function uint64 ModDiamond::get_available_memory()
+ *
+ * Description          - Memory available to this process, the lowest of
+ *                        MemAvailable and the remaining cgroup (v1 or v2)
+ *                        memory limit
+ *
+ * Notes                - None
+ *
+ * @return              - Bytes, 0 if unknown
+ *
+ * =====================================================================
+ */
+uint64 ModDiamond::get_available_memory() {
+    uint64          available=0;
+    uint64          limit;
+    uint64          usage;
+    std::string     line;
+    std::string     cgroup_v1;
+    std::string     cgroup_v2;
+    std::ifstream   meminfo("/proc/meminfo");
+    std::ifstream   cgroup("/proc/self/cgroup");
+
+    while (std::getline(meminfo, line)) {
+        if (line.compare(0, 13, "MemAvailable:") == 0) {
+            // kB, unknown (DIAMOND defaults) if the format is unexpected
+            std::istringstream value(line.substr(13));
+            if (!(value >> available)) available = 0;
+            available *= 1024;
+            break;
+        }
+    }
+
+    // hierarchy-ID:controllers:path, v2 has an empty controller list
+    while (std::getline(cgroup, line)) {
+        if (line.compare(0, 3, "0::") == 0) {
+            cgroup_v2 = line.substr(3);
+        } else if (line.find(":memory:") != std::string::npos) {
+            cgroup_v1 = line.substr(line.find(":memory:") + 8);
+        }
+    }
+
+    std::vector<std::pair<std::string, std::string>> cgroup_files {
+            {PATHS("/sys/fs/cgroup" + cgroup_v2, "memory.max"), PATHS("/sys/fs/cgroup" + cgroup_v2, "memory.current")},
+            {"/sys/fs/cgroup/memory.max", "/sys/fs/cgroup/memory.current"},
+            {PATHS("/sys/fs/cgroup/memory" + cgroup_v1, "memory.limit_in_bytes"),
+             PATHS("/sys/fs/cgroup/memory" + cgroup_v1, "memory.usage_in_bytes")},
+            {"/sys/fs/cgroup/memory/memory.limit_in_bytes", "/sys/fs/cgroup/memory/memory.usage_in_bytes"}
+    };
+    for (auto &pair : cgroup_files) {
+        std::ifstream limit_file(pair.first);
+        std::ifstream usage_file(pair.second);
+        // "max" (v2) fails to parse, v1 reports a huge limit when unlimited
+        if (!(limit_file >> limit) || !(usage_file >> usage)) continue;
+        limit = limit > usage ? limit - usage : 0;
+        if (available == 0 || limit < available) available = limit;
+        break;
+    }
+    return available;
+}
+
+#ifdef DIAMOND_LINKED
+/**
+ * ======================================================================
+ * Function void ModDiamond::run_blast_linked(SimSearchCmd *cmd,
+ *                                            std::string &diamond_args)
+ *
+ * Description          - Runs the search with DIAMOND linked into EnTAP,
+ *                        hits are received directly instead of written by
+ *                        DIAMOND and parsed back
+ *
+ * Notes                - Only compiled in with LINK_DIAMOND
+ *
+ * @param cmd           - Search command
+ * @param diamond_args  - DIAMOND arguments (without output options)
+ *
+ * @return              - None
+ *
+ * =====================================================================
+ */
+void ModDiamond::run_blast_linked(SimSearchCmd *cmd, std::string &diamond_args) {
+    std::string             err_msg;
+    vect_str_t              args;
+    std::vector<DiamondHit> hits;
+    std::stringstream       ss(diamond_args);
+
+    for (std::string arg; ss >> arg;) {
+        args.push_back(arg);
+    }
+    args.push_back("--quiet");
+    args.push_back("-o");               // Nothing written, hits passed back and written by add_search_hits
+    args.push_back(cmd->output_path);
+
+    FS_dprint("Running linked DIAMOND: " + diamond_args);
+    if (DMND_run_linked(args, [&hits](std::vector<DiamondHit> &query_hits) {
+            std::move(query_hits.begin(), query_hits.end(), std::back_inserter(hits));
+        }, err_msg) != 0) {
+        _pFileSystem->delete_file(cmd->output_path);
+        throw ExceptionHandler("Error with database located at: " + cmd->database_path + "\nDIAMOND Error: " +
+                               err_msg, ERR_ENTAP_RUN_SIM_SEARCH_RUN);
+    }
+    FS_dprint("Linked DIAMOND complete, hits: " + std::to_string(hits.size()));
+    add_search_hits(cmd, hits);
+}
+#endif
+
+/**
+ * ======================================================================
+ * Function void ModDiamond::run_smith_waterman(SimSearchCmd *cmd)
+ *
+ * Description          - Searches a small FASTA database with the built-in
+ *                        Smith-Waterman aligner instead of DIAMOND, saving
+ *                        the DIAMOND start up and indexing
+ *
+ * Notes                - Sensitivity modes do not apply, every candidate
+ *                        is aligned in full
+ *
+ * @param cmd           - Search command
+ *
+ * @return              - None
+ *
+ * =====================================================================
+ */
+void ModDiamond::run_smith_waterman(SimSearchCmd *cmd) {
+    SmithWaterman::SearchParams params;
+    std::vector<DiamondHit>     hits;
+
+    FS_dprint("Running Smith-Waterman against database: " + cmd->database_path);
+    params.query_path   = cmd->query_path;
+    params.blastp       = cmd->blastp;
+    params.eval         = cmd->eval;
+    params.qcoverage    = cmd->qcoverage;
+    params.tcoverage    = cmd->tcoverage;
+    params.top_percent  = SW_TOP_PERCENT;
+    params.max_targets  = cmd->max_target_seqs;
+    params.threads      = cmd->threads;
+    try {
+        SmithWaterman smithWaterman(cmd->database_path);
+        smithWaterman.search(params, hits);
+    } catch (const ExceptionHandler &e) {
+        throw e;
+    } catch (const std::exception &e) {
+        throw ExceptionHandler("Error with database located at: " + cmd->database_path + "\n" + e.what(),
+                               ERR_ENTAP_RUN_SIM_SEARCH_RUN);
+    }
+    FS_dprint("Smith-Waterman complete, hits: " + std::to_string(hits.size()));
+    add_search_hits(cmd, hits);
+}
+
+/**
+ * ======================================================================
+ * Function void ModDiamond::add_search_hits(SimSearchCmd *cmd,
+ *                                           std::vector<DiamondHit> &hits)
+ *
+ * Description          - Stores hits from an in-process search (linked
+ *                        DIAMOND or Smith-Waterman)
+ *                      - Hits are always written to the search output in
+ *                        DIAMOND format, same as the executable, so later
+ *                        runs find the output and do not search again
+ *                      - Hits for a database output are also kept in memory
+ *                        for parse(). Searches that are merged, cached,
+ *                        split or used to pick queries for later searches
+ *                        are parsed back from the file
+ *
+ * Notes                - None
+ *
+ * @param cmd           - Search command the hits are from
+ * @param hits          - Hits found
+ *
+ * @return              - None
+ *
+ * =====================================================================
+ */
+void ModDiamond::add_search_hits(SimSearchCmd *cmd, std::vector<DiamondHit> &hits) {
+    write_hit_output(cmd->output_path, hits);
+    if (cmd->output_path == get_database_output_path(cmd->database_path) &&
+        !_db_cascade && !_merged_outputs.count(cmd->output_path)) {
+        _memory_hits[cmd->output_path] = std::move(hits);
+    }
+}
+
+void ModDiamond::write_hit_output(std::string &output_path, std::vector<DiamondHit> &hits) {
+    std::string temp_path = output_path + TEMP_EXT;     // Incomplete output is never picked up on resume
+    std::ofstream out_file(temp_path, std::ios::out | std::ios::trunc);
+    for (DiamondHit &hit : hits) {
+        out_file << hit.qseqid  << '\t' << hit.sseqid   << '\t' << hit.pident  << '\t' << hit.length << '\t' <<
+                    hit.mismatch << '\t' << hit.gapopen << '\t' << hit.qstart  << '\t' << hit.qend   << '\t' <<
+                    hit.sstart  << '\t' << hit.send     << '\t' << hit.evalue  << '\t' << hit.bitscore << '\t' <<
+                    hit.coverage << '\t' << hit.stitle  << '\n';
+    }
+    out_file.close();
+    if (!out_file || !_pFileSystem->rename_file(temp_path, output_path)) {
+        _pFileSystem->delete_file(temp_path);
+        throw ExceptionHandler("Unable to write DIAMOND output to: " + output_path, ERR_ENTAP_RUN_SIM_SEARCH_RUN);
+    }
+}
 
-    // ----------------------------------------------------------------- //
+/**
+ * ======================================================================
+ * Function void ModDiamond::parse()
+ *
+ * Description          - Parses every DIAMOND database output together,
+ *                        k-way merging them by query so that the database
+ *                        best hits, overall best hit and unselected hits
+ *                        are determined and written one query at a time
+ *                      - Only the best hits are kept in QueryData, so
+ *                        memory depends on the hits for the current query
+ *                        instead of every hit across every database
+ *
+ * Notes                - Outputs are expected in the order of the DIAMOND
+ *                        input transcriptome (as DIAMOND writes them). Any
+ *                        that are not (shard merges, cached hits, or older
+ *                        runs) are reordered before merging
+ *
+ * @return              - None
+ *
+ * =====================================================================
+ */
+void ModDiamond::parse() {
+    uint16              file_status=0;
+    uint32              query_order;
+    QuerySequence      *query;
+    SimSearchAlignment *best_hit;
+    query_order_t       query_orders;
+    BestHitStats        overall_stats;
+    std::vector<std::unique_ptr<DiamondOutput>> outputs;
+    std::vector<DiamondOutput*> query_outputs;      // Outputs with hits for the current query
+    std::set<std::string> split_outputs;            // Database outputs split from a merged database
+    QuerySequence::align_database_hits_t *alignment_data;
 
     FS_dprint("Beginning to filter individual DIAMOND files...");
 
     // disable UniProt headers until we know we have a hit
     _pQUERY_DATA->header_set_uniprot(false);
 
-    for (std::string &output_path : _output_paths) {
-        FS_dprint("DIAMOND file located at " + output_path + " being parsed");
+    read_query_order(query_orders);
 
-        // reset uniprot info for each database
-        is_uniprot = false;
-        uniprot_attempts = 0;
-        simSearchResults = {};
+    // Route hits from merged databases back to the databases they were built from
+    for (auto &pair : _merged_outputs) {
+        std::string merged_output = pair.first;
+        split_merged_output(merged_output, pair.second);
+        split_outputs.insert(pair.second.begin(), pair.second.end());
+    }
+
+    for (std::string &output_path : _output_paths) {
+        std::unique_ptr<DiamondOutput> output(new DiamondOutput());
+        output->output_path = output_path;
+        init_best_stats(output->stats, false, output_path);
+        load_subject_index(*output);
+
+        auto memory = _memory_hits.find(output_path);
+        if (memory != _memory_hits.end()) {
+            // Searched in-process, hits are already in memory
+            FS_dprint("DIAMOND hits for " + output_path + " being parsed from memory");
+            sort_memory_hits(memory->second, query_orders, output_path);
+            output->memory_hits = &memory->second;
+            read_output_row(*output, query_orders);
+            outputs.push_back(std::move(output));
+            continue;
+        }
 
         // ensure file exists
         file_status = _pFileSystem->get_file_status(output_path);
+        if (_db_cascade || split_outputs.count(output_path)) {
+            // Later databases may have had nothing left to search, or no hits in merged database
+            file_status &= (uint16) ~FileSystem::FILE_STATUS_EMPTY;
+        }
         if (file_status != 0) {
             throw ExceptionHandler("File not found or empty: " + output_path, ERR_ENTAP_RUN_SIM_SEARCH_FILTER);
         }
+        sort_output_by_query(output_path, query_orders);
 
-        // setup individual database directories for stats/figures
-        database_shortname = _path_to_database[output_path];
-
-        // Begin using CSVReader lib to parse data
-        io::CSVReader<DMND_COL_NUMBER, io::trim_chars<' '>, io::no_quote_escape<'\t'>> in(output_path);
-        while (in.read_row(qseqid, sseqid, pident, length, mismatch, gapopen,
-                           qstart, qend, sstart, send, evalue, bitscore, coverage,stitle)) {
-            simSearchResults = {};
+        FS_dprint("DIAMOND file located at " + output_path + " being parsed");
+        output->reader.reset(new TsvReader(output_path, ERR_ENTAP_RUN_SIM_SEARCH_FILTER));
+        read_output_row(*output, query_orders);
+        outputs.push_back(std::move(output));
+    }
+    init_best_stats(overall_stats, true);
 
-            // Get pointer to sequence in overall map
-            QuerySequence *query = _pQUERY_DATA->get_sequence(qseqid);
-            if (query == nullptr) {
-                throw ExceptionHandler("Unable to find sequence in transcriptome: " + qseqid + " from file: " + output_path,
-                                       ERR_ENTAP_RUN_SIM_SEARCH_FILTER);
+    try {
+        while (true) {
+            // Find the next query across every database
+            query_outputs.clear();
+            query_order = std::numeric_limits<uint32>::max();
+            for (std::unique_ptr<DiamondOutput> &output : outputs) {
+                if (!output->has_row) continue;
+                if (output->query_order < query_order) {
+                    query_order = output->query_order;
+                    query_outputs.clear();
+                }
+                if (output->query_order == query_order) query_outputs.push_back(output.get());
             }
+            if (query_outputs.empty()) break;   // All outputs have been parsed
 
-            // get species from database alignment (using boost regex for now)
-            species = get_species(stitle);
-            // get taxonomic information with species
-            taxEntry = _pEntapDatabase->get_tax_entry(species);
-            // get contaminant information
-            contam_info = is_contaminant(taxEntry.lineage, _contaminants);
+            // Add every hit for this query, databases are added in order so overall ties are unchanged
+            query = _pQUERY_DATA->get_sequence(query_outputs.front()->qseqid);
+            for (DiamondOutput *output : query_outputs) {
+                add_query_hits(*output, query, query_orders);
+            }
 
-            // Check if this is a UniProt match and pull back info if so
-            if (is_uniprot) {
-                // Get uniprot info
-                is_uniprot_entry(sseqid, simSearchResults.uniprot_info);
-            } else {
-                if (uniprot_attempts <= UNIPROT_ATTEMPTS) {
-                    // First UniProt match assumes the rest are UniProt as well in database
-                    is_uniprot = is_uniprot_entry(sseqid, simSearchResults.uniprot_info);
-                    if (!is_uniprot) {
-                        uniprot_attempts++;
-                    } else {
-                        FS_dprint("Database file at " + output_path + "\nDetermined to be UniProt");
-                        _pQUERY_DATA->set_is_uniprot(true);
-                        _pQUERY_DATA->header_set_uniprot(true);
+            // Database best hits and unselected hits
+            for (DiamondOutput *output : query_outputs) {
+                best_hit = query->get_best_hit_alignment<SimSearchAlignment>(
+                        SIMILARITY_SEARCH, SIM_DIAMOND, output->output_path);
+                alignment_data = query->get_database_hits(output->output_path, SIMILARITY_SEARCH, SIM_DIAMOND);
+                for (QueryAlignment *hit : *alignment_data) {
+                    output->stats.count_TOTAL_alignments++;
+                    if (hit != best_hit) {  // If this hit is not the best hit
+                        output->stats.file_unselected_hits <<
+                            hit->print_delim(DEFAULT_HEADERS, 0, FileSystem::DELIM_TSV) << std::endl;
+                        output->stats.count_unselected++;
                     }
-                } // Else, database is NOT UniProt after # of attempts
+                }
+                add_best_stats(output->stats, query, best_hit);
             }
 
-            // Compile sim search data
-            simSearchResults.database_path = output_path;
-            simSearchResults.qseqid = qseqid;
-            simSearchResults.sseqid = sseqid;
-            simSearchResults.pident = pident;
-            simSearchResults.length = length;
-            simSearchResults.mismatch = mismatch;
-            simSearchResults.gapopen = gapopen;
-            simSearchResults.qstart = qstart;
-            simSearchResults.qend = qend;
-            simSearchResults.sstart = sstart;
-            simSearchResults.send = send;
-            simSearchResults.stitle = stitle;
-            simSearchResults.bit_score = bitscore;
-            simSearchResults.lineage = taxEntry.lineage;
-            simSearchResults.species = species;
-            simSearchResults.e_val_raw = evalue;
-            simSearchResults.e_val = float_to_sci(evalue,2);
-            simSearchResults.coverage_raw = coverage;
-            simSearchResults.coverage = float_to_string(coverage);
-            simSearchResults.contaminant = contam_info.first;
-            simSearchResults.contam_type = contam_info.second;
-            simSearchResults.contaminant ? simSearchResults.yes_no_contam = YES_FLAG :
-                    simSearchResults.yes_no_contam  = NO_FLAG;
-            simSearchResults.is_informative = is_informative(stitle, _uninformative_vect);
-            simSearchResults.is_informative ? simSearchResults.yes_no_inform = YES_FLAG :
-                    simSearchResults.yes_no_inform  = NO_FLAG;
-
-            query->add_alignment(_execution_state, _software_flag,
-                    simSearchResults, output_path, _input_lineage);
-        } // END WHILE LOOP
-
-        // Finished parsing and adding to alignment data, being to calc stats
-        FS_dprint("File parsed, calculating statistics and writing output...");
-        calculate_best_stats(false,output_path);
-        FS_dprint("Success!");
-    } // END FOR LOOP
+            // Overall best hit across databases
+            best_hit = query->get_best_hit_alignment<SimSearchAlignment>(SIMILARITY_SEARCH, SIM_DIAMOND, "");
+            add_best_stats(overall_stats, query, best_hit);
+
+            // Results written, only best hits are needed past this point
+            for (DiamondOutput *output : query_outputs) {
+                query->clear_unselected_hits(SIMILARITY_SEARCH, SIM_DIAMOND, output->output_path);
+            }
+        }
+
+        // Sequences that did not hit a database
+        for (auto &pair : *_pQUERY_DATA->get_sequences_ptr()) {
+            for (std::unique_ptr<DiamondOutput> &output : outputs) {
+                add_no_hit_stats(output->stats, pair.second);
+            }
+            add_no_hit_stats(overall_stats, pair.second);
+        }
+    } catch (const ExceptionHandler &e) {
+        throw e;
+    } catch (const std::exception &e) {
+        throw ExceptionHandler(e.what(), ERR_ENTAP_RUN_SIM_SEARCH_FILTER);
+    }
+
+    FS_dprint("Files parsed, calculating statistics and writing output...");
+    for (std::unique_ptr<DiamondOutput> &output : outputs) {
+        finish_best_stats(output->stats);
+    }
 
     FS_dprint("Calculating overall Similarity Searching statistics...");
-    calculate_best_stats(true);
+    finish_best_stats(overall_stats);
+    _memory_hits.clear();
     FS_dprint("Success!");
 }
 
-typedef std::map<std::string,std::map<std::string,uint32>> graph_sum_t;
+/**
+ * ======================================================================
+ * Function void ModDiamond::read_query_order(query_order_t &query_orders)
+ *
+ * Description          - Maps each query ID to its position within the
+ *                        transcriptome DIAMOND was ran against
+ *
+ * Notes                - IDs are taken up to the first whitespace as DIAMOND
+ *                        does for qseqid
+ *
+ * @param query_orders  - Map to be filled with query positions
+ *
+ * @return              - None
+ *
+ * =====================================================================
+ */
+void ModDiamond::read_query_order(query_order_t &query_orders) {
+    std::string line;
+    uint32      order=0;
+
+    std::ifstream in_file(_in_hits);
+    while (std::getline(in_file, line)) {
+        if (!line.empty() && line[0] == FileSystem::FASTA_FLAG) {
+            query_orders.emplace(line.substr(1, line.find_first_of(" \t\r", 1) - 1), order++);
+        }
+    }
+    FS_dprint("Query order read for " + std::to_string(order) + " sequences");
+}
 
-void ModDiamond::calculate_best_stats (bool is_final, std::string database_path) {
+/**
+ * ======================================================================
+ * Function void ModDiamond::sort_output_by_query(std::string &output_path,
+ *                                                query_order_t &query_orders)
+ *
+ * Description          - Ensures a DIAMOND output lists hits in transcriptome
+ *                        order so it can be merged with other databases
+ *                      - Outputs already in order are left untouched
+ *
+ * Notes                - Only line offsets are held in memory when sorting.
+ *                        Hits keep their relative order within a query
+ *                      - Compressed outputs are sorted from a temporary
+ *                        plain copy and compressed again
+ *
+ * @param output_path   - DIAMOND output file
+ * @param query_orders  - Query positions from read_query_order
+ *
+ * @return              - None
+ *
+ * =====================================================================
+ */
+void ModDiamond::sort_output_by_query(std::string &output_path, query_order_t &query_orders) {
+    typedef std::pair<uint32, std::pair<uint64, uint64>> line_pos_t;  // query order -> (offset, length)
+
+    std::string line;
+    std::string temp_path;
+    std::string sort_path;
+    uint64      offset=0;
+    uint32      query_order;
+    uint32      prev_order=0;
+    bool        is_sorted=true;
+    FileSystem::ENT_FILE_TYPES compression;
+    std::vector<line_pos_t> line_positions;
+
+    // Nothing needs to be held unless the file turns out to be out of order
+    std::unique_ptr<std::istream> order_file = FileSystem::open_input(output_path);
+    while (is_sorted && std::getline(*order_file, line)) {
+        if (line.empty()) continue;
+        query_order = get_query_order(line.substr(0, line.find('\t')), query_orders, output_path);
+        if (query_order < prev_order) is_sorted = false;
+        prev_order = query_order;
+    }
+    if (is_sorted && !FileSystem::close_input(*order_file)) {
+        throw ExceptionHandler("Unable to read DIAMOND output: " + output_path, ERR_ENTAP_RUN_SIM_SEARCH_FILTER);
+    }
+    order_file.reset();
+    if (is_sorted) return;
+
+    FS_dprint("DIAMOND output not in query order, sorting: " + output_path);
+    temp_path = output_path + TEMP_EXT;
+
+    // Lines are read back by offset, compressed outputs are sorted from a plain copy
+    sort_path   = output_path;
+    compression = FileSystem::get_compression(output_path);
+    if (compression != FileSystem::ENT_FILE_UNUSED) {
+        sort_path = temp_path + FileSystem::EXT_OUT;
+        if (!_pFileSystem->decompress_file(output_path, sort_path, compression)) {
+            throw ExceptionHandler("Unable to decompress DIAMOND output: " + output_path,
+                                   ERR_ENTAP_RUN_SIM_SEARCH_FILTER);
+        }
+    }
+    std::ifstream in_file(sort_path, std::ios::in | std::ios::binary);
+    while (std::getline(in_file, line)) {
+        if (!line.empty()) {
+            query_order = get_query_order(line.substr(0, line.find('\t')), query_orders, output_path);
+            line_positions.emplace_back(query_order, std::make_pair(offset, (uint64) line.size()));
+        }
+        offset += line.size() + 1;
+    }
+    std::stable_sort(line_positions.begin(), line_positions.end(),
+                     [](const line_pos_t &first, const line_pos_t &second) {return first.first < second.first;});
+
+    std::ofstream out_file(temp_path, std::ios::out | std::ios::binary | std::ios::trunc);
+    in_file.clear();
+    for (line_pos_t &pos : line_positions) {
+        line.resize(pos.second.second);
+        in_file.seekg(pos.second.first);
+        in_file.read(&line[0], pos.second.second);
+        out_file << line << '\n';
+    }
+    in_file.close();
+    out_file.close();
 
-    GraphingData                graphingStruct;
-    std::string                 species;
-    std::string                 database_shortname;
-    std::string                 figure_base;
-    std::string                 frame;
-    std::string                 base_path;
-    std::string                 temp_file_path;
-    std::string                 contam;
-    std::stringstream           ss;
-    uint64                      count_no_hit=0;
-    uint64                      count_contam=0;
-    uint64                      count_filtered=0;
-    uint64                      count_informative=0;
-    uint64                      count_uninformative=0;
-    uint64                      count_unselected=0;
-    uint64                      count_TOTAL_alignments=0;
-    uint32                      ct;
-    fp64                        percent;
-    fp64                        contam_percent;
-    Compair<std::string>        contam_counter;
-    Compair<std::string>        species_counter;
-    Compair<std::string>        contam_species_counter;
-    graph_sum_t                 graphing_sum_map;
+    if (sort_path != output_path) _pFileSystem->delete_file(sort_path);
 
-    // Set up output directories (processed directory cleared earlier so these will be empty)
+    if (!out_file || !_pFileSystem->rename_file(temp_path, output_path)) {
+        throw ExceptionHandler("Unable to sort DIAMOND output: " + output_path, ERR_ENTAP_RUN_SIM_SEARCH_FILTER);
+    }
+    compress_output(output_path);
+}
+
+/**
+ * ======================================================================
+ * Function void ModDiamond::sort_memory_hits(std::vector<DiamondHit> &hits,
+ *                                            query_order_t &query_orders,
+ *                                            std::string &output_path)
+ *
+ * Description          - In-process counterpart of sort_output_by_query,
+ *                        linked DIAMOND reports queries as threads finish
+ *                        them so hits are put back in query order
+ *
+ * Notes                - Hits keep their relative order within a query
+ *
+ * @param hits          - Hits from add_search_hits
+ * @param query_orders  - Query positions from read_query_order
+ * @param output_path   - Output the hits belong to (error messages)
+ *
+ * @return              - None
+ *
+ * =====================================================================
+ */
+void ModDiamond::sort_memory_hits(std::vector<DiamondHit> &hits, query_order_t &query_orders,
+                                  std::string &output_path) {
+    typedef std::pair<uint32, uint64> hit_pos_t;   // query order -> index in hits
+
+    std::vector<hit_pos_t>  hit_positions;
+    std::vector<DiamondHit> sorted_hits;
+
+    hit_positions.reserve(hits.size());
+    for (uint64 i = 0; i < hits.size(); i++) {
+        hit_positions.emplace_back(get_query_order(hits[i].qseqid, query_orders, output_path), i);
+    }
+    std::stable_sort(hit_positions.begin(), hit_positions.end(),
+                     [](const hit_pos_t &first, const hit_pos_t &second) {return first.first < second.first;});
+
+    sorted_hits.reserve(hits.size());
+    for (hit_pos_t &pos : hit_positions) {
+        sorted_hits.push_back(std::move(hits[pos.second]));
+    }
+    hits.swap(sorted_hits);
+}
+
+uint32 ModDiamond::get_query_order(const std::string &qseqid, query_order_t &query_orders,
+                                   std::string &output_path) {
+    auto it = query_orders.find(qseqid);
+    if (it == query_orders.end()) {
+        throw ExceptionHandler("Unable to find sequence in transcriptome: " + qseqid + " from file: " + output_path,
+                               ERR_ENTAP_RUN_SIM_SEARCH_FILTER);
+    }
+    return it->second;
+}
+
+bool ModDiamond::read_output_row(DiamondOutput &output, query_order_t &query_orders) {
+    if (output.memory_hits != nullptr) {
+        output.has_row = output.memory_index < output.memory_hits->size();
+        if (output.has_row) {
+            DiamondHit &hit = (*output.memory_hits)[output.memory_index++];
+            output.qseqid   = std::move(hit.qseqid);
+            output.sseqid   = std::move(hit.sseqid);
+            output.pident   = std::move(hit.pident);
+            output.length   = std::move(hit.length);
+            output.mismatch = std::move(hit.mismatch);
+            output.gapopen  = std::move(hit.gapopen);
+            output.qstart   = std::move(hit.qstart);
+            output.qend     = std::move(hit.qend);
+            output.sstart   = std::move(hit.sstart);
+            output.send     = std::move(hit.send);
+            output.bitscore = std::move(hit.bitscore);
+            output.stitle   = std::move(hit.stitle);
+            output.evalue   = hit.evalue;
+            output.coverage = hit.coverage;
+            output.query_order = get_query_order(output.qseqid, query_orders, output.output_path);
+        }
+        return output.has_row;
+    }
+    output.has_row = output.reader->read_row(output.qseqid, output.sseqid, output.pident, output.length,
+            output.mismatch, output.gapopen, output.qstart, output.qend, output.sstart, output.send,
+            output.evalue, output.bitscore, output.coverage, output.stitle);
+    if (output.has_row) {
+        output.query_order = get_query_order(output.qseqid, query_orders, output.output_path);
+    }
+    return output.has_row;
+}
+
+/**
+ * ======================================================================
+ * Function void ModDiamond::add_query_hits(DiamondOutput &output,
+ *                                          QuerySequence *query,
+ *                                          query_order_t &query_orders)
+ *
+ * Description          - Adds every hit from a database output for the
+ *                        current query, leaving the output positioned at
+ *                        the next query
+ *
+ * Notes                - None
+ *
+ * @param output        - DIAMOND output positioned at the query
+ * @param query         - Query the hits belong to
+ * @param query_orders  - Query positions from read_query_order
+ *
+ * @return              - None
+ *
+ * =====================================================================
+ */
+void ModDiamond::add_query_hits(DiamondOutput &output, QuerySequence *query, query_order_t &query_orders) {
+    std::string         species;
+    std::string         qseqid;
+    std::string         accession;
+    QuerySequence::SimSearchResults simSearchResults;
+    TaxEntry            taxEntry;
+    std::pair<bool, std::string> contam_info;
+    const SubjectIndex::SubjectInfo *subject;
+
+    if (query == nullptr) {
+        throw ExceptionHandler("Unable to find sequence in transcriptome: " + output.qseqid + " from file: " +
+                               output.output_path, ERR_ENTAP_RUN_SIM_SEARCH_FILTER);
+    }
+    qseqid = output.qseqid;
+
+    do {
+        simSearchResults = {};
+        subject = output.subject_index ? output.subject_index->find(output.sseqid) : nullptr;
+
+        if (subject != nullptr) {
+            // Species and taxonomy from the subject index
+            species  = output.subject_index->get_species(*subject);
+            taxEntry = output.subject_index->get_tax_entry(*subject, _pEntapDatabase);
+        } else {
+            // get species from database alignment (using boost regex for now)
+            species = get_species(output.stitle);
+            // get taxonomic information with species
+            taxEntry = _pEntapDatabase->get_tax_entry(species);
+        }
+        const EntapDatabase::tax_ancestors_t &lineage_ids = _pEntapDatabase->get_tax_ancestors(taxEntry.lineage);
+        // get contaminant information
+        contam_info = is_contaminant(taxEntry.lineage, lineage_ids);
+
+        // Check if this is a UniProt match and pull back info if so
+        if (subject != nullptr) {
+            // Only UniProt formatted subjects are looked up
+            if (subject->flags & SubjectIndex::SUBJECT_UNIPROT) {
+                accession = output.subject_index->get_accession(*subject);
+                simSearchResults.uniprot_info = _pEntapDatabase->get_uniprot_entry(accession);
+                if (!output.is_uniprot && !simSearchResults.uniprot_info.is_empty()) {
+                    output.is_uniprot = true;
+                    FS_dprint("Database file at " + output.output_path + "\nDetermined to be UniProt");
+                    _pQUERY_DATA->set_is_uniprot(true);
+                    _pQUERY_DATA->header_set_uniprot(true);
+                }
+            }
+        } else if (output.is_uniprot) {
+            // Get uniprot info
+            is_uniprot_entry(output.sseqid, simSearchResults.uniprot_info);
+        } else {
+            if (output.uniprot_attempts <= UNIPROT_ATTEMPTS) {
+                // First UniProt match assumes the rest are UniProt as well in database
+                output.is_uniprot = is_uniprot_entry(output.sseqid, simSearchResults.uniprot_info);
+                if (!output.is_uniprot) {
+                    output.uniprot_attempts++;
+                } else {
+                    FS_dprint("Database file at " + output.output_path + "\nDetermined to be UniProt");
+                    _pQUERY_DATA->set_is_uniprot(true);
+                    _pQUERY_DATA->header_set_uniprot(true);
+                }
+            } // Else, database is NOT UniProt after # of attempts
+        }
+
+        // Compile sim search data
+        simSearchResults.database_path = output.output_path;
+        simSearchResults.qseqid = output.qseqid;
+        simSearchResults.sseqid = output.sseqid;
+        simSearchResults.pident = output.pident;
+        simSearchResults.length = output.length;
+        simSearchResults.mismatch = output.mismatch;
+        simSearchResults.gapopen = output.gapopen;
+        simSearchResults.qstart = output.qstart;
+        simSearchResults.qend = output.qend;
+        simSearchResults.sstart = output.sstart;
+        simSearchResults.send = output.send;
+        simSearchResults.stitle = output.stitle;
+        simSearchResults.bit_score = output.bitscore;
+        simSearchResults.lineage = taxEntry.lineage;
+        simSearchResults.lineage_ids = &lineage_ids;
+        simSearchResults.species = species;
+        simSearchResults.e_val_raw = output.evalue;
+        simSearchResults.e_val = float_to_sci(output.evalue,2);
+        simSearchResults.coverage_raw = output.coverage;
+        simSearchResults.coverage = float_to_string(output.coverage);
+        simSearchResults.contaminant = contam_info.first;
+        simSearchResults.contam_type = contam_info.second;
+        simSearchResults.contaminant ? simSearchResults.yes_no_contam = YES_FLAG :
+                simSearchResults.yes_no_contam  = NO_FLAG;
+        simSearchResults.is_informative = subject != nullptr && output.subject_index->has_informative() ?
+                                          (subject->flags & SubjectIndex::SUBJECT_INFORMATIVE) != 0 :
+                                          is_informative(output.stitle);
+        simSearchResults.is_informative ? simSearchResults.yes_no_inform = YES_FLAG :
+                simSearchResults.yes_no_inform  = NO_FLAG;
+
+        query->add_alignment(_execution_state, _software_flag,
+                simSearchResults, output.output_path, _input_ancestors);
+    } while (read_output_row(output, query_orders) && output.qseqid == qseqid);
+}
+
+/**
+ * ======================================================================
+ * Function void ModDiamond::init_best_stats(BestHitStats &stats, bool is_final,
+ *                                           std::string database_path)
+ *
+ * Description          - Creates the output directories for a database (or
+ *                        the overall results) and opens the best hit,
+ *                        contaminant, unselected and no hit files
+ *
+ * Notes                - Processed directory cleared earlier so these will
+ *                        be empty
+ *
+ * @param stats         - Stats to initialize
+ * @param is_final      - True for the overall results across databases
+ * @param database_path - DIAMOND output path (database results only)
+ *
+ * @return              - None
+ *
+ * =====================================================================
+ */
+void ModDiamond::init_best_stats(BestHitStats &stats, bool is_final, std::string database_path) {
+    std::string base_path;
+
+    stats.is_final = is_final;
+    stats.database_path = database_path;
     if (is_final) {
         // Overall results across databases
         base_path = _overall_results_dir;
-        database_shortname = "";
+        stats.database_shortname = "";
     } else {
         // Individual database results
-        database_shortname = _path_to_database[database_path];
-        base_path   = PATHS(_proc_dir, database_shortname);
+        stats.database_shortname = _path_to_database[database_path];
+        base_path = PATHS(_proc_dir, stats.database_shortname);
     }
-    figure_base = PATHS(base_path, FIGURE_DIR);
+    stats.figure_base = PATHS(base_path, FIGURE_DIR);
     _pFileSystem->create_dir(base_path);
-    _pFileSystem->create_dir(figure_base);
+    _pFileSystem->create_dir(stats.figure_base);
 
     // Open contam best hit tsv file and print headers
-    std::string out_best_contams_filepath = PATHS(base_path, SIM_SEARCH_DATABASE_BEST_HITS_CONTAM);
-    _pQUERY_DATA->start_alignment_files(out_best_contams_filepath, DEFAULT_HEADERS, 0, _alignment_file_types);
+    stats.out_best_contams_filepath = PATHS(base_path, SIM_SEARCH_DATABASE_BEST_HITS_CONTAM);
+    _pQUERY_DATA->start_alignment_files(stats.out_best_contams_filepath, DEFAULT_HEADERS, 0, _alignment_file_types);
 
     // Open best hits files
-    std::string out_best_hits_filepath = PATHS(base_path, SIM_SEARCH_DATABASE_BEST_HITS);
-    _pQUERY_DATA->start_alignment_files(out_best_hits_filepath, DEFAULT_HEADERS, 0, _alignment_file_types);
+    stats.out_best_hits_filepath = PATHS(base_path, SIM_SEARCH_DATABASE_BEST_HITS);
+    _pQUERY_DATA->start_alignment_files(stats.out_best_hits_filepath, DEFAULT_HEADERS, 0, _alignment_file_types);
 
     // Open best hits files with no contaminants
-    std::string out_best_hits_no_contams = PATHS(base_path, SIM_SEARCH_DATABASE_BEST_HITS_NO_CONTAM);
-    _pQUERY_DATA->start_alignment_files(out_best_hits_no_contams, DEFAULT_HEADERS, 0, _alignment_file_types);
+    stats.out_best_hits_no_contams = PATHS(base_path, SIM_SEARCH_DATABASE_BEST_HITS_NO_CONTAM);
+    _pQUERY_DATA->start_alignment_files(stats.out_best_hits_no_contams, DEFAULT_HEADERS, 0, _alignment_file_types);
 
     // Open unselected hits, so every hit that was not the best hit (tsv)
-    std::string out_unselected_tsv  = PATHS(base_path, SIM_SEARCH_DATABASE_UNSELECTED + FileSystem::EXT_TSV);
-    std::ofstream file_unselected_hits(out_unselected_tsv, std::ios::out | std::ios::app);
+    stats.out_unselected_tsv = PATHS(base_path, SIM_SEARCH_DATABASE_UNSELECTED + FileSystem::EXT_TSV);
+    stats.file_unselected_hits.open(stats.out_unselected_tsv, std::ios::out | std::ios::app);
+    _pFileSystem->print_headers(stats.file_unselected_hits, DEFAULT_HEADERS, FileSystem::DELIM_TSV);
 
     // Open no hits file (fasta nucleotide)
     std::string out_no_hits_fa_nucl = PATHS(base_path, SIM_SEARCH_DATABASE_NO_HITS + FileSystem::EXT_FNN);
-    std::ofstream file_no_hits_nucl(out_no_hits_fa_nucl, std::ios::out | std::ios::app);
+    stats.file_no_hits_nucl.open(out_no_hits_fa_nucl, std::ios::out | std::ios::app);
 
     // Open no hits file (fasta protein)
-    std::string out_no_hits_fa_prot  = PATHS(base_path, SIM_SEARCH_DATABASE_NO_HITS + FileSystem::EXT_FAA);
-    std::ofstream file_no_hits_prot(out_no_hits_fa_prot, std::ios::out | std::ios::app);
-
-    // ------------------- Setup graphing files ------------------------- //
-
-    std::string graph_species_txt_path           = PATHS(figure_base, GRAPH_SPECIES_BAR_TXT);
-    std::string graph_species_png_path           = PATHS(figure_base, GRAPH_SPECIES_BAR_PNG);
-    std::string graph_contam_txt_path            = PATHS(figure_base, GRAPH_CONTAM_BAR_TXT);
-    std::string graph_contam_png_path            = PATHS(figure_base, GRAPH_CONTAM_BAR_PNG);
-    std::string graph_sum_txt_path               = PATHS(figure_base, GRAPH_DATABASE_SUM_TXT);
-    std::string graph_sum_png_path               = PATHS(figure_base, GRAPH_DATABASE_SUM_PNG);
-
-    std::ofstream graph_species_file(graph_species_txt_path, std::ios::out | std::ios::app);
-    std::ofstream graph_contam_file(graph_contam_txt_path, std::ios::out | std::ios::app);
-    std::ofstream graph_sum_file(graph_sum_txt_path, std::ios::out | std::ios::app);
-
-    // ------------------------------------------------------------------ //
+    stats.out_no_hits_fa_prot = PATHS(base_path, SIM_SEARCH_DATABASE_NO_HITS + FileSystem::EXT_FAA);
+    stats.file_no_hits_prot.open(stats.out_no_hits_fa_prot, std::ios::out | std::ios::app);
+}
 
-    // Print headers to relevant tsv files
-    _pFileSystem->print_headers(file_unselected_hits, DEFAULT_HEADERS, FileSystem::DELIM_TSV);
+/**
+ * ======================================================================
+ * Function void ModDiamond::add_best_stats(BestHitStats &stats,
+ *                                          QuerySequence *query,
+ *                                          SimSearchAlignment *best_hit)
+ *
+ * Description          - Writes the best hit of a query to the best hit
+ *                        files and counts its species, contaminant and
+ *                        informative status
+ *
+ * Notes                - None
+ *
+ * @param stats         - Database (or overall) stats being accumulated
+ * @param query         - Query that hit the database
+ * @param best_hit      - Best hit for the query
+ *
+ * @return              - None
+ *
+ * =====================================================================
+ */
+void ModDiamond::add_best_stats(BestHitStats &stats, QuerySequence *query, SimSearchAlignment *best_hit) {
+    std::string frame;
+    std::string species;
+    QuerySequence::SimSearchResults *sim_search_data;
+
+    sim_search_data = best_hit->get_results();
+    stats.count_filtered++;   // increment best hit
+
+    // Write to best hits files
+    _pQUERY_DATA->add_alignment_data(stats.out_best_hits_filepath, query, best_hit);
+
+    frame = query->getFrame();     // Used for graphing
+    species = sim_search_data->species;
+
+    // Determine contaminant information and print to files
+    if (sim_search_data->contaminant) {
+        // Species is considered a contaminant
+        stats.count_contam++;
+        _pQUERY_DATA->add_alignment_data(stats.out_best_contams_filepath, query, best_hit);
+
+        stats.contam_counter.add_value(sim_search_data->contam_type);
+        stats.contam_species_counter.add_value(species);
+    } else {
+        // Species is NOT a contaminant, print to files
+        _pQUERY_DATA->add_alignment_data(stats.out_best_hits_no_contams, query, best_hit);
+    }
 
+    // Count species type
+    stats.species_counter.add_value(species);
 
-    try {
-        graph_species_file << "Species\tCount"     << std::endl;
-        graph_contam_file  << "Contaminant Species\tCount" << std::endl;
-        graph_sum_file     << "Category\tCount"    << std::endl;
+    // Check if this is an informative alignment and respond accordingly
+    if (sim_search_data->is_informative) {
+        stats.count_informative++;
+        stats.graphing_sum_map[frame][INFORMATIVE_FLAG]++;
+    } else {
+        stats.count_uninformative++;
+        stats.graphing_sum_map[frame][UNINFORMATIVE_FLAG]++;
+    }
+}
 
-        // Cycle through all sequences
-        for (auto &pair : *_pQUERY_DATA->get_sequences_ptr()) {
-            // Check if original sequences have hit a database
-            if (!pair.second->hit_database(SIMILARITY_SEARCH, SIM_DIAMOND, database_path)) {
-                // Did NOT hit a database during sim search
-                // Do NOT log if it was never blasted
-                if ((pair.second->QUERY_FLAG_GET(QuerySequence::QUERY_IS_PROTEIN) && _blastp) ||
-                    (!pair.second->QUERY_FLAG_GET(QuerySequence::QUERY_IS_PROTEIN) && !_blastp)) {
-                    // Protein/nucleotide did not hit database
-                    count_no_hit++;
-                    file_no_hits_nucl << pair.second->get_sequence_n() << std::endl;
-                    file_no_hits_prot << pair.second->get_sequence_p() << std::endl;
-                    // Graphing
-                    frame = pair.second->getFrame();
-                    if (graphing_sum_map[frame].find(NO_HIT_FLAG) != graphing_sum_map[frame].end()) {
-                        graphing_sum_map[frame][NO_HIT_FLAG]++;
-                    } else graphing_sum_map[frame][NO_HIT_FLAG] = 1;
-                } else {
-                    pair.second->QUERY_FLAG_SET(QuerySequence::QUERY_BLASTED);
-                }
-            } else {
-                // HIT a database during sim search
-
-                QuerySequence::SimSearchResults *sim_search_data;
-                SimSearchAlignment *best_hit;
-                // Process unselected hits for non-final analysis and set best hit pointer
-                if (is_final) {
-                    best_hit =
-                            pair.second->get_best_hit_alignment<SimSearchAlignment>(
-                                    SIMILARITY_SEARCH, SIM_DIAMOND,"");
-                    sim_search_data = best_hit->get_results();
-                } else {
-                    best_hit = pair.second->get_best_hit_alignment<SimSearchAlignment>(
-                            SIMILARITY_SEARCH, SIM_DIAMOND,database_path);
-                    QuerySequence::align_database_hits_t *alignment_data =
-                            pair.second->get_database_hits(database_path,SIMILARITY_SEARCH, SIM_DIAMOND);
-                    sim_search_data = best_hit->get_results();
-                    for (auto &hit : *alignment_data) {
-                        count_TOTAL_alignments++;
-                        if (hit != best_hit) {  // If this hit is not the best hit
-                            file_unselected_hits << hit->print_delim(DEFAULT_HEADERS, 0, FileSystem::DELIM_TSV) << std::endl;
-                            count_unselected++;
-                        } else {
-                            ;   // Do notthing
-                        }
-                    }
-                }
-                count_filtered++;   // increment best hit
+void ModDiamond::add_no_hit_stats(BestHitStats &stats, QuerySequence *query) {
+    if (query->hit_database(SIMILARITY_SEARCH, SIM_DIAMOND, stats.database_path)) return;
+    // Removed by the prefilter or contaminant screen, never searched
+    if (!query->QUERY_FLAG_GET(QuerySequence::QUERY_PREFILTER_KEPT) ||
+        !query->QUERY_FLAG_GET(QuerySequence::QUERY_CONTAM_SCREEN_KEPT)) return;
+    // Left for a later run by the time budget
+    if (query->QUERY_FLAG_GET(QuerySequence::QUERY_BUDGET_SKIPPED)) return;
+
+    // Do NOT log if it was never blasted
+    if ((query->QUERY_FLAG_GET(QuerySequence::QUERY_IS_PROTEIN) && _blastp) ||
+        (!query->QUERY_FLAG_GET(QuerySequence::QUERY_IS_PROTEIN) && !_blastp)) {
+        // Protein/nucleotide did not hit database
+        stats.count_no_hit++;
+        stats.file_no_hits_nucl << query->get_sequence_n() << std::endl;
+        stats.file_no_hits_prot << query->get_sequence_p() << std::endl;
+        stats.graphing_sum_map[query->getFrame()][NO_HIT_FLAG]++;
+    } else {
+        query->QUERY_FLAG_SET(QuerySequence::QUERY_BLASTED);
+    }
+}
 
-                // Write to best hits files
-                _pQUERY_DATA->add_alignment_data(out_best_hits_filepath, pair.second, best_hit);
+/**
+ * ======================================================================
+ * Function void ModDiamond::finish_best_stats(BestHitStats &stats)
+ *
+ * Description          - Closes the output files for a database (or the
+ *                        overall results), prints statistics and graphs
+ *
+ * Notes                - Throws if there were no alignments overall
+ *
+ * @param stats         - Accumulated database (or overall) stats
+ *
+ * @return              - None
+ *
+ * =====================================================================
+ */
+void ModDiamond::finish_best_stats(BestHitStats &stats) {
 
-                frame = pair.second->getFrame();     // Used for graphing
-                species = sim_search_data->species;
+    GraphingData                graphingStruct;
+    std::stringstream           ss;
+    uint32                      ct;
+    fp64                        percent;
+    fp64                        contam_percent;
 
-                // Determine contaminant information and print to files
-                if (sim_search_data->contaminant) {
-                    // Species is considered a contaminant
-                    count_contam++;
-                    _pQUERY_DATA->add_alignment_data(out_best_contams_filepath, pair.second, best_hit);
+    // ------------------- Setup graphing files ------------------------- //
 
-                    contam = sim_search_data->contam_type;
-                    contam_counter.add_value(contam);
-                    contam_species_counter.add_value(species);
-                } else {
-                    // Species is NOT a contaminant, print to files
-                    _pQUERY_DATA->add_alignment_data(out_best_hits_no_contams, pair.second, best_hit);
-                }
+    std::string graph_species_txt_path           = PATHS(stats.figure_base, GRAPH_SPECIES_BAR_TXT);
+    std::string graph_species_png_path           = PATHS(stats.figure_base, GRAPH_SPECIES_BAR_PNG);
+    std::string graph_contam_txt_path            = PATHS(stats.figure_base, GRAPH_CONTAM_BAR_TXT);
+    std::string graph_contam_png_path            = PATHS(stats.figure_base, GRAPH_CONTAM_BAR_PNG);
+    std::string graph_sum_txt_path               = PATHS(stats.figure_base, GRAPH_DATABASE_SUM_TXT);
+    std::string graph_sum_png_path               = PATHS(stats.figure_base, GRAPH_DATABASE_SUM_PNG);
 
-                // Count species type
-                species_counter.add_value(species);
+    std::ofstream graph_species_file(graph_species_txt_path, std::ios::out | std::ios::app);
+    std::ofstream graph_contam_file(graph_contam_txt_path, std::ios::out | std::ios::app);
+    std::ofstream graph_sum_file(graph_sum_txt_path, std::ios::out | std::ios::app);
 
-                // Check if this is an informative alignment and respond accordingly
-                if (sim_search_data->is_informative) {
-                    count_informative++;
-                    // Graphing
-                    if (graphing_sum_map[frame].find(INFORMATIVE_FLAG) != graphing_sum_map[frame].end()) {
-                        graphing_sum_map[frame][INFORMATIVE_FLAG]++;
-                    } else graphing_sum_map[frame][INFORMATIVE_FLAG] = 1;
+    // ------------------------------------------------------------------ //
 
-                } else {
-                    count_uninformative++;
-                    if (graphing_sum_map[frame].find(UNINFORMATIVE_FLAG) != graphing_sum_map[frame].end()) {
-                        graphing_sum_map[frame][UNINFORMATIVE_FLAG]++;
-                    } else graphing_sum_map[frame][UNINFORMATIVE_FLAG] = 1;
-                }
-            }
-        }
-    } catch (const std::exception &e){throw ExceptionHandler(e.what(), ERR_ENTAP_RUN_SIM_SEARCH_FILTER);}
+    graph_species_file << "Species\tCount"     << std::endl;
+    graph_contam_file  << "Contaminant Species\tCount" << std::endl;
+    graph_sum_file     << "Category\tCount"    << std::endl;
 
     try {
-        _pQUERY_DATA->end_alignment_files(out_best_contams_filepath);
-        _pQUERY_DATA->end_alignment_files(out_best_hits_filepath);
-        _pQUERY_DATA->end_alignment_files(out_best_hits_no_contams);
+        _pQUERY_DATA->end_alignment_files(stats.out_best_contams_filepath);
+        _pQUERY_DATA->end_alignment_files(stats.out_best_hits_filepath);
+        _pQUERY_DATA->end_alignment_files(stats.out_best_hits_no_contams);
 
-        _pFileSystem->close_file(file_no_hits_nucl);
-        _pFileSystem->close_file(file_no_hits_prot);
-        _pFileSystem->close_file(file_unselected_hits);
+        _pFileSystem->close_file(stats.file_no_hits_nucl);
+        _pFileSystem->close_file(stats.file_no_hits_prot);
+        _pFileSystem->close_file(stats.file_unselected_hits);
     } catch (const ExceptionHandler &e) {throw e;}
 
     // ------------ Calculate statistics and print to output ------------ //
     ss<<std::fixed<<std::setprecision(2);
 
     // Different headers if final analysis or database specific analysis
-    if (is_final) {
+    if (stats.is_final) {
         _pFileSystem->format_stat_stream(ss, "Compiled Similarity Search - DIAMOND - Best Overall");
     } else {
-        _pFileSystem->format_stat_stream(ss, "Similarity Search - DIAMOND - " + database_shortname);
+        _pFileSystem->format_stat_stream(ss, "Similarity Search - DIAMOND - " + stats.database_shortname);
         ss <<
-           "Search results:\n"            << database_path <<
-           "\n\tTotal alignments: "               << count_TOTAL_alignments   <<
-           "\n\tTotal unselected results: "       << count_unselected      <<
-           "\n\t\tWritten to: "                   << out_unselected_tsv;
+           "Search results:\n"            << stats.database_path <<
+           "\n\tTotal alignments: "               << stats.count_TOTAL_alignments   <<
+           "\n\tTotal unselected results: "       << stats.count_unselected      <<
+           "\n\t\tWritten to: "                   << stats.out_unselected_tsv;
     }
 
     // If overall alignments are 0, then throw error
-    if (is_final && count_filtered == 0) {
+    if (stats.is_final && stats.count_filtered == 0) {
         throw ExceptionHandler("No alignments found during Similarity Searching!",
                                ERR_ENTAP_RUN_SIM_SEARCH_FILTER);
     }
 
     // If no total or filealignments for this database, return and warn user
-    if (!is_final && (count_TOTAL_alignments == 0 || count_filtered == 0)) {
+    if (!stats.is_final && (stats.count_TOTAL_alignments == 0 || stats.count_filtered == 0)) {
         ss << "WARNING: No alignments for this database";
         std::string out_msg = ss.str() + "\n";
         _pFileSystem->print_stats(out_msg);
@@ -550,29 +2025,29 @@ void ModDiamond::calculate_best_stats (bool is_final, std::string database_path)
     }
 
     // Sort counters
-    contam_species_counter.sort(true);
-    species_counter.sort(true);
+    stats.contam_species_counter.sort(true);
+    stats.species_counter.sort(true);
 
-    contam_percent = ((fp64) count_contam / count_filtered) * 100;
+    contam_percent = ((fp64) stats.count_contam / stats.count_filtered) * 100;
 
     ss <<
-       "\n\tTotal unique transcripts with an alignment: " << count_filtered <<
-       "\n\t\tReference transcriptome sequences with an alignment (FASTA):\n\t\t\t" << out_best_hits_filepath <<
-       "\n\t\tSearch results (TSV):\n\t\t\t" << out_best_hits_filepath <<
-       "\n\tTotal unique transcripts without an alignment: " << count_no_hit <<
-       "\n\t\tReference transcriptome sequences without an alignment (FASTA):\n\t\t\t" << out_no_hits_fa_prot;
+       "\n\tTotal unique transcripts with an alignment: " << stats.count_filtered <<
+       "\n\t\tReference transcriptome sequences with an alignment (FASTA):\n\t\t\t" << stats.out_best_hits_filepath <<
+       "\n\t\tSearch results (TSV):\n\t\t\t" << stats.out_best_hits_filepath <<
+       "\n\tTotal unique transcripts without an alignment: " << stats.count_no_hit <<
+       "\n\t\tReference transcriptome sequences without an alignment (FASTA):\n\t\t\t" << stats.out_no_hits_fa_prot;
     // Have frame information
-    if (graphing_sum_map.size() > 1) {
-        for (auto &pair : graphing_sum_map) {
+    if (stats.graphing_sum_map.size() > 1) {
+        for (auto &pair : stats.graphing_sum_map) {
             // Frame -> Map of uninform/inform/no hits
             ss << "\n\t\t" << pair.first << "(" << pair.second[NO_HIT_FLAG] << ")";
             graph_sum_file << pair.first << "\t" << NO_HIT_FLAG << "\t" << pair.second[NO_HIT_FLAG] << "\n";
         }
     }
     ss <<
-       "\n\tTotal unique informative alignments: " << count_informative;
-    if (graphing_sum_map.size() > 1) {
-        for (auto &pair : graphing_sum_map) {
+       "\n\tTotal unique informative alignments: " << stats.count_informative;
+    if (stats.graphing_sum_map.size() > 1) {
+        for (auto &pair : stats.graphing_sum_map) {
             // Frame -> Map of uninform/inform/no hits
             ss << "\n\t\t" << pair.first << "(" << pair.second[INFORMATIVE_FLAG] << ")";
             graph_sum_file << pair.first << "\t" << INFORMATIVE_FLAG << "\t" << pair.second[INFORMATIVE_FLAG]
@@ -580,9 +2055,9 @@ void ModDiamond::calculate_best_stats (bool is_final, std::string database_path)
         }
     }
     ss <<
-       "\n\tTotal unique uninformative alignments: " << count_uninformative;
-    if (graphing_sum_map.size() > 1) {
-        for (auto &pair : graphing_sum_map) {
+       "\n\tTotal unique uninformative alignments: " << stats.count_uninformative;
+    if (stats.graphing_sum_map.size() > 1) {
+        for (auto &pair : stats.graphing_sum_map) {
             // Frame -> Map of uninform/inform/no hits
             ss << "\n\t\t" << pair.first << "(" << pair.second[UNINFORMATIVE_FLAG] << ")";
             graph_sum_file << pair.first << "\t" << UNINFORMATIVE_FLAG << "\t" << pair.second[UNINFORMATIVE_FLAG]
@@ -591,26 +2066,27 @@ void ModDiamond::calculate_best_stats (bool is_final, std::string database_path)
     }
 
     ss <<
-       "\n\tTotal unique contaminants: " << count_contam <<
+       "\n\tTotal unique contaminants: " << stats.count_contam <<
        "(" << contam_percent << "%): " <<
        "\n\t\tTranscriptome reference sequences labeled as a contaminant (FASTA):\n\t\t\t"
-       << out_best_contams_filepath <<
-       "\n\t\tTranscriptome reference sequences labeled as a contaminant (TSV):\n\t\t\t" << out_best_contams_filepath;
+       << stats.out_best_contams_filepath <<
+       "\n\t\tTranscriptome reference sequences labeled as a contaminant (TSV):\n\t\t\t"
+       << stats.out_best_contams_filepath;
 
 
     // ********** Contaminant Calculations ************** //
-    if (count_contam > 0) {
+    if (stats.count_contam > 0) {
         ss << "\n\t\tFlagged contaminants (all % based on total contaminants):";
-        for (auto &pair : contam_counter._data) {
-            percent = ((fp64) pair.second / count_contam) * 100;
+        for (auto &pair : stats.contam_counter._data) {
+            percent = ((fp64) pair.second / stats.count_contam) * 100;
             ss
                     << "\n\t\t\t" << pair.first << ": " << pair.second << "(" << percent << "%)";
         }
         ss << "\n\t\tTop " << COUNT_TOP_SPECIES << " contaminants by species:";
         ct = 1;
-        for (auto &pair : contam_species_counter._sorted) {
+        for (auto &pair : stats.contam_species_counter._sorted) {
             if (ct > COUNT_TOP_SPECIES) break;
-            percent = ((fp64) pair.second / count_contam) * 100;
+            percent = ((fp64) pair.second / stats.count_contam) * 100;
             ss
                     << "\n\t\t\t" << ct << ")" << pair.first << ": "
                     << pair.second << "(" << percent << "%)";
@@ -621,9 +2097,9 @@ void ModDiamond::calculate_best_stats (bool is_final, std::string database_path)
 
     ss << "\n\tTop " << COUNT_TOP_SPECIES << " alignments by species:";
     ct = 1;
-    for (auto &pair : species_counter._sorted) {
+    for (auto &pair : stats.species_counter._sorted) {
         if (ct > COUNT_TOP_SPECIES) break;
-        percent = ((fp64) pair.second / count_filtered) * 100;
+        percent = ((fp64) pair.second / stats.count_filtered) * 100;
         ss
                 << "\n\t\t\t" << ct << ")" << pair.first << ": "
                 << pair.second << "(" << percent << "%)";
@@ -640,21 +2116,21 @@ void ModDiamond::calculate_best_stats (bool is_final, std::string database_path)
     _pFileSystem->close_file(graph_contam_file);
     _pFileSystem->close_file(graph_species_file);
     _pFileSystem->close_file(graph_sum_file);
-    if (count_contam > 0) {
+    if (stats.count_contam > 0) {
         graphingStruct.fig_out_path   = graph_contam_png_path;
-        graphingStruct.graph_title    = database_shortname + GRAPH_CONTAM_TITLE;
+        graphingStruct.graph_title    = stats.database_shortname + GRAPH_CONTAM_TITLE;
         graphingStruct.text_file_path = graph_contam_txt_path;
         graphingStruct.graph_type     = GRAPH_BAR_FLAG;
         _pGraphingManager->graph(graphingStruct);
     }
     graphingStruct.fig_out_path   = graph_species_png_path;
-    graphingStruct.graph_title    = database_shortname + GRAPH_SPECIES_TITLE;
+    graphingStruct.graph_title    = stats.database_shortname + GRAPH_SPECIES_TITLE;
     graphingStruct.text_file_path = graph_species_txt_path;
     graphingStruct.graph_type     = GRAPH_BAR_FLAG;
     _pGraphingManager->graph(graphingStruct);
 
     graphingStruct.fig_out_path   = graph_sum_png_path;
-    graphingStruct.graph_title    = database_shortname + GRAPH_DATABASE_SUM_TITLE;
+    graphingStruct.graph_title    = stats.database_shortname + GRAPH_DATABASE_SUM_TITLE;
     graphingStruct.text_file_path = graph_sum_txt_path;
     graphingStruct.graph_type     = GRAPH_SUM_FLAG;
     _pGraphingManager->graph(graphingStruct);
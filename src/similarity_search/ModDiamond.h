@@ -30,6 +30,11 @@
 
 
 #include "AbstractSimilaritySearch.h"
+#include "../TsvReader.h"
+#include "DiamondLinked.h"     // DiamondHit, DMND_run_linked only defined with LINK_DIAMOND
+#include "SubjectIndex.h"
+
+class SimSearchAlignment;
 
 class ModDiamond : public AbstractSimilaritySearch {
 
@@ -43,15 +48,45 @@ public:
     virtual void execute() override ;
     virtual void parse() override ;
     static bool is_executable(std::string& exe);
+    static bool is_valid_sensitivity(const vect_str_t &modes);
 
     // AbstractSimilaritySearch overrides
     virtual bool run_blast(SimSearchCmd *cmd, bool use_defaults);
 
     static std::vector<ENTAP_HEADERS> DEFAULT_HEADERS;
+    static const vect_str_t SENSITIVITY_MODES;
+    static const std::string MERGED_DATABASE_NAME;     // Filename of merged DIAMOND database
+    static const std::string MERGED_MANIFEST_EXT;      // Sidecar listing databases by tag
+    static const std::string MERGED_TAG_PREFIX;        // Subject IDs are prefixed with <prefix><index><delim>
+    static const char        MERGED_TAG_DELIM;
+    static std::string get_merged_tag(uint16 index);
 
 
 private:
-    static constexpr int DMND_COL_NUMBER = 14;
+    const std::string DMND_TOP_FLAGS         = "--top 3";
+    const std::string DMND_COMPRESS_FLAGS    = "--compress 1";   // gzip output (--compress-outputs gzip)
+    const fp32        SW_TOP_PERCENT         = 3;        // DMND_TOP_FLAGS for Smith-Waterman databases
+    const std::string SENSITIVITY_FAST       = "fast";     // DIAMOND default mode, no flag
+    const std::string CASCADE_TAG            = "_pass";
+    const std::string CASCADE_QUERY_EXT      = ".fasta";
+    const std::string CASCADE_OUTPUT_EXT     = ".out";
+    const std::string DB_CASCADE_QUERY_EXT   = "_query.fasta";
+    const uint32      MERGED_TARGETS_PER_DB  = 25;   // DIAMOND default max-target-seqs for a single database
+    const std::string DMND_OUTPUT_FORMAT     =
+            "6 qseqid sseqid pident length mismatch gapopen qstart qend sstart send evalue bitscore qcovhsp stitle";
+    // Memory planner, DIAMOND uses roughly block_size * (BASE + INDEX / chunks) GB
+    const fp64        PLAN_MEMORY_BASE_GB    = 2.0;
+    const fp64        PLAN_MEMORY_INDEX_GB   = 16.0;
+    const fp64        PLAN_OVERHEAD_GB       = 1.0;    // Independent of block size
+    const fp64        PLAN_MEMORY_FRACTION   = 0.85;   // Of detected memory, when no budget is given
+    const fp64        PLAN_CHUNK_COST        = 0.15;   // Relative cost of each extra index chunk
+    const fp64        PLAN_MIN_BLOCK_SIZE    = 0.1;
+    const uint64      DMND_HEADER_ID         = 0x24af8a415ee186dllu;
+    const std::vector<uint16> PLAN_INDEX_CHUNKS {1, 2, 4, 8, 16};
+    const fp64        BUDGET_STOP_FRACTION   = 0.95;   // No batches are launched past this much of the budget
+    const std::string CACHE_QUERY_EXT        = "_uncached.fasta";
+    const std::string CACHE_SEARCH_EXT       = "_uncached.out";
+    const char        CACHE_PARAM_DELIM      = '|';
     const std::string SIM_SEARCH_DATABASE_BEST_HITS              = "best_hits";
     const std::string SIM_SEARCH_DATABASE_BEST_HITS_CONTAM       = "best_hits_contam";
     const std::string SIM_SEARCH_DATABASE_BEST_HITS_NO_CONTAM    = "best_hits_no_contam";
@@ -75,7 +110,101 @@ private:
     const std::string INFORMATIVE_FLAG                           = "Informative";
     const std::string NO_HIT_FLAG                                = "No Hits";
 
-    void calculate_best_stats(bool is_final, std::string database_path="");
+    typedef std::unordered_map<std::string, uint32> query_order_t;  // query ID -> position in DIAMOND input
+    typedef std::map<std::string,std::map<std::string,uint32>> graph_sum_t;
+
+    // Output files and statistics for a database (or overall best hits)
+    struct BestHitStats {
+        bool                    is_final;
+        std::string             database_path;          // Empty for overall
+        std::string             database_shortname;
+        std::string             figure_base;
+        std::string             out_best_hits_filepath;
+        std::string             out_best_contams_filepath;
+        std::string             out_best_hits_no_contams;
+        std::string             out_unselected_tsv;
+        std::string             out_no_hits_fa_prot;
+        std::ofstream           file_unselected_hits;
+        std::ofstream           file_no_hits_nucl;
+        std::ofstream           file_no_hits_prot;
+        uint64                  count_no_hit=0;
+        uint64                  count_contam=0;
+        uint64                  count_filtered=0;
+        uint64                  count_informative=0;
+        uint64                  count_uninformative=0;
+        uint64                  count_unselected=0;
+        uint64                  count_TOTAL_alignments=0;
+        Compair<std::string>    contam_counter;
+        Compair<std::string>    species_counter;
+        Compair<std::string>    contam_species_counter;
+        graph_sum_t             graphing_sum_map;
+    };
+
+    // DIAMOND output being merged, positioned at its first unparsed row
+    struct DiamondOutput {
+        std::string                     output_path;
+        std::unique_ptr<TsvReader>      reader;
+        std::vector<DiamondHit>        *memory_hits=nullptr;   // Used instead of reader for in-process searches
+        size_t                          memory_index=0;
+        BestHitStats                    stats;
+        bool                            has_row=false;
+        bool                            is_uniprot=false;
+        uint32                          uniprot_attempts=0;
+        uint32                          query_order=0;
+        std::unique_ptr<SubjectIndex>   subject_index;          // Subject metadata from configuration, if built
+        std::string qseqid, sseqid, stitle, pident, bitscore,
+                length, mismatch, gapopen, qstart, qend, sstart, send;
+        fp64                            evalue;
+        fp64                            coverage;
+    };
+
+    // Block size/index chunks chosen to fit a DIAMOND search in memory
+    struct DiamondPlan {
+        fp64    block_size;
+        uint16  index_chunks;
+    };
+
+    std::map<std::string, std::vector<DiamondHit>> _memory_hits;  // Output path -> hits from in-process searches
+
+    void read_query_order(query_order_t &query_orders);
+    void sort_output_by_query(std::string &output_path, query_order_t &query_orders);
+    void sort_memory_hits(std::vector<DiamondHit> &hits, query_order_t &query_orders, std::string &output_path);
+    uint32 get_query_order(const std::string &qseqid, query_order_t &query_orders, std::string &output_path);
+    bool read_output_row(DiamondOutput &output, query_order_t &query_orders);
+    void add_query_hits(DiamondOutput &output, QuerySequence *query, query_order_t &query_orders);
+    void init_best_stats(BestHitStats &stats, bool is_final, std::string database_path="");
+    void add_best_stats(BestHitStats &stats, QuerySequence *query, SimSearchAlignment *best_hit);
+    void add_no_hit_stats(BestHitStats &stats, QuerySequence *query);
+    void finish_best_stats(BestHitStats &stats);
+    vect_str_t _sensitivity_modes;     // Sensitivity cascade, each mode only searches queries without hits
+    bool       _db_cascade;            // Databases searched in order, only with queries not yet annotated
+    std::map<std::string, vect_str_t> _merged_outputs;  // Merged database output -> database outputs by tag
+
+    void execute_shards();
+    void execute_budgeted();
+    void write_budget_unsearched(std::vector<uint16> &batches);
+#ifdef DIAMOND_LINKED
+    void run_blast_linked(SimSearchCmd *cmd, std::string &diamond_args);
+#endif
+    void run_smith_waterman(SimSearchCmd *cmd);
+    void add_search_hits(SimSearchCmd *cmd, std::vector<DiamondHit> &hits);
+    void write_hit_output(std::string &output_path, std::vector<DiamondHit> &hits);
+    void run_search(SimSearchCmd &cmd);
+    void run_sensitivity_cascade(SimSearchCmd &cmd);
+    void read_accepted_queries(std::string &output_path, std::unordered_set<std::string> &accepted);
+    void init_search_cmd(SimSearchCmd &cmd, std::string &database_path, std::string &output_path);
+    uint32 get_max_target_seqs(std::string &output_path);
+    void split_merged_output(std::string &merged_output, vect_str_t &database_outputs);
+    void execute_cached(SimSearchCmd &cmd);
+    void cache_add_output(SimSearchCmd &cmd, std::string &output_path);
+    std::string get_cache_parameters(SimSearchCmd &cmd);
+    DiamondPlan plan_memory(SimSearchCmd *cmd);
+    fp64 get_database_letters(std::string &database_path);
+    bool read_database_header(std::string &database_path, uint64 &sequences, uint64 &letters);
+    void load_subject_index(DiamondOutput &output);
+    std::map<std::string, std::string> _subject_databases;  // Output path -> DIAMOND database its subjects are from
+    static uint64 get_available_memory();
+    fp64 _memory_budget;               // GB a DIAMOND search may use, 0 to detect
 };
 
 
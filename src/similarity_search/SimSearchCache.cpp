@@ -0,0 +1,327 @@
+/*
+ *
+ * Developed by Alexander Hart
+ * Plant Computational Genomics Lab
+ * University of Connecticut
+ *
+ * For information, contact Alexander Hart at:
+ *     entap.dev@gmail.com
+ *
+ * Copyright 2017-2019, Alexander Hart, Dr. Jill Wegrzyn
+ *
+ * This file is part of EnTAP.
+ *
+ * EnTAP is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * EnTAP is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with EnTAP.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+//*********************** Includes *****************************
+#include <cerrno>
+#include <cstdlib>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "SimSearchCache.h"
+#include "../ExceptionHandler.h"
+//**************************************************************
+
+const uint64 SimSearchCache::FNV_OFFSET;
+const uint64 SimSearchCache::FNV_PRIME;
+
+SimSearchCache::SimSearchCache(FileSystem *filesystem, std::string &cache_dir) {
+    _pFileSystem = filesystem;
+    _cache_dir   = cache_dir;
+    _pFileSystem->create_dir(_cache_dir);
+}
+
+
+/**
+ * ======================================================================
+ * Function bool SimSearchCache::open(std::string &database_path, std::string &parameters)
+ *
+ * Description          - Selects cache bucket for this database/search
+ *                        parameters and loads every sequence hash that
+ *                        has already been searched
+ *
+ * Notes                - Database checksum is computed from its contents
+ *                        (remembered by path, size and modification time)
+ *
+ * @param database_path - Path to database being searched
+ * @param parameters    - Any search parameters that change results
+ *
+ * @return              - True if bucket could be opened
+ *
+ * =====================================================================
+ */
+bool SimSearchCache::open(std::string &database_path, std::string &parameters) {
+    std::string checksum;
+    std::string line;
+    std::string list_path;
+    uint64      hash;
+
+    _cached_hashes.clear();
+    _batches.clear();
+
+    checksum = get_database_checksum(database_path);
+    if (checksum.empty()) return false;
+
+    _bucket_dir = PATHS(_cache_dir, checksum + "_" + hash_to_str(hash_sequence(parameters)));
+    if (!_pFileSystem->file_exists(_bucket_dir)) {
+        _pFileSystem->create_dir(_bucket_dir);
+        FS_dprint("New similarity search cache at: " + _bucket_dir);
+        return true;
+    }
+
+    for (std::string &filename : _pFileSystem->list_files(_bucket_dir)) {
+        if (filename.compare(0, BATCH_PREFIX.size(), BATCH_PREFIX) != 0) continue;
+        if (_pFileSystem->get_file_extension(filename, false) != BATCH_LIST_EXT) continue;
+        _batches.push_back(filename.substr(0, filename.size() - BATCH_LIST_EXT.size()));
+    }
+    std::sort(_batches.begin(), _batches.end());
+
+    for (std::string &batch : _batches) {
+        list_path = get_batch_path(batch, BATCH_LIST_EXT);
+        std::ifstream in_file(list_path);
+        while (std::getline(in_file, line)) {
+            // Skip truncated/corrupt lines, sequence is searched again
+            if (!str_to_hash(line, line.size(), hash)) continue;
+            _cached_hashes.insert(hash);
+        }
+    }
+    FS_dprint("Similarity search cache opened at: " + _bucket_dir + "\nCached sequences: " +
+              std::to_string(_cached_hashes.size()));
+    return true;
+}
+
+bool SimSearchCache::is_cached(uint64 seq_hash) {
+    return _cached_hashes.find(seq_hash) != _cached_hashes.end();
+}
+
+uint64 SimSearchCache::get_cached_count() {
+    return _cached_hashes.size();
+}
+
+
+/**
+ * ======================================================================
+ * Function uint64 SimSearchCache::write_cached_hits(std::ofstream &out_file, hash_queries_t &queries)
+ *
+ * Description          - Writes cached hits for the requested sequences
+ *                        in search output format, with the sequence hash
+ *                        replaced by each query ID sharing that sequence
+ *
+ * Notes                - None
+ *
+ * @param out_file      - Output stream (search output format)
+ * @param queries       - Sequence hash to query ID's of this run
+ *
+ * @return              - Number of hits written
+ *
+ * =====================================================================
+ */
+uint64 SimSearchCache::write_cached_hits(std::ofstream &out_file, hash_queries_t &queries) {
+    std::string line;
+    uint64      hash;
+    uint64      delim_pos;
+    uint64      count = 0;
+
+    for (std::string &batch : _batches) {
+        std::ifstream in_file(get_batch_path(batch, BATCH_HITS_EXT));
+        while (std::getline(in_file, line)) {
+            delim_pos = line.find(CACHE_DELIM);
+            if (delim_pos == std::string::npos) continue;
+            if (!str_to_hash(line, delim_pos, hash)) continue;
+            hash_queries_t::iterator it = queries.find(hash);
+            if (it == queries.end()) continue;
+            for (std::string &query_id : it->second) {
+                out_file << query_id;
+                out_file.write(line.data() + delim_pos, line.size() - delim_pos);
+                out_file << '\n';
+                count++;
+            }
+        }
+    }
+    return count;
+}
+
+
+/**
+ * ======================================================================
+ * Function bool SimSearchCache::add_results(std::string &output_path,
+ *                                   std::unordered_map<std::string, uint64> &query_hashes,
+ *                                   std::set<uint64> &searched)
+ *
+ * Description          - Adds a new batch to the cache from a completed
+ *                        search output
+ *
+ * Notes                - Hits file is finalized before the list of searched
+ *                        sequences, an incomplete batch is ignored on open
+ *
+ * @param output_path   - Search output (query ID in first column)
+ * @param query_hashes  - Query ID to sequence hash
+ * @param searched      - Every sequence hash that was searched
+ *
+ * @return              - True if batch was added
+ *
+ * =====================================================================
+ */
+bool SimSearchCache::add_results(std::string &output_path, std::unordered_map<std::string, uint64> &query_hashes,
+                                 std::set<uint64> &searched) {
+    std::string batch_name;
+    std::string hits_path;
+    std::string list_path;
+    std::string temp_path;
+    std::string line;
+    std::string prev_query;
+    std::unordered_set<uint64> written;     // Only keep one copy of hits for identical sequences
+    uint64      hash = 0;
+    uint64      delim_pos;
+    bool        skip_query = false;
+
+    if (searched.empty() || _bucket_dir.empty()) return false;
+
+    batch_name = BATCH_PREFIX + std::to_string(std::time(nullptr)) + "_" + std::to_string(getpid());
+    hits_path  = get_batch_path(batch_name, BATCH_HITS_EXT);
+    list_path  = get_batch_path(batch_name, BATCH_LIST_EXT);
+
+    // Hits
+    temp_path = hits_path + TEMP_EXT;
+    std::ofstream hits_file(temp_path, std::ios::out | std::ios::trunc);
+    std::unique_ptr<std::istream> in_file = FileSystem::open_input(output_path);
+    while (std::getline(*in_file, line)) {
+        delim_pos = line.find(CACHE_DELIM);
+        if (delim_pos == std::string::npos) continue;
+        if (prev_query.empty() || line.compare(0, delim_pos, prev_query) != 0) {
+            // Moved to next query (hits are grouped by query)
+            prev_query = line.substr(0, delim_pos);
+            std::unordered_map<std::string, uint64>::iterator it = query_hashes.find(prev_query);
+            skip_query = it == query_hashes.end() || !written.insert(it->second).second;
+            if (!skip_query) hash = it->second;
+        }
+        if (skip_query) continue;
+        hits_file << hash_to_str(hash);
+        hits_file.write(line.data() + delim_pos, line.size() - delim_pos);
+        hits_file << '\n';
+    }
+    hits_file.close();
+    if (!FileSystem::close_input(*in_file)) {
+        _pFileSystem->delete_file(temp_path);
+        return false;
+    }
+    if (!_pFileSystem->rename_file(temp_path, hits_path)) return false;
+
+    // Searched sequences
+    temp_path = list_path + TEMP_EXT;
+    std::ofstream list_file(temp_path, std::ios::out | std::ios::trunc);
+    for (uint64 seq_hash : searched) list_file << hash_to_str(seq_hash) << '\n';
+    list_file.close();
+    if (!_pFileSystem->rename_file(temp_path, list_path)) return false;
+
+    FS_dprint("Added " + std::to_string(searched.size()) + " sequences to similarity search cache: " + list_path);
+    return true;
+}
+
+
+// FNV-1a of sequence residues, case and whitespace insensitive
+uint64 SimSearchCache::hash_sequence(const std::string &sequence, uint64 seed) {
+    uint64 hash = seed;
+    for (const char &c : sequence) {
+        if (::isspace((uint8)c)) continue;
+        hash ^= (uint8) ::toupper((uint8)c);
+        hash *= FNV_PRIME;
+    }
+    return hash;
+}
+
+uint64 SimSearchCache::hash_file(std::string &path) {
+    uint64 hash = FNV_OFFSET;
+    std::vector<char> buffer(1 << 20);      // 1MB reads
+    std::ifstream in_file(path, std::ios::in | std::ios::binary);
+
+    while (in_file) {
+        in_file.read(buffer.data(), buffer.size());
+        std::streamsize read = in_file.gcount();
+        for (std::streamsize i = 0; i < read; i++) {
+            hash ^= (uint8) buffer[i];
+            hash *= FNV_PRIME;
+        }
+    }
+    return hash;
+}
+
+std::string SimSearchCache::hash_to_str(uint64 hash) {
+    std::stringstream ss;
+    ss << std::hex << std::setw(16) << std::setfill('0') << hash;
+    return ss.str();
+}
+
+// Parses hash written by hash_to_str from the first len characters of str
+bool SimSearchCache::str_to_hash(const std::string &str, uint64 len, uint64 &hash) {
+    char *end;
+
+    if (len == 0 || len > str.size() || !::isxdigit((uint8) str[0])) return false;
+    errno = 0;
+    hash = std::strtoull(str.c_str(), &end, 16);
+    return errno == 0 && end == str.c_str() + len;
+}
+
+
+/**
+ * ======================================================================
+ * Function std::string SimSearchCache::get_database_checksum(std::string &database_path)
+ *
+ * Description          - Returns checksum of database contents
+ *                      - Checksums are remembered within the cache directory
+ *                        keyed by path, size and modification time so large
+ *                        databases are only read once
+ *
+ * Notes                - None
+ *
+ * @param database_path - Path to database
+ *
+ * @return              - Checksum string, empty if database can't be read
+ *
+ * =====================================================================
+ */
+std::string SimSearchCache::get_database_checksum(std::string &database_path) {
+    struct stat  file_stat;
+    std::string  checksum_path;
+    std::string  key;
+    std::string  line;
+    std::string  checksum;
+
+    if (stat(database_path.c_str(), &file_stat) != 0) return "";
+
+    key = database_path + CACHE_DELIM + std::to_string((uint64)file_stat.st_size) + CACHE_DELIM +
+          std::to_string((int64)file_stat.st_mtime) + CACHE_DELIM;
+    checksum_path = PATHS(_cache_dir, CHECKSUM_FILENAME);
+
+    std::ifstream in_file(checksum_path);
+    while (std::getline(in_file, line)) {
+        if (line.compare(0, key.size(), key) == 0) {
+            return line.substr(key.size());
+        }
+    }
+    in_file.close();
+
+    FS_dprint("Computing checksum of database: " + database_path);
+    checksum = hash_to_str(hash_file(database_path));
+
+    std::ofstream out_file(checksum_path, std::ios::out | std::ios::app);
+    out_file << key << checksum << std::endl;
+    return checksum;
+}
+
+std::string SimSearchCache::get_batch_path(std::string &batch_name, const std::string &extension) {
+    return PATHS(_bucket_dir, batch_name + extension);
+}
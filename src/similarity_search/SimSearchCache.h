@@ -0,0 +1,90 @@
+/*
+ *
+ * Developed by Alexander Hart
+ * Plant Computational Genomics Lab
+ * University of Connecticut
+ *
+ * For information, contact Alexander Hart at:
+ *     entap.dev@gmail.com
+ *
+ * Copyright 2017-2019, Alexander Hart, Dr. Jill Wegrzyn
+ *
+ * This file is part of EnTAP.
+ *
+ * EnTAP is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * EnTAP is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with EnTAP.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef ENTAP_SIMSEARCHCACHE_H
+#define ENTAP_SIMSEARCHCACHE_H
+
+//*********************** Includes *****************************
+#include <unordered_set>
+#include "../common.h"
+#include "../FileSystem.h"
+//**************************************************************
+
+
+/**
+ * On-disk cache of similarity search hits shared between EnTAP runs
+ *
+ * Hits are stored per query sequence hash within a bucket for each
+ * (database checksum, search parameters) pair. Each run that searches new
+ * sequences adds a batch to the bucket: a hits file (sequence hash + the
+ * remaining alignment columns) and a list of every sequence hash searched,
+ * including those without hits. The list is written last, so an
+ * interrupted batch is never used.
+ */
+class SimSearchCache {
+
+public:
+    typedef std::unordered_map<uint64, vect_str_t> hash_queries_t;  // Sequence hash to query ID's
+
+    SimSearchCache(FileSystem *filesystem, std::string &cache_dir);
+    ~SimSearchCache() = default;
+
+    bool open(std::string &database_path, std::string &parameters);
+    bool is_cached(uint64 seq_hash);
+    uint64 write_cached_hits(std::ofstream &out_file, hash_queries_t &queries);
+    bool add_results(std::string &output_path, std::unordered_map<std::string, uint64> &query_hashes,
+                     std::set<uint64> &searched);
+    uint64 get_cached_count();
+
+    static uint64 hash_sequence(const std::string &sequence, uint64 seed=FNV_OFFSET);
+    static uint64 hash_file(std::string &path);
+    static std::string hash_to_str(uint64 hash);
+    static bool str_to_hash(const std::string &str, uint64 len, uint64 &hash);
+
+private:
+    std::string get_database_checksum(std::string &database_path);
+    std::string get_batch_path(std::string &batch_name, const std::string &extension);
+
+    static const uint64 FNV_OFFSET = 14695981039346656037ULL;
+    static const uint64 FNV_PRIME  = 1099511628211ULL;
+
+    const std::string CHECKSUM_FILENAME = "database_checksums.tsv";
+    const std::string BATCH_PREFIX      = "batch_";
+    const std::string BATCH_HITS_EXT    = ".hits";
+    const std::string BATCH_LIST_EXT    = ".lst";
+    const std::string TEMP_EXT          = ".tmp";
+    const char        CACHE_DELIM       = '\t';
+
+    FileSystem              *_pFileSystem;
+    std::string              _cache_dir;
+    std::string              _bucket_dir;       // Directory for current database/parameters
+    std::unordered_set<uint64> _cached_hashes;      // Sequences searched in previous runs
+    vect_str_t               _batches;          // Completed batches within bucket
+};
+
+
+#endif //ENTAP_SIMSEARCHCACHE_H
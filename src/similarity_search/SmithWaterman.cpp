@@ -0,0 +1,717 @@
+/*
+ *
+ * Developed by Alexander Hart
+ * Plant Computational Genomics Lab
+ * University of Connecticut
+ *
+ * For information, contact Alexander Hart at:
+ *     entap.dev@gmail.com
+ *
+ * Copyright 2017-2019, Alexander Hart, Dr. Jill Wegrzyn
+ *
+ * This file is part of EnTAP.
+ *
+ * EnTAP is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * EnTAP is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with EnTAP.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+//*********************** Includes *****************************
+#include <atomic>
+#include <mutex>
+#include "SmithWaterman.h"
+#include "../ExceptionHandler.h"
+#include "../FileSystem.h"
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define SW_SIMD_X86
+#include <immintrin.h>
+#endif
+//**************************************************************
+
+// Striped score kernel for each instruction set, chosen at runtime by select_kernel
+namespace {
+#if defined(SW_SIMD_X86)
+#define SW_SIMD_NAMESPACE   striped_avx2
+#define SW_SIMD_TARGET      __attribute__((target("avx2")))
+#define SW_SIMD_AVX2
+#include "SmithWatermanStriped.h"
+#undef SW_SIMD_AVX2
+#undef SW_SIMD_TARGET
+#undef SW_SIMD_NAMESPACE
+#endif
+#if defined(SW_SIMD_X86) && defined(__SSE2__)
+#define SW_SIMD_NAMESPACE   striped_sse2
+#define SW_SIMD_TARGET
+#define SW_SIMD_SSE2
+#include "SmithWatermanStriped.h"
+#undef SW_SIMD_SSE2
+#undef SW_SIMD_TARGET
+#undef SW_SIMD_NAMESPACE
+#else   // Single lane fallback, only selected without SSE2
+#define SW_SIMD_NAMESPACE   striped_scalar
+#define SW_SIMD_TARGET
+#include "SmithWatermanStriped.h"
+#undef SW_SIMD_TARGET
+#undef SW_SIMD_NAMESPACE
+#endif
+}
+
+// Traceback flags
+#define TB_SOURCE_MASK  0x03        // H from: 0 start, 1 diagonal, 2 E, 3 F
+#define TB_E_EXTEND     0x04        // E extended from E to the left
+#define TB_F_EXTEND     0x08        // F extended from F above
+
+const std::string SmithWaterman::ALPHABET    = "ARNDCQEGHILKMFPSTWYVBZX*";
+// Codons ordered by A, C, G, T at each position
+const std::string SmithWaterman::CODON_TABLE = "KNKNTTTTRSRSIIMIQHQHPPPPRRRRLLLLEDEDAAAAGGGGVVVV*Y*YSSSS*CWCLFLF";
+
+const int8 SmithWaterman::BLOSUM62[ALPHABET_SIZE][ALPHABET_SIZE] = {
+        { 4, -1, -2, -2,  0, -1, -1,  0, -2, -1, -1, -1, -1, -2, -1,  1,  0, -3, -2,  0, -2, -1, -1, -4},   // A
+        {-1,  5,  0, -2, -3,  1,  0, -2,  0, -3, -2,  2, -1, -3, -2, -1, -1, -3, -2, -3, -1,  0, -1, -4},   // R
+        {-2,  0,  6,  1, -3,  0,  0,  0,  1, -3, -3,  0, -2, -3, -2,  1,  0, -4, -2, -3,  4,  0, -1, -4},   // N
+        {-2, -2,  1,  6, -3,  0,  2, -1, -1, -3, -4, -1, -3, -3, -1,  0, -1, -4, -3, -3,  4,  1, -1, -4},   // D
+        { 0, -3, -3, -3,  9, -3, -4, -3, -3, -1, -1, -3, -1, -2, -3, -1, -1, -2, -2, -1, -3, -3, -1, -4},   // C
+        {-1,  1,  0,  0, -3,  5,  2, -2,  0, -3, -2,  1,  0, -3, -1,  0, -1, -2, -1, -2,  0,  4, -1, -4},   // Q
+        {-1,  0,  0,  2, -4,  2,  5, -2,  0, -3, -3,  1, -2, -3, -1,  0, -1, -3, -2, -2,  1,  4, -1, -4},   // E
+        { 0, -2,  0, -1, -3, -2, -2,  6, -2, -4, -4, -2, -3, -3, -2,  0, -2, -2, -3, -3, -1, -2, -1, -4},   // G
+        {-2,  0,  1, -1, -3,  0,  0, -2,  8, -3, -3, -1, -2, -1, -2, -1, -2, -2,  2, -3,  0,  0, -1, -4},   // H
+        {-1, -3, -3, -3, -1, -3, -3, -4, -3,  4,  2, -3,  1,  0, -3, -2, -1, -3, -1,  3, -3, -3, -1, -4},   // I
+        {-1, -2, -3, -4, -1, -2, -3, -4, -3,  2,  4, -2,  2,  0, -3, -2, -1, -2, -1,  1, -4, -3, -1, -4},   // L
+        {-1,  2,  0, -1, -3,  1,  1, -2, -1, -3, -2,  5, -1, -3, -1,  0, -1, -3, -2, -2,  0,  1, -1, -4},   // K
+        {-1, -1, -2, -3, -1,  0, -2, -3, -2,  1,  2, -1,  5,  0, -2, -1, -1, -1, -1,  1, -3, -1, -1, -4},   // M
+        {-2, -3, -3, -3, -2, -3, -3, -3, -1,  0,  0, -3,  0,  6, -4, -2, -2,  1,  3, -1, -3, -3, -1, -4},   // F
+        {-1, -2, -2, -1, -3, -1, -1, -2, -2, -3, -3, -1, -2, -4,  7, -1, -1, -4, -3, -2, -2, -1, -1, -4},   // P
+        { 1, -1,  1,  0, -1,  0,  0,  0, -1, -2, -2,  0, -1, -2, -1,  4,  1, -3, -2, -2,  0,  0, -1, -4},   // S
+        { 0, -1,  0, -1, -1, -1, -1, -2, -2, -1, -1, -1, -1, -2, -1,  1,  5, -2, -2,  0, -1, -1, -1, -4},   // T
+        {-3, -3, -4, -4, -2, -2, -3, -2, -2, -3, -2, -3, -1,  1, -4, -3, -2, 11,  2, -3, -4, -2, -1, -4},   // W
+        {-2, -2, -2, -3, -2, -1, -2, -3,  2, -1, -1, -2, -1,  3, -3, -2, -2,  2,  7, -1, -3, -2, -1, -4},   // Y
+        { 0, -3, -3, -3, -1, -2, -2, -3, -3,  3,  1, -2,  1, -1, -2, -2,  0, -3, -1,  4, -3, -2, -1, -4},   // V
+        {-2, -1,  4,  4, -3,  0,  1, -1,  0, -3, -4,  0, -3, -3, -2,  0, -1, -4, -3, -3,  4,  0, -1, -4},   // B
+        {-1,  0,  0,  1, -3,  4,  4, -2,  0, -3, -3,  1, -1, -3, -1,  0, -1, -2, -2, -2,  0,  4, -1, -4},   // Z
+        {-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -4},   // X
+        {-4, -4, -4, -4, -4, -4, -4, -4, -4, -4, -4, -4, -4, -4, -4, -4, -4, -4, -4, -4, -4, -4, -4,  1},   // *
+};
+
+/**
+ * ======================================================================
+ * Function SmithWaterman::SmithWaterman(std::string &database_path)
+ *
+ * Description          - Loads a FASTA protein database and indexes its
+ *                        k-mers for candidate selection
+ *
+ * Notes                - Meant for small databases, everything is held in
+ *                        memory
+ *
+ * @param database_path - Path to FASTA database
+ *
+ * @return              - None
+ *
+ * =====================================================================
+ */
+SmithWaterman::SmithWaterman(std::string &database_path) {
+    _database_letters = 0;
+    select_kernel();
+
+    read_fasta(database_path, [this](std::string &header, std::string &sequence) {
+        Sequence subject;
+        subject.title = header;
+        subject.id    = header.substr(0, header.find_first_of(" \t"));
+        subject.residues.reserve(sequence.size());
+        for (char c : sequence) {
+            subject.residues.push_back(encode(c));
+        }
+        _database_letters += subject.residues.size();
+        _subjects.push_back(std::move(subject));
+    });
+    if (_subjects.empty()) {
+        throw ExceptionHandler("No sequences found in database: " + database_path, ERR_ENTAP_RUN_SIM_SEARCH_RUN);
+    }
+    index_database();
+    FS_dprint("Smith-Waterman database loaded: " + std::to_string(_subjects.size()) + " sequences, " +
+              std::to_string(_database_letters) + " letters");
+}
+
+/**
+ * ======================================================================
+ * Function void SmithWaterman::search(SearchParams &params,
+ *                                     std::vector<DiamondHit> &hits)
+ *
+ * Description          - Aligns every query against the database across
+ *                        params.threads threads
+ *                      - Subjects sharing k-mers on a diagonal with the
+ *                        query are scored with striped Smith-Waterman, those
+ *                        passing the e-value are aligned with traceback
+ *
+ * Notes                - Hits are filtered and reported with the DIAMOND
+ *                        options ModDiamond uses (e-value, coverage, top)
+ *                      - Hits are returned in query order
+ *
+ * @param params        - Search parameters
+ * @param hits          - Hits found
+ *
+ * @return              - None
+ *
+ * =====================================================================
+ */
+void SmithWaterman::search(SearchParams &params, std::vector<DiamondHit> &hits) {
+    std::vector<std::pair<std::string, std::string>> queries;
+    std::vector<std::vector<DiamondHit>>             query_hits;
+    std::vector<std::thread>                         threads;
+    std::atomic<uint64>                              next_query(0);
+    std::exception_ptr                               error;
+    std::mutex                                       error_mutex;
+
+    read_fasta(params.query_path, [&queries](std::string &header, std::string &sequence) {
+        queries.emplace_back(header.substr(0, header.find_first_of(" \t")), std::move(sequence));
+    });
+    query_hits.resize(queries.size());
+
+    for (uint16 i = 0; i < std::max<uint16>(params.threads, 1); i++) {
+        threads.emplace_back([&]() {
+            Workspace workspace;
+            try {
+                for (uint64 q = next_query++; q < queries.size(); q = next_query++) {
+                    search_query(params, queries[q].first, queries[q].second, workspace, query_hits[q]);
+                }
+            } catch (...) {
+                std::lock_guard<std::mutex> lock(error_mutex);
+                error = std::current_exception();
+                next_query = queries.size();
+            }
+        });
+    }
+    for (std::thread &thread : threads) {
+        thread.join();
+    }
+    if (error) std::rethrow_exception(error);
+
+    for (std::vector<DiamondHit> &query : query_hits) {
+        std::move(query.begin(), query.end(), std::back_inserter(hits));
+    }
+}
+
+uint64 SmithWaterman::count_sequences(const std::string &fasta_path) {
+    std::string line;
+    uint64      count=0;
+
+    std::ifstream in_file(fasta_path);
+    while (std::getline(in_file, line)) {
+        if (!line.empty() && line[0] == FileSystem::FASTA_FLAG) count++;
+    }
+    return count;
+}
+
+void SmithWaterman::read_fasta(std::string &path, std::function<void(std::string&, std::string&)> add_sequence) {
+    std::string line;
+    std::string header;
+    std::string sequence;
+
+    std::ifstream in_file(path);
+    if (!in_file.is_open()) {
+        throw ExceptionHandler("Unable to open FASTA file: " + path, ERR_ENTAP_RUN_SIM_SEARCH_RUN);
+    }
+    while (std::getline(in_file, line)) {
+        if (!line.empty() && line.back() == '\r') line.pop_back();
+        if (line.empty()) continue;
+        if (line[0] == FileSystem::FASTA_FLAG) {
+            if (!header.empty()) add_sequence(header, sequence);
+            header = line.substr(1);
+            sequence.clear();
+        } else {
+            sequence += line;
+        }
+    }
+    if (!header.empty()) add_sequence(header, sequence);
+}
+
+uint8 SmithWaterman::encode(char residue) {
+    static const std::vector<uint8> codes = [] {
+        std::vector<uint8> table(256, (uint8) ALPHABET.find('X'));
+        for (uint8 i = 0; i < ALPHABET.size(); i++) {
+            table[(uint8) ALPHABET[i]] = i;
+            table[(uint8) tolower(ALPHABET[i])] = i;
+        }
+        table[(uint8)'U'] = table[(uint8)'u'] = (uint8) ALPHABET.find('C');    // Selenocysteine
+        table[(uint8)'O'] = table[(uint8)'o'] = (uint8) ALPHABET.find('K');    // Pyrrolysine
+        return table;
+    }();
+    return codes[(uint8) residue];
+}
+
+/**
+ * ======================================================================
+ * Function void SmithWaterman::translate(const std::string &nucleotides,
+ *                                        uint8 frame,
+ *                                        std::vector<uint8> &residues)
+ *
+ * Description          - Translates a reading frame with the standard code
+ *
+ * Notes                - Codons with ambiguous bases are X
+ *
+ * @param nucleotides   - Query sequence
+ * @param frame         - 0-2 forward, 3-5 reverse complement
+ * @param residues      - Encoded protein
+ *
+ * @return              - None
+ *
+ * =====================================================================
+ */
+void SmithWaterman::translate(const std::string &nucleotides, uint8 frame, std::vector<uint8> &residues) {
+    static const std::string BASES = "ACGT";
+    std::string strand = nucleotides;
+    size_t      base;
+    int         codon;
+
+    if (frame >= 3) {
+        std::reverse(strand.begin(), strand.end());
+        for (char &c : strand) {
+            base = BASES.find((char) toupper(c));
+            c = base == std::string::npos ? 'N' : BASES[3 - base];
+        }
+    }
+    residues.clear();
+    for (size_t i = frame % 3; i + 3 <= strand.size(); i += 3) {
+        codon = 0;
+        for (size_t j = i; j < i + 3 && codon >= 0; j++) {
+            base = BASES.find((char) toupper(strand[j]));
+            codon = base == std::string::npos ? -1 : codon * 4 + (int) base;
+        }
+        residues.push_back(codon < 0 ? encode('X') : encode(CODON_TABLE[codon]));
+    }
+}
+
+void SmithWaterman::index_database() {
+    uint32 kmer_count = 1;
+    uint32 kmer;
+    std::vector<uint32> positions;
+
+    for (uint8 i = 0; i < KMER_SIZE; i++) kmer_count *= STANDARD_SIZE;
+    _kmer_offsets.assign(kmer_count + 1, 0);
+
+    // Count then fill each k-mer's entries
+    for (uint8 pass = 0; pass < 2; pass++) {
+        if (pass == 1) {
+            for (uint32 i = 1; i <= kmer_count; i++) _kmer_offsets[i] += _kmer_offsets[i - 1];
+            _kmer_entries.resize(_kmer_offsets[kmer_count]);
+            positions.assign(_kmer_offsets.begin(), _kmer_offsets.end() - 1);
+        }
+        for (uint32 s = 0; s < _subjects.size(); s++) {
+            const std::vector<uint8> &residues = _subjects[s].residues;
+            for (uint32 p = 0; p + KMER_SIZE <= residues.size(); p++) {
+                kmer = 0;
+                for (uint8 k = 0; k < KMER_SIZE && kmer < kmer_count; k++) {
+                    kmer = residues[p + k] < STANDARD_SIZE ? kmer * STANDARD_SIZE + residues[p + k] : kmer_count;
+                }
+                if (kmer >= kmer_count) continue;
+                if (pass == 0) {
+                    _kmer_offsets[kmer + 1]++;
+                } else {
+                    _kmer_entries[positions[kmer]++] = {s, p};
+                }
+            }
+        }
+    }
+}
+
+/**
+ * ======================================================================
+ * Function void SmithWaterman::find_candidates(const std::vector<uint8> &query,
+ *                                              Workspace &workspace)
+ *
+ * Description          - Subjects sharing at least MIN_DIAGONAL_HITS k-mers
+ *                        with the query on the same diagonal
+ *
+ * Notes                - Candidates written to workspace.candidates
+ *
+ * @param query         - Encoded query (frame)
+ * @param workspace     - Thread buffers
+ *
+ * @return              - None
+ *
+ * =====================================================================
+ */
+void SmithWaterman::find_candidates(const std::vector<uint8> &query, Workspace &workspace) {
+    std::vector<uint64> &diagonals = workspace.diagonals;
+    uint32 kmer_count = (uint32) _kmer_offsets.size() - 1;
+    uint32 kmer;
+    uint32 run;
+
+    diagonals.clear();
+    workspace.candidates.clear();
+    for (uint32 q = 0; q + KMER_SIZE <= query.size(); q++) {
+        kmer = 0;
+        for (uint8 k = 0; k < KMER_SIZE && kmer < kmer_count; k++) {
+            kmer = query[q + k] < STANDARD_SIZE ? kmer * STANDARD_SIZE + query[q + k] : kmer_count;
+        }
+        if (kmer >= kmer_count || _kmer_offsets[kmer + 1] - _kmer_offsets[kmer] > MAX_KMER_ENTRIES) continue;
+        for (uint32 i = _kmer_offsets[kmer]; i < _kmer_offsets[kmer + 1]; i++) {
+            // Diagonal offset by query length to stay positive
+            diagonals.push_back(((uint64) _kmer_entries[i].subject << 32) |
+                                (uint32) (_kmer_entries[i].position + query.size() - q));
+        }
+    }
+    std::sort(diagonals.begin(), diagonals.end());
+
+    for (uint64 i = 0; i < diagonals.size(); i += run) {
+        for (run = 1; i + run < diagonals.size() && diagonals[i + run] == diagonals[i]; run++);
+        if (run >= MIN_DIAGONAL_HITS) {
+            uint32 subject = (uint32) (diagonals[i] >> 32);
+            if (workspace.candidates.empty() || workspace.candidates.back() != subject) {
+                workspace.candidates.push_back(subject);
+            }
+        }
+    }
+}
+
+// Farrar striped layout: lane l of segment i holds query position l * seg_len + i
+void SmithWaterman::build_profile(const std::vector<uint8> &query, Workspace &workspace) {
+    uint32 seg_len = (uint32) (query.size() + _simd_lanes - 1) / _simd_lanes;
+    uint32 pos;
+
+    workspace.profile.resize(ALPHABET_SIZE * seg_len * _simd_lanes);
+    for (uint8 a = 0; a < ALPHABET_SIZE; a++) {
+        int16 *p = &workspace.profile[a * seg_len * _simd_lanes];
+        for (uint32 i = 0; i < seg_len; i++) {
+            for (uint32 l = 0; l < _simd_lanes; l++) {
+                pos = l * seg_len + i;
+                *p++ = pos < query.size() ? BLOSUM62[a][query[pos]] : PAD_SCORE;
+            }
+        }
+    }
+}
+
+/**
+ * ======================================================================
+ * Function int32 SmithWaterman::striped_score(const std::vector<uint8> &query,
+ *                                             const std::vector<uint8> &subject,
+ *                                             Workspace &workspace)
+ *
+ * Description          - Local alignment score with affine gaps using
+ *                        Farrar's striped Smith-Waterman on 16-bit lanes
+ *
+ * Notes                - Profile must be built for query beforehand
+ *                      - Saturated scores are recomputed without SIMD
+ *
+ * @param query         - Encoded query (frame)
+ * @param subject       - Encoded subject
+ * @param workspace     - Thread buffers
+ *
+ * @return              - Best local alignment score
+ *
+ * =====================================================================
+ */
+int32 SmithWaterman::striped_score(const std::vector<uint8> &query, const std::vector<uint8> &subject,
+                                   Workspace &workspace) {
+    const uint32 seg_len = (uint32) (query.size() + _simd_lanes - 1) / _simd_lanes;
+    int32 score;
+
+    workspace.h_store.assign(seg_len * _simd_lanes, 0);
+    workspace.h_load.assign(seg_len * _simd_lanes, 0);
+    workspace.e.assign(seg_len * _simd_lanes, 0);
+    score = _striped_kernel(workspace.profile.data(), seg_len, subject, workspace.h_store.data(),
+                            workspace.h_load.data(), workspace.e.data(),
+                            (int16) (GAP_OPEN + GAP_EXTEND), (int16) GAP_EXTEND);
+    if (score >= SATURATED_SCORE) {
+        Alignment alignment;
+        align(query, subject, workspace, alignment);
+        score = alignment.score;
+    }
+    return score;
+}
+
+/**
+ * ======================================================================
+ * Function void SmithWaterman::select_kernel()
+ *
+ * Description          - Picks the widest striped kernel the CPU supports
+ *                        (AVX2, SSE2, then single lane)
+ *
+ * Notes                - Checked at runtime so one build runs on any x86-64
+ *                        node, query profiles use the kernel's lane count
+ *
+ * @return              - None
+ *
+ * =====================================================================
+ */
+void SmithWaterman::select_kernel() {
+#if defined(SW_SIMD_X86)
+    if (__builtin_cpu_supports("avx2")) {
+        _striped_kernel = striped_avx2::striped_score;
+        _simd_lanes     = striped_avx2::SIMD_LANES;
+        FS_dprint("Smith-Waterman using AVX2");
+        return;
+    }
+#endif
+#if defined(SW_SIMD_X86) && defined(__SSE2__)
+    _striped_kernel = striped_sse2::striped_score;
+    _simd_lanes     = striped_sse2::SIMD_LANES;
+    FS_dprint("Smith-Waterman using SSE2");
+#else
+    _striped_kernel = striped_scalar::striped_score;
+    _simd_lanes     = striped_scalar::SIMD_LANES;
+    FS_dprint("Smith-Waterman using single lane kernel");
+#endif
+}
+
+/**
+ * ======================================================================
+ * Function void SmithWaterman::align(const std::vector<uint8> &query,
+ *                                    const std::vector<uint8> &subject,
+ *                                    Workspace &workspace,
+ *                                    Alignment &alignment)
+ *
+ * Description          - Gotoh local alignment with traceback to report
+ *                        coordinates, identities, mismatches and gaps
+ *
+ * Notes                - Only ran on hits passing the e-value, traceback
+ *                        uses a byte per cell
+ *
+ * @param query         - Encoded query (frame)
+ * @param subject       - Encoded subject
+ * @param workspace     - Thread buffers
+ * @param alignment     - Alignment found (subject/frame left unchanged)
+ *
+ * @return              - None
+ *
+ * =====================================================================
+ */
+void SmithWaterman::align(const std::vector<uint8> &query, const std::vector<uint8> &subject,
+                          Workspace &workspace, Alignment &alignment) {
+    const uint32 rows = (uint32) query.size();
+    const uint32 cols = (uint32) subject.size();
+    const int32  gap_first = GAP_OPEN + GAP_EXTEND;
+    std::vector<int32> &h_row = workspace.h_row;        // H of the previous row, then current row
+    std::vector<int32> &f_row = workspace.f_row;
+    std::vector<uint8> &traceback = workspace.traceback;
+    int32  h_diag;
+    int32  h;
+    int32  e;
+    uint8  flags;
+    uint32 best_i = 0;
+    uint32 best_j = 0;
+    uint32 i;
+    uint32 j;
+    uint8  state = 0;                                   // 0 H, 2 E, 3 F
+
+    alignment.score = 0;
+    h_row.assign(cols + 1, 0);
+    f_row.assign(cols + 1, INT32_MIN / 2);
+    traceback.assign((uint64) (rows + 1) * (cols + 1), 0);
+
+    for (i = 1; i <= rows; i++) {
+        const int8 *scores = BLOSUM62[query[i - 1]];
+        uint8 *tb_row = &traceback[(uint64) i * (cols + 1)];
+        h_diag = 0;
+        h = 0;
+        e = INT32_MIN / 2;
+        h_row[0] = 0;
+        for (j = 1; j <= cols; j++) {
+            flags = 0;
+            // Horizontal gap (E) from the left, vertical gap (F) from above
+            if (e - GAP_EXTEND >= h - gap_first) {
+                e -= GAP_EXTEND;
+                flags |= TB_E_EXTEND;
+            } else {
+                e = h - gap_first;
+            }
+            if (f_row[j] - GAP_EXTEND >= h_row[j] - gap_first) {
+                f_row[j] -= GAP_EXTEND;
+                flags |= TB_F_EXTEND;
+            } else {
+                f_row[j] = h_row[j] - gap_first;
+            }
+
+            h = h_diag + scores[subject[j - 1]];
+            flags |= 1;
+            if (e > h) {
+                h = e;
+                flags = (uint8) ((flags & ~TB_SOURCE_MASK) | 2);
+            }
+            if (f_row[j] > h) {
+                h = f_row[j];
+                flags = (uint8) ((flags & ~TB_SOURCE_MASK) | 3);
+            }
+            if (h <= 0) {
+                h = 0;
+                flags &= ~TB_SOURCE_MASK;
+            }
+            tb_row[j] = flags;
+            h_diag = h_row[j];
+            h_row[j] = h;
+            if (h > alignment.score) {
+                alignment.score = h;
+                best_i = i;
+                best_j = j;
+            }
+        }
+    }
+
+    alignment.query_end    = best_i;
+    alignment.subject_end  = best_j;
+    alignment.length       = 0;
+    alignment.identities   = 0;
+    alignment.mismatches   = 0;
+    alignment.gap_openings = 0;
+    i = best_i;
+    j = best_j;
+    while (i > 0 && j > 0) {
+        flags = traceback[(uint64) i * (cols + 1) + j];
+        if (state == 0) {
+            state = flags & TB_SOURCE_MASK;
+            if (state == 0) break;
+            if (state == 1) {
+                query[i - 1] == subject[j - 1] ? alignment.identities++ : alignment.mismatches++;
+                alignment.length++;
+                i--;
+                j--;
+                state = 0;
+            } else {
+                alignment.gap_openings++;
+            }
+        } else if (state == 2) {
+            alignment.length++;
+            j--;
+            state = (flags & TB_E_EXTEND) ? (uint8) 2 : (uint8) 0;
+        } else {
+            alignment.length++;
+            i--;
+            state = (flags & TB_F_EXTEND) ? (uint8) 3 : (uint8) 0;
+        }
+    }
+    alignment.query_begin   = i;
+    alignment.subject_begin = j;
+}
+
+fp64 SmithWaterman::get_bit_score(int32 score) {
+    return (LAMBDA * score - std::log(K)) / std::log(2.0);
+}
+
+// As DIAMOND, database letters * query length * 2^-bits
+fp64 SmithWaterman::get_evalue(int32 score, uint64 query_length) {
+    return (fp64) _database_letters * query_length * std::pow(2.0, -get_bit_score(score));
+}
+
+/**
+ * ======================================================================
+ * Function void SmithWaterman::search_query(SearchParams &params,
+ *                                           std::string &query_id,
+ *                                           std::string &query_seq,
+ *                                           Workspace &workspace,
+ *                                           std::vector<DiamondHit> &hits)
+ *
+ * Description          - Searches one query (all six frames for blastx),
+ *                        keeping the best alignment for each subject
+ *
+ * Notes                - Targets are limited by score before coverage is
+ *                        checked, as DIAMOND does
+ *
+ * @param params        - Search parameters
+ * @param query_id      - Query ID (qseqid)
+ * @param query_seq     - Query sequence
+ * @param workspace     - Thread buffers
+ * @param hits          - Hits for this query, best first
+ *
+ * @return              - None
+ *
+ * =====================================================================
+ */
+void SmithWaterman::search_query(SearchParams &params, std::string &query_id, std::string &query_seq,
+                                 Workspace &workspace, std::vector<DiamondHit> &hits) {
+    std::vector<std::vector<uint8>> frames;
+    std::map<uint32, Alignment>     best_alignments;     // Subject -> best alignment
+    std::vector<Alignment>          alignments;
+    Alignment                       alignment;
+    int32                           score;
+    uint32                          source_length;
+    std::stringstream               ss;
+
+    if (params.blastp) {
+        frames.resize(1);
+        for (char c : query_seq) frames[0].push_back(encode(c));
+        source_length = (uint32) frames[0].size();
+    } else {
+        frames.resize(6);
+        for (uint8 f = 0; f < 6; f++) translate(query_seq, f, frames[f]);
+        source_length = (uint32) query_seq.size();
+    }
+
+    for (uint8 f = 0; f < frames.size(); f++) {
+        std::vector<uint8> &frame = frames[f];
+        if (frame.size() < KMER_SIZE) continue;
+        find_candidates(frame, workspace);
+        if (workspace.candidates.empty()) continue;
+        build_profile(frame, workspace);
+
+        for (uint32 subject : workspace.candidates) {
+            score = striped_score(frame, _subjects[subject].residues, workspace);
+            if (score <= 0 || get_evalue(score, frames[0].size()) > params.eval) continue;
+            auto it = best_alignments.find(subject);
+            if (it != best_alignments.end() && it->second.score >= score) continue;
+            align(frame, _subjects[subject].residues, workspace, alignment);
+            alignment.subject = subject;
+            alignment.frame   = f;
+            best_alignments[subject] = alignment;
+        }
+    }
+    if (best_alignments.empty()) return;
+
+    for (auto &pair : best_alignments) alignments.push_back(pair.second);
+    std::stable_sort(alignments.begin(), alignments.end(),
+                     [](const Alignment &a, const Alignment &b) {return a.score > b.score;});
+    if (params.max_targets > 0) {
+        if (alignments.size() > params.max_targets) alignments.resize(params.max_targets);
+    } else {
+        const int32 top_score = alignments.front().score;
+        alignments.erase(std::find_if(alignments.begin(), alignments.end(), [&](const Alignment &a) {
+            return (1.0 - (fp64) a.score / top_score) * 100 > params.top_percent;
+        }), alignments.end());
+    }
+
+    for (Alignment &a : alignments) {
+        const Sequence &subject = _subjects[a.subject];
+        uint32 query_covered = params.blastp ? a.query_end - a.query_begin : 3 * (a.query_end - a.query_begin);
+        fp64   coverage = (fp64) query_covered * 100 / source_length;
+        fp64   subject_coverage = (fp64) (a.subject_end - a.subject_begin) * 100 / subject.residues.size();
+        if (coverage < params.qcoverage || subject_coverage < params.tcoverage) continue;
+
+        DiamondHit hit;
+        hit.qseqid   = query_id;
+        hit.sseqid   = subject.id;
+        hit.stitle   = subject.title;
+        hit.length   = std::to_string(a.length);
+        hit.mismatch = std::to_string(a.mismatches);
+        hit.gapopen  = std::to_string(a.gap_openings);
+        hit.sstart   = std::to_string(a.subject_begin + 1);
+        hit.send     = std::to_string(a.subject_end);
+        if (params.blastp) {
+            hit.qstart = std::to_string(a.query_begin + 1);
+            hit.qend   = std::to_string(a.query_end);
+        } else if (a.frame < 3) {
+            hit.qstart = std::to_string(a.frame + 3 * a.query_begin + 1);
+            hit.qend   = std::to_string(a.frame + 3 * a.query_end);
+        } else {
+            // Reverse frames are reported from the query's end as DIAMOND does
+            hit.qstart = std::to_string(source_length - (a.frame - 3) - 3 * a.query_begin);
+            hit.qend   = std::to_string(source_length - (a.frame - 3) - 3 * a.query_end + 1);
+        }
+        ss.str("");
+        ss << std::fixed << std::setprecision(1) << (fp64) a.identities * 100 / a.length;
+        hit.pident   = ss.str();
+        ss.str("");
+        ss << std::fixed << std::setprecision(1) << get_bit_score(a.score);
+        hit.bitscore = ss.str();
+        hit.evalue   = get_evalue(a.score, frames[0].size());
+        hit.coverage = coverage;
+        hits.push_back(std::move(hit));
+    }
+}
@@ -0,0 +1,138 @@
+/*
+ *
+ * Developed by Alexander Hart
+ * Plant Computational Genomics Lab
+ * University of Connecticut
+ *
+ * For information, contact Alexander Hart at:
+ *     entap.dev@gmail.com
+ *
+ * Copyright 2017-2019, Alexander Hart, Dr. Jill Wegrzyn
+ *
+ * This file is part of EnTAP.
+ *
+ * EnTAP is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * EnTAP is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with EnTAP.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef ENTAP_SMITHWATERMAN_H
+#define ENTAP_SMITHWATERMAN_H
+
+//*********************** Includes *****************************
+#include "../common.h"
+#include "DiamondLinked.h"
+//**************************************************************
+
+// Built-in aligner for small FASTA databases, reports hits as DIAMOND would
+class SmithWaterman {
+
+public:
+    struct SearchParams {
+        std::string query_path;
+        bool        blastp;
+        fp64        eval;
+        fp32        qcoverage;
+        fp32        tcoverage;
+        fp32        top_percent;    // Targets within this percent of the best score
+        uint32      max_targets;    // Used instead of top_percent when > 0
+        uint16      threads;
+    };
+
+    SmithWaterman(std::string &database_path);
+    ~SmithWaterman() = default;
+    void search(SearchParams &params, std::vector<DiamondHit> &hits);
+    static uint64 count_sequences(const std::string &fasta_path);
+
+private:
+    struct Sequence {
+        std::string         id;
+        std::string         title;
+        std::vector<uint8>  residues;
+    };
+
+    struct KmerEntry {
+        uint32 subject;
+        uint32 position;
+    };
+
+    struct Alignment {
+        int32  score;
+        uint32 subject;
+        uint8  frame;               // Query frame (blastx), 0-2 forward and 3-5 reverse
+        uint32 query_begin;         // Residue range within frame, end exclusive
+        uint32 query_end;
+        uint32 subject_begin;
+        uint32 subject_end;
+        uint32 length;
+        uint32 identities;
+        uint32 mismatches;
+        uint32 gap_openings;
+    };
+
+    // Buffers reused between queries by a thread
+    struct Workspace {
+        std::vector<int16>  profile;
+        std::vector<int16>  h_store;
+        std::vector<int16>  h_load;
+        std::vector<int16>  e;
+        std::vector<uint64> diagonals;
+        std::vector<uint32> candidates;
+        std::vector<int32>  h_row;
+        std::vector<int32>  f_row;
+        std::vector<uint8>  traceback;
+    };
+
+    typedef int32 (*striped_kernel_t)(const int16 *profile, uint32 seg_len, const std::vector<uint8> &subject,
+                                      int16 *h_store, int16 *h_load, int16 *e, int16 gap_open, int16 gap_extend);
+
+    static const uint8  ALPHABET_SIZE   = 24;
+    static const uint8  STANDARD_SIZE   = 20;      // Residues used for k-mers
+    static const int8   BLOSUM62[ALPHABET_SIZE][ALPHABET_SIZE];
+    static const std::string ALPHABET;
+    static const std::string CODON_TABLE;
+
+    const int32  GAP_OPEN           = 11;          // DIAMOND/BLAST defaults with BLOSUM62
+    const int32  GAP_EXTEND         = 1;
+    const fp64   LAMBDA             = 0.267;
+    const fp64   K                  = 0.041;
+    const uint8  KMER_SIZE          = 3;
+    const uint8  MIN_DIAGONAL_HITS  = 2;           // Shared k-mers on a diagonal to align a subject
+    const uint32 MAX_KMER_ENTRIES   = 4096;        // Skip k-mers repeated more than this (low complexity)
+    const int16  PAD_SCORE          = -1024;       // Striped profile beyond the query
+    const int32  SATURATED_SCORE    = 32000;       // 16-bit scores at or above are recomputed
+
+    std::vector<Sequence>   _subjects;
+    std::vector<uint32>     _kmer_offsets;
+    std::vector<KmerEntry>  _kmer_entries;
+    uint64                  _database_letters;
+    striped_kernel_t        _striped_kernel;        // Widest instruction set the CPU supports
+    uint32                  _simd_lanes;            // 16-bit lanes of _striped_kernel
+
+    static void read_fasta(std::string &path, std::function<void(std::string&, std::string&)> add_sequence);
+    static uint8 encode(char residue);
+    static void translate(const std::string &nucleotides, uint8 frame, std::vector<uint8> &residues);
+    void select_kernel();
+    void index_database();
+    void find_candidates(const std::vector<uint8> &query, Workspace &workspace);
+    void build_profile(const std::vector<uint8> &query, Workspace &workspace);
+    int32 striped_score(const std::vector<uint8> &query, const std::vector<uint8> &subject, Workspace &workspace);
+    void align(const std::vector<uint8> &query, const std::vector<uint8> &subject, Workspace &workspace,
+               Alignment &alignment);
+    fp64 get_bit_score(int32 score);
+    fp64 get_evalue(int32 score, uint64 query_length);
+    void search_query(SearchParams &params, std::string &query_id, std::string &query_seq,
+                      Workspace &workspace, std::vector<DiamondHit> &hits);
+};
+
+
+#endif //ENTAP_SMITHWATERMAN_H
@@ -0,0 +1,158 @@
+/*
+ *
+ * Developed by Alexander Hart
+ * Plant Computational Genomics Lab
+ * University of Connecticut
+ *
+ * For information, contact Alexander Hart at:
+ *     entap.dev@gmail.com
+ *
+ * Copyright 2017-2019, Alexander Hart, Dr. Jill Wegrzyn
+ *
+ * This file is part of EnTAP.
+ *
+ * EnTAP is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * EnTAP is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with EnTAP.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// No include guard, included by SmithWaterman.cpp once per instruction set with:
+//   SW_SIMD_NAMESPACE  - Namespace for this instruction set
+//   SW_SIMD_TARGET     - Function attribute selecting the instruction set (may be empty)
+//   SW_SIMD_AVX2 or SW_SIMD_SSE2, neither for the single lane fallback
+
+// 16-bit striped vector operations
+namespace SW_SIMD_NAMESPACE {
+#if defined(SW_SIMD_AVX2)
+    typedef __m256i simd_t;
+    const uint32 SIMD_LANES = 16;
+    SW_SIMD_TARGET inline simd_t simd_load(const int16 *p) {return _mm256_loadu_si256((const __m256i*)p);}
+    SW_SIMD_TARGET inline void simd_store(int16 *p, simd_t v) {_mm256_storeu_si256((__m256i*)p, v);}
+    SW_SIMD_TARGET inline simd_t simd_set1(int16 x) {return _mm256_set1_epi16(x);}
+    SW_SIMD_TARGET inline simd_t simd_adds(simd_t a, simd_t b) {return _mm256_adds_epi16(a, b);}
+    SW_SIMD_TARGET inline simd_t simd_subs(simd_t a, simd_t b) {return _mm256_subs_epi16(a, b);}
+    SW_SIMD_TARGET inline simd_t simd_max(simd_t a, simd_t b) {return _mm256_max_epi16(a, b);}
+    SW_SIMD_TARGET inline bool simd_any_gt(simd_t a, simd_t b) {return _mm256_movemask_epi8(_mm256_cmpgt_epi16(a, b)) != 0;}
+    // Shift every lane up by one, zero into lane 0 (crosses the 128-bit halves)
+    SW_SIMD_TARGET inline simd_t simd_shift(simd_t v) {
+        return _mm256_alignr_epi8(v, _mm256_permute2x128_si256(v, v, 0x08), 14);
+    }
+#elif defined(SW_SIMD_SSE2)
+    typedef __m128i simd_t;
+    const uint32 SIMD_LANES = 8;
+    SW_SIMD_TARGET inline simd_t simd_load(const int16 *p) {return _mm_loadu_si128((const __m128i*)p);}
+    SW_SIMD_TARGET inline void simd_store(int16 *p, simd_t v) {_mm_storeu_si128((__m128i*)p, v);}
+    SW_SIMD_TARGET inline simd_t simd_set1(int16 x) {return _mm_set1_epi16(x);}
+    SW_SIMD_TARGET inline simd_t simd_adds(simd_t a, simd_t b) {return _mm_adds_epi16(a, b);}
+    SW_SIMD_TARGET inline simd_t simd_subs(simd_t a, simd_t b) {return _mm_subs_epi16(a, b);}
+    SW_SIMD_TARGET inline simd_t simd_max(simd_t a, simd_t b) {return _mm_max_epi16(a, b);}
+    SW_SIMD_TARGET inline bool simd_any_gt(simd_t a, simd_t b) {return _mm_movemask_epi8(_mm_cmpgt_epi16(a, b)) != 0;}
+    SW_SIMD_TARGET inline simd_t simd_shift(simd_t v) {return _mm_slli_si128(v, 2);}
+#else
+    // Single lane fallback, same algorithm
+    typedef int16 simd_t;
+    const uint32 SIMD_LANES = 1;
+    inline int16 saturate(int32 x) {return (int16)std::max<int32>(INT16_MIN, std::min<int32>(INT16_MAX, x));}
+    inline simd_t simd_load(const int16 *p) {return *p;}
+    inline void simd_store(int16 *p, simd_t v) {*p = v;}
+    inline simd_t simd_set1(int16 x) {return x;}
+    inline simd_t simd_adds(simd_t a, simd_t b) {return saturate((int32)a + b);}
+    inline simd_t simd_subs(simd_t a, simd_t b) {return saturate((int32)a - b);}
+    inline simd_t simd_max(simd_t a, simd_t b) {return std::max(a, b);}
+    inline bool simd_any_gt(simd_t a, simd_t b) {return a > b;}
+    inline simd_t simd_shift(simd_t) {return 0;}
+#endif
+
+    /**
+     * ======================================================================
+     * Function int32 striped_score(const int16 *profile, uint32 seg_len,
+     *                              const std::vector<uint8> &subject, int16 *h_store,
+     *                              int16 *h_load, int16 *e, int16 gap_open, int16 gap_extend)
+     *
+     * Description          - Local alignment score with affine gaps using
+     *                        Farrar's striped Smith-Waterman on 16-bit lanes
+     *
+     * Notes                - Buffers hold seg_len * SIMD_LANES scores and
+     *                        must be zeroed
+     *                      - Scores saturate at INT16_MAX
+     *
+     * @param profile       - Striped query profile (SIMD_LANES layout)
+     * @param seg_len       - Segments per profile row
+     * @param subject       - Encoded subject
+     * @param h_store       - H buffer
+     * @param h_load        - H buffer
+     * @param e             - E buffer
+     * @param gap_open      - Penalty of the first gap residue
+     * @param gap_extend    - Penalty of each further gap residue
+     *
+     * @return              - Best local alignment score
+     *
+     * =====================================================================
+     */
+    SW_SIMD_TARGET int32 striped_score(const int16 *profile, uint32 seg_len, const std::vector<uint8> &subject,
+                                       int16 *h_store, int16 *h_load, int16 *e, int16 gap_open, int16 gap_extend) {
+        const simd_t v_zero  = simd_set1(0);
+        const simd_t v_gap_o = simd_set1(gap_open);
+        const simd_t v_gap_e = simd_set1(gap_extend);
+        simd_t v_max = v_zero;
+        simd_t v_h;
+        simd_t v_e;
+        simd_t v_f;
+        int16  lanes[SIMD_LANES];
+        int32  score = 0;
+
+        for (uint8 residue : subject) {
+            const int16 *residue_profile = profile + residue * seg_len * SIMD_LANES;
+
+            v_f = v_zero;
+            v_h = simd_shift(simd_load(h_store + (seg_len - 1) * SIMD_LANES));
+            std::swap(h_load, h_store);
+
+            for (uint32 i = 0; i < seg_len; i++) {
+                v_h = simd_adds(v_h, simd_load(residue_profile + i * SIMD_LANES));
+                v_e = simd_load(e + i * SIMD_LANES);
+                v_h = simd_max(simd_max(v_h, v_e), simd_max(v_f, v_zero));
+                v_max = simd_max(v_max, v_h);
+                simd_store(h_store + i * SIMD_LANES, v_h);
+
+                v_h = simd_subs(v_h, v_gap_o);
+                simd_store(e + i * SIMD_LANES, simd_max(simd_subs(v_e, v_gap_e), v_h));
+                v_f = simd_max(simd_subs(v_f, v_gap_e), v_h);
+                v_h = simd_load(h_load + i * SIMD_LANES);
+            }
+
+            // Lazy F, carry vertical gaps across lanes until they no longer change H
+            for (uint32 l = 0; l < SIMD_LANES; l++) {
+                bool done = false;
+                v_f = simd_shift(v_f);
+                for (uint32 i = 0; i < seg_len; i++) {
+                    v_h = simd_max(simd_load(h_store + i * SIMD_LANES), v_f);
+                    simd_store(h_store + i * SIMD_LANES, v_h);
+                    v_max = simd_max(v_max, v_h);
+                    v_h = simd_subs(v_h, v_gap_o);
+                    // Horizontal gaps may open from the corrected H
+                    simd_store(e + i * SIMD_LANES, simd_max(simd_load(e + i * SIMD_LANES), v_h));
+                    v_f = simd_subs(v_f, v_gap_e);
+                    if (!simd_any_gt(v_f, v_h)) {
+                        done = true;
+                        break;
+                    }
+                }
+                if (done) break;
+            }
+        }
+
+        simd_store(lanes, v_max);
+        for (int16 lane : lanes) score = std::max<int32>(score, lane);
+        return score;
+    }
+}
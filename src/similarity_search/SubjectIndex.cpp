@@ -0,0 +1,316 @@
+/*
+ *
+ * Developed by Alexander Hart
+ * Plant Computational Genomics Lab
+ * University of Connecticut
+ *
+ * For information, contact Alexander Hart at:
+ *     entap.dev@gmail.com
+ *
+ * Copyright 2017-2019, Alexander Hart, Dr. Jill Wegrzyn
+ *
+ * This file is part of EnTAP.
+ *
+ * EnTAP is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * EnTAP is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with EnTAP.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+//*********************** Includes *****************************
+#include "SubjectIndex.h"
+#include "SimSearchCache.h"
+#include "AbstractSimilaritySearch.h"
+#include "../PatternMatcher.h"
+#include "../ExceptionHandler.h"
+//**************************************************************
+
+const std::string SubjectIndex::INDEX_EXT = ".subjects";
+const uint64 SubjectIndex::INDEX_MAGIC;
+const uint32 SubjectIndex::INDEX_VERSION;
+
+SubjectIndex::SubjectIndex() {
+    _informative_valid = false;
+}
+
+
+/**
+ * ======================================================================
+ * Function uint64 SubjectIndex::build(FileSystem *filesystem, std::string &fasta_path,
+ *                                     std::string &index_path,
+ *                                     const vect_str_t &uninformative)
+ *
+ * Description          - Parses every header of a database FASTA once for
+ *                        species, UniProt accession and informativeness
+ *                        and writes the subject index
+ *
+ * Notes                - Written to a temporary file and renamed, so a
+ *                        partial index is never loaded
+ *                      - Duplicate subject IDs keep the first header, as
+ *                        DIAMOND reports the same ID for both
+ *                      - Different subject IDs with the same hash are
+ *                        kept next to each other, find() compares IDs
+ *
+ * @param filesystem    - Filesystem
+ * @param fasta_path    - Database FASTA (uncompressed)
+ * @param index_path    - Output path of index
+ * @param uninformative - Uninformative terms titles are checked against
+ *
+ * @return              - Number of subjects indexed
+ *
+ * =====================================================================
+ */
+uint64 SubjectIndex::build(FileSystem *filesystem, std::string &fasta_path, std::string &index_path,
+                           const vect_str_t &uninformative) {
+    std::string         line;
+    std::string         title;
+    std::string         sseqid;
+    std::string         species;
+    std::string         ids;
+    std::string         temp_path;
+    std::vector<SubjectInfo> subjects;
+    vect_str_t          species_table;
+    std::unordered_map<std::string, uint32> species_ids;
+    PatternMatcher      uninformative_matcher(uninformative);
+    SubjectInfo         info;
+    uint64              headers=0;
+    uint64              terms_hash;
+    uint64              count;
+    uint64              kept=0;
+    uint64              prev;
+    bool                duplicate;
+    uint32              length;
+
+    FS_dprint("Building subject index for: " + fasta_path);
+
+    std::ifstream in_file(fasta_path);
+    if (!in_file.is_open()) {
+        throw ExceptionHandler("Unable to read database to index subjects: " + fasta_path,
+                               ERR_ENTAP_INIT_INDX_DATABASE);
+    }
+    while (std::getline(in_file, line)) {
+        if (line.empty() || line[0] != FileSystem::FASTA_FLAG) continue;
+        if (line.back() == '\r') line.pop_back();
+        headers++;
+
+        title  = line.substr(1);
+        sseqid = title.substr(0, title.find_first_of(" \t"));
+        info   = {};
+        info.id_hash   = hash_id(sseqid);
+        info.id_offset = ids.size();
+        info.id_length = (uint32) sseqid.size();
+        ids.append(sseqid);
+
+        species = AbstractSimilaritySearch::get_species(title);
+        auto it = species_ids.emplace(species, (uint32) species_table.size());
+        if (it.second) species_table.push_back(species);
+        info.species = it.first->second;
+
+        // UniProt subject, sp|Q9FJZ9|PER72_ARATH
+        if (sseqid.compare(0, 3, "sp|") == 0 || sseqid.compare(0, 3, "tr|") == 0) {
+            info.flags |= SUBJECT_UNIPROT;
+            info.accession_start = (uint16) std::min(sseqid.rfind('|') + 1, (size_t) UINT16_MAX);
+        }
+        if (!uninformative_matcher.contains_any(title)) info.flags |= SUBJECT_INFORMATIVE;
+        subjects.push_back(info);
+    }
+    in_file.close();
+
+    std::stable_sort(subjects.begin(), subjects.end(), [](const SubjectInfo &a, const SubjectInfo &b) {
+        return a.id_hash < b.id_hash;
+    });
+    for (SubjectInfo &subject : subjects) {
+        // Check every kept subject with this hash, collisions are kept
+        duplicate = false;
+        for (prev = kept; !duplicate && prev > 0 && subjects[prev - 1].id_hash == subject.id_hash; prev--) {
+            duplicate = same_id(ids, subjects[prev - 1], subject);
+        }
+        if (duplicate) continue;
+        subjects[kept++] = subject;
+    }
+    subjects.resize(kept);
+
+    temp_path  = index_path + ".tmp";
+    terms_hash = hash_terms(uninformative);
+    std::ofstream out_file(temp_path, std::ios::out | std::ios::binary | std::ios::trunc);
+    out_file.write((const char*) &INDEX_MAGIC, sizeof(INDEX_MAGIC));
+    out_file.write((const char*) &INDEX_VERSION, sizeof(INDEX_VERSION));
+    out_file.write((const char*) &terms_hash, sizeof(terms_hash));
+    out_file.write((const char*) &headers, sizeof(headers));
+    length = (uint32) species_table.size();
+    out_file.write((const char*) &length, sizeof(length));
+    for (std::string &name : species_table) {
+        length = (uint32) name.size();
+        out_file.write((const char*) &length, sizeof(length));
+        out_file.write(name.data(), length);
+    }
+    count = ids.size();
+    out_file.write((const char*) &count, sizeof(count));
+    out_file.write(ids.data(), count);
+    count = subjects.size();
+    out_file.write((const char*) &count, sizeof(count));
+    out_file.write((const char*) subjects.data(), count * sizeof(SubjectInfo));
+    out_file.close();
+    if (!out_file || !filesystem->rename_file(temp_path, index_path)) {
+        filesystem->delete_file(temp_path);
+        throw ExceptionHandler("Unable to write subject index to: " + index_path, ERR_ENTAP_INIT_INDX_DATABASE);
+    }
+
+    FS_dprint("Success! Indexed " + std::to_string(subjects.size()) + " subjects (" +
+              std::to_string(species_table.size()) + " species) to: " + index_path);
+    return subjects.size();
+}
+
+
+/**
+ * ======================================================================
+ * Function bool SubjectIndex::load(std::string &index_path,
+ *                                  const vect_str_t &uninformative,
+ *                                  uint64 subjects)
+ *
+ * Description          - Reads a subject index written by build()
+ *                      - Informative flags are only used if the index was
+ *                        built with the same uninformative terms
+ *
+ * Notes                - Index is rejected if it does not have the same
+ *                        number of subjects as the DIAMOND database, as
+ *                        the database was rebuilt since
+ *                      - Index is rejected if any table size or offset is
+ *                        outside of the file (truncated/corrupt)
+ *
+ * @param index_path    - Path to subject index
+ * @param uninformative - Uninformative terms of this run
+ * @param subjects      - Sequences in DIAMOND database, 0 if unknown
+ *
+ * @return              - True if index can be used
+ *
+ * =====================================================================
+ */
+bool SubjectIndex::load(std::string &index_path, const vect_str_t &uninformative, uint64 subjects) {
+    uint64  magic=0;
+    uint32  version=0;
+    uint64  terms_hash;
+    uint64  headers;
+    uint64  file_size;
+    uint64  count;
+    uint32  length;
+    bool    valid=true;
+
+    std::ifstream in_file(index_path, std::ios::in | std::ios::binary | std::ios::ate);
+    if (!in_file.is_open()) return false;
+    file_size = (uint64) in_file.tellg();
+    in_file.seekg(0);
+    in_file.read((char*) &magic, sizeof(magic));
+    in_file.read((char*) &version, sizeof(version));
+    in_file.read((char*) &terms_hash, sizeof(terms_hash));
+    in_file.read((char*) &headers, sizeof(headers));
+    if (!in_file || magic != INDEX_MAGIC || version != INDEX_VERSION) {
+        FS_dprint("WARNING unrecognized subject index, ignoring: " + index_path);
+        return false;
+    }
+    if (subjects != 0 && headers != subjects) {
+        FS_dprint("WARNING subject index does not match database (" + std::to_string(headers) + "/" +
+                  std::to_string(subjects) + " subjects), ignoring: " + index_path);
+        return false;
+    }
+
+    // Sizes are checked against the file before allocating
+    in_file.read((char*) &length, sizeof(length));
+    valid = in_file && length <= file_size;
+    _species.resize(valid ? length : 0);
+    for (std::string &name : _species) {
+        in_file.read((char*) &length, sizeof(length));
+        if (!(valid = in_file && length <= file_size)) break;
+        name.resize(length);
+        in_file.read(&name[0], length);
+    }
+    in_file.read((char*) &count, sizeof(count));
+    valid = valid && in_file && count <= file_size;
+    _ids.resize(valid ? count : 0);
+    in_file.read(&_ids[0], _ids.size());
+    in_file.read((char*) &count, sizeof(count));
+    valid = valid && in_file && count <= file_size / sizeof(SubjectInfo);
+    _subjects.resize(valid ? count : 0);
+    in_file.read((char*) _subjects.data(), _subjects.size() * sizeof(SubjectInfo));
+    valid = valid && in_file;
+    for (uint64 i = 0; valid && i < _subjects.size(); i++) {
+        const SubjectInfo &info = _subjects[i];
+        valid = info.id_offset <= _ids.size() && info.id_length <= _ids.size() - info.id_offset &&
+                info.accession_start <= info.id_length && info.species < _species.size() &&
+                (i == 0 || _subjects[i - 1].id_hash <= info.id_hash);
+    }
+    if (!valid) {
+        FS_dprint("WARNING subject index truncated or corrupt, ignoring: " + index_path);
+        _subjects.clear();
+        _species.clear();
+        _ids.clear();
+        return false;
+    }
+
+    _tax_entries.assign(_species.size(), TaxEntry());
+    _tax_resolved.assign(_species.size(), false);
+    _informative_valid = terms_hash == hash_terms(uninformative);
+    FS_dprint("Loaded subject index (" + std::to_string(_subjects.size()) + " subjects): " + index_path);
+    return true;
+}
+
+const SubjectIndex::SubjectInfo *SubjectIndex::find(const std::string &sseqid) const {
+    uint64 id_hash = hash_id(sseqid);
+    auto it = std::lower_bound(_subjects.begin(), _subjects.end(), id_hash,
+                               [](const SubjectInfo &info, uint64 hash) {return info.id_hash < hash;});
+    // Colliding IDs are stored next to each other
+    for (; it != _subjects.end() && it->id_hash == id_hash; ++it) {
+        if (_ids.compare(it->id_offset, it->id_length, sseqid) == 0) return &*it;
+    }
+    return nullptr;
+}
+
+const std::string &SubjectIndex::get_species(const SubjectInfo &info) const {
+    return _species[info.species];
+}
+
+std::string SubjectIndex::get_accession(const SubjectInfo &info) const {
+    return _ids.substr(info.id_offset + info.accession_start, info.id_length - info.accession_start);
+}
+
+const TaxEntry &SubjectIndex::get_tax_entry(const SubjectInfo &info, EntapDatabase *database) {
+    if (!_tax_resolved[info.species]) {
+        _tax_entries[info.species]  = database->get_tax_entry(_species[info.species]);
+        _tax_resolved[info.species] = true;
+    }
+    return _tax_entries[info.species];
+}
+
+bool SubjectIndex::has_informative() const {
+    return _informative_valid;
+}
+
+uint64 SubjectIndex::hash_terms(const vect_str_t &terms) {
+    uint64 hash = SimSearchCache::hash_sequence("");
+
+    for (const std::string &term : terms) hash = SimSearchCache::hash_sequence(term + '\n', hash);
+    return hash;
+}
+
+// FNV-1a, case sensitive unlike SimSearchCache::hash_sequence as IDs may differ only by case
+uint64 SubjectIndex::hash_id(const std::string &id) {
+    uint64 hash = 14695981039346656037ULL;
+    for (const char &c : id) {
+        hash ^= (uint8) c;
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+bool SubjectIndex::same_id(const std::string &ids, const SubjectInfo &a, const SubjectInfo &b) {
+    return ids.compare(a.id_offset, a.id_length, ids, b.id_offset, b.id_length) == 0;
+}
@@ -0,0 +1,98 @@
+/*
+ *
+ * Developed by Alexander Hart
+ * Plant Computational Genomics Lab
+ * University of Connecticut
+ *
+ * For information, contact Alexander Hart at:
+ *     entap.dev@gmail.com
+ *
+ * Copyright 2017-2019, Alexander Hart, Dr. Jill Wegrzyn
+ *
+ * This file is part of EnTAP.
+ *
+ * EnTAP is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * EnTAP is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with EnTAP.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef ENTAP_SUBJECTINDEX_H
+#define ENTAP_SUBJECTINDEX_H
+
+//*********************** Includes *****************************
+#include "../common.h"
+#include "../database/EntapDatabase.h"
+//**************************************************************
+
+
+/**
+ * Metadata for every subject of a DIAMOND database, built once from the
+ * database FASTA headers during configuration and written beside the
+ * DIAMOND database
+ *
+ * Each subject ID (first word of the header, as DIAMOND reports sseqid)
+ * is found by its hash and confirmed against the stored ID, and maps to a
+ * species, whether it is a UniProt subject (and its accession),
+ * and whether its title is informative. Species are stored once in a
+ * table and resolved to taxonomy the first time they are hit, so parsing
+ * is a single lookup per hit instead of scanning every title.
+ */
+class SubjectIndex {
+
+public:
+    typedef enum {
+        SUBJECT_UNIPROT     = (1 << 0),     // sp|/tr| formatted subject ID
+        SUBJECT_INFORMATIVE = (1 << 1)
+    } SUBJECT_FLAGS;
+
+    struct SubjectInfo {
+        uint64  id_hash;                // Subject ID hash, index is sorted by this (may repeat)
+        uint64  id_offset;              // Into subject ID table
+        uint32  id_length;
+        uint32  species;                // Into species table
+        uint16  accession_start;        // UniProt accession, from here to end of ID
+        uint16  flags;                  // SUBJECT_FLAGS
+    };
+
+    static const std::string INDEX_EXT;
+
+    SubjectIndex();
+    ~SubjectIndex() = default;
+
+    static uint64 build(FileSystem *filesystem, std::string &fasta_path, std::string &index_path,
+                        const vect_str_t &uninformative);
+    bool load(std::string &index_path, const vect_str_t &uninformative, uint64 subjects);
+    const SubjectInfo *find(const std::string &sseqid) const;
+    const std::string &get_species(const SubjectInfo &info) const;
+    std::string get_accession(const SubjectInfo &info) const;
+    const TaxEntry &get_tax_entry(const SubjectInfo &info, EntapDatabase *database);
+    bool has_informative() const;
+
+private:
+    static uint64 hash_terms(const vect_str_t &terms);
+    static uint64 hash_id(const std::string &id);
+    static bool same_id(const std::string &ids, const SubjectInfo &a, const SubjectInfo &b);
+
+    static const uint64 INDEX_MAGIC   = 0x78646e4970415445ULL;    // "ETApIndx"
+    static const uint32 INDEX_VERSION = 2;
+
+    std::vector<SubjectInfo> _subjects;         // Sorted by id_hash
+    vect_str_t               _species;
+    std::string              _ids;              // Every subject ID, concatenated
+    std::vector<TaxEntry>    _tax_entries;      // Per species, resolved on first hit
+    std::vector<bool>        _tax_resolved;
+    bool                     _informative_valid;    // Informative flags use the current uninformative terms
+    TaxEntry                 _empty_tax;
+};
+
+
+#endif //ENTAP_SUBJECTINDEX_H